@@ -0,0 +1,90 @@
+/** @file bench_util.h
+ * Timing and sample statistics shared by the BARSM and SIMM benchmarks.
+ *
+ * Every benchmark is a single source file, so the helpers are static inline
+ * rather than a source file of their own.
+ *
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ */
+
+#ifndef __BENCH_UTIL_H__
+#define __BENCH_UTIL_H__
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+/****************
+* FUNCTIONS
+****************/
+/**
+ * Reads the monotonic clock.
+ *
+ * @param[in] void
+ *
+ * @return the current CLOCK_MONOTONIC time in nanoseconds
+ */
+static inline uint64_t now_ns(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return ((uint64_t)now.tv_sec * 1000000000u) + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * qsort() comparison for uint64_t samples.
+ *
+ * @param[in] a: first sample
+ * @param[in] b: second sample
+ *
+ * @return <0, 0 or >0 as a is less than, equal to or greater than b
+ */
+static inline int compare_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+/**
+ * Sorts samples in ascending order, as percentile() expects them.
+ *
+ * @param[in,out] samples: the samples
+ * @param[in] num: the number of samples
+ *
+ * @return void
+ */
+static inline void sort_samples(uint64_t *samples, int32_t num)
+{
+    if ( 0 < num )
+    {
+        qsort(samples, (size_t)num, sizeof(samples[0]), compare_u64);
+    }
+}
+
+/**
+ * Picks a percentile of sorted samples: 0 is the minimum, 50 the median and
+ * 100 the maximum.
+ *
+ * @param[in] samples: the samples, sorted by sort_samples()
+ * @param[in] num: the number of samples
+ * @param[in] pct: the percentile, 0 to 100
+ *
+ * @return the sample at that percentile, 0 without samples
+ */
+static inline uint64_t percentile(const uint64_t *samples, int32_t num, int32_t pct)
+{
+    int32_t i = (int32_t)(((int64_t)num * pct) / 100);
+
+    if ( i >= num )
+    {
+        i = num - 1;
+    }
+
+    return (0 < num) ? samples[i] : 0;
+}
+
+#endif
@@ -0,0 +1,901 @@
+/**
+ * File: boot_bench.c
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ *
+ * Description:
+ *   Measures how fast BARSM boots and restarts a system of dummy items. Every
+ *   run installs boot_dummy as the AACM item and as the given number of items
+ *   spread over the modules/applications directories of
+ *   BOOT_BENCH_ROOT/opt/rc360, starts boot_barsm, a BARSM built to run on that
+ *   tree, and plays AACM itself: it answers the INIT on the AF_UNIX control
+ *   socket (see AACM_SOCKET_ENV), the OPEN on UDP with SYS_INIT, and ACKs
+ *   every BARSM_TO_AACM. Once the process list has arrived it kills items one
+ *   at a time and times how long BARSM takes to have each running again,
+ *   then stops BARSM.
+ *
+ *   Per run it prints the time from starting BARSM until the AACM connection,
+ *   until every dummy has reported that it started, until SYS_INIT and until
+ *   the process list, the restart latencies and the CPU time of BARSM and
+ *   everything it reaped. The time to SYS_INIT includes BARSM's fixed settle
+ *   time before the OPEN. The summary takes the median of each over the
+ *   runs, and the victims are drawn from a fixed seed, so two builds can be
+ *   compared by running both with the same arguments on an idle system.
+ *
+ *   The dummies report to the benchmark when they have started, see
+ *   boot_bench.h, and can be told to burn CPU and touch memory first. The
+ *   benchmark binds the AACM UDP port and multicast group, so no real AACM may
+ *   be running.
+ *
+ *   Usage: boot_bench [-n items] [-r runs] [-k crashes] [-g gap ms]
+ *                     [-w work ms] [-m memory KB] [-R] [-s seed]
+ *   Defaults: 32 items, 5 runs, 8 crashes 250 ms apart, no work, no memory,
+ *   seed 1. -R gives every item ready=notify, so the boot waits for each one
+ *   to signal readiness.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <limits.h>
+#include <libgen.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "barsm_functions.h"
+#include "boot_bench.h"
+#include "bench_util.h"
+
+#define DEFAULT_ITEMS           32
+#define DEFAULT_RUNS            5
+#define DEFAULT_CRASHES         8
+#define DEFAULT_GAP_MS          250
+#define DEFAULT_SEED            1
+/* Room for the AACM item and BARSM in the process table */
+#define MAX_ITEMS               (MAX_PROCS - 2)
+#define MAX_RUNS                100
+/* Longest a run may take to boot, or an item to be restarted */
+#define BOOT_TIMEOUT_MS         30000
+#define RESTART_TIMEOUT_MS      10000
+#define STOP_TIMEOUT_MS         10000
+
+/* Where AACM is reached, see barsm_functions.c */
+#define AACM_UDP_GROUP          "225.0.0.37"
+#define AACM_UDP_PORT           4096
+
+#define TREE                    BOOT_BENCH_ROOT "/opt/rc360"
+#define AACM_SOCKET             BOOT_BENCH_ROOT "/aacm.sock"
+#define REPORT_SOCKET           BOOT_BENCH_ROOT "/report.sock"
+#define BARSM_LOG               BOOT_BENCH_ROOT "/barsm.log"
+
+/****************
+* PRIVATE DATA TYPES
+****************/
+struct bench_options_struct
+{
+    int32_t items;
+    int32_t runs;
+    int32_t crashes;
+    int32_t gap_ms;
+    int32_t work_ms;
+    int32_t memory_kb;
+    bool notify;
+    uint32_t seed;
+};
+typedef struct bench_options_struct bench_options;
+
+/* A dummy as last reported */
+struct bench_item_struct
+{
+    char item[16];
+    pid_t pid;
+    uint64_t start_ns;
+};
+typedef struct bench_item_struct bench_item;
+
+/* What one run measured, times from starting BARSM */
+struct bench_run_struct
+{
+    uint64_t connect_ns;
+    uint64_t started_ns;
+    uint64_t sysinit_ns;
+    uint64_t procs_ns;
+    uint64_t cpu_us;
+    int32_t num_restarts;
+    uint64_t restart_ns[MAX_ITEMS];
+};
+typedef struct bench_run_struct bench_run;
+
+/* The state of the run in progress */
+struct bench_state_struct
+{
+    int32_t listenFd;
+    int32_t aacmFd;
+    int32_t udpFd;
+    int32_t reportFd;
+    pid_t barsm;
+    uint64_t start_ns;
+    bench_item items[MAX_ITEMS + 1];
+    int32_t num_items;
+    bench_run *run;
+};
+typedef struct bench_state_struct bench_state;
+
+/****************
+* PRIVATE GLOBALS
+****************/
+static const char *treeDirs[] = { "system", "modules/GE", "modules/TPA", "apps/GE", "apps/TPA" };
+static char barsmPath[PATH_MAX];
+static char dummyPath[PATH_MAX];
+static bench_run runs[MAX_RUNS];
+
+/****************
+* PRIVATE FUNCTION PROTOTYPES
+****************/
+static int remove_entry(const char *path, const struct stat *info, int flag, struct FTW *ftw);
+static bool copy_file(const char *from, const char *to);
+static bool install_tree(const bench_options *opts);
+static void remove_cgroups(void);
+static int32_t open_unix(const char *path, int32_t type);
+static int32_t open_udp(void);
+static bool start_barsm(bench_state *state, const bench_options *opts);
+static void handle_aacm(bench_state *state);
+static void handle_report(bench_state *state);
+static void pump(bench_state *state, int32_t timeout_ms);
+static bool run_once(const bench_options *opts, bench_run *run);
+static uint64_t median(uint64_t *samples, int32_t num);
+static void print_summary(const bench_options *opts);
+
+
+
+/**
+ * nftw() callback that removes everything it visits.
+ *
+ * @param[in] path: the entry
+ * @param[in] info: unused
+ * @param[in] flag: unused
+ * @param[in] ftw: unused
+ *
+ * @return 0 to carry on
+ */
+int remove_entry(const char *path, const struct stat *info, int flag, struct FTW *ftw)
+{
+    (void)info;
+    (void)flag;
+    (void)ftw;
+
+    remove(path);
+
+    return 0;
+}
+
+/**
+ * Copies an executable.
+ *
+ * @param[in] from: the source
+ * @param[in] to: the destination
+ *
+ * @return true/false whether the copy is complete
+ */
+bool copy_file(const char *from, const char *to)
+{
+    bool success = true;
+    char buf[8192];
+    ssize_t len;
+    int32_t in = open(from, O_RDONLY | O_CLOEXEC);
+    int32_t out = open(to, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0755);
+
+    success = (0 <= in) && (0 <= out);
+    while ( (true == success) && (0 < (len = read(in, buf, sizeof(buf)))) )
+    {
+        success = (len == write(out, buf, (size_t)len));
+    }
+
+    if ( 0 <= in )
+    {
+        close(in);
+    }
+    if ( (0 <= out) && (0 != close(out)) )
+    {
+        success = false;
+    }
+
+    return success;
+}
+
+/**
+ * Installs a fresh tree: boot_dummy as the AACM item and as the items,
+ * dealt over the modules/applications directories in turn.
+ *
+ * @param[in] opts: the options of the benchmark
+ *
+ * @return true/false whether the tree is complete
+ */
+bool install_tree(const bench_options *opts)
+{
+    bool success = true;
+    char path[PATH_MAX];
+    FILE *manifests[sizeof(treeDirs) / sizeof(treeDirs[0])] = { NULL };
+    int32_t dir;
+    int32_t i;
+
+    nftw(TREE, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    for ( dir = 0; (true == success) && (dir < (int32_t)(sizeof(treeDirs) / sizeof(treeDirs[0]))); dir++ )
+    {
+        snprintf(path, sizeof(path), "mkdir -p %s/%s", TREE, treeDirs[dir]);
+        success = (0 == system(path));
+        if ( (true == success) && (true == opts->notify) )
+        {
+            snprintf(path, sizeof(path), "%s/%s/.manifest", TREE, treeDirs[dir]);
+            manifests[dir] = fopen(path, "w");
+            success = (NULL != manifests[dir]);
+        }
+    }
+
+    snprintf(path, sizeof(path), "%s/system/aacm", TREE);
+    success = (true == success) && (true == copy_file(dummyPath, path));
+
+    for ( i = 0; (true == success) && (i < opts->items); i++ )
+    {
+        dir = 1 + (i % 4);
+        snprintf(path, sizeof(path), "%s/%s/dummy%03d", TREE, treeDirs[dir], i);
+        success = copy_file(dummyPath, path);
+        if ( NULL != manifests[dir] )
+        {
+            fprintf(manifests[dir], "dummy%03d   ready=notify\n", i);
+        }
+    }
+
+    for ( dir = 0; dir < (int32_t)(sizeof(treeDirs) / sizeof(treeDirs[0])); dir++ )
+    {
+        if ( (NULL != manifests[dir]) && (0 != fclose(manifests[dir])) )
+        {
+            success = false;
+        }
+    }
+
+    if ( true != success )
+    {
+        fprintf(stderr, "ERROR: unable to install the items in %s (%d:%s)\n",
+            TREE, errno, strerror(errno));
+    }
+
+    return success;
+}
+
+/**
+ * Removes the cgroups boot_barsm created below the cgroup of the benchmark,
+ * see barsm_cgroup.c. Only empty ones can be removed, the rest stays.
+ *
+ * @param[in] void
+ *
+ * @return void
+ */
+void remove_cgroups(void)
+{
+    static const char *mounts[] = { "/sys/fs/cgroup", "/sys/fs/cgroup/unified" };
+    char line[PATH_MAX];
+    char base[PATH_MAX];
+    char path[PATH_MAX * 2];
+    struct dirent *entry;
+    DIR *dir;
+    FILE *fp;
+    size_t i;
+
+    line[0] = '\0';
+    fp = fopen("/proc/self/cgroup", "re");
+    while ( (NULL != fp) && (NULL != fgets(line, sizeof(line), fp)) &&
+            (0 != strncmp(line, "0::", 3)) )
+    {
+        line[0] = '\0';
+    }
+    if ( NULL != fp )
+    {
+        fclose(fp);
+    }
+    line[strcspn(line, "\n")] = '\0';
+
+    for ( i = 0; (0 == strncmp(line, "0::", 3)) && (i < sizeof(mounts) / sizeof(mounts[0])); i++ )
+    {
+        snprintf(base, sizeof(base), "%s%s", mounts[i],
+                 (0 == strcmp(&line[3], "/")) ? "" : &line[3]);
+        snprintf(path, sizeof(path), "%s/%s", base, CGROUP_ITEMS);
+        dir = opendir(path);
+        while ( (NULL != dir) && (NULL != (entry = readdir(dir))) )
+        {
+            if ( (DT_DIR == entry->d_type) && ('.' != entry->d_name[0]) )
+            {
+                snprintf(path, sizeof(path), "%s/%s/%s", base, CGROUP_ITEMS, entry->d_name);
+                rmdir(path);
+            }
+        }
+        if ( NULL != dir )
+        {
+            closedir(dir);
+            snprintf(path, sizeof(path), "%s/%s", base, CGROUP_ITEMS);
+            rmdir(path);
+            snprintf(path, sizeof(path), "%s/%s", base, CGROUP_SELF);
+            rmdir(path);
+        }
+    }
+}
+
+/**
+ * Creates an AF_UNIX socket bound to a path.
+ *
+ * @param[in] path: the path
+ * @param[in] type: SOCK_SEQPACKET to listen on, SOCK_DGRAM to receive on
+ *
+ * @return the socket, -1 on failure
+ */
+int32_t open_unix(const char *path, int32_t type)
+{
+    int32_t fd;
+    struct sockaddr_un addr;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+    unlink(path);
+
+    fd = socket(AF_UNIX, type | SOCK_CLOEXEC, 0);
+    if ( (0 <= fd) &&
+         ((0 != bind(fd, (struct sockaddr *)&addr, sizeof(addr))) ||
+          ((SOCK_SEQPACKET == type) && (0 != listen(fd, 1)))) )
+    {
+        close(fd);
+        fd = -1;
+    }
+
+    if ( 0 > fd )
+    {
+        fprintf(stderr, "ERROR: unable to open %s (%d:%s)\n", path, errno, strerror(errno));
+    }
+
+    return fd;
+}
+
+/**
+ * Joins the multicast group BARSM sends its OPEN to.
+ *
+ * @param[in] void
+ *
+ * @return the socket, -1 on failure
+ */
+int32_t open_udp(void)
+{
+    int32_t fd;
+    int32_t reuse = 1;
+    struct sockaddr_in addr;
+    struct ip_mreq mreq;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(AACM_UDP_PORT);
+    inet_pton(AF_INET, AACM_UDP_GROUP, &addr.sin_addr);
+    mreq.imr_multiaddr = addr.sin_addr;
+    mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+
+    fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if ( (0 <= fd) &&
+         ((0 != setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse))) ||
+          (0 != bind(fd, (struct sockaddr *)&addr, sizeof(addr))) ||
+          (0 != setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)))) )
+    {
+        close(fd);
+        fd = -1;
+    }
+
+    if ( 0 > fd )
+    {
+        fprintf(stderr, "ERROR: unable to join %s:%d (%d:%s)\n",
+            AACM_UDP_GROUP, AACM_UDP_PORT, errno, strerror(errno));
+    }
+
+    return fd;
+}
+
+/**
+ * Starts boot_barsm with its output in BARSM_LOG and the environment of the
+ * dummies.
+ *
+ * @param[out] state: the run, gets the PID and the start time
+ * @param[in] opts: the options of the benchmark
+ *
+ * @return true/false whether BARSM was started
+ */
+bool start_barsm(bench_state *state, const bench_options *opts)
+{
+    char number[16];
+    int32_t fd;
+
+    state->start_ns = now_ns();
+    state->barsm = fork();
+    if ( 0 == state->barsm )
+    {
+        fd = open(BARSM_LOG, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if ( 0 <= fd )
+        {
+            dup2(fd, STDOUT_FILENO);
+            dup2(fd, STDERR_FILENO);
+        }
+
+        setenv(AACM_SOCKET_ENV, AACM_SOCKET, 1);
+        setenv(BOOT_BENCH_SOCKET_ENV, REPORT_SOCKET, 1);
+        snprintf(number, sizeof(number), "%d", opts->work_ms);
+        setenv(BOOT_DUMMY_WORK_ENV, number, 1);
+        snprintf(number, sizeof(number), "%d", opts->memory_kb);
+        setenv(BOOT_DUMMY_MEMORY_ENV, number, 1);
+
+        execl(barsmPath, barsmPath, (char *)NULL);
+        _exit(127);
+    }
+
+    if ( -1 == state->barsm )
+    {
+        fprintf(stderr, "ERROR: unable to start %s (%d:%s)\n", barsmPath, errno, strerror(errno));
+    }
+
+    return (0 < state->barsm);
+}
+
+/**
+ * Answers one message from BARSM on the AACM connection.
+ *
+ * @param[in,out] state: the run
+ *
+ * @return void
+ */
+void handle_aacm(bench_state *state)
+{
+    uint8_t msg[MAXBUFSIZE];
+    uint8_t reply[10];
+    uint16_t command = 0;
+    uint16_t val16;
+    uint32_t pid = 0;
+    ssize_t len;
+
+    len = recv(state->aacmFd, msg, sizeof(msg), 0);
+    if ( 0 >= len )
+    {
+        close(state->aacmFd);
+        state->aacmFd = -1;
+    }
+    else if ( 4 <= len )
+    {
+        memcpy(&command, msg, sizeof(command));
+    }
+
+    if ( CMD_BARSM_TO_AACM_INIT == command )
+    {
+        val16 = 0;
+        memcpy(reply, &val16, sizeof(val16));
+        val16 = CMD_BARSM_TO_AACM_INIT_ACK;
+        memcpy(&reply[2], &val16, sizeof(val16));
+        send(state->aacmFd, reply, 4, MSG_NOSIGNAL);
+    }
+    else if ( CMD_BARSM_TO_AACM_PROCESSES == command )
+    {
+        state->run->procs_ns = now_ns() - state->start_ns;
+    }
+    else if ( (CMD_BARSM_TO_AACM == command) && (8 <= len) )
+    {
+        memcpy(&pid, &msg[4], sizeof(pid));
+        val16 = CMD_BARSM_TO_AACM_ACK;
+        memcpy(reply, &val16, sizeof(val16));
+        val16 = sizeof(reply);
+        memcpy(&reply[2], &val16, sizeof(val16));
+        memcpy(&reply[4], &pid, sizeof(pid));
+        val16 = GE_SUCCESS;
+        memcpy(&reply[8], &val16, sizeof(val16));
+        send(state->aacmFd, reply, sizeof(reply), MSG_NOSIGNAL);
+    }
+    else
+    {
+        /* e.g. BARSM_TO_AACM_USAGE, nothing to answer */
+    }
+}
+
+/**
+ * Records the report of a dummy.
+ *
+ * @param[in,out] state: the run
+ *
+ * @return void
+ */
+void handle_report(bench_state *state)
+{
+    boot_report rep;
+    int32_t i;
+
+    if ( sizeof(rep) == recv(state->reportFd, &rep, sizeof(rep), 0) )
+    {
+        rep.item[sizeof(rep.item) - 1] = '\0';
+        for ( i = 0; (i < state->num_items) && (0 != strcmp(state->items[i].item, rep.item)); i++ )
+        {
+            /* find the item */
+        }
+
+        if ( (i == state->num_items) && (MAX_ITEMS >= i) )
+        {
+            memcpy(state->items[i].item, rep.item, sizeof(rep.item));
+            state->num_items++;
+        }
+        if ( i < state->num_items )
+        {
+            state->items[i].pid = rep.pid;
+            state->items[i].start_ns = rep.start_ns;
+        }
+    }
+}
+
+/**
+ * Handles whatever BARSM and the dummies send until the timeout.
+ *
+ * @param[in,out] state: the run
+ * @param[in] timeout_ms: how long to wait for something to happen
+ *
+ * @return void
+ */
+void pump(bench_state *state, int32_t timeout_ms)
+{
+    struct pollfd fds[4];
+    uint8_t msg[64];
+    uint16_t val16;
+    struct sockaddr_in from;
+    socklen_t fromLen = sizeof(from);
+
+    fds[0].fd = (0 > state->aacmFd) ? state->listenFd : -1;
+    fds[1].fd = state->aacmFd;
+    fds[2].fd = state->udpFd;
+    fds[3].fd = state->reportFd;
+    fds[0].events = fds[1].events = fds[2].events = fds[3].events = POLLIN;
+
+    if ( 0 < poll(fds, 4, timeout_ms) )
+    {
+        if ( 0 != fds[0].revents )
+        {
+            state->aacmFd = accept4(state->listenFd, NULL, NULL, SOCK_CLOEXEC);
+            state->run->connect_ns = now_ns() - state->start_ns;
+        }
+        if ( 0 != fds[1].revents )
+        {
+            handle_aacm(state);
+        }
+        if ( (0 != fds[2].revents) &&
+             (4 <= recvfrom(state->udpFd, msg, sizeof(msg), 0, (struct sockaddr *)&from, &fromLen)) )
+        {
+            memcpy(&val16, msg, sizeof(val16));
+            if ( CMD_OPEN == val16 )
+            {
+                val16 = CMD_SYSINIT;
+                memcpy(msg, &val16, sizeof(val16));
+                val16 = 0;
+                memcpy(&msg[2], &val16, sizeof(val16));
+                sendto(state->udpFd, msg, 4, 0, (struct sockaddr *)&from, fromLen);
+                state->run->sysinit_ns = now_ns() - state->start_ns;
+            }
+        }
+        if ( 0 != fds[3].revents )
+        {
+            handle_report(state);
+        }
+    }
+}
+
+/**
+ * Boots BARSM once, crashes items and stops it again.
+ *
+ * @param[in] opts: the options of the benchmark
+ * @param[out] run: what was measured
+ *
+ * @return true/false whether the run completed
+ */
+bool run_once(const bench_options *opts, bench_run *run)
+{
+    static bench_state state;
+    bool success = true;
+    int32_t victims[MAX_ITEMS];
+    int32_t numVictims = 0;
+    int32_t status;
+    int32_t i;
+    int32_t j;
+    uint64_t deadline;
+    uint64_t killed_ns;
+    pid_t oldPid;
+    struct rusage usage;
+
+    memset(run, 0, sizeof(*run));
+    memset(&state, 0, sizeof(state));
+    state.run = run;
+    state.aacmFd = -1;
+    state.barsm = -1;
+
+    success = install_tree(opts);
+    if ( true == success )
+    {
+        state.listenFd = open_unix(AACM_SOCKET, SOCK_SEQPACKET);
+        state.reportFd = open_unix(REPORT_SOCKET, SOCK_DGRAM);
+        state.udpFd = open_udp();
+        success = (0 <= state.listenFd) && (0 <= state.reportFd) && (0 <= state.udpFd) &&
+                  (true == start_barsm(&state, opts));
+    }
+
+    /* the boot: until the process list has arrived and every dummy has
+     * started */
+    deadline = now_ns() + ((uint64_t)BOOT_TIMEOUT_MS * 1000000u);
+    while ( (true == success) && ((0 == run->procs_ns) || (opts->items + 1 > state.num_items)) )
+    {
+        pump(&state, 100);
+        success = (now_ns() < deadline);
+    }
+    for ( i = 0; i < state.num_items; i++ )
+    {
+        if ( run->started_ns < state.items[i].start_ns - state.start_ns )
+        {
+            run->started_ns = state.items[i].start_ns - state.start_ns;
+        }
+    }
+    if ( true != success )
+    {
+        fprintf(stderr, "ERROR: BARSM did not boot within %d ms, see %s\n",
+            BOOT_TIMEOUT_MS, BARSM_LOG);
+    }
+
+    /* every item is crashed at most once, so the restart is never backed off
+     * as a crash loop */
+    for ( i = 0; i < state.num_items; i++ )
+    {
+        if ( 0 != strcmp(state.items[i].item, "aacm") )
+        {
+            victims[numVictims++] = i;
+        }
+    }
+    for ( i = numVictims - 1; 0 < i; i-- )
+    {
+        j = rand() % (i + 1);
+        status = victims[i];
+        victims[i] = victims[j];
+        victims[j] = status;
+    }
+
+    for ( i = 0; (true == success) && (i < opts->crashes) && (i < numVictims); i++ )
+    {
+        oldPid = state.items[victims[i]].pid;
+        killed_ns = now_ns();
+        kill(oldPid, SIGKILL);
+
+        deadline = killed_ns + ((uint64_t)RESTART_TIMEOUT_MS * 1000000u);
+        while ( (true == success) && (oldPid == state.items[victims[i]].pid) )
+        {
+            pump(&state, 100);
+            success = (now_ns() < deadline);
+        }
+        if ( true == success )
+        {
+            run->restart_ns[run->num_restarts++] = state.items[victims[i]].start_ns - killed_ns;
+        }
+        else
+        {
+            fprintf(stderr, "ERROR: %s was not restarted within %d ms\n",
+                state.items[victims[i]].item, RESTART_TIMEOUT_MS);
+        }
+
+        deadline = now_ns() + ((uint64_t)opts->gap_ms * 1000000u);
+        while ( now_ns() < deadline )
+        {
+            pump(&state, 10);
+        }
+    }
+
+    /* BARSM stops its children on SIGTERM, the rusage covers them as well */
+    if ( 0 < state.barsm )
+    {
+        kill(state.barsm, SIGTERM);
+        deadline = now_ns() + ((uint64_t)STOP_TIMEOUT_MS * 1000000u);
+        while ( (0 == wait4(state.barsm, &status, WNOHANG, &usage)) && (now_ns() < deadline) )
+        {
+            pump(&state, 10);
+        }
+        if ( now_ns() >= deadline )
+        {
+            kill(state.barsm, SIGKILL);
+            wait4(state.barsm, &status, 0, &usage);
+        }
+        run->cpu_us = ((uint64_t)usage.ru_utime.tv_sec * 1000000u) + (uint64_t)usage.ru_utime.tv_usec +
+                      ((uint64_t)usage.ru_stime.tv_sec * 1000000u) + (uint64_t)usage.ru_stime.tv_usec;
+    }
+    for ( i = 0; i < state.num_items; i++ )
+    {
+        /* in case BARSM left any behind */
+        kill(state.items[i].pid, SIGKILL);
+    }
+
+    if ( 0 <= state.aacmFd )
+    {
+        close(state.aacmFd);
+    }
+    if ( 0 <= state.listenFd )
+    {
+        close(state.listenFd);
+    }
+    if ( 0 <= state.reportFd )
+    {
+        close(state.reportFd);
+    }
+    if ( 0 <= state.udpFd )
+    {
+        close(state.udpFd);
+    }
+
+    return success;
+}
+
+/**
+ * Sorts samples and returns their median.
+ *
+ * @param[in,out] samples: the samples
+ * @param[in] num: the number of samples
+ *
+ * @return the median, 0 without samples
+ */
+uint64_t median(uint64_t *samples, int32_t num)
+{
+    sort_samples(samples, num);
+
+    return percentile(samples, num, 50);
+}
+
+/**
+ * Prints the median of every measurement over the runs and the distribution
+ * of all restart latencies.
+ *
+ * @param[in] opts: the options of the benchmark
+ *
+ * @return void
+ */
+void print_summary(const bench_options *opts)
+{
+    static uint64_t restarts[MAX_RUNS * MAX_ITEMS];
+    uint64_t samples[5][MAX_RUNS];
+    int32_t numRestarts = 0;
+    int32_t r;
+    int32_t i;
+
+    for ( r = 0; r < opts->runs; r++ )
+    {
+        samples[0][r] = runs[r].connect_ns;
+        samples[1][r] = runs[r].started_ns;
+        samples[2][r] = runs[r].sysinit_ns;
+        samples[3][r] = runs[r].procs_ns;
+        samples[4][r] = runs[r].cpu_us;
+        for ( i = 0; i < runs[r].num_restarts; i++ )
+        {
+            restarts[numRestarts++] = runs[r].restart_ns[i];
+        }
+    }
+
+    printf("\nmedian of %d runs with %d items:\n", opts->runs, opts->items);
+    printf("  AACM connected   %10.3f ms\n", (double)median(samples[0], opts->runs) / 1e6);
+    printf("  all started      %10.3f ms\n", (double)median(samples[1], opts->runs) / 1e6);
+    printf("  SYS_INIT         %10.3f ms\n", (double)median(samples[2], opts->runs) / 1e6);
+    printf("  process list     %10.3f ms\n", (double)median(samples[3], opts->runs) / 1e6);
+    printf("  BARSM CPU        %10.3f ms\n", (double)median(samples[4], opts->runs) / 1e3);
+
+    sort_samples(restarts, numRestarts);
+    if ( 0 < numRestarts )
+    {
+        printf("restart latency of %d crashes: min %.3f p50 %.3f p90 %.3f max %.3f ms\n",
+            numRestarts, (double)percentile(restarts, numRestarts, 0) / 1e6,
+            (double)percentile(restarts, numRestarts, 50) / 1e6,
+            (double)percentile(restarts, numRestarts, 90) / 1e6,
+            (double)percentile(restarts, numRestarts, 100) / 1e6);
+    }
+}
+
+/**
+ * Runs the benchmark.
+ *
+ * @param[in] argc: number of arguments
+ * @param[in] argv: see the usage above
+ *
+ * @return 0 on success, 1 on failure
+ */
+int main(int argc, char *argv[])
+{
+    bool success = true;
+    bench_options opts = { DEFAULT_ITEMS, DEFAULT_RUNS, DEFAULT_CRASHES, DEFAULT_GAP_MS,
+                           0, 0, false, DEFAULT_SEED };
+    char self[PATH_MAX - 16];
+    ssize_t len;
+    int32_t opt;
+    int32_t r;
+    int32_t i;
+
+    while ( -1 != (opt = getopt(argc, argv, "n:r:k:g:w:m:Rs:")) )
+    {
+        switch ( opt )
+        {
+            case 'n': opts.items = atoi(optarg); break;
+            case 'r': opts.runs = atoi(optarg); break;
+            case 'k': opts.crashes = atoi(optarg); break;
+            case 'g': opts.gap_ms = atoi(optarg); break;
+            case 'w': opts.work_ms = atoi(optarg); break;
+            case 'm': opts.memory_kb = atoi(optarg); break;
+            case 'R': opts.notify = true; break;
+            case 's': opts.seed = (uint32_t)strtoul(optarg, NULL, 10); break;
+            default: success = false; break;
+        }
+    }
+    if ( (true != success) || (1 > opts.items) || (MAX_ITEMS < opts.items) ||
+         (1 > opts.runs) || (MAX_RUNS < opts.runs) || (0 > opts.crashes) ||
+         (0 > opts.gap_ms) || (0 > opts.work_ms) || (0 > opts.memory_kb) )
+    {
+        fprintf(stderr, "Usage: %s [-n items] [-r runs] [-k crashes] [-g gap ms] "
+            "[-w work ms] [-m memory KB] [-R] [-s seed]\n", argv[0]);
+        success = false;
+    }
+
+    /* boot_barsm and boot_dummy are built next to the benchmark */
+    len = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    if ( (true == success) && (0 < len) )
+    {
+        self[len] = '\0';
+        snprintf(barsmPath, sizeof(barsmPath), "%s/boot_barsm", dirname(self));
+        snprintf(dummyPath, sizeof(dummyPath), "%s/boot_dummy", self);
+        success = (0 == access(barsmPath, X_OK)) && (0 == access(dummyPath, X_OK));
+        if ( true != success )
+        {
+            fprintf(stderr, "ERROR: %s or %s is missing, build them with 'make bench'\n",
+                barsmPath, dummyPath);
+        }
+    }
+
+    if ( true == success )
+    {
+        mkdir(BOOT_BENCH_ROOT, 0755);
+        signal(SIGPIPE, SIG_IGN);
+        srand(opts.seed);
+        printf("%d items, %d crashes %d ms apart, %d ms work, %d KB memory, ready=%s\n",
+            opts.items, opts.crashes, opts.gap_ms, opts.work_ms, opts.memory_kb,
+            (true == opts.notify) ? "notify" : "settle");
+    }
+
+    for ( r = 0; (true == success) && (r < opts.runs); r++ )
+    {
+        success = run_once(&opts, &runs[r]);
+        printf("run %d: connected %.3f started %.3f SYS_INIT %.3f list %.3f ms, CPU %.3f ms,"
+            " restarts", r + 1, (double)runs[r].connect_ns / 1e6,
+            (double)runs[r].started_ns / 1e6, (double)runs[r].sysinit_ns / 1e6,
+            (double)runs[r].procs_ns / 1e6, (double)runs[r].cpu_us / 1e3);
+        for ( i = 0; i < runs[r].num_restarts; i++ )
+        {
+            printf(" %.3f", (double)runs[r].restart_ns[i] / 1e6);
+        }
+        printf(" ms\n");
+    }
+
+    if ( true == success )
+    {
+        print_summary(&opts);
+        nftw(BOOT_BENCH_ROOT "/opt", remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+    }
+    remove_cgroups();
+
+    return (true == success) ? 0 : 1;
+}
@@ -0,0 +1,41 @@
+/** @file boot_bench.h
+ * Shared between the boot benchmark and the dummy items it installs.
+ *
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ */
+
+#ifndef __BARSM_BOOT_BENCH_H__
+#define __BARSM_BOOT_BENCH_H__
+
+#include <stdint.h>
+
+/****************
+* CONSTANTS
+****************/
+/* Scratch directory of the benchmark, the bench BARSM is built to run on
+ * BOOT_BENCH_ROOT/opt/rc360 */
+#ifndef BOOT_BENCH_ROOT
+#define BOOT_BENCH_ROOT         "/tmp/barsm_boot_bench"
+#endif
+
+/* Environment of the dummies, passed through BARSM */
+#define BOOT_BENCH_SOCKET_ENV   "BOOT_BENCH_SOCKET"     /* where to report */
+#define BOOT_DUMMY_WORK_ENV     "BOOT_DUMMY_WORK_MS"    /* CPU time to burn */
+#define BOOT_DUMMY_MEMORY_ENV   "BOOT_DUMMY_MEMORY_KB"  /* memory to touch */
+
+/****************
+* DATA TYPES
+****************/
+/* Sent by a dummy once it has done its startup work, and signalled readiness
+ * if it was asked to */
+struct boot_report_struct
+{
+    uint64_t start_ns;          /* CLOCK_MONOTONIC when main() was entered */
+    uint64_t ready_ns;          /* CLOCK_MONOTONIC after the startup work */
+    int32_t pid;
+    char item[16];              /* its item name, NUL terminated */
+    char proc_name[8];          /* the name BARSM gave it, NUL terminated */
+};
+typedef struct boot_report_struct boot_report;
+
+#endif
@@ -0,0 +1,150 @@
+/**
+ * File: boot_dummy.c
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ *
+ * Description:
+ *   Dummy module/application installed by boot_bench. It burns
+ *   BOOT_DUMMY_WORK_MS of CPU time and touches BOOT_DUMMY_MEMORY_KB of memory
+ *   to stand in for the startup of a real item, signals readiness when BARSM
+ *   gave it a readiness pipe, reports to the benchmark on BOOT_BENCH_SOCKET
+ *   and then sleeps until it is killed.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "barsm_spawn.h"
+#include "boot_bench.h"
+
+/****************
+* PRIVATE FUNCTION PROTOTYPES
+****************/
+static uint64_t now_ns(void);
+static long env_number(const char *name);
+static void report(const boot_report *rep);
+
+
+
+/**
+ * Reads the monotonic clock.
+ *
+ * @param[in] void
+ *
+ * @return the current CLOCK_MONOTONIC time in nanoseconds
+ */
+uint64_t now_ns(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return ((uint64_t)now.tv_sec * 1000000000u) + (uint64_t)now.tv_nsec;
+}
+
+/**
+ * Reads a number from the environment.
+ *
+ * @param[in] name: the environment variable
+ *
+ * @return its value, 0 if it is not set
+ */
+long env_number(const char *name)
+{
+    const char *value = getenv(name);
+
+    return (NULL != value) ? strtol(value, NULL, 10) : 0;
+}
+
+/**
+ * Sends the report to the benchmark.
+ *
+ * @param[in] rep: the report
+ *
+ * @return void
+ */
+void report(const boot_report *rep)
+{
+    const char *path = getenv(BOOT_BENCH_SOCKET_ENV);
+    struct sockaddr_un addr;
+    int32_t fd;
+
+    if ( NULL != path )
+    {
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+        fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        if ( (0 > fd) ||
+             (sizeof(*rep) != sendto(fd, rep, sizeof(*rep), 0,
+                                     (struct sockaddr *)&addr, sizeof(addr))) )
+        {
+            perror("boot_dummy: report");
+        }
+        if ( 0 <= fd )
+        {
+            close(fd);
+        }
+    }
+}
+
+/**
+ * Starts up like an item and sleeps.
+ *
+ * @param[in] argc: number of arguments
+ * @param[in] argv: item name and the name BARSM gave it
+ *
+ * @return never returns
+ */
+int main(int argc, char *argv[])
+{
+    boot_report rep;
+    uint64_t deadline;
+    long memoryKb = env_number(BOOT_DUMMY_MEMORY_ENV);
+    volatile uint8_t *memory;
+    long i;
+    uint8_t byte = 1;
+
+    memset(&rep, 0, sizeof(rep));
+    rep.start_ns = now_ns();
+    rep.pid = (int32_t)getpid();
+    strncpy(rep.item, argv[0], sizeof(rep.item) - 1);
+    if ( 1 < argc )
+    {
+        strncpy(rep.proc_name, argv[1], sizeof(rep.proc_name) - 1);
+    }
+
+    deadline = rep.start_ns + ((uint64_t)env_number(BOOT_DUMMY_WORK_ENV) * 1000000u);
+    while ( now_ns() < deadline )
+    {
+        /* burn CPU */
+    }
+
+    memory = (0 < memoryKb) ? malloc((size_t)memoryKb * 1024u) : NULL;
+    for ( i = 0; (NULL != memory) && (i < memoryKb * 1024); i += 4096 )
+    {
+        memory[i] = (uint8_t)i;
+    }
+
+    if ( (NULL != getenv(SPAWN_READY_FD_ENV)) &&
+         (sizeof(byte) != write(SPAWN_READY_FD, &byte, sizeof(byte))) )
+    {
+        perror("boot_dummy: ready");
+    }
+
+    rep.ready_ns = now_ns();
+    report(&rep);
+
+    while ( true )
+    {
+        pause();
+    }
+}
@@ -0,0 +1,50 @@
+/**
+ * File: zygote_dummy.c
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ *
+ * Description:
+ *   Minimal item used by zygote_bench. It is built twice: as a shared object
+ *   the zygote starts at zygote_dummy_main(), and with -DZYGOTE_DUMMY_EXEC as
+ *   a program BARSM would exec. Both do nothing but return, so the benchmark
+ *   only measures what it takes to get the item running.
+ */
+
+#include <stdlib.h>
+
+/****************
+* FUNCTION PROTOTYPES
+****************/
+int zygote_dummy_main(int argc, char *argv[]);
+
+
+
+/**
+ * Entry of the item.
+ *
+ * @param[in] argc: number of arguments
+ * @param[in] argv: the arguments
+ *
+ * @return 0
+ */
+int zygote_dummy_main(int argc, char *argv[])
+{
+    (void)argc;
+    (void)argv;
+
+    return EXIT_SUCCESS;
+}
+
+#ifdef ZYGOTE_DUMMY_EXEC
+/**
+ * Runs the item as a program.
+ *
+ * @param[in] argc: number of arguments
+ * @param[in] argv: the arguments
+ *
+ * @return the exit status of the entry
+ */
+int main(int argc, char *argv[])
+{
+    return zygote_dummy_main(argc, argv);
+}
+#endif
@@ -0,0 +1,177 @@
+/**
+ * File: spawn_bench.c
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ *
+ * Description:
+ *   Compares the restart latency of the BARSM spawn backends. The process
+ *   first grows its heap to stand in for the strings and socket state a long
+ *   running BARSM holds, then repeatedly launches a program with each backend
+ *   and times how long it takes until the exec is confirmed, which is the
+ *   latency start_process() adds to every restart.
+ *
+ *   Usage: spawn_bench [iterations] [heap MB] [program]
+ *   Defaults: 500 iterations, 64 MB of heap, /bin/true
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "barsm_spawn.h"
+#include "bench_util.h"
+
+#define DEFAULT_ITERATIONS      500
+#define DEFAULT_HEAP_MB         64
+
+/****************
+* PRIVATE FUNCTION PROTOTYPES
+****************/
+static bool run_backend(enum spawn_backend backend, const char *name,
+    const char *program, int32_t iterations, uint64_t *samples);
+
+
+
+/**
+ * Launches program iterations times with one backend and prints the latency
+ * from the start of the spawn until the exec is confirmed.
+ *
+ * @param[in] backend: the spawn backend to measure
+ * @param[in] name: label for the output
+ * @param[in] program: the program to launch
+ * @param[in] iterations: number of launches
+ * @param[in] samples: scratch space for iterations samples
+ *
+ * @return true/false whether every launch succeeded
+ */
+bool run_backend(enum spawn_backend backend, const char *name,
+    const char *program, int32_t iterations, uint64_t *samples)
+{
+    bool success = true;
+    int32_t i;
+    int32_t rc;
+    int32_t status_fd;
+    int32_t status;
+    uint64_t start;
+    uint64_t total = 0;
+    pid_t pid;
+    char *argv[2];
+    spawn_request req;
+
+    argv[0] = (char *)(uintptr_t)program;
+    argv[1] = NULL;
+    req.path = program;
+    req.argv = argv;
+    req.envp = NULL;
+    req.ready_fd = -1;
+    req.heartbeat_fd = -1;
+    req.listen_fds = NULL;
+    req.num_listen_fds = 0;
+    req.sched = NULL;
+    req.cgroup_fd = -1;
+
+    for ( i = 0; (i < iterations) && (true == success); i++ )
+    {
+        start = now_ns();
+        rc = spawn_process(backend, &req, &pid, &status_fd);
+        if ( (0 == rc) && (0 <= status_fd) )
+        {
+            rc = spawn_confirm(status_fd);
+        }
+        samples[i] = now_ns() - start;
+        total += samples[i];
+
+        if ( 0 != pid )
+        {
+            waitpid(pid, &status, 0);
+        }
+
+        if ( 0 != rc )
+        {
+            printf("ERROR: %s launch of %s failed! (%d:%s)\n",
+                name, program, rc, strerror(rc));
+            success = false;
+        }
+    }
+
+    if ( true == success )
+    {
+        sort_samples(samples, iterations);
+        printf("%-12s mean %8.1f us  min %8.1f us  p50 %8.1f us  p99 %8.1f us\n",
+            name,
+            (double)total / iterations / 1000.0,
+            (double)percentile(samples, iterations, 0) / 1000.0,
+            (double)percentile(samples, iterations, 50) / 1000.0,
+            (double)percentile(samples, iterations, 99) / 1000.0);
+    }
+
+    return success;
+}
+
+/**
+ * Runs the benchmark for both backends.
+ *
+ * @param[in] argc: number of arguments
+ * @param[in] argv: [iterations] [heap MB] [program]
+ *
+ * @return 0 on success, 1 on failure
+ */
+int main(int argc, char *argv[])
+{
+    bool success = true;
+    int32_t iterations = DEFAULT_ITERATIONS;
+    size_t heapMb = DEFAULT_HEAP_MB;
+    const char *program = "/bin/true";
+    uint8_t *heap;
+    uint64_t *samples;
+
+    if ( 1 < argc )
+    {
+        iterations = atoi(argv[1]);
+    }
+    if ( 2 < argc )
+    {
+        heapMb = (size_t)atoi(argv[2]);
+    }
+    if ( 3 < argc )
+    {
+        program = argv[3];
+    }
+    if ( 0 >= iterations )
+    {
+        iterations = DEFAULT_ITERATIONS;
+    }
+
+    /* touch every page so that fork() has page tables to copy */
+    heap = (uint8_t *)malloc((heapMb * 1024 * 1024) + 1);
+    samples = (uint64_t *)malloc((size_t)iterations * sizeof(uint64_t));
+    if ( (NULL == heap) || (NULL == samples) )
+    {
+        printf("ERROR: unable to allocate %zu MB of heap\n", heapMb);
+        success = false;
+    }
+    else
+    {
+        memset(heap, 0xA5, (heapMb * 1024 * 1024) + 1);
+        printf("%d launches of %s with %zu MB of resident heap\n",
+            iterations, program, heapMb);
+    }
+
+    if ( true == success )
+    {
+        success = run_backend(SPAWN_FORK, "fork", program, iterations, samples);
+    }
+    if ( true == success )
+    {
+        success = run_backend(SPAWN_POSIX, "posix_spawn", program, iterations, samples);
+    }
+
+    free(samples);
+    free(heap);
+
+    return (true == success) ? 0 : 1;
+}
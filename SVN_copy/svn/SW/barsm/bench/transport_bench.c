@@ -0,0 +1,380 @@
+/**
+ * File: transport_bench.c
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ *
+ * Description:
+ *   Compares the round trip latency of the AACM control channel over TCP
+ *   loopback and over an AF_UNIX SOCK_SEQPACKET socket, see AACMsetup(). A
+ *   forked stand-in for AACM answers every REGISTER_APP with a
+ *   REGISTER_APP_ACK and echoes every HEARTBEAT; the client times each message
+ *   from its send() until the whole reply is received.
+ *
+ *   Usage: transport_bench [iterations]
+ *   Defaults: 20000 iterations of each message on each transport
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "bench_util.h"
+
+#define DEFAULT_ITERATIONS      20000
+
+/* the messages of the AACM protocol being timed, see simm_functions.c */
+#define CMD_REGISTER_APP        0x0001
+#define CMD_REGISTER_APP_ACK    0x0002
+#define CMD_HEARTBEAT           0x0007
+#define REGISTER_APP_SIZE       13
+#define REGISTER_APP_ACK_SIZE   6
+#define HEARTBEAT_SIZE          4
+#define MAX_MSG_SIZE            64
+
+/****************
+* PRIVATE FUNCTION PROTOTYPES
+****************/
+static bool recv_all(int32_t fd, uint8_t *buf, size_t len);
+static void serve(int32_t listenFd, bool packet);
+static pid_t start_server(int32_t domain, int32_t type, struct sockaddr_storage *addr,
+    socklen_t *addrLen);
+static bool run_message(int32_t fd, const char *name, const uint8_t *msg, size_t msgLen,
+    size_t replyLen, int32_t iterations, uint64_t *samples);
+static bool run_transport(int32_t domain, int32_t type, const char *name,
+    int32_t iterations, uint64_t *samples);
+
+
+
+/**
+ * Receives exactly len bytes, the way a TCP client has to. A SOCK_SEQPACKET
+ * message always arrives with the first recv().
+ *
+ * @param[in] fd: the connected socket
+ * @param[out] buf: the bytes received
+ * @param[in] len: the number of bytes to receive
+ *
+ * @return true/false whether all of them were received
+ */
+bool recv_all(int32_t fd, uint8_t *buf, size_t len)
+{
+    bool success = true;
+    size_t got = 0;
+    ssize_t rc;
+
+    while ( (true == success) && (got < len) )
+    {
+        rc = recv(fd, &buf[got], len - got, 0);
+        if ( 0 >= rc )
+        {
+            success = false;
+        }
+        else
+        {
+            got += (size_t)rc;
+        }
+    }
+
+    return success;
+}
+
+/**
+ * Runs in the forked AACM stand-in: answers the messages of one client until
+ * it disconnects. Never returns.
+ *
+ * @param[in] listenFd: the listening socket
+ * @param[in] packet: whether every recv() returns one whole message; a stream
+ *      is read header first, like AACM has to
+ *
+ * @return void
+ */
+void serve(int32_t listenFd, bool packet)
+{
+    bool received = true;
+    int32_t fd;
+    uint16_t cmd = 0;
+    uint16_t val16;
+    uint8_t msg[MAX_MSG_SIZE];
+    uint8_t ack[REGISTER_APP_ACK_SIZE];
+
+    fd = accept(listenFd, NULL, NULL);
+    while ( (0 <= fd) && (true == received) )
+    {
+        if ( true == packet )
+        {
+            received = (HEARTBEAT_SIZE <= recv(fd, msg, sizeof(msg), 0));
+        }
+        else
+        {
+            received = recv_all(fd, msg, HEARTBEAT_SIZE);
+            memcpy(&cmd, msg, sizeof(cmd));
+            if ( (true == received) && (CMD_REGISTER_APP == cmd) )
+            {
+                received = recv_all(fd, &msg[HEARTBEAT_SIZE],
+                                    REGISTER_APP_SIZE - HEARTBEAT_SIZE);
+            }
+        }
+
+        memcpy(&cmd, msg, sizeof(cmd));
+        if ( false == received )
+        {
+            /* the client disconnected */
+        }
+        else if ( CMD_REGISTER_APP == cmd )
+        {
+            val16 = CMD_REGISTER_APP_ACK;
+            memcpy(ack, &val16, sizeof(val16));
+            val16 = REGISTER_APP_ACK_SIZE - 4;
+            memcpy(&ack[2], &val16, sizeof(val16));
+            val16 = 0;
+            memcpy(&ack[4], &val16, sizeof(val16));
+            send(fd, ack, sizeof(ack), 0);
+        }
+        else
+        {
+            send(fd, msg, HEARTBEAT_SIZE, 0);
+        }
+    }
+
+    _exit(0);
+}
+
+/**
+ * Forks the AACM stand-in listening on a new socket of the given transport.
+ *
+ * @param[in] domain: AF_INET or AF_UNIX
+ * @param[in] type: SOCK_STREAM or SOCK_SEQPACKET
+ * @param[out] addr: the address the stand-in listens on
+ * @param[out] addrLen: the size of addr
+ *
+ * @return the PID of the stand-in, -1 if it could not be started
+ */
+pid_t start_server(int32_t domain, int32_t type, struct sockaddr_storage *addr,
+    socklen_t *addrLen)
+{
+    int32_t fd;
+    pid_t pid = -1;
+    struct sockaddr_in *in = (struct sockaddr_in *)addr;
+    struct sockaddr_un *un = (struct sockaddr_un *)addr;
+
+    memset(addr, 0, sizeof(*addr));
+    if ( AF_INET == domain )
+    {
+        /* an ephemeral port, so that a running AACM is not in the way */
+        in->sin_family = AF_INET;
+        in->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        *addrLen = sizeof(*in);
+    }
+    else
+    {
+        un->sun_family = AF_UNIX;
+        snprintf(un->sun_path, sizeof(un->sun_path), "/tmp/transport_bench.%d", getpid());
+        unlink(un->sun_path);
+        *addrLen = sizeof(*un);
+    }
+
+    fd = socket(domain, type, 0);
+    if ( (0 <= fd) && (0 == bind(fd, (struct sockaddr *)addr, *addrLen)) &&
+         (0 == listen(fd, 1)) &&
+         (0 == getsockname(fd, (struct sockaddr *)addr, addrLen)) )
+    {
+        pid = fork();
+        if ( 0 == pid )
+        {
+            serve(fd, (SOCK_SEQPACKET == type));
+        }
+    }
+
+    if ( 0 <= fd )
+    {
+        close(fd);
+    }
+
+    return pid;
+}
+
+/**
+ * Sends one message iterations times and prints the round trip latency.
+ *
+ * @param[in] fd: the connected socket
+ * @param[in] name: label for the output
+ * @param[in] msg: the message
+ * @param[in] msgLen: the size of the message
+ * @param[in] replyLen: the size of the reply
+ * @param[in] iterations: number of round trips
+ * @param[in] samples: scratch space for iterations samples
+ *
+ * @return true/false whether every round trip succeeded
+ */
+bool run_message(int32_t fd, const char *name, const uint8_t *msg, size_t msgLen,
+    size_t replyLen, int32_t iterations, uint64_t *samples)
+{
+    bool success = true;
+    int32_t i;
+    uint64_t start;
+    uint64_t total = 0;
+    uint8_t reply[MAX_MSG_SIZE];
+
+    for ( i = 0; (i < iterations) && (true == success); i++ )
+    {
+        start = now_ns();
+        success = ((ssize_t)msgLen == send(fd, msg, msgLen, 0)) &&
+                  (true == recv_all(fd, reply, replyLen));
+        samples[i] = now_ns() - start;
+        total += samples[i];
+    }
+
+    if ( true == success )
+    {
+        sort_samples(samples, iterations);
+        printf("%-24s mean %6.1f us  min %6.1f us  p50 %6.1f us  p99 %6.1f us\n",
+            name,
+            (double)total / iterations / 1000.0,
+            (double)percentile(samples, iterations, 0) / 1000.0,
+            (double)percentile(samples, iterations, 50) / 1000.0,
+            (double)percentile(samples, iterations, 99) / 1000.0);
+    }
+    else
+    {
+        printf("ERROR: %s round trip failed!\n", name);
+    }
+
+    return success;
+}
+
+/**
+ * Times REGISTER_APP/ACK and HEARTBEAT round trips over one transport.
+ *
+ * @param[in] domain: AF_INET or AF_UNIX
+ * @param[in] type: SOCK_STREAM or SOCK_SEQPACKET
+ * @param[in] name: label for the output
+ * @param[in] iterations: number of round trips of each message
+ * @param[in] samples: scratch space for iterations samples
+ *
+ * @return true/false whether the transport could be measured
+ */
+bool run_transport(int32_t domain, int32_t type, const char *name,
+    int32_t iterations, uint64_t *samples)
+{
+    bool success = true;
+    int32_t fd = -1;
+    int32_t status;
+    uint16_t val16;
+    uint32_t val32 = (uint32_t)getpid();
+    uint8_t registerApp[REGISTER_APP_SIZE];
+    uint8_t heartbeat[HEARTBEAT_SIZE];
+    char label[32];
+    struct sockaddr_storage addr;
+    socklen_t addrLen;
+    pid_t server;
+
+    val16 = CMD_REGISTER_APP;
+    memcpy(registerApp, &val16, sizeof(val16));
+    val16 = REGISTER_APP_SIZE - 4;
+    memcpy(&registerApp[2], &val16, sizeof(val16));
+    registerApp[4] = 0;
+    memcpy(&registerApp[5], &val32, sizeof(val32));
+    memcpy(&registerApp[9], "simm", 4);
+
+    val16 = CMD_HEARTBEAT;
+    memcpy(heartbeat, &val16, sizeof(val16));
+    val16 = 0;
+    memcpy(&heartbeat[2], &val16, sizeof(val16));
+
+    server = start_server(domain, type, &addr, &addrLen);
+    if ( 0 < server )
+    {
+        fd = socket(domain, type, 0);
+    }
+    if ( (0 > fd) || (0 != connect(fd, (struct sockaddr *)&addr, addrLen)) )
+    {
+        printf("ERROR: unable to connect over %s\n", name);
+        success = false;
+    }
+
+    if ( true == success )
+    {
+        snprintf(label, sizeof(label), "%s REGISTER_APP", name);
+        success = run_message(fd, label, registerApp, sizeof(registerApp),
+                              REGISTER_APP_ACK_SIZE, iterations, samples);
+    }
+    if ( true == success )
+    {
+        snprintf(label, sizeof(label), "%s HEARTBEAT", name);
+        success = run_message(fd, label, heartbeat, sizeof(heartbeat),
+                              HEARTBEAT_SIZE, iterations, samples);
+    }
+
+    if ( 0 <= fd )
+    {
+        close(fd);
+    }
+    if ( 0 < server )
+    {
+        kill(server, SIGTERM);
+        waitpid(server, &status, 0);
+    }
+    if ( AF_UNIX == domain )
+    {
+        unlink(((struct sockaddr_un *)&addr)->sun_path);
+    }
+
+    return success;
+}
+
+/**
+ * Runs the benchmark for both transports.
+ *
+ * @param[in] argc: number of arguments
+ * @param[in] argv: [iterations]
+ *
+ * @return 0 on success, 1 on failure
+ */
+int main(int argc, char *argv[])
+{
+    bool success = true;
+    int32_t iterations = DEFAULT_ITERATIONS;
+    uint64_t *samples;
+
+    if ( 1 < argc )
+    {
+        iterations = atoi(argv[1]);
+    }
+    if ( 0 >= iterations )
+    {
+        iterations = DEFAULT_ITERATIONS;
+    }
+
+    samples = (uint64_t *)malloc((size_t)iterations * sizeof(uint64_t));
+    if ( NULL == samples )
+    {
+        printf("ERROR: unable to allocate %d samples\n", iterations);
+        success = false;
+    }
+    else
+    {
+        printf("%d round trips of each message\n", iterations);
+    }
+
+    if ( true == success )
+    {
+        success = run_transport(AF_INET, SOCK_STREAM, "tcp", iterations, samples);
+    }
+    if ( true == success )
+    {
+        success = run_transport(AF_UNIX, SOCK_SEQPACKET, "unix", iterations, samples);
+    }
+
+    free(samples);
+
+    return (true == success) ? 0 : 1;
+}
@@ -0,0 +1,208 @@
+/**
+ * File: zygote_bench.c
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ *
+ * Description:
+ *   Compares restarting an item through the zygote with restarting it with the
+ *   exec backends. The zygote is started first, while the process is small, as
+ *   BARSM starts it at boot. The process then grows its heap to stand in for
+ *   a long running BARSM and repeatedly starts the zygote_dummy item, built
+ *   both as a shared object and as a program, with each backend. Every launch
+ *   is timed until the item has run its entry and exited, so the exec figures
+ *   include the dynamic linking that the zygote has done ahead of time.
+ *
+ *   Usage: zygote_bench [iterations] [heap MB]
+ *   Defaults: 500 iterations, 64 MB of heap
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "barsm_proctable.h"
+#include "barsm_spawn.h"
+#include "barsm_zygote.h"
+#include "bench_util.h"
+
+#define DEFAULT_ITERATIONS      500
+#define DEFAULT_HEAP_MB         64
+
+/* the dummy item, see bench/dummies/zygote_dummy.c */
+#ifndef ZYGOTE_DUMMY_DIR
+#define ZYGOTE_DUMMY_DIR        "."
+#endif
+#define ZYGOTE_DUMMY_PROGRAM    ZYGOTE_DUMMY_DIR "/zygote_dummy"
+#define ZYGOTE_DUMMY_LIB        ZYGOTE_DUMMY_DIR "/zygote_dummy.so"
+#define ZYGOTE_DUMMY_ENTRY      "zygote_dummy_main"
+
+/* the table the zygote loads its shared objects from */
+proc_table procTable;
+
+/****************
+* PRIVATE FUNCTION PROTOTYPES
+****************/
+static bool run_backend(int32_t backend, const char *name, int32_t iterations,
+    uint64_t *samples);
+
+
+
+/**
+ * Starts the dummy item iterations times with one backend and prints the
+ * latency from the start of the launch until the item has exited.
+ *
+ * @param[in] backend: SPAWN_FORK, SPAWN_POSIX, or -1 for the zygote
+ * @param[in] name: label for the output
+ * @param[in] iterations: number of launches
+ * @param[in] samples: scratch space for iterations samples
+ *
+ * @return true/false whether every launch succeeded
+ */
+bool run_backend(int32_t backend, const char *name, int32_t iterations,
+    uint64_t *samples)
+{
+    bool success = true;
+    int32_t i;
+    int32_t rc;
+    int32_t status_fd;
+    int32_t status = 0;
+    uint64_t start;
+    uint64_t total = 0;
+    pid_t pid;
+    char *argv[2];
+    spawn_request req;
+
+    argv[0] = (char *)(uintptr_t)"zygote_dummy";
+    argv[1] = NULL;
+    req.path = (0 > backend) ? ZYGOTE_DUMMY_LIB : ZYGOTE_DUMMY_PROGRAM;
+    req.argv = argv;
+    req.envp = NULL;
+    req.ready_fd = -1;
+    req.heartbeat_fd = -1;
+    req.listen_fds = NULL;
+    req.num_listen_fds = 0;
+    req.sched = NULL;
+    req.cgroup_fd = -1;
+
+    for ( i = 0; (i < iterations) && (true == success); i++ )
+    {
+        start = now_ns();
+        if ( 0 > backend )
+        {
+            rc = zygote_spawn(&req, ZYGOTE_DUMMY_ENTRY, &pid, &status_fd);
+        }
+        else
+        {
+            rc = spawn_process((enum spawn_backend)backend, &req, &pid, &status_fd);
+        }
+        if ( (0 == rc) && (0 <= status_fd) )
+        {
+            rc = spawn_confirm(status_fd);
+        }
+        if ( 0 != pid )
+        {
+            waitpid(pid, &status, 0);
+        }
+        samples[i] = now_ns() - start;
+        total += samples[i];
+
+        if ( (0 != rc) || (false == WIFEXITED(status)) || (0 != WEXITSTATUS(status)) )
+        {
+            printf("ERROR: %s launch of %s failed! (%d:%s, status 0x%x)\n",
+                name, req.path, rc, strerror(rc), (unsigned int)status);
+            success = false;
+        }
+    }
+
+    if ( true == success )
+    {
+        sort_samples(samples, iterations);
+        printf("%-12s mean %8.1f us  min %8.1f us  p50 %8.1f us  p99 %8.1f us\n",
+            name,
+            (double)total / iterations / 1000.0,
+            (double)percentile(samples, iterations, 0) / 1000.0,
+            (double)percentile(samples, iterations, 50) / 1000.0,
+            (double)percentile(samples, iterations, 99) / 1000.0);
+    }
+
+    return success;
+}
+
+/**
+ * Runs the benchmark for the zygote and both exec backends.
+ *
+ * @param[in] argc: number of arguments
+ * @param[in] argv: [iterations] [heap MB]
+ *
+ * @return 0 on success, 1 on failure
+ */
+int main(int argc, char *argv[])
+{
+    bool success = true;
+    int32_t iterations = DEFAULT_ITERATIONS;
+    size_t heapMb = DEFAULT_HEAP_MB;
+    uint8_t *heap = NULL;
+    uint64_t *samples = NULL;
+
+    if ( 1 < argc )
+    {
+        iterations = atoi(argv[1]);
+    }
+    if ( 2 < argc )
+    {
+        heapMb = (size_t)atoi(argv[2]);
+    }
+    if ( 0 >= iterations )
+    {
+        iterations = DEFAULT_ITERATIONS;
+    }
+
+    procTable.nodes[0].dir = (char *)(uintptr_t)ZYGOTE_DUMMY_LIB;
+    procTable.nodes[0].zygote = (char *)(uintptr_t)ZYGOTE_DUMMY_ENTRY;
+    procTable.num_nodes = 1;
+    if ( false == zygote_start(&procTable) )
+    {
+        printf("ERROR: unable to start the zygote\n");
+        success = false;
+    }
+
+    if ( true == success )
+    {
+        /* touch every page so that fork() has page tables to copy */
+        heap = (uint8_t *)malloc((heapMb * 1024 * 1024) + 1);
+        samples = (uint64_t *)malloc((size_t)iterations * sizeof(uint64_t));
+        if ( (NULL == heap) || (NULL == samples) )
+        {
+            printf("ERROR: unable to allocate %zu MB of heap\n", heapMb);
+            success = false;
+        }
+        else
+        {
+            memset(heap, 0xA5, (heapMb * 1024 * 1024) + 1);
+            printf("%d restarts of zygote_dummy with %zu MB of resident heap\n",
+                iterations, heapMb);
+        }
+    }
+
+    if ( true == success )
+    {
+        success = run_backend(-1, "zygote", iterations, samples);
+    }
+    if ( true == success )
+    {
+        success = run_backend(SPAWN_FORK, "fork", iterations, samples);
+    }
+    if ( true == success )
+    {
+        success = run_backend(SPAWN_POSIX, "posix_spawn", iterations, samples);
+    }
+
+    free(samples);
+    free(heap);
+
+    return (true == success) ? 0 : 1;
+}
@@ -26,24 +26,54 @@
 #include <pthread.h>
 #include <sys/stat.h>
 #include <signal.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <poll.h>
 
 #include "barsm.h"
 #include "barsm_functions.h"
+#include "barsm_timer.h"
+#include "barsm_manifest.h"
+#include "barsm_boot.h"
+#include "barsm_restart.h"
+#include "barsm_watch.h"
+#include "barsm_shutdown.h"
+#include "barsm_heartbeat.h"
+#include "barsm_journal.h"
+#include "barsm_supervisor.h"
+#include "barsm_zygote.h"
+#include "barsm_sockets.h"
+#include "barsm_metrics.h"
+#include "barsm_cgroup.h"
 
 static int32_t clientSocket_TCP = -1;
 static int32_t clientSocket_UDP = -1;
+static int32_t epollFd = -1;
+static int32_t sigchldFd = -1;
+/* SIGTERM/SIGINT ask BARSM to stop everything and exit, see barsmRun() */
+static int32_t stopFd = -1;
+static int32_t stopSignal = 0;
+/* everything received from AACM goes through this reader, see barsm_frame.c */
+static frame_reader aacmReader;
+/* the directories are watched for items being added/removed once BARSM is up */
+static watch_set watchSet;
 
 /****************
 * PRIVATE CONSTANTS
 ****************/
 #define MAX_LAUNCH_ATTEMPTS    5
-/* LAUNCH_CHECK_PERIOD is the amount of time given between status checks on a
- * module/appplication immediately after launch. Recommmended: 5 */
-#define LAUNCH_CHECK_PERIOD    5
-/* START_ENSURE_DELAY must be greater than any possible amount of time that may
- * pass between a child process being forked and the execl() command completion
- * in the child process. Recommmended: 4 */
-#define START_ENSURE_DELAY     4
+/* LAUNCH_SETTLE_MS is the amount of time, in milliseconds, that a batch of
+ * freshly exec'd modules/applications is given to crash on startup before it
+ * is considered launched. Completion of the exec itself is confirmed by
+ * confirm_exec(), so this only needs to cover immediate failures.
+ * Recommended: 500 */
+#define LAUNCH_SETTLE_MS       500
+/* MAX_EVENTS is the number of epoll events handled per pass of barsmRun() */
+#define MAX_EVENTS             8
+/* The pidfd of an adopted child is added to the epoll set with data.fd set to
+ * EVENT_PIDFD(index of its node), which no descriptor can be, so that its
+ * events are told apart without looking through the process table */
+#define EVENT_PIDFD(index)     (-1 - (index))
 
 /* RETURN VALUE ENUMS */
 enum e_return
@@ -57,24 +87,39 @@ enum e_return
 /****************
 * GLOBALS
 ****************/
-child_pid_list *first_node, *nth_node, *tmp_toFree;
+proc_table procTable;
+timer_wheel timerWheel;
+static boot_graph bootGraph;
+static char barsm_name[5];
 
 const char *dirs[] =
 {
-    "/opt/rc360/system",
-    "/opt/rc360/modules/GE",
-    "/opt/rc360/modules/TPA",
-    "/opt/rc360/apps/GE",
-    "/opt/rc360/apps/TPA"
+    RC360_ROOT "/system",
+    RC360_ROOT "/modules/GE",
+    RC360_ROOT "/modules/TPA",
+    RC360_ROOT "/apps/GE",
+    RC360_ROOT "/apps/TPA"
 };
 
 /****************
 * PRIVATE FUNCTION PROTOTYPES
 ****************/
+static bool eventSetup(void);
+static bool eventAdd(int32_t fd, uint32_t events);
+static bool eventAddData(int32_t fd, uint32_t events, int32_t data);
+static bool stopWait(int32_t timeout_ms);
 static bool aacmSetup(void);
-static int32_t launch_itemsInDir( const char *directory );
+static bool resume(bool *resumed);
+static bool aacmReconnect(void);
+static int32_t read_itemsInDir( const char *directory );
+static proc_node *add_item( const char *directory, const char *name );
+static void item_changed( const char *directory, const char *item, bool present,
+    uint32_t mask );
+static bool launch_waves( void );
+static bool launch_batch( int32_t wave );
+static void wait_ready( int32_t wave );
 static bool rcv_errMsgs(void);
-static bool barsmRun(child_pid_list *nth_node);
+static bool barsmRun(proc_table *table);
 
 
 
@@ -94,70 +139,61 @@ bool main(int32_t UNUSED(argc), char UNUSED(*argv[]))
     int32_t dir_index;
     int32_t dirs_array_size;
     bool success = true;
-    char barsm_name[5];
+    bool resumed = false;
+    int32_t i;
 
     openlog(DAEMON_NAME, LOG_CONS, LOG_LOCAL0);
     syslog(LOG_INFO, "%s started", DAEMON_NAME);
     syslog(LOG_INFO, "version %s", DAEMON_VERSION);
     syslog(LOG_INFO, "date %s", DAEMON_BUILD_DATE);
 
-    /* Initialize random number generator */
-    srand(time(NULL));
-
-    /* create linked list ... */
-    printf("EXECUTING: 'malloc()' for creating 'first_node'\n");
-    errno = 0;
-    first_node = (child_pid_list *)malloc(sizeof(child_pid_list));
-    if ( 0 != errno && success )
+    /* only BARSM itself is moved to its cgroup, so before anything else is
+     * started */
+    if ( true != cgroup_init() )
     {
-        syslog(LOG_ERR, "%s:%d ERROR: In 'malloc()' when creating 'first_node'! (%d: %s)",
-            __FUNCTION__, __LINE__, errno, strerror(errno));
-        printf("ERROR: In 'malloc()' when creating 'first_node'! (%d: %s)\n",
-               errno, strerror(errno));
-        success = false;
+        printf("ERROR: No cgroups, the items run without limits\n");
     }
-    else
+
+    /* everything from here on runs in the BARSM the supervisor forks, and
+     * again in a new one every time it crashes */
+    supervisor_run();
+
+    /* SIGCHLD must be blocked before the first child is forked so that no exit
+     * notification is lost before the event loop starts */
+    printf("EXECUTING: 'eventSetup()'\n");
+    success = eventSetup();
+
+    /* create the process table ... */
+    proctable_init(&procTable);
+    timer_init(&timerWheel);
+    if ( (true == success) &&
+         ((true != metrics_init(&procTable)) || (true != eventAdd(metrics_fd(), EPOLLIN))) )
     {
-        printf("SUCCESS: 'malloc()' for creating 'first_node'\n");
+        printf("ERROR: No metrics socket, the metrics cannot be queried\n");
     }
+    frame_init(&aacmReader, clientSocket_TCP, aacm_frameSize);
+    watchSet.fd = -1;
+    printf("SUCCESS: creation of process table\n");
 
     if ( true == success )
     {
-        if ( NULL != first_node )
-        {
-            first_node->next = NULL;
-            nth_node = first_node;
-            printf("SUCCESS: creation of linked list\n");
-        }
-        else
-        {
-            syslog(LOG_ERR, "ERROR: In 'malloc()' when creating linked list!");
-            printf("ERROR: In 'malloc()' when creating linked list!\n");
-        }
-
         launch_status = 0;
         dir_index = 0;
 
         /* get number of elements in dirs ... */
-        dirs_array_size = 0;
-        while( '\0' != dirs[++dirs_array_size] );
+        dirs_array_size = (int32_t)(sizeof(dirs) / sizeof(dirs[0]));
     } /* if ( true == success ) */
 
-    /* launch items in each dirs directory.  If directory empty, do nothing. */
+    /* read the items in each dirs directory.  If directory empty, do nothing. */
     if ( true == success )
     {
         for (dir_index = 0; dir_index < dirs_array_size; dir_index++)
         {
-            printf("EXECUTING: Launching all items in directory %s\n", dirs[dir_index]);
+            printf("EXECUTING: Reading all items in directory %s\n", dirs[dir_index]);
 
-            launch_status = launch_itemsInDir(dirs[dir_index]);
+            launch_status = read_itemsInDir(dirs[dir_index]);
             if ( terminalError == launch_status )
             {
-                /* AACM was not able to start. */
-                /* this is to give the test scripts time to confirm that there
-                 * were no lasting children. */
-                sleep(1);
-
                 success = false;
                 break;
             }
@@ -168,132 +204,394 @@ bool main(int32_t UNUSED(argc), char UNUSED(*argv[]))
             }
             else /* ( normal == launch_status ) */
             {
-                syslog(LOG_NOTICE, "SUCCESS: All items in %s launched!", dirs[dir_index] );
-                printf("SUCCESS: All items in %s launched!\n", dirs[dir_index] );
+                printf("SUCCESS: All items in %s read!\n", dirs[dir_index] );
+            }
+        } /* for (dir_index = 0; dir_index < dirs_array_size; dir_index++) */
+    } /* if ( true == success ) */
+
+    /* shared object items are forked from the zygote, which is forked while
+     * BARSM is still small. Without it they are started once it is retried. */
+    if ( (true == success) && (true != zygote_start(&procTable)) )
+    {
+        printf("ERROR: No zygote, shared object items cannot be started yet\n");
+    }
+
+    /* a BARSM restarted after a crash takes over the running children of the
+     * old one, unless the old one had not got through the boot sequence */
+    if ( (true == success) && (true == journal_isRestart()) )
+    {
+        success = resume(&resumed);
+        if ( (true == success) && (true != resumed) )
+        {
+            printf("NOTICE: Nothing to resume, stopping what is left and booting again\n");
+            journal_killAll(SIGKILL);
+        }
+    }
 
-                if ( 0 == dir_index )
+    /* launch everything that was found, wave by wave */
+    if ( (true == success) && (false == resumed) )
+    {
+        boot_buildGraph(&bootGraph, &procTable, dirs[0]);
+        success = launch_waves();
+        if ( true != success )
+        {
+            /* AACM was not able to start. */
+            /* this is to give the test scripts time to confirm that there
+             * were no lasting children. */
+            sleep(1);
+        }
+        else
+        {
+            for (dir_index = 0; dir_index < dirs_array_size; dir_index++)
+            {
+                for ( i = 0; i < procTable.num_nodes; i++ )
                 {
-                    // connect to the AACM TCP server
-                    // send startup message
-                    // receive ack
-                    if ( true == success )
+                    if ( dirs[dir_index] == procTable.nodes[i].directory )
                     {
-                        printf("EXECUTING: 'aacmSetup()'\n");
-                        success = aacmSetup();
+                        syslog(LOG_NOTICE, "SUCCESS: All items in %s launched!", dirs[dir_index] );
+                        printf("SUCCESS: All items in %s launched!\n", dirs[dir_index] );
+                        break;
                     }
-                } /* if ( 0 == dir_index ) */
-            } /* else if (normal == launch_status) */
-        } /* for (dir_index = 0; dir_index < dirs_array_size; dir_index++) */
+                }
+            }
+        }
         syslog(LOG_NOTICE, "COMPLETED: Launch sequence complete!");
         // syslog(LOG_DEBUG, "\nCOMPLETED: Launch sequence complete!\n\n");
 
-        /* all done, so last node is NULL */
-        nth_node->next = NULL;
-
-        if ( true == success )
+        if ( (true == success) && (0 == stopSignal) )
         {
             /* BARSM needs to be assigned a name as all the child processes were
              * given when they were launched */
             printf("SUCCESS: Launch sequence complete!\n");
             printf("EXECUTING: Assigning a 4 character name to BARSM\n");
 
-            assign_procName(barsm_name, first_node, first_node);
+            success = assign_procName(barsm_name, DAEMON_NAME, &procTable);
+        }
+        if ( (true == success) && (0 == stopSignal) )
+        {
             syslog(LOG_DEBUG, "SUCCESS: assigned BARSM name %s", barsm_name);
             printf("SUCCESS: 'assign_procName() = %s'\n", barsm_name);
 
-            sleep(5);
-            printf("EXECUTING: Sending OPEN message over UDP\n");
-            process_openUDP(clientSocket_UDP);
-            printf("SUCCESS: OPEN message sent\n");
+            if ( false == stopWait(5000) )
+            {
+                printf("EXECUTING: Sending OPEN message over UDP\n");
+                process_openUDP(clientSocket_UDP);
+                printf("SUCCESS: OPEN message sent\n");
+
+                printf("EXECUTING: Receiving SYS_INIT message over UDP\n");
+                success = process_sysInit(clientSocket_UDP, stopFd);
 
-            printf("EXECUTING: Receiving SYS_INIT message over UDP\n");
-            success = process_sysInit(clientSocket_UDP);
+                /* a stop request ends the wait without a SYS_INIT */
+                if ( (true != success) && (true == stopWait(0)) )
+                {
+                    success = true;
+                }
+            }
         }
-        if ( true == success )
+        if ( (true == success) && (0 == stopSignal) )
         {
             printf("SUCCESS: SYS_INIT message recieved over UDP\n");
             printf("EXECUTING: Sending the AACM_TO_BARSM_PROCESSES message on TCP\n");
-            success = send_barsmToAacmProcesses(clientSocket_TCP, first_node,
+            success = send_barsmToAacmProcesses(clientSocket_TCP, &procTable,
                                                 dirs, barsm_name);
         }
+        if ( (true == success) && (0 == stopSignal) )
+        {
+            /* the boot sequence is not repeated if BARSM crashes from now on */
+            supervisor_keep(KEEP_AACM_TCP, clientSocket_TCP);
+            supervisor_keep(KEEP_AACM_UDP, clientSocket_UDP);
+            journal_setBooted(barsm_name);
+        }
+    } /* if ( (true == success) && (false == resumed) ) */
 
-        while( true == success )
+    if ( (true == success) && (0 == stopSignal) )
+    {
+        /* items installed or removed from now on are handled as they
+         * happen, BARSM keeps running without the watch if it fails */
+        printf("EXECUTING: Watching the application/module directories\n");
+        if ( (true == watch_init(&watchSet, dirs, dirs_array_size)) &&
+             (true == eventAdd(watchSet.fd, EPOLLIN)) )
         {
-            success = barsmRun(first_node);
+            printf("SUCCESS: Directories watched\n");
         }
-    } /* if ( true == success ) */
+    }
 
-    printf("NOTICE: BARSM exiting due to terminal error!\n");
-    syslog(LOG_NOTICE, "NOTICE: BARSM exiting due to terminal error!");
+    while( (true == success) && (0 == stopSignal) )
+    {
+        success = barsmRun(&procTable);
+    }
 
-    /* Won't get here with the above while(1) loop.  But, if this main ever
-     * exits, this free's all the nodes in the linked list. */
-    nth_node = first_node;
-    while( NULL != nth_node->next )
+    if ( 0 != stopSignal )
     {
-        /* Need to kill all child processes that were started up */
-        printf("EXECUTING: Killing process with PID %d\n", nth_node->child_pid);
-        errno = 0;
-        if ( -1 == kill(nth_node->child_pid, SIGTERM) )
+        printf("NOTICE: BARSM stopping on signal %d\n", stopSignal);
+        syslog(LOG_NOTICE, "NOTICE: BARSM stopping on signal %d", stopSignal);
+    }
+    else
+    {
+        printf("NOTICE: BARSM exiting due to terminal error!\n");
+        syslog(LOG_NOTICE, "NOTICE: BARSM exiting due to terminal error!");
+    }
+
+    /* Stop every child that was started up, in reverse launch order and within
+     * a bounded time, and reap them all so none is left behind BARSM */
+    shutdown_children(&procTable, dirs, dirs_array_size, sigchldFd);
+
+    /* free any allocated information */
+    proctable_free(&procTable);
+
+    return success;
+} /* int32_t main(void) */
+
+/**
+ * Waits for activity on the AACM TCP socket, the SIGCHLD signalfd or the pidfd
+ * of an adopted child and handles whichever became ready. A SIGTERM/SIGINT only records the signal, main()
+ * leaves the loop and stops the children. Nothing runs until one of them has an event, so a
+ * crashed module is detected as soon as the kernel reports its exit rather than
+ * on the next pass of a polling loop. The wait is bounded by the next timer on
+ * the timer wheel, whose expired timers (e.g. delayed restarts) are run on
+ * every pass.
+ *
+ * @param[in] table: the process table
+ *
+ * @return true/false whether a terminal error has occurred
+ */
+bool barsmRun(proc_table *table)
+{
+    bool success = true;
+    int32_t numEvents;
+    int32_t i;
+    struct epoll_event events[MAX_EVENTS];
+
+    errno = 0;
+    numEvents = epoll_wait(epollFd, events, MAX_EVENTS, timer_nextTimeout(&timerWheel));
+    if ( -1 == numEvents )
+    {
+        if ( EINTR != errno )
         {
-            syslog(LOG_ERR, "%s:%d ERROR! Not able to kill process with PID %d (%d:%s)",
-                __FUNCTION__, __LINE__, nth_node->child_pid, errno, strerror(errno));
+            syslog(LOG_ERR, "%s:%d ERROR: epoll_wait() failed! (%d: %s)",
+                __FUNCTION__, __LINE__, errno, strerror(errno));
+            success = false;
         }
-        else
+        numEvents = 0;
+    }
+
+    for ( i = 0; (i < numEvents) && (true == success); i++ )
+    {
+        if ( (sigchldFd == events[i].data.fd) || (0 > events[i].data.fd) )
         {
-            printf("SUCCESS: Process with PID %d eliminated successfully\n",
-                   nth_node->child_pid);
-        }
+            /* drain the signalfd, the standard SIGCHLD is not queued so one
+             * read may stand for several exited children. An adopted child
+             * is reported on its pidfd instead, see EVENT_PIDFD(). */
+            struct signalfd_siginfo siginfo;
+            while ( (sigchldFd == events[i].data.fd) &&
+                    (sizeof(siginfo) == read(sigchldFd, &siginfo, sizeof(siginfo))) )
+            {
+                /* nothing to do per signal, check_modules() reaps them all */
+            }
 
-        /* free any allocated information */
-        free(nth_node->dir);
-        free(nth_node->item_name);
+            printf("EXECUTING: BARSM health monitoring system\n");
+            success = check_modules(&aacmReader, table);
+            if (true == success)
+            {
+                printf("SUCCESS: Health monitoring sequence complete\n");
+            }
+            else
+            {
+                printf("ERROR: While checking the health of the apps/modules\n");
+            }
+        }
+        else if ( stopFd == events[i].data.fd )
+        {
+            struct signalfd_siginfo siginfo;
+            if ( sizeof(siginfo) == read(stopFd, &siginfo, sizeof(siginfo)) )
+            {
+                stopSignal = (int32_t)siginfo.ssi_signo;
+            }
+        }
+        else if ( watchSet.fd == events[i].data.fd )
+        {
+            watch_read(&watchSet, item_changed);
+        }
+        else if ( metrics_fd() == events[i].data.fd )
+        {
+            metrics_serve();
+        }
+        else if ( clientSocket_TCP == events[i].data.fd )
+        {
+            if ( 0 != (events[i].events & EPOLLIN) )
+            {
+                rcv_errMsgs();
+            }
 
-        tmp_toFree = nth_node;
-        nth_node = nth_node->next;
-        free(tmp_toFree);
-    } /* while( NULL != nth_node->next ) */
+            if ( 0 != (events[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) )
+            {
+                /* AACM closed the connection, stop watching the socket so the
+                 * loop does not spin on a permanently readable descriptor */
+                syslog(LOG_ERR, "%s:%d ERROR: AACM TCP connection closed!",
+                    __FUNCTION__, __LINE__);
+                printf("ERROR: AACM TCP connection closed!\n");
+                epoll_ctl(epollFd, EPOLL_CTL_DEL, clientSocket_TCP, NULL);
+
+                /* no ACK can arrive any more, restart whatever waits for one */
+                restart_ackLost(table);
+            }
+        }
+        else
+        {
+            syslog(LOG_ERR, "%s:%d ERROR: event for unknown fd %d!",
+                __FUNCTION__, __LINE__, events[i].data.fd);
+        }
+    }
 
-    /* There is always an extra node at the end with the way this list is
-     * managed */
-    free(nth_node);
+    timer_advance(&timerWheel);
 
     return success;
-} /* int32_t main(void) */
+}
 
 /**
- * Listens over TCP for a set amount of time, if no message is found
- * the modules are checked for errors
+ * Blocks SIGCHLD, SIGTERM and SIGINT, creates the signalfds that report child
+ * exits and stop requests and the epoll set used by barsmRun(). Must be called before any child is forked.
  *
  * @param[in] void
  *
- * @return success
+ * @return true/false whether a terminal error has occured
  */
-bool barsmRun(child_pid_list *node_to_use)
+bool eventSetup(void)
 {
-    bool handleError;
     bool success = true;
+    sigset_t mask;
+    sigset_t stopMask;
 
-    handleError = rcv_errMsgs();
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigemptyset(&stopMask);
+    sigaddset(&stopMask, SIGTERM);
+    sigaddset(&stopMask, SIGINT);
 
-    /* check if any of the processes have gone zombie or killed */
-    /* list back to first node */
-    if (!handleError)
+    errno = 0;
+    if ( (-1 == sigprocmask(SIG_BLOCK, &mask, NULL)) ||
+         (-1 == sigprocmask(SIG_BLOCK, &stopMask, NULL)) )
     {
-        printf("EXECUTING: BARSM health monitoring system\n");
+        syslog(LOG_ERR, "%s:%d ERROR: sigprocmask() failed! (%d: %s)",
+            __FUNCTION__, __LINE__, errno, strerror(errno));
+        success = false;
+    }
 
-        success = check_modules(clientSocket_TCP, node_to_use);
+    if ( true == success )
+    {
+        errno = 0;
+        sigchldFd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+        if ( -1 == sigchldFd )
+        {
+            syslog(LOG_ERR, "%s:%d ERROR: signalfd() failed! (%d: %s)",
+                __FUNCTION__, __LINE__, errno, strerror(errno));
+            success = false;
+        }
+    }
 
-        if (true == success)
+    if ( true == success )
+    {
+        errno = 0;
+        stopFd = signalfd(-1, &stopMask, SFD_NONBLOCK | SFD_CLOEXEC);
+        if ( -1 == stopFd )
         {
-            printf("SUCCESS: Health monitoring sequence complete\n");
+            syslog(LOG_ERR, "%s:%d ERROR: signalfd() failed! (%d: %s)",
+                __FUNCTION__, __LINE__, errno, strerror(errno));
+            success = false;
         }
-        else
+    }
+
+    if ( true == success )
+    {
+        errno = 0;
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        if ( -1 == epollFd )
         {
-            printf("ERROR: While checking the health of the apps/modules\n");
+            syslog(LOG_ERR, "%s:%d ERROR: epoll_create1() failed! (%d: %s)",
+                __FUNCTION__, __LINE__, errno, strerror(errno));
+            success = false;
         }
     }
 
+    if ( true == success )
+    {
+        success = eventAdd(sigchldFd, EPOLLIN);
+    }
+
+    if ( true == success )
+    {
+        success = eventAdd(stopFd, EPOLLIN);
+    }
+
+    return success;
+}
+
+/**
+ * Waits for a SIGTERM/SIGINT while BARSM boots, when barsmRun() is not yet
+ * reading the stop signalfd. A boot step that would otherwise block calls it
+ * instead of sleeping, or checks it between steps, so that a BARSM that is
+ * asked to stop while it boots stops its children and exits.
+ *
+ * @param[in] timeout_ms: how long to wait for the signal, 0 to only check
+ *
+ * @return true if BARSM has been asked to stop
+ */
+bool stopWait(int32_t timeout_ms)
+{
+    struct pollfd pfd;
+    struct signalfd_siginfo siginfo;
+
+    pfd.fd = stopFd;
+    pfd.events = POLLIN;
+    if ( (0 == stopSignal) && (0 < poll(&pfd, 1, timeout_ms)) &&
+         (sizeof(siginfo) == read(stopFd, &siginfo, sizeof(siginfo))) )
+    {
+        stopSignal = (int32_t)siginfo.ssi_signo;
+    }
+
+    return (0 != stopSignal);
+}
+
+/**
+ * Adds a file descriptor to the BARSM epoll set.
+ *
+ * @param[in] fd: the file descriptor to watch
+ * @param[in] events: the epoll events of interest
+ *
+ * @return true/false whether a terminal error has occured
+ */
+bool eventAdd(int32_t fd, uint32_t events)
+{
+    return eventAddData(fd, events, fd);
+}
+
+/**
+ * Adds a file descriptor to the BARSM epoll set, with its events reported
+ * under a value other than the descriptor, see EVENT_PIDFD().
+ *
+ * @param[in] fd: the file descriptor to watch
+ * @param[in] events: the epoll events of interest
+ * @param[in] data: data.fd of its events
+ *
+ * @return true/false whether a terminal error has occured
+ */
+bool eventAddData(int32_t fd, uint32_t events, int32_t data)
+{
+    bool success = true;
+    struct epoll_event ev;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.fd = data;
+
+    errno = 0;
+    if ( -1 == epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) )
+    {
+        syslog(LOG_ERR, "%s:%d ERROR: epoll_ctl() failed for fd %d! (%d: %s)",
+            __FUNCTION__, __LINE__, fd, errno, strerror(errno));
+        success = false;
+    }
+
     return success;
 }
 
@@ -311,12 +609,13 @@ bool aacmSetup(void)
 
     if ( true == success )
     {
-        printf("EXECUTING: TCP Setup\n");
-        success = TCPsetup(&clientSocket_TCP);
+        printf("EXECUTING: AACM Setup\n");
+        success = AACMsetup(&clientSocket_TCP);
+        frame_init(&aacmReader, clientSocket_TCP, aacm_frameSize);
     }
     if ( true == success )
     {
-        printf("SUCCESS: TCP Setup Complete!\n");
+        printf("SUCCESS: AACM Setup Complete!\n");
         printf("EXECUTING: UDP Setup\n");
         success = UDPsetup(&clientSocket_UDP);
     }
@@ -330,7 +629,7 @@ bool aacmSetup(void)
     {
         printf("SUCCESS: BARSM to AACM INIT sent!\n");
         printf("EXECUTING: Receiveing INIT ACK\n");
-        success = receive_barsmToAacmInitAck(clientSocket_TCP);
+        success = receive_barsmToAacmInitAck(&aacmReader);
     }
     if (true == success)
     {
@@ -340,26 +639,158 @@ bool aacmSetup(void)
     return success;
 }
 
+/**
+ * Resumes the work of a BARSM that crashed. The AACM connections kept by the
+ * supervisor are taken over, the children still running are adopted from the
+ * journal and only the items that are not running any more are launched, after
+ * which AACM is sent the updated process list. Nothing is done if the crashed
+ * BARSM had not completed the boot sequence with AACM. A TCP connection to
+ * AACM is replaced by a new one, see aacmReconnect().
+ *
+ * @param[out] resumed: false if nothing was resumed and BARSM has to boot again
+ *
+ * @return true/false whether a terminal error has occurred
+ */
+bool resume(bool *resumed)
+{
+    bool success = true;
+    bool reconnected = false;
+    int32_t numAdopted = 0;
+    int32_t numLaunched = 0;
+    int32_t i;
+    proc_node *tmp_node;
+
+    clientSocket_TCP = supervisor_kept(KEEP_AACM_TCP);
+    clientSocket_UDP = supervisor_kept(KEEP_AACM_UDP);
+    *resumed = (true == journal_booted(barsm_name)) && (-1 != clientSocket_TCP) &&
+               (-1 != clientSocket_UDP);
+    if ( true != *resumed )
+    {
+        clientSocket_TCP = -1;
+        clientSocket_UDP = -1;
+    }
+
+    if ( true == *resumed )
+    {
+        printf("EXECUTING: Adopting the children of the previous BARSM\n");
+        numAdopted = journal_adopt(&procTable);
+        frame_init(&aacmReader, clientSocket_TCP, aacm_frameSize);
+        if ( false == aacmReader.packet )
+        {
+            reconnected = true;
+            success = aacmReconnect();
+        }
+    }
+
+    if ( (true == success) && (true == *resumed) )
+    {
+        success = eventAdd(clientSocket_TCP, EPOLLIN | EPOLLRDHUP);
+    }
+
+    for ( i = 0; (i < procTable.num_nodes) && (true == success) && (true == *resumed); i++ )
+    {
+        tmp_node = &procTable.nodes[i];
+        if ( 0 <= tmp_node->pid_fd )
+        {
+            success = eventAddData(tmp_node->pid_fd, EPOLLIN, EVENT_PIDFD(i));
+            heartbeat_start(tmp_node);
+        }
+        else if ( launchWaiting == tmp_node->alive )
+        {
+            tmp_node->alive = normal;
+            if ( true == start_process(tmp_node) )
+            {
+                numLaunched++;
+            }
+        }
+        else
+        {
+            /* disabled before the crash, it stays disabled */
+        }
+    }
+
+    if ( (true == success) && (true == *resumed) )
+    {
+        syslog(LOG_NOTICE, "COMPLETED: BARSM resumed as %s, %d children adopted, %d launched",
+            barsm_name, numAdopted, numLaunched);
+        printf("COMPLETED: BARSM resumed as %s, %d children adopted, %d launched\n",
+            barsm_name, numAdopted, numLaunched);
+    }
+
+    if ( (true == success) && ((0 < numLaunched) || (true == reconnected)) )
+    {
+        printf("EXECUTING: Sending the updated process list to AACM\n");
+        send_barsmToAacmProcesses(clientSocket_TCP, &procTable, dirs, barsm_name);
+    }
+
+    return success;
+} /* bool resume(void) */
+
+/**
+ * Replaces the AACM TCP connection kept from a crashed BARSM by a new one. The
+ * crashed BARSM may have received part of a message, and what it received is
+ * lost with it; a byte stream has no way to find the start of the next
+ * message, so nothing more is read from it. A SOCK_SEQPACKET connection never
+ * holds part of a message and is kept as it is. The UDP socket is kept either
+ * way.
+ *
+ * @param[in] void
+ *
+ * @return true/false whether a terminal error has occurred
+ */
+bool aacmReconnect(void)
+{
+    bool success;
+
+    syslog(LOG_NOTICE, "NOTICE: AACM TCP connection may be in the middle of a message, reconnecting");
+    printf("EXECUTING: Reconnecting to AACM\n");
+
+    /* the supervisor's copy keeps it open until the new one replaces it */
+    close(clientSocket_TCP);
+    clientSocket_TCP = -1;
+
+    success = AACMsetup(&clientSocket_TCP);
+    frame_init(&aacmReader, clientSocket_TCP, aacm_frameSize);
+    if ( true == success )
+    {
+        success = send_barsmToAacmInit(clientSocket_TCP);
+    }
+    if ( true == success )
+    {
+        success = receive_barsmToAacmInitAck(&aacmReader);
+    }
+    if ( true == success )
+    {
+        supervisor_keep(KEEP_AACM_TCP, clientSocket_TCP);
+        printf("SUCCESS: Reconnected to AACM\n");
+    }
+
+    return success;
+}
+
 
 
 /**
- * Used to launch all the items in a passed in directory location. This function
+ * Used to read all the items in a passed in directory location. This function
  * indicates if a terminal error has occurred, or if the directory is empty with
- * the return value.
+ * the return value. A node is added to the process table for every item found,
+ * the directory's manifest is applied to them, and they are left waiting for
+ * their boot wave.
  *
  * @param[in] const char *directory: The directory location from which things
  *      need to be luanched.
  *
  * @return int: To indicate normal operation, empty directory, or terminal error
  */
-int32_t launch_itemsInDir( const char *directory )
+int32_t read_itemsInDir( const char *directory )
 {
     int32_t rc = 0;
-    int32_t launch_attempts = 0, run_time = 0;
     struct dirent *dp;
     bool success = true;
     bool empty_dir = true;
     DIR *dir;
+    proc_node *nth_node = NULL;
+    int32_t dir_first_index = procTable.num_nodes;
 
     printf("EXECUTING: Opening directory %s\n", directory);
 
@@ -385,198 +816,616 @@ int32_t launch_itemsInDir( const char *directory )
 
                 empty_dir = false;
 
-                printf("EXECUTING: Putting file path and name together in malloc()'ed area\n");
-                nth_node->dir = NULL;
-                errno = 0;
-                rc = asprintf(&nth_node->dir, "%s/%s", directory, dp->d_name);
-                if ((0 >= rc) || (NULL == nth_node->dir))
+                nth_node = add_item(directory, dp->d_name);
+                if (NULL == nth_node)
                 {
-                    syslog(LOG_ERR, "%s:%d ERROR: unable to allocate %s/%s (%d: %s)",
-                        __FUNCTION__, __LINE__, directory, dp->d_name, errno, strerror(errno));
                     success = false;
-                }
-                else
-                {
-                    printf("SUCCESS: String combination completed\n");
+                    break;
                 }
 
-                if (true == success)
-                {
-                    printf("EXECUTING: Copying filename\n");
+                printf("EXECUTING: Checking if another file is present in directory %s\n", directory);
+            } /* if ('.' != dp->d_name[0]) */
 
-                    errno = 0;
-                    nth_node->item_name = strdup(dp->d_name);
-                    if (NULL == nth_node->item_name)
-                    {
-                        syslog(LOG_ERR, "%s:%d ERROR: unable to dup filename %s (%d: %s)",
-                               __FUNCTION__, __LINE__, dp->d_name, errno, strerror(errno));
-                        success = false;
-                    }
-                    else
-                    {
-                        printf("SUCCESS: String copying completed\n");
-                    }
-                }
+            errno = 0;
+            dp = readdir(dir);
+        } /* while ((NULL != dp) && (true == success)) */
 
-                if (true == success)
-                {
-                    printf("EXECUTING: Allocating space for next item in linked list\n");
-                    errno = 0;
-                    nth_node->next = (child_pid_list *)malloc(sizeof(child_pid_list));
-                    if (NULL == nth_node->next)
-                    {
-                        syslog(LOG_ERR, "%s:%d ERROR: unable to malloc new node (%d: %s)",
-                               __FUNCTION__, __LINE__, errno, strerror(errno));
-                        success = false;
-                    }
-                    else
-                    {
-                        printf("SUCCESS: Space allocated for next item\n");
-                    }
-                }
+        if ((NULL == dp) && (0 != errno))
+        {
+            syslog(LOG_ERR, "%s:%d ERROR: unable to read dir %s (%d:%s)",
+                   __FUNCTION__, __LINE__, directory, errno, strerror(errno));
+            success = false;
+        }
+
+        printf("EXECUTING: Leaving directory %s\n", directory);
+        closedir(dir);
+    } /* else ! (NULL == dir) */
+
+    if ( (true == success) && (false == empty_dir) )
+    {
+        manifest_load(&procTable, dir_first_index, procTable.num_nodes, directory);
+    }
+
+    if (true != success)
+    {
+        rc = terminalError;
+    }
+    else if ( empty_dir )
+    {
+        rc = dirIsEmpty;
+    }
+    else
+    {
+        rc = normal;
+    }
+
+    return rc;
+} /* int32_t read_itemsInDir( const char *directory ) */
+
+
+
+/**
+ * Adds an item of one of the dirs[] directories to the process table and
+ * assigns it its 4 character name. The node is left waiting to be launched,
+ * with the default settings of its directory.
+ *
+ * @param[in] directory: the dirs[] entry the item was found in
+ * @param[in] name: the file name of the item
+ *
+ * @return the new node, NULL if a terminal error has occured
+ */
+proc_node *add_item( const char *directory, const char *name )
+{
+    int32_t rc = 0;
+    bool success = true;
+    proc_node *nth_node = NULL;
+
+    printf("EXECUTING: Adding item to the process table\n");
+    nth_node = proctable_add(&procTable);
+    if (NULL == nth_node)
+    {
+        syslog(LOG_ERR, "%s:%d ERROR: process table full, unable to add %s/%s (max %d)",
+            __FUNCTION__, __LINE__, directory, name, MAX_PROCS);
+        printf("ERROR: process table full, unable to add %s/%s\n",
+            directory, name);
+        success = false;
+    }
+
+    if (true == success)
+    {
+        printf("EXECUTING: Putting file path and name together in malloc()'ed area\n");
+        errno = 0;
+        rc = asprintf(&nth_node->dir, "%s/%s", directory, name);
+        if ((0 >= rc) || (NULL == nth_node->dir))
+        {
+            syslog(LOG_ERR, "%s:%d ERROR: unable to allocate %s/%s (%d: %s)",
+                __FUNCTION__, __LINE__, directory, name, errno, strerror(errno));
+            success = false;
+        }
+        else
+        {
+            printf("SUCCESS: String combination completed\n");
+        }
+    }
+
+    if (true == success)
+    {
+        printf("EXECUTING: Copying filename\n");
+
+        errno = 0;
+        nth_node->item_name = strdup(name);
+        if (NULL == nth_node->item_name)
+        {
+            syslog(LOG_ERR, "%s:%d ERROR: unable to dup filename %s (%d: %s)",
+                   __FUNCTION__, __LINE__, name, errno, strerror(errno));
+            success = false;
+        }
+        else
+        {
+            printf("SUCCESS: String copying completed\n");
+        }
+    }
+
+    if (true == success)
+    {
+        printf("EXECUTING: Assigning a 4 character name to item %s\n",
+               nth_node->item_name);
+        success = assign_procName(nth_node->proc_name, nth_node->dir, &procTable);
+    }
 
-                if (true == success)
+    if (true == success)
+    {
+        proctable_setName(&procTable, nth_node, nth_node->proc_name);
+        printf("SUCCESS: Assigned name of %s\n", nth_node->proc_name);
+        syslog(LOG_DEBUG, "SUCCESS: Assigned item_name %s proc_name %s", nth_node->item_name, nth_node->proc_name);
+
+        /* the item is launched in its boot wave once every
+         * directory has been read */
+        nth_node->alive = launchWaiting;
+        nth_node->directory = directory;
+        nth_node->ready = readySettle;
+        nth_node->ready_timeout_ms = READY_TIMEOUT_MS;
+        nth_node->critical = (dirs[0] == directory);
+    }
+    else
+    {
+        nth_node = NULL;
+    }
+
+    return nth_node;
+} /* proc_node *add_item( const char *directory, const char *name ) */
+
+
+
+/**
+ * Watch callback for an item of a dirs[] directory that was installed,
+ * replaced or removed while BARSM is running. New items are launched right
+ * away, replaced ones are restarted on the new file and removed ones are
+ * stopped and no longer supervised. AACM is sent the new process list
+ * whenever the set of processes changes.
+ *
+ * @param[in] directory: the dirs[] entry the item is in
+ * @param[in] item: the file name of the item
+ * @param[in] present: whether the item is now there and executable
+ * @param[in] mask: the inotify event that reported the change
+ *
+ * @return void
+ */
+void item_changed( const char *directory, const char *item, bool present,
+    uint32_t mask )
+{
+    bool changed = false;
+    int32_t i;
+    proc_node *node = NULL;
+
+    for ( i = 0; (i < procTable.num_nodes) && (NULL == node); i++ )
+    {
+        if ( (directory == procTable.nodes[i].directory) &&
+             (0 == strcmp(procTable.nodes[i].item_name, item)) )
+        {
+            node = &procTable.nodes[i];
+        }
+    }
+
+    if ( (true == present) && (NULL == node) )
+    {
+        syslog(LOG_NOTICE, "NOTICE: %s/%s installed, launching it", directory, item);
+        printf("EXECUTING: Launching new item %s/%s\n", directory, item);
+
+        node = add_item(directory, item);
+        if ( NULL != node )
+        {
+            manifest_load(&procTable, procTable.num_nodes - 1, procTable.num_nodes, directory);
+            node->alive = normal;
+            start_process(node);
+            changed = true;
+        }
+    }
+    else if ( (true == present) && (downPermanently == node->alive) )
+    {
+        /* installed again after being removed, or a new version of an item
+         * that was disabled for crashing */
+        syslog(LOG_NOTICE, "NOTICE: %s reinstalled, launching it", node->dir);
+        printf("EXECUTING: Launching reinstalled item %s\n", node->dir);
+
+        if ( true == assign_procName(node->proc_name, node->dir, &procTable) )
+        {
+            proctable_setName(&procTable, node, node->proc_name);
+            node->crash_count = 0;
+            changed = true;
+            if ( 0 != node->child_pid )
+            {
+                /* the removed version is still being stopped, the new one is
+                 * launched by the restart batch once the old one is reaped */
+                restart_batchAdd(&procTable, -1, &node->child_pid, 1);
+            }
+            else
+            {
+                node->alive = normal;
+                start_process(node);
+            }
+        }
+    }
+    else if ( (true == present) && (0 == (mask & IN_ATTRIB)) && (0 != node->child_pid) )
+    {
+        /* a new version was moved over the running one, the replacement
+         * keeps its name and is launched from the new file */
+        syslog(LOG_NOTICE, "NOTICE: %s replaced, restarting it", node->dir);
+        printf("EXECUTING: Restarting replaced item %s\n", node->dir);
+        restart_batchAdd(&procTable, -1, &node->child_pid, 1);
+    }
+    else if ( (false == present) && (NULL != node) && (downPermanently != node->alive) )
+    {
+        syslog(LOG_NOTICE, "NOTICE: %s removed, stopping it", node->dir);
+        printf("EXECUTING: Stopping removed item %s\n", node->dir);
+
+        restart_stop(&procTable, node);
+        sockets_close(node);
+        proctable_releaseName(&procTable, node);
+        changed = true;
+    }
+    else
+    {
+        /* nothing BARSM has to act on, e.g. a touch of a running item */
+    }
+
+    if ( (true == changed) && (-1 != clientSocket_TCP) )
+    {
+        printf("EXECUTING: Sending the updated process list to AACM\n");
+        send_barsmToAacmProcesses(clientSocket_TCP, &procTable, dirs, barsm_name);
+    }
+} /* void item_changed(...) */
+
+
+
+/**
+ * Launches the items of the process table wave by wave, following the boot
+ * graph. AACM is connected to as soon as every item of the system directory has
+ * been launched, so that the TCP link is up before anything else is started.
+ * No further wave is launched once BARSM is asked to stop.
+ *
+ * @param[in] void
+ *
+ * @return true/false whether a terminal error has occured
+ */
+bool launch_waves( void )
+{
+    bool success = true;
+    bool aacmConnected = false;
+    bool systemFound;
+    bool systemWaiting;
+    int32_t wave_size;
+    int32_t i;
+    proc_node *tmp_node;
+
+    wave_size = boot_nextWave(&bootGraph, &procTable);
+    while ( (0 < wave_size) && (true == success) )
+    {
+        printf("EXECUTING: Launching boot wave %d (%d items)\n", bootGraph.wave, wave_size);
+        for ( i = 0; i < procTable.num_nodes; i++ )
+        {
+            tmp_node = &procTable.nodes[i];
+            if ( bootGraph.wave == tmp_node->wave )
+            {
+                syslog(LOG_DEBUG, "Boot wave %d: %s", bootGraph.wave, tmp_node->dir);
+            }
+        }
+
+        success = launch_batch(bootGraph.wave);
+        if ( true == success )
+        {
+            wait_ready(bootGraph.wave);
+            boot_waveDone(&bootGraph, &procTable);
+        }
+
+        if ( (true == success) && (false == aacmConnected) && (0 == stopSignal) )
+        {
+            systemFound = false;
+            systemWaiting = false;
+            for ( i = 0; i < procTable.num_nodes; i++ )
+            {
+                tmp_node = &procTable.nodes[i];
+                if ( dirs[0] == tmp_node->directory )
                 {
-                    printf("EXECUTING: Assigning a 4 character name to item %s\n",
-                           nth_node->item_name);
-                    assign_procName(nth_node->proc_name, first_node, nth_node);
-                    if (true == success)
+                    systemFound = true;
+                    if ( launchWaiting == tmp_node->alive )
                     {
-                        printf("SUCCESS: Assigned name of %s\n", nth_node->proc_name);
-                        syslog(LOG_DEBUG, "SUCCESS: Assigned item_name %s proc_name %s", nth_node->item_name, nth_node->proc_name);
+                        systemWaiting = true;
                     }
                 }
+            }
 
-                if (true == success)
+            if ( (true == systemFound) && (false == systemWaiting) )
+            {
+                // connect to the AACM TCP server
+                // send startup message
+                // receive ack
+                printf("EXECUTING: 'aacmSetup()'\n");
+                success = aacmSetup();
+                if ( true == success )
                 {
-                    printf("EXECUTING: Launching item %s\n", nth_node->dir);
-                    success = start_process(nth_node);
-                    if (true == success)
-                    {
-                        printf("SUCCESS: Item launch attempt complete\n");
-                    }
+                    success = eventAdd(clientSocket_TCP, EPOLLIN | EPOLLRDHUP);
                 }
+                aacmConnected = true;
+            }
+        } /* if ( (true == success) && (false == aacmConnected) ) */
 
-                if (true == success)
-                {
-                    /* Check if the process just launched was successful, if
-                     * not, try up to four times to restart it. The waitpid()
-                     * function will return a false positive if the child
-                     * process has not yet tried to execl(). The run_time value
-                     * is used to make sure that enough time has been given to
-                     * make sure that execl() was called. */
-                    launch_attempts = 1;
-                    run_time = 0;
-                    while ( launch_attempts < MAX_LAUNCH_ATTEMPTS && run_time <= START_ENSURE_DELAY )
-                    {
-                        sleep(LAUNCH_CHECK_PERIOD);
-                        errno = 0;
-                        printf("EXECUTING: Checking status of %s after initial launch\n",
-                               nth_node->item_name);
-                        nth_node->alive = waitpid(nth_node->child_pid, &rc, WNOHANG);
+        if ( true == stopWait(0) )
+        {
+            /* the waves that are left are not launched */
+            wave_size = 0;
+        }
+        else if ( true == success )
+        {
+            wave_size = boot_nextWave(&bootGraph, &procTable);
+        }
+    } /* while ( (0 < wave_size) && (true == success) ) */
 
-                        if ( normal != nth_node->alive )
-                        {
-                            syslog(LOG_ERR, "ERROR: File launch failed! (%s in %s) (try #%d) (%d:%s)",
-                                dp->d_name, directory, launch_attempts, errno, strerror(errno));
-                            printf("ERROR: File %s not launched properly! (%d:%s)\n",
-                                dp->d_name, errno, strerror(errno));
-
-                            start_process(nth_node);
-                            launch_attempts++;
-                            nth_node->alive = normal;
-                            run_time = 0;
-                        }
-                        else
-                        {
-                            run_time += LAUNCH_CHECK_PERIOD;
-                        }
-                    } /* while ( launch_attempts < MAX_LAUNCH_ATTEMPTS && run_time <= START_ENSURE_DELAY ) */
-                    sleep(START_ENSURE_DELAY);
-                    errno = 0;
-                    nth_node->alive = waitpid(nth_node->child_pid, &rc, WNOHANG);
+    return success;
+} /* bool launch_waves( void ) */
 
-                    if ( normal != nth_node->alive )
-                    {
-                        /* This last launch error needs to be outside the previous for loop in order to
-                         * log the error for a fifth launch error. */
-                        syslog(LOG_ERR, "ERROR: File launch failed! (%s in %s) (try #%d) (%d:%s)",
-                            dp->d_name, directory, launch_attempts, errno, strerror(errno));
-                        printf("ERROR: File %s not launched properly! (%d:%s)\n",
-                            dp->d_name, errno, strerror(errno));
 
-                        syslog(LOG_ERR, "NOTICE: Process for %s in %s disabled permanently! (%d:%s)",
-                            dp->d_name, directory, errno, strerror(errno));
-                        printf("NOTICE: Process for %s in %s disabled permanently! (%d:%s)\n",
-                            dp->d_name, directory, errno, strerror(errno));
 
-                        nth_node->alive = downPermanently;
+/**
+ * Waits for the ready=notify items of a boot wave to signal that they are
+ * ready, by writing to or closing their readiness pipe, or for their timeout to
+ * run out. An item that misses its timeout is only logged; its dependents are
+ * started anyway. A stop request ends the wait for all of them.
+ *
+ * @param[in] wave: the boot wave that was just launched
+ *
+ * @return void
+ */
+void wait_ready( int32_t wave )
+{
+    struct pollfd fds[MAX_PROCS + 1];
+    proc_node *waiting[MAX_PROCS];
+    uint64_t deadline[MAX_PROCS];
+    uint64_t now;
+    int32_t numWaiting = 0;
+    int32_t timeout;
+    int32_t rc;
+    int32_t i;
+    uint8_t byte;
+    proc_node *tmp_node;
+
+    now = timer_nowMs();
+    for ( i = 0; i < procTable.num_nodes; i++ )
+    {
+        tmp_node = &procTable.nodes[i];
+        if ( (wave == tmp_node->wave) && (normal == tmp_node->alive) &&
+             (0 <= tmp_node->ready_fd) )
+        {
+            fds[numWaiting].fd = tmp_node->ready_fd;
+            fds[numWaiting].events = POLLIN;
+            waiting[numWaiting] = tmp_node;
+            deadline[numWaiting] = tmp_node->start_ms + (uint64_t)tmp_node->ready_timeout_ms;
+            numWaiting++;
+        }
+    }
 
-                        /* return a termination value if it is AACM that failed */
-                        if ( dirs[0] == directory )
-                        {
-                            syslog(LOG_ERR, "ERROR: AACM Cannot be started! (%d:%s)",
-                                errno, strerror(errno));
-                            printf("ERROR: AACM Cannot be started! (%d:%s)\n",
-                                errno, strerror(errno));
+    while ( 0 < numWaiting )
+    {
+        /* sleep until the earliest deadline at most */
+        now = timer_nowMs();
+        timeout = 0;
+        for ( i = 0; i < numWaiting; i++ )
+        {
+            if ( deadline[i] > now )
+            {
+                if ( (0 == timeout) || ((int32_t)(deadline[i] - now) < timeout) )
+                {
+                    timeout = (int32_t)(deadline[i] - now);
+                }
+            }
+        }
 
-                            success = false;
-                        }
-                    } /* if ( normal != nth_node->alive ) */
+        /* a stop request ends the wait, see stopWait() */
+        fds[numWaiting].fd = stopFd;
+        fds[numWaiting].events = POLLIN;
+        fds[numWaiting].revents = 0;
 
-                    printf("SUCCESS: Status check completed\n");
-                    if ( NULL == nth_node->next )
-                    {
-                        syslog(LOG_ERR, "ERROR: In 'realloc()' when adding node to linked list!");
-                        printf("ERROR: In 'realloc()' when adding node to linked list!\n");
-                        success = false;
-                    }
+        errno = 0;
+        rc = poll(fds, (nfds_t)numWaiting + 1, timeout);
+        if ( (-1 == rc) && (EINTR != errno) )
+        {
+            syslog(LOG_ERR, "%s:%d ERROR: poll() failed! (%d:%s)",
+                __FUNCTION__, __LINE__, errno, strerror(errno));
+            break;
+        }
+        if ( (0 != fds[numWaiting].revents) && (true == stopWait(0)) )
+        {
+            for ( i = 0; i < numWaiting; i++ )
+            {
+                close(waiting[i]->ready_fd);
+                waiting[i]->ready_fd = -1;
+            }
+            numWaiting = 0;
+        }
 
-                    if (true == success)
-                    {
-                        printf( "CHILD linked list 'pid': %d\n" , nth_node->child_pid );
-                        printf( "CHILD linked list 'dir': %s\n" , nth_node->dir );
-                        printf( "CHILD linked list 'name': %s\n" , nth_node->item_name );
-                        printf( "this address %p\n" , (void *)nth_node );
-                        printf( "next address %p\n" , (void *)nth_node->next );
-                    }
+        now = timer_nowMs();
+        i = 0;
+        while ( i < numWaiting )
+        {
+            tmp_node = waiting[i];
+            if ( 0 != fds[i].revents )
+            {
+                if ( 0 >= read(fds[i].fd, &byte, sizeof(byte)) )
+                {
+                    syslog(LOG_NOTICE, "NOTICE: %s closed its readiness pipe", tmp_node->dir);
+                }
+                printf("SUCCESS: %s is ready\n", tmp_node->item_name);
+                metrics_ready(tmp_node);
+            }
+            else if ( deadline[i] <= now )
+            {
+                syslog(LOG_NOTICE, "NOTICE: %s not ready after %d ms, continuing",
+                    tmp_node->dir, tmp_node->ready_timeout_ms);
+                printf("NOTICE: %s not ready after %d ms, continuing\n",
+                    tmp_node->item_name, tmp_node->ready_timeout_ms);
+            }
+            else
+            {
+                i++;
+                continue;
+            }
 
-                    nth_node = nth_node->next;
-                } /* if (true == success) */
+            /* done with this item, move the last one into its place */
+            close(tmp_node->ready_fd);
+            tmp_node->ready_fd = -1;
+            numWaiting--;
+            fds[i] = fds[numWaiting];
+            waiting[i] = waiting[numWaiting];
+            deadline[i] = deadline[numWaiting];
+        } /* while ( i < numWaiting ) */
+    } /* while ( 0 < numWaiting ) */
+} /* void wait_ready( int32_t wave ) */
 
-                printf("EXECUTING: Checking if another file is present in directory %s\n", directory);
-            } /* if ('.' != dp->d_name[0]) */
 
-            errno = 0;
-            dp = readdir(dir);
-        } /* while ((NULL != dp) && (true == success)) */
 
-        if ((NULL == dp) && (0 != errno))
+/**
+ * Launches every pending item of a boot wave at the same time. Each launch is
+ * confirmed with confirm_exec(), which reports the errno of a failed exec
+ * whichever spawn backend is in use, and unless every item of the wave is
+ * ready=exec the wave is then given LAUNCH_SETTLE_MS to crash on startup.
+ * Items that fail are relaunched together, up to MAX_LAUNCH_ATTEMPTS times,
+ * before being disabled permanently.
+ *
+ * @param[in] wave: the boot wave to launch
+ *
+ * @return true/false whether a terminal error has occured
+ */
+bool launch_batch( int32_t wave )
+{
+    bool success = true;
+    int32_t launch_attempts;
+    int32_t num_pending = 1;
+    int32_t rc;
+    int32_t exec_errno;
+    int32_t i;
+    pid_t waitreturn;
+    bool needSettle = false;
+    proc_node *tmp_node;
+
+    for ( launch_attempts = 1;
+          (launch_attempts <= MAX_LAUNCH_ATTEMPTS) && (0 < num_pending) && (true == success) &&
+          (0 == stopSignal);
+          launch_attempts++ )
+    {
+        /* only the items relaunched by this attempt decide whether it needs
+         * to settle */
+        needSettle = false;
+
+        /* fork everything that still needs launching before waiting on any */
+        for ( i = 0; i < procTable.num_nodes; i++ )
         {
-            syslog(LOG_ERR, "%s:%d ERROR: unable to read dir %s (%d:%s)",
-                   __FUNCTION__, __LINE__, directory, errno, strerror(errno));
-            success = false;
+            tmp_node = &procTable.nodes[i];
+            if ( (wave == tmp_node->wave) && (launchPending == tmp_node->alive) )
+            {
+                if ( readyExec != tmp_node->ready )
+                {
+                    needSettle = true;
+                }
+                printf("EXECUTING: Launching item %s\n", tmp_node->dir);
+                success = launch_process(tmp_node);
+                if ( true != success )
+                {
+                    break;
+                }
+            }
         }
 
-        printf("EXECUTING: Leaving directory %s\n", directory);
-        closedir(dir);
-    } /* else ! (NULL == dir) */
+        /* The children exec concurrently, so waiting on each status pipe in
+         * turn costs no more than waiting on the slowest one */
+        for ( i = 0; (i < procTable.num_nodes) && (true == success); i++ )
+        {
+            tmp_node = &procTable.nodes[i];
+            if ( (wave == tmp_node->wave) && (launchPending == tmp_node->alive) )
+            {
+                tmp_node->exec_errno = confirm_exec(tmp_node);
+            }
+        }
 
-    if (true != success)
-    {
-        rc = terminalError;
-    }
-    else if ( empty_dir )
-    {
-        rc = dirIsEmpty;
-    }
-    else
+        if ( (true == success) && (true == needSettle) )
+        {
+            stopWait(LAUNCH_SETTLE_MS);
+        }
+
+        num_pending = 0;
+        for ( i = 0; (i < procTable.num_nodes) && (true == success); i++ )
+        {
+            tmp_node = &procTable.nodes[i];
+            if ( (wave == tmp_node->wave) && (launchPending == tmp_node->alive) )
+            {
+                printf("EXECUTING: Checking status of %s after initial launch\n",
+                       tmp_node->item_name);
+                exec_errno = tmp_node->exec_errno;
+                waitreturn = 0;
+                /* a failed posix_spawn() leaves no child behind to wait for */
+                if ( 0 != tmp_node->child_pid )
+                {
+                    errno = 0;
+                    waitreturn = waitpid(tmp_node->child_pid, &rc, WNOHANG);
+                }
+                if ( 0 < waitreturn )
+                {
+                    /* the PID is reaped and may be reused, nothing may
+                     * signal it or report it as running any more */
+                    heartbeat_stop(tmp_node);
+                    proctable_setPid(&procTable, tmp_node, 0);
+                }
+
+                if ( (0 == waitreturn) && (0 == exec_errno) )
+                {
+                    tmp_node->alive = normal;
+                }
+                else
+                {
+                    syslog(LOG_ERR, "ERROR: File launch failed! (%s in %s) (try #%d) (%d:%s)",
+                        tmp_node->item_name, tmp_node->directory, launch_attempts, exec_errno, strerror(exec_errno));
+                    printf("ERROR: File %s not launched properly! (%d:%s)\n",
+                        tmp_node->item_name, exec_errno, strerror(exec_errno));
+
+                    if ( MAX_LAUNCH_ATTEMPTS > launch_attempts )
+                    {
+                        num_pending++;
+                    }
+                    else
+                    {
+                        errno = 0;
+                        syslog(LOG_ERR, "NOTICE: Process for %s in %s disabled permanently! (%d:%s)",
+                            tmp_node->item_name, tmp_node->directory, errno, strerror(errno));
+                        printf("NOTICE: Process for %s in %s disabled permanently! (%d:%s)\n",
+                            tmp_node->item_name, tmp_node->directory, errno, strerror(errno));
+
+                        tmp_node->alive = downPermanently;
+                        /* the name is not reported to AACM any more, so it
+                         * can be handed to another item */
+                        proctable_releaseName(&procTable, tmp_node);
+
+                        /* return a termination value if it is AACM, or any
+                         * other critical item, that failed */
+                        if ( true == tmp_node->critical )
+                        {
+                            if ( dirs[0] == tmp_node->directory )
+                            {
+                                syslog(LOG_ERR, "ERROR: AACM Cannot be started! (%d:%s)",
+                                    errno, strerror(errno));
+                                printf("ERROR: AACM Cannot be started! (%d:%s)\n",
+                                    errno, strerror(errno));
+                            }
+                            else
+                            {
+                                syslog(LOG_ERR, "ERROR: Critical item %s cannot be started!",
+                                    tmp_node->dir);
+                                printf("ERROR: Critical item %s cannot be started!\n",
+                                    tmp_node->dir);
+                            }
+
+                            success = false;
+                        }
+                    }
+                }
+            } /* if ( launchPending == tmp_node->alive ) */
+        } /* for each item in the batch */
+    } /* for ( launch_attempts ... ) */
+
+    printf("SUCCESS: Status check completed\n");
+    for ( i = 0; i < procTable.num_nodes; i++ )
     {
-        rc = normal;
+        tmp_node = &procTable.nodes[i];
+        if ( wave != tmp_node->wave )
+        {
+            continue;
+        }
+        printf( "CHILD process table 'pid': %d\n" , tmp_node->child_pid );
+        printf( "CHILD process table 'dir': %s\n" , tmp_node->dir );
+        printf( "CHILD process table 'name': %s\n" , tmp_node->item_name );
+        printf( "CHILD process table 'proc_name': %s\n" , tmp_node->proc_name );
     }
 
-    return rc;
-} /* int32_t launch_itemsInDir( const char *directory ) */
+    return success;
+} /* bool launch_batch(...) */
 
 
 
@@ -594,14 +1443,12 @@ bool rcv_errMsgs( void )
     bool handleError = false;
 
     printf("EXECUTING: Waiting for AACM_TO_BARSM message\n");
-    handleError = receive_aacmToBarsm( clientSocket_TCP, first_node );
+    handleError = receive_aacmToBarsm( &aacmReader, &procTable );
 
+    /* every AACM_TO_BARSM message is acknowledged as it is handled */
     if (handleError)
     {
         printf("SUCCESS: AACM_TO_BARSM message received and handled\n");
-        printf("EXECUTING: Sending ACK\n");
-        send_aacmToBarsmAck( clientSocket_TCP );
-        printf("EXECUTING: ACK sent\n");
     }
 
     return handleError;
@@ -13,4 +13,10 @@
 #  define DAEMON_BUILD_DATE     "UNKNOWN"
 #endif
 
+/* Tree the modules/applications are installed in, build with
+ * -DRC360_ROOT=\"...\" to run BARSM on another tree, see bench/boot_bench.c */
+#ifndef RC360_ROOT
+#  define RC360_ROOT            "/opt/rc360"
+#endif
+
 
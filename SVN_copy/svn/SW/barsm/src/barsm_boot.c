@@ -0,0 +1,272 @@
+/**
+ * File: barsm_boot.c
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ *
+ * Description:
+ *   This file contains the dependency graph used to boot the system. Every item
+ *   found in the application/module directories is a node, and its edges come
+ *   from the directory manifests. Without a manifest an item waits for all the
+ *   items of the previous non-empty directory, which is the order BARSM always
+ *   launched in. The graph is released in waves: each wave is every item whose
+ *   dependencies have all finished their own wave, and all items of a wave are
+ *   launched at the same time.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+
+#include "barsm_functions.h"
+#include "barsm_boot.h"
+
+/****************
+* PRIVATE FUNCTION PROTOTYPES
+****************/
+static void mask_set(uint64_t *mask, int32_t index);
+static bool mask_covers(const uint64_t *done, const uint64_t *deps);
+static int32_t find_dependency(proc_table *table, const char *item);
+static void add_after(boot_graph *graph, proc_table *table, int32_t index);
+
+
+
+/**
+ * Sets the bit of a node in a mask.
+ *
+ * @param[in] mask: the mask
+ * @param[in] index: the index of the node
+ *
+ * @return void
+ */
+void mask_set(uint64_t *mask, int32_t index)
+{
+    mask[index / 64] |= 1ULL << (index % 64);
+}
+
+/**
+ * Checks whether every node in deps is also in done.
+ *
+ * @param[in] done: the finished nodes
+ * @param[in] deps: the nodes waited for
+ *
+ * @return true if nothing in deps is still outstanding
+ */
+bool mask_covers(const uint64_t *done, const uint64_t *deps)
+{
+    bool covered = true;
+    int32_t i;
+
+    for ( i = 0; (i < BOOT_MASK_WORDS) && (true == covered); i++ )
+    {
+        covered = (0 == (deps[i] & ~done[i]));
+    }
+
+    return covered;
+}
+
+/**
+ * Finds the node of an item named in an after= list.
+ *
+ * @param[in] table: the process table
+ * @param[in] item: the file name of the item
+ *
+ * @return the index of the node, -1 if no directory has that item
+ */
+int32_t find_dependency(proc_table *table, const char *item)
+{
+    int32_t found = -1;
+    int32_t i;
+
+    for ( i = 0; (i < table->num_nodes) && (-1 == found); i++ )
+    {
+        if ( 0 == strcmp(table->nodes[i].item_name, item) )
+        {
+            found = i;
+        }
+    }
+
+    return found;
+}
+
+/**
+ * Adds the edges of a node's after= list to the graph.
+ *
+ * @param[in] graph: the boot graph
+ * @param[in] table: the process table
+ * @param[in] index: the node whose list is added
+ *
+ * @return void
+ */
+void add_after(boot_graph *graph, proc_table *table, int32_t index)
+{
+    char list[MAX_PROCS * 8];
+    char *savePtr;
+    char *item;
+    int32_t dep;
+
+    snprintf(list, sizeof(list), "%s", table->nodes[index].after);
+
+    item = strtok_r(list, ",", &savePtr);
+    while ( NULL != item )
+    {
+        dep = find_dependency(table, item);
+        if ( -1 == dep )
+        {
+            syslog(LOG_NOTICE, "NOTICE: %s waits for %s which is not installed",
+                table->nodes[index].dir, item);
+        }
+        else if ( dep != index )
+        {
+            mask_set(graph->deps[index], dep);
+        }
+        else
+        {
+            /* an item waiting for itself is ignored */
+        }
+
+        item = strtok_r(NULL, ",", &savePtr);
+    }
+}
+
+
+
+/**
+ * Builds the dependency graph of every node in the process table. Items
+ * outside of the system directory always wait for the whole system directory,
+ * since AACM has to be running before anything else is started.
+ *
+ * @param[in] graph: the boot graph
+ * @param[in] table: the process table, filled in directory order
+ * @param[in] system_dir: the directory AACM is in
+ *
+ * @return void
+ */
+void boot_buildGraph(boot_graph *graph, proc_table *table, const char *system_dir)
+{
+    uint64_t systemMask[BOOT_MASK_WORDS];
+    uint64_t prevDirMask[BOOT_MASK_WORDS];
+    uint64_t curDirMask[BOOT_MASK_WORDS];
+    const char *curDir = NULL;
+    proc_node *node;
+    int32_t i;
+    int32_t w;
+
+    memset(graph, 0, sizeof(*graph));
+    memset(systemMask, 0, sizeof(systemMask));
+    memset(prevDirMask, 0, sizeof(prevDirMask));
+    memset(curDirMask, 0, sizeof(curDirMask));
+
+    for ( i = 0; i < table->num_nodes; i++ )
+    {
+        node = &table->nodes[i];
+
+        if ( node->directory != curDir )
+        {
+            memcpy(prevDirMask, curDirMask, sizeof(prevDirMask));
+            memset(curDirMask, 0, sizeof(curDirMask));
+            curDir = node->directory;
+        }
+
+        if ( NULL == node->after )
+        {
+            memcpy(graph->deps[i], prevDirMask, sizeof(prevDirMask));
+        }
+        else
+        {
+            add_after(graph, table, i);
+            if ( system_dir != node->directory )
+            {
+                for ( w = 0; w < BOOT_MASK_WORDS; w++ )
+                {
+                    graph->deps[i][w] |= systemMask[w];
+                }
+            }
+        }
+
+        mask_set(curDirMask, i);
+        if ( system_dir == node->directory )
+        {
+            mask_set(systemMask, i);
+        }
+    } /* for ( i = 0; i < table->num_nodes; i++ ) */
+}
+
+/**
+ * Releases the next wave: every waiting node whose dependencies have all
+ * finished is marked launchPending and tagged with the wave number. If nodes
+ * are left waiting but none can be released, the manifests contain a cycle;
+ * it is logged and the remaining nodes are released together.
+ *
+ * @param[in] graph: the boot graph
+ * @param[in] table: the process table
+ *
+ * @return the number of nodes in the new wave, 0 once every node was launched
+ */
+int32_t boot_nextWave(boot_graph *graph, proc_table *table)
+{
+    int32_t numReleased = 0;
+    int32_t numWaiting = 0;
+    int32_t i;
+    proc_node *node;
+
+    graph->wave++;
+
+    for ( i = 0; i < table->num_nodes; i++ )
+    {
+        node = &table->nodes[i];
+        if ( launchWaiting == node->alive )
+        {
+            numWaiting++;
+            if ( true == mask_covers(graph->done, graph->deps[i]) )
+            {
+                node->alive = launchPending;
+                node->wave = graph->wave;
+                numReleased++;
+            }
+        }
+    }
+
+    if ( (0 == numReleased) && (0 < numWaiting) )
+    {
+        syslog(LOG_ERR, "%s:%d ERROR: dependency cycle between the %d items left to launch!",
+            __FUNCTION__, __LINE__, numWaiting);
+        printf("ERROR: dependency cycle between the %d items left to launch!\n", numWaiting);
+
+        for ( i = 0; i < table->num_nodes; i++ )
+        {
+            node = &table->nodes[i];
+            if ( launchWaiting == node->alive )
+            {
+                node->alive = launchPending;
+                node->wave = graph->wave;
+                numReleased++;
+            }
+        }
+    }
+
+    return numReleased;
+}
+
+/**
+ * Marks every node of the current wave as finished, whether it launched or was
+ * disabled, so that the items waiting for them can be released.
+ *
+ * @param[in] graph: the boot graph
+ * @param[in] table: the process table
+ *
+ * @return void
+ */
+void boot_waveDone(boot_graph *graph, proc_table *table)
+{
+    int32_t i;
+
+    for ( i = 0; i < table->num_nodes; i++ )
+    {
+        if ( graph->wave == table->nodes[i].wave )
+        {
+            mask_set(graph->done, i);
+        }
+    }
+}
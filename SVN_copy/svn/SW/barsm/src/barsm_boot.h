@@ -0,0 +1,39 @@
+/** @file barsm_boot.h
+ * Dependency graph BARSM uses to launch the system in waves.
+ *
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ */
+
+#ifndef __BARSM_BOOT_H__
+#define __BARSM_BOOT_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "barsm_proctable.h"
+
+/****************
+* CONSTANTS
+****************/
+#define BOOT_MASK_WORDS         ((MAX_PROCS + 63) / 64)
+
+/****************
+* DATA TYPES
+****************/
+/* One bit per node of the process table in every mask */
+struct boot_graph_struct
+{
+    uint64_t deps[MAX_PROCS][BOOT_MASK_WORDS];  /* what each node waits for */
+    uint64_t done[BOOT_MASK_WORDS];             /* nodes whose wave finished */
+    int32_t wave;                               /* number of the last wave */
+};
+typedef struct boot_graph_struct boot_graph;
+
+/****************
+* FUNCTION PROTOTYPES
+****************/
+void boot_buildGraph(boot_graph *graph, proc_table *table, const char *system_dir);
+int32_t boot_nextWave(boot_graph *graph, proc_table *table);
+void boot_waveDone(boot_graph *graph, proc_table *table);
+
+#endif
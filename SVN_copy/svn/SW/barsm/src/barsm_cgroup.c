@@ -0,0 +1,609 @@
+/**
+ * File: barsm_cgroup.c
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ *
+ * Description:
+ *   This file contains the cgroup v2 handling of BARSM. At startup BARSM finds
+ *   the cgroup it was started in, moves itself into the CGROUP_SELF child of
+ *   it and creates CGROUP_ITEMS next to it with the cpu, memory and io
+ *   controllers enabled, as far as the kernel offers them. A cgroup v2
+ *   hierarchy only allows controllers to be enabled below a cgroup without
+ *   processes of its own, hence the move. Every item then gets a leaf of its
+ *   own below CGROUP_ITEMS the first time it is launched, named after its
+ *   path, which is kept across restarts so the limits are written once:
+ *
+ *     <cgroup of BARSM>/barsm.items/opt_rc360_apps_GE_geapp
+ *
+ *   The child joins its leaf between the fork and the exec, see
+ *   spawn_joinCgroup(), so no instruction of the item runs outside of it.
+ *   The manifest sets the limits of the leaf:
+ *
+ *   geapp      cpu.max=20000/100000 memory.max=64M io.weight=50
+ *
+ *   Without a cgroup v2 hierarchy, or when BARSM cannot create its cgroups,
+ *   the items run in BARSM's cgroup without limits. A controller the kernel
+ *   does not offer only loses its limits and statistics.
+ *
+ *   When a process exits its usage is collected from the rusage of wait4()
+ *   and from the statistics of its leaf, see cgroup_collect().
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/vfs.h>
+#include <linux/magic.h>
+
+#include "barsm_cgroup.h"
+
+/****************
+* PRIVATE CONSTANTS
+****************/
+/* Largest cgroup file BARSM reads, e.g. cpu.stat or memory.events */
+#define CGROUP_FILE_MAX         1024
+/* Largest value BARSM writes, e.g. "100000 1000000" for cpu.max */
+#define CGROUP_VALUE_MAX        32
+
+/****************
+* PRIVATE GLOBALS
+****************/
+/* Where a unified hierarchy is mounted: on its own, or next to the v1
+ * controllers of a hybrid system */
+static const char *mounts[] = { "/sys/fs/cgroup", "/sys/fs/cgroup/unified" };
+static int32_t itemsFd = -1;
+
+/****************
+* PRIVATE FUNCTION PROTOTYPES
+****************/
+static bool find_base(char *base, size_t size);
+static int32_t make_leaf(int32_t parentFd, const char *name);
+static bool leaf_name(const char *dir, char *name, size_t size);
+static bool write_file(int32_t dirFd, const char *file, const char *value);
+static ssize_t read_file(int32_t dirFd, const char *file, char *buf, size_t size);
+static uint64_t read_key(int32_t dirFd, const char *file, const char *key);
+static bool has_word(const char *list, const char *word);
+static void enable_controllers(int32_t baseFd);
+static void write_limit(const proc_node *node, const char *file, const char *value);
+
+
+
+/**
+ * Finds the directory of the cgroup v2 BARSM was started in.
+ *
+ * @param[out] base: the directory
+ * @param[in] size: the size of base
+ *
+ * @return true/false whether there is a cgroup v2 hierarchy
+ */
+bool find_base(char *base, size_t size)
+{
+    bool success = false;
+    const char *mount = NULL;
+    char line[PATH_MAX];
+    char *path = NULL;
+    size_t len;
+    size_t i;
+    struct statfs fs;
+    FILE *fp;
+
+    for ( i = 0; (i < sizeof(mounts) / sizeof(mounts[0])) && (NULL == mount); i++ )
+    {
+        if ( (0 == statfs(mounts[i], &fs)) && (CGROUP2_SUPER_MAGIC == fs.f_type) )
+        {
+            mount = mounts[i];
+        }
+    }
+
+    /* the unified hierarchy is the "0::" line */
+    fp = (NULL != mount) ? fopen("/proc/self/cgroup", "re") : NULL;
+    if ( NULL != fp )
+    {
+        while ( (NULL == path) && (NULL != fgets(line, sizeof(line), fp)) )
+        {
+            if ( 0 == strncmp(line, "0::", 3) )
+            {
+                path = &line[3];
+                path[strcspn(path, "\n")] = '\0';
+            }
+        }
+        fclose(fp);
+    }
+
+    if ( NULL != path )
+    {
+        /* a BARSM started from within BARSM's own cgroup uses the same base */
+        len = strlen(path);
+        if ( (sizeof(CGROUP_SELF) <= len) &&
+             (0 == strcmp(&path[len - sizeof(CGROUP_SELF) + 1], CGROUP_SELF)) &&
+             ('/' == path[len - sizeof(CGROUP_SELF)]) )
+        {
+            path[len - sizeof(CGROUP_SELF)] = '\0';
+        }
+        if ( 0 == strcmp(path, "/") )
+        {
+            path[0] = '\0';
+        }
+
+        success = ((size_t)snprintf(base, size, "%s%s", mount, path) < size);
+    }
+
+    return success;
+}
+
+/**
+ * Creates a cgroup, unless it already exists, and opens it.
+ *
+ * @param[in] parentFd: the parent cgroup
+ * @param[in] name: the name of the cgroup
+ *
+ * @return the close-on-exec directory descriptor, -1 on failure
+ */
+int32_t make_leaf(int32_t parentFd, const char *name)
+{
+    int32_t fd = -1;
+
+    errno = 0;
+    if ( (0 == mkdirat(parentFd, name, 0755)) || (EEXIST == errno) )
+    {
+        fd = openat(parentFd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    }
+
+    return fd;
+}
+
+/**
+ * Builds the name of an item's leaf from the path of the item.
+ *
+ * @param[in] dir: the path of the item
+ * @param[out] name: the name of the leaf
+ * @param[in] size: the size of name
+ *
+ * @return true/false whether the name fits
+ */
+bool leaf_name(const char *dir, char *name, size_t size)
+{
+    size_t i = 0;
+
+    while ( '/' == *dir )
+    {
+        dir++;
+    }
+
+    for ( i = 0; ('\0' != dir[i]) && (i + 1 < size); i++ )
+    {
+        name[i] = ('/' == dir[i]) ? '_' : dir[i];
+    }
+    name[i] = '\0';
+
+    return ('\0' == dir[i]);
+}
+
+/**
+ * Writes a value to a cgroup interface file.
+ *
+ * @param[in] dirFd: the cgroup
+ * @param[in] file: the interface file
+ * @param[in] value: the value
+ *
+ * @return true/false whether the kernel took the value, errno is set otherwise
+ */
+bool write_file(int32_t dirFd, const char *file, const char *value)
+{
+    bool success = false;
+    int32_t fd;
+    int32_t err;
+    size_t len = strlen(value);
+
+    fd = openat(dirFd, file, O_WRONLY | O_CLOEXEC);
+    if ( -1 != fd )
+    {
+        success = ((ssize_t)len == write(fd, value, len));
+        err = errno;
+        close(fd);
+        errno = err;
+    }
+
+    return success;
+}
+
+/**
+ * Reads a cgroup interface file.
+ *
+ * @param[in] dirFd: the cgroup
+ * @param[in] file: the interface file
+ * @param[out] buf: the NUL terminated contents
+ * @param[in] size: the size of buf
+ *
+ * @return the length of the contents, -1 on failure
+ */
+ssize_t read_file(int32_t dirFd, const char *file, char *buf, size_t size)
+{
+    ssize_t len = -1;
+    int32_t fd;
+
+    fd = openat(dirFd, file, O_RDONLY | O_CLOEXEC);
+    if ( -1 != fd )
+    {
+        len = read(fd, buf, size - 1);
+        close(fd);
+    }
+    buf[(0 < len) ? len : 0] = '\0';
+
+    return len;
+}
+
+/**
+ * Reads a number from a cgroup interface file.
+ *
+ * @param[in] dirFd: the cgroup
+ * @param[in] file: the interface file
+ * @param[in] key: the key of a flat keyed file like cpu.stat, NULL for a file
+ *      with a single value like memory.peak
+ *
+ * @return the number, 0 if the file or the key does not exist
+ */
+uint64_t read_key(int32_t dirFd, const char *file, const char *key)
+{
+    uint64_t number = 0;
+    char buf[CGROUP_FILE_MAX];
+    const char *line = buf;
+    size_t keyLen = (NULL != key) ? strlen(key) : 0;
+
+    if ( 0 >= read_file(dirFd, file, buf, sizeof(buf)) )
+    {
+        line = NULL;
+    }
+
+    while ( (NULL != line) && (NULL != key) &&
+            ((0 != strncmp(line, key, keyLen)) || (' ' != line[keyLen])) )
+    {
+        line = strchr(line, '\n');
+        line = (NULL != line) ? line + 1 : NULL;
+    }
+
+    if ( NULL != line )
+    {
+        number = strtoull(&line[keyLen], NULL, 10);
+    }
+
+    return number;
+}
+
+/**
+ * Checks whether a space separated list contains a word.
+ *
+ * @param[in] list: the list, e.g. cgroup.controllers
+ * @param[in] word: the word
+ *
+ * @return true if the word is in the list
+ */
+bool has_word(const char *list, const char *word)
+{
+    bool found = false;
+    size_t wordLen = strlen(word);
+    size_t len;
+
+    while ( (false == found) && ('\0' != *list) )
+    {
+        len = strcspn(list, " \n");
+        found = (len == wordLen) && (0 == strncmp(list, word, len));
+        list += len;
+        list += strspn(list, " \n");
+    }
+
+    return found;
+}
+
+/**
+ * Enables the CGROUP_CONTROLLERS the kernel offers for the items. Each one is
+ * enabled on its own so that a controller that cannot be enabled does not
+ * cost the others.
+ *
+ * @param[in] baseFd: the cgroup BARSM was started in
+ *
+ * @return void
+ */
+void enable_controllers(int32_t baseFd)
+{
+    char available[CGROUP_FILE_MAX];
+    char wanted[] = CGROUP_CONTROLLERS;
+    char value[CGROUP_VALUE_MAX];
+    char *saveptr = NULL;
+    char *name;
+
+    read_file(baseFd, "cgroup.controllers", available, sizeof(available));
+
+    for ( name = strtok_r(wanted, " ", &saveptr); NULL != name;
+          name = strtok_r(NULL, " ", &saveptr) )
+    {
+        snprintf(value, sizeof(value), "+%s", name);
+        if ( false == has_word(available, name) )
+        {
+            syslog(LOG_NOTICE, "NOTICE: no %s controller, the items run without %s limits",
+                name, name);
+        }
+        else if ( (false == write_file(baseFd, "cgroup.subtree_control", value)) ||
+                  (false == write_file(itemsFd, "cgroup.subtree_control", value)) )
+        {
+            syslog(LOG_ERR, "%s:%d ERROR: unable to enable the %s controller! (%d:%s)",
+                __FUNCTION__, __LINE__, name, errno, strerror(errno));
+        }
+        else
+        {
+            syslog(LOG_DEBUG, "SUCCESS: %s controller enabled for the items", name);
+        }
+    }
+}
+
+/**
+ * Writes one limit of the manifest to the leaf of an item. A limit the kernel
+ * refuses is logged and the item runs without it.
+ *
+ * @param[in] node: the process table node of the item
+ * @param[in] file: the interface file of the limit
+ * @param[in] value: the value in the format of the kernel
+ *
+ * @return void
+ */
+void write_limit(const proc_node *node, const char *file, const char *value)
+{
+    if ( false == write_file(node->cgroup_fd, file, value) )
+    {
+        syslog(LOG_ERR, "%s:%d ERROR: unable to set %s of %s to %s! (%d:%s)",
+            __FUNCTION__, __LINE__, file, node->dir, value, errno, strerror(errno));
+    }
+}
+
+
+
+/**
+ * Sets up the cgroups of BARSM and its items. Has to be called before BARSM
+ * starts any other process or thread, since only BARSM itself is moved.
+ *
+ * @param[in] void
+ *
+ * @return true/false whether the items get cgroups of their own
+ */
+bool cgroup_init(void)
+{
+    bool success = true;
+    char base[PATH_MAX];
+    int32_t baseFd = -1;
+    int32_t selfFd = -1;
+
+    success = find_base(base, sizeof(base));
+    if ( true == success )
+    {
+        baseFd = open(base, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        success = (-1 != baseFd);
+    }
+
+    /* BARSM has to leave the base before controllers can be enabled there */
+    if ( true == success )
+    {
+        selfFd = make_leaf(baseFd, CGROUP_SELF);
+        success = (-1 != selfFd) && (true == write_file(selfFd, "cgroup.procs", "0"));
+    }
+
+    if ( true == success )
+    {
+        itemsFd = make_leaf(baseFd, CGROUP_ITEMS);
+        success = (-1 != itemsFd);
+    }
+
+    if ( true == success )
+    {
+        enable_controllers(baseFd);
+        syslog(LOG_INFO, "SUCCESS: items are placed below %s/%s", base, CGROUP_ITEMS);
+    }
+    else
+    {
+        syslog(LOG_ERR, "%s:%d ERROR: no cgroup v2 for the items, they run without limits! (%d:%s)",
+            __FUNCTION__, __LINE__, errno, strerror(errno));
+    }
+
+    if ( -1 != selfFd )
+    {
+        close(selfFd);
+    }
+    if ( -1 != baseFd )
+    {
+        close(baseFd);
+    }
+
+    return success;
+}
+
+/**
+ * Checks the value of cpu.max= when the manifest is read: max, or a quota
+ * and an optional period in microseconds, e.g. 20000/100000.
+ *
+ * @param[in] value: the value
+ *
+ * @return true/false whether the value is valid
+ */
+bool cgroup_validCpuMax(const char *value)
+{
+    bool success = true;
+    const char *rest = value;
+    char *end;
+    unsigned long long quota;
+    unsigned long long period = 100000;
+
+    if ( 0 == strncmp(value, "max", 3) )
+    {
+        rest = &value[3];
+    }
+    else
+    {
+        errno = 0;
+        quota = strtoull(value, &end, 10);
+        success = (0 == errno) && (end != value) && (1000 <= quota);
+        rest = end;
+    }
+
+    if ( (true == success) && ('/' == *rest) )
+    {
+        errno = 0;
+        period = strtoull(rest + 1, &end, 10);
+        success = (0 == errno) && (end != rest + 1);
+        rest = end;
+    }
+
+    return (true == success) && ('\0' == *rest) && (1000 <= period) && (1000000 >= period);
+}
+
+/**
+ * Checks the value of memory.max= when the manifest is read: max, or bytes
+ * with an optional K, M or G suffix.
+ *
+ * @param[in] value: the value
+ *
+ * @return true/false whether the value is valid
+ */
+bool cgroup_validMemoryMax(const char *value)
+{
+    bool success = true;
+    size_t digits = strspn(value, "0123456789");
+
+    if ( 0 != strcmp(value, "max") )
+    {
+        success = (0 < digits) && (CGROUP_VALUE_MAX > digits) &&
+                  (('\0' == value[digits]) ||
+                   ((NULL != strchr("KMG", value[digits])) && ('\0' == value[digits + 1])));
+    }
+
+    return success;
+}
+
+/**
+ * Creates and opens the leaf of an item and writes its limits, unless an
+ * earlier launch of the item already did.
+ *
+ * @param[in] node: the process table node of the item
+ *
+ * @return true/false whether node->cgroup_fd is the leaf of the item
+ */
+bool cgroup_open(proc_node *node)
+{
+    bool success = true;
+    char name[NAME_MAX + 1];
+    char value[CGROUP_VALUE_MAX];
+
+    if ( 0 <= node->cgroup_fd )
+    {
+        /* kept from an earlier launch */
+    }
+    else if ( -1 == itemsFd )
+    {
+        success = false;
+    }
+    else
+    {
+        errno = ENAMETOOLONG;
+        if ( true == leaf_name(node->dir, name, sizeof(name)) )
+        {
+            node->cgroup_fd = make_leaf(itemsFd, name);
+        }
+
+        if ( -1 == node->cgroup_fd )
+        {
+            syslog(LOG_ERR, "%s:%d ERROR: unable to create the cgroup of %s! (%d:%s)",
+                __FUNCTION__, __LINE__, node->dir, errno, strerror(errno));
+            success = false;
+        }
+        else
+        {
+            if ( NULL != node->cpu_max )
+            {
+                /* the manifest takes quota/period, the kernel "quota period" */
+                snprintf(value, sizeof(value), "%s", node->cpu_max);
+                value[strcspn(value, "/")] = (NULL != strchr(value, '/')) ? ' ' : '\0';
+                write_limit(node, "cpu.max", value);
+            }
+            if ( NULL != node->memory_max )
+            {
+                write_limit(node, "memory.max", node->memory_max);
+            }
+            if ( 0 != node->io_weight )
+            {
+                snprintf(value, sizeof(value), "default %d", node->io_weight);
+                write_limit(node, "io.weight", value);
+            }
+        }
+    }
+
+    return success;
+}
+
+/**
+ * Closes the leaf of an item that is no longer supervised and removes it once
+ * its last process has exited.
+ *
+ * @param[in] node: the process table node of the item
+ *
+ * @return void
+ */
+void cgroup_close(proc_node *node)
+{
+    char name[NAME_MAX + 1];
+
+    if ( 0 <= node->cgroup_fd )
+    {
+        close(node->cgroup_fd);
+        node->cgroup_fd = -1;
+
+        if ( (true == leaf_name(node->dir, name, sizeof(name))) &&
+             (0 != unlinkat(itemsFd, name, AT_REMOVEDIR)) )
+        {
+            syslog(LOG_DEBUG, "cgroup of %s left in place (%d:%s)",
+                node->dir, errno, strerror(errno));
+        }
+    }
+}
+
+/**
+ * Collects what the last process of an item used, after it has been reaped.
+ *
+ * @param[in] node: the process table node of the item
+ * @param[in] rusage: the rusage wait4() returned, NULL if unknown
+ * @param[out] usage: the usage
+ *
+ * @return void
+ */
+void cgroup_collect(const proc_node *node, const struct rusage *rusage, cgroup_usage *usage)
+{
+    memset(usage, 0, sizeof(*usage));
+
+    if ( NULL != rusage )
+    {
+        usage->user_us = ((uint64_t)rusage->ru_utime.tv_sec * 1000000u) +
+                         (uint64_t)rusage->ru_utime.tv_usec;
+        usage->system_us = ((uint64_t)rusage->ru_stime.tv_sec * 1000000u) +
+                           (uint64_t)rusage->ru_stime.tv_usec;
+        usage->max_rss_kb = (uint64_t)rusage->ru_maxrss;
+        usage->voluntary_cs = (uint64_t)rusage->ru_nvcsw;
+        usage->involuntary_cs = (uint64_t)rusage->ru_nivcsw;
+    }
+
+    if ( 0 <= node->cgroup_fd )
+    {
+        usage->cgroup_cpu_us = read_key(node->cgroup_fd, "cpu.stat", "usage_usec");
+        usage->memory_peak = read_key(node->cgroup_fd, "memory.peak", NULL);
+        if ( 0 == usage->memory_peak )
+        {
+            /* kernels before 5.19 only have the current usage */
+            usage->memory_peak = read_key(node->cgroup_fd, "memory.current", NULL);
+        }
+        usage->oom_kills = read_key(node->cgroup_fd, "memory.events", "oom_kill");
+    }
+}
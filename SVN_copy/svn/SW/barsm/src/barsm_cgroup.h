@@ -0,0 +1,61 @@
+/** @file barsm_cgroup.h
+ * cgroup v2 leaves, resource limits and resource accounting of the
+ * modules/applications BARSM launches.
+ *
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ */
+
+#ifndef __BARSM_CGROUP_H__
+#define __BARSM_CGROUP_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/resource.h>
+
+#include "barsm_proctable.h"
+
+/****************
+* CONSTANTS
+****************/
+/* Children of the cgroup BARSM was started in: BARSM itself moves to
+ * CGROUP_SELF and every item gets a leaf below CGROUP_ITEMS */
+#define CGROUP_SELF             "barsm.self"
+#define CGROUP_ITEMS            "barsm.items"
+
+/* Controllers enabled for the items when the kernel offers them */
+#define CGROUP_CONTROLLERS      "cpu memory io"
+
+/* Range of io.weight= */
+#define CGROUP_IO_WEIGHT_MIN    1
+#define CGROUP_IO_WEIGHT_MAX    10000
+
+/****************
+* DATA TYPES
+****************/
+/* What the last process of an item used. The rusage part covers that process
+ * and its reaped descendants; the cgroup part covers every process the item's
+ * leaf has held and is 0 without the cgroup or its controller. */
+struct cgroup_usage_struct
+{
+    uint64_t user_us;           /* CPU time in user mode */
+    uint64_t system_us;         /* CPU time in the kernel */
+    uint64_t max_rss_kb;        /* peak resident set */
+    uint64_t voluntary_cs;      /* context switches waiting for something */
+    uint64_t involuntary_cs;    /* context switches by preemption */
+    uint64_t cgroup_cpu_us;     /* cpu.stat usage_usec */
+    uint64_t memory_peak;       /* memory.peak, or memory.current, in bytes */
+    uint64_t oom_kills;         /* memory.events oom_kill */
+};
+typedef struct cgroup_usage_struct cgroup_usage;
+
+/****************
+* FUNCTION PROTOTYPES
+****************/
+bool cgroup_init(void);
+bool cgroup_validCpuMax(const char *value);
+bool cgroup_validMemoryMax(const char *value);
+bool cgroup_open(proc_node *node);
+void cgroup_close(proc_node *node);
+void cgroup_collect(const proc_node *node, const struct rusage *rusage, cgroup_usage *usage);
+
+#endif
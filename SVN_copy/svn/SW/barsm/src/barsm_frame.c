@@ -0,0 +1,229 @@
+/**
+ * File: barsm_frame.c
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ *
+ * Description:
+ *   This file contains the reader for the messages BARSM receives from AACM over
+ *   TCP. TCP does not keep message boundaries: one recv() can return part of a
+ *   message, or several messages that AACM sent back to back. The reader keeps
+ *   what was received in a persistent buffer and hands out one complete message
+ *   at a time, so a burst of messages costs a single recv() and nothing that
+ *   arrived together with another message is lost.
+ *
+ *   The size of each message is decided by a sizer callback, since not every
+ *   message of the AACM protocol has a usable LENGTH field.
+ *
+ *   Over an AF_UNIX SOCK_SEQPACKET socket every recv() returns exactly one
+ *   message, so the sizer only has to confirm that the packet is one whole
+ *   message. A malformed packet is dropped on its own instead of losing the
+ *   position of every message received after it.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <syslog.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include "barsm_frame.h"
+
+
+
+/**
+ * Prepares a reader for a connected stream or SOCK_SEQPACKET socket.
+ *
+ * @param[in] reader: the reader
+ * @param[in] fd: the socket to read from
+ * @param[in] sizer: returns the size of the message at the front of the buffer
+ *
+ * @return void
+ */
+void frame_init(frame_reader *reader, int32_t fd, frame_sizer sizer)
+{
+    int32_t type = 0;
+    socklen_t typeLen = sizeof(type);
+
+    reader->fd = fd;
+    reader->packet = (0 == getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &typeLen)) &&
+                     (SOCK_SEQPACKET == type);
+    reader->sizer = sizer;
+    reader->start = 0;
+    reader->end = 0;
+}
+
+/**
+ * Receives whatever the socket has into the free space of the buffer, with a
+ * single recv(). Unconsumed bytes are moved to the front of the buffer first if
+ * there is no room left behind them. A packet reader receives one packet into
+ * the empty buffer; a packet larger than the buffer is dropped.
+ *
+ * @param[in] reader: the reader
+ * @param[in] flags: recv() flags, MSG_DONTWAIT to not block
+ *
+ * @return the result of recv(): the number of bytes received, 0 if the peer
+ *      closed the connection or -1 with errno set
+ */
+ssize_t frame_fill(frame_reader *reader, int32_t flags)
+{
+    ssize_t retBytes;
+    int32_t truncFlag = (true == reader->packet) ? MSG_TRUNC : 0;
+
+    if ( (true == reader->packet) && (reader->start == reader->end) )
+    {
+        reader->start = 0;
+        reader->end = 0;
+    }
+
+    if ( (FRAME_BUF_SIZE == reader->end) && (0 < reader->start) )
+    {
+        memmove(reader->buf, &reader->buf[reader->start], reader->end - reader->start);
+        reader->end -= reader->start;
+        reader->start = 0;
+    }
+
+    if ( FRAME_BUF_SIZE == reader->end )
+    {
+        /* a full buffer without a complete message, the sizer said the message
+         * is larger than it said it could be */
+        syslog(LOG_ERR, "%s:%d ERROR: no message found in %d bytes, dropping them!",
+            __FUNCTION__, __LINE__, FRAME_BUF_SIZE);
+        reader->start = 0;
+        reader->end = 0;
+    }
+
+    do
+    {
+        errno = 0;
+        retBytes = recv(reader->fd, &reader->buf[reader->end],
+                        FRAME_BUF_SIZE - reader->end, flags | truncFlag);
+    } while ( (-1 == retBytes) && (EINTR == errno) );
+
+    if ( (0 < retBytes) && (FRAME_BUF_SIZE - reader->end < (size_t)retBytes) )
+    {
+        /* MSG_TRUNC returned the real size of a packet that did not fit */
+        syslog(LOG_ERR, "%s:%d ERROR: %zd byte packet does not fit, dropping it!",
+            __FUNCTION__, __LINE__, retBytes);
+    }
+    else if ( 0 < retBytes )
+    {
+        reader->end += (size_t)retBytes;
+    }
+
+    return retBytes;
+}
+
+/**
+ * Takes the next complete message out of the buffer, without receiving.
+ *
+ * @param[in] reader: the reader
+ * @param[out] frame: the message, valid until the next frame_fill()
+ * @param[out] len: the size of the message
+ *
+ * @return 1 if a message was returned, 0 if more bytes have to be received, -1
+ *      if the buffered bytes were not a valid message and were dropped
+ */
+int32_t frame_next(frame_reader *reader, const uint8_t **frame, size_t *len)
+{
+    int32_t rc = 0;
+    int32_t size;
+    size_t avail = reader->end - reader->start;
+
+    if ( (0 < avail) && (true == reader->packet) )
+    {
+        /* the packet is the message, the sizer only has to agree with it */
+        size = reader->sizer(&reader->buf[reader->start], avail);
+        reader->start = 0;
+        reader->end = 0;
+        if ( (size_t)size == avail )
+        {
+            *frame = reader->buf;
+            *len = avail;
+            rc = 1;
+        }
+        else
+        {
+            syslog(LOG_ERR, "%s:%d ERROR: invalid %zu byte message, dropping it!",
+                __FUNCTION__, __LINE__, avail);
+            rc = -1;
+        }
+    }
+    else if ( 0 < avail )
+    {
+        size = reader->sizer(&reader->buf[reader->start], avail);
+        if ( (0 > size) || (FRAME_BUF_SIZE < size) )
+        {
+            /* a stream has no way to find the start of the next message, so
+             * everything received so far is given up */
+            syslog(LOG_ERR, "%s:%d ERROR: invalid message, dropping %zu bytes!",
+                __FUNCTION__, __LINE__, avail);
+            printf("ERROR: invalid message, dropping %zu bytes!\n", avail);
+            reader->start = 0;
+            reader->end = 0;
+            rc = -1;
+        }
+        else if ( (0 < size) && ((size_t)size <= avail) )
+        {
+            *frame = &reader->buf[reader->start];
+            *len = (size_t)size;
+            reader->start += (size_t)size;
+            if ( reader->start == reader->end )
+            {
+                /* the frame stays readable, only the next fill reuses it */
+                reader->start = 0;
+                reader->end = 0;
+            }
+            rc = 1;
+        }
+        else
+        {
+            /* part of a message, wait for the rest */
+        }
+    }
+
+    return rc;
+}
+
+/**
+ * Returns the next complete message, receiving from the socket and blocking
+ * for as long as it takes for one to arrive.
+ *
+ * @param[in] reader: the reader
+ * @param[out] frame: the message, valid until the next frame_fill()
+ * @param[out] len: the size of the message
+ *
+ * @return true if a message was returned, false if the connection failed or
+ *      was closed first
+ */
+bool frame_wait(frame_reader *reader, const uint8_t **frame, size_t *len)
+{
+    bool success = true;
+    int32_t rc;
+    ssize_t retBytes;
+
+    rc = frame_next(reader, frame, len);
+    while ( (1 != rc) && (true == success) )
+    {
+        retBytes = frame_fill(reader, 0);
+        if ( -1 == retBytes )
+        {
+            syslog(LOG_ERR, "%s:%d ERROR: recv() failure! (%d: %s)",
+                __FUNCTION__, __LINE__, errno, strerror(errno));
+            success = false;
+        }
+        else if ( 0 == retBytes )
+        {
+            syslog(LOG_ERR, "%s:%d ERROR: connection closed by peer!",
+                __FUNCTION__, __LINE__);
+            success = false;
+        }
+        else
+        {
+            rc = frame_next(reader, frame, len);
+        }
+    }
+
+    return success;
+}
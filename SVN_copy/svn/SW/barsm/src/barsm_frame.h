@@ -0,0 +1,55 @@
+/** @file barsm_frame.h
+ * Buffered reader that splits a TCP byte stream, or a stream of SOCK_SEQPACKET
+ * packets, into protocol messages.
+ *
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ */
+
+#ifndef __BARSM_FRAME_H__
+#define __BARSM_FRAME_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/****************
+* CONSTANTS
+****************/
+/* every message starts with a 2 byte CMD_ID and a 2 byte LENGTH */
+#define FRAME_HEADER_SIZE       4
+/* room for several of the largest messages, so that a burst is read with a
+ * single recv() */
+#define FRAME_BUF_SIZE          4096
+
+/****************
+* DATA TYPES
+****************/
+/* Returns the size of the message that starts at data, given the len bytes
+ * received so far: 0 if more bytes are needed to tell, -1 if data cannot be
+ * the start of a valid message */
+typedef int32_t (*frame_sizer)(const uint8_t *data, size_t len);
+
+/* Bytes between start and end have been received but not consumed yet. They
+ * are moved back to the front of buf only when the free space at the end runs
+ * out. A packet reader holds at most one packet, which is one message. */
+struct frame_reader_struct
+{
+    int32_t fd;
+    bool packet;                /* fd is a SOCK_SEQPACKET socket */
+    frame_sizer sizer;
+    size_t start;
+    size_t end;
+    uint8_t buf[FRAME_BUF_SIZE];
+};
+typedef struct frame_reader_struct frame_reader;
+
+/****************
+* FUNCTION PROTOTYPES
+****************/
+void frame_init(frame_reader *reader, int32_t fd, frame_sizer sizer);
+ssize_t frame_fill(frame_reader *reader, int32_t flags);
+int32_t frame_next(frame_reader *reader, const uint8_t **frame, size_t *len);
+bool frame_wait(frame_reader *reader, const uint8_t **frame, size_t *len);
+
+#endif
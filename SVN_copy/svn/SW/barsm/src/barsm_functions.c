@@ -16,13 +16,30 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <arpa/inet.h>
+#include <sys/un.h>
 #include <sys/wait.h>
 #include <stdio.h>
 #include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <time.h>
 
 #include "barsm_functions.h"
-
-extern child_pid_list *first_node;
+#include "barsm_restart.h"
+#include "barsm_spawn.h"
+#include "barsm_manifest.h"
+#include "barsm_frame.h"
+#include "barsm_heartbeat.h"
+#include "barsm_journal.h"
+#include "barsm_zygote.h"
+#include "barsm_sockets.h"
+#include "barsm_metrics.h"
+
+/* How often, and how far apart, a refused connection to AACM is retried */
+#define TCP_CONNECT_RETRIES     50
+#define TCP_CONNECT_RETRY_MS    100
+
+extern proc_table procTable;
 
 struct sockaddr_in DestAddr_TCP;
 struct sockaddr_in DestAddr_UDP;
@@ -46,10 +63,13 @@ bool TCPsetup(int32_t *csocket)
     int32_t TCPServerPort       =  8000;
     int32_t reuse           = 1;
     int32_t chkSetSockOpt   = 0;
+    int32_t connectRc       = 0;
+    int32_t connectTries    = TCP_CONNECT_RETRIES;
+    struct timespec retryDelay = { 0, TCP_CONNECT_RETRY_MS * 1000000L };
 
     printf("EXECUTING: Creating TCP socket\n");
     errno = 0;
-    *csocket = socket(AF_INET, SOCK_STREAM, 0);
+    *csocket = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
     // printf("'socket' call return: %d\n", *csocket);
     if (0 > *csocket)
     {
@@ -86,7 +106,18 @@ bool TCPsetup(int32_t *csocket)
         DestAddr_TCP.sin_addr.s_addr = inet_addr(ServerIPAddress);  // set destination IP address
         memset(&(DestAddr_TCP.sin_zero), '\0', 8);                  // zero the rest of the struct
 
-        if (0 != connect(*csocket,(struct sockaddr *)&DestAddr_TCP, sizeof(DestAddr_TCP)))
+        /* AACM is launched only a moment before this runs and may not be
+         * listening yet, so a refused connection is retried for a while */
+        errno = 0;
+        connectRc = connect(*csocket,(struct sockaddr *)&DestAddr_TCP, sizeof(DestAddr_TCP));
+        while ( (0 != connectRc) && (ECONNREFUSED == errno) && (0 < connectTries--) )
+        {
+            nanosleep(&retryDelay, NULL);
+            errno = 0;
+            connectRc = connect(*csocket,(struct sockaddr *)&DestAddr_TCP, sizeof(DestAddr_TCP));
+        }
+
+        if (0 != connectRc)
         {
             syslog(LOG_ERR, "%s:%d ERROR! TCP failed to connect %hd (%d:%s)",
                    __FUNCTION__, __LINE__, TCPServerPort, errno, strerror(errno));
@@ -101,6 +132,102 @@ bool TCPsetup(int32_t *csocket)
     return success;
 }
 
+/**
+ * Establish the AF_UNIX control channel to AACM. A SOCK_SEQPACKET socket
+ * keeps the boundaries of the messages, so every recv() returns exactly one
+ * of them, and skips the TCP/IP stack for what is local traffic anyway.
+ *
+ * @param[in] csocket: socket for the AACM communications
+ * @param[in] path: the path AACM listens on
+ *
+ * @return true/false status of socket setup.
+ */
+bool UNIXsetup(int32_t *csocket, const char *path)
+{
+    bool success            = true;
+    int32_t connectRc       = 0;
+    int32_t connectTries    = TCP_CONNECT_RETRIES;
+    struct timespec retryDelay = { 0, TCP_CONNECT_RETRY_MS * 1000000L };
+    struct sockaddr_un addr;
+
+    if ( sizeof(addr.sun_path) <= strlen(path) )
+    {
+        syslog(LOG_ERR, "%s:%d ERROR! AACM socket path %s is too long",
+            __FUNCTION__, __LINE__, path);
+        success = false;
+    }
+
+    if ( true == success )
+    {
+        printf("EXECUTING: Creating UNIX socket\n");
+        errno = 0;
+        *csocket = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+        if (0 > *csocket)
+        {
+            success = false;
+            syslog(LOG_ERR, "%s:%d ERROR! Failed to create socket %d (%d:%s) ",
+                __FUNCTION__, __LINE__, *csocket, errno, strerror(errno));
+        }
+    }
+
+    if ( true == success )
+    {
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, path);
+
+        /* as for TCP, AACM may not be listening yet; until it has created
+         * its socket the path does not exist */
+        errno = 0;
+        connectRc = connect(*csocket, (struct sockaddr *)&addr, sizeof(addr));
+        while ( (0 != connectRc) && ((ECONNREFUSED == errno) || (ENOENT == errno)) &&
+                (0 < connectTries--) )
+        {
+            nanosleep(&retryDelay, NULL);
+            errno = 0;
+            connectRc = connect(*csocket, (struct sockaddr *)&addr, sizeof(addr));
+        }
+
+        if (0 != connectRc)
+        {
+            syslog(LOG_ERR, "%s:%d ERROR! UNIX socket failed to connect to %s (%d:%s)",
+                   __FUNCTION__, __LINE__, path, errno, strerror(errno));
+            success = false;
+        }
+        else
+        {
+            printf("SUCCESS: UNIX socket connection to AACM successful\n");
+        }
+    }
+
+    return success;
+}
+
+/**
+ * Establish the control channel to AACM over the transport chosen at startup:
+ * the UNIX socket named by AACM_SOCKET_ENV if it is set, TCP otherwise.
+ *
+ * @param[in] csocket: socket for the AACM communications
+ *
+ * @return true/false status of socket setup.
+ */
+bool AACMsetup(int32_t *csocket)
+{
+    bool success;
+    const char *path = getenv(AACM_SOCKET_ENV);
+
+    if ( (NULL != path) && ('\0' != path[0]) )
+    {
+        success = UNIXsetup(csocket, path);
+    }
+    else
+    {
+        success = TCPsetup(csocket);
+    }
+
+    return success;
+}
+
 
 
 /**
@@ -126,7 +253,7 @@ bool UDPsetup(int32_t *csocket)
     {
         printf("EXECUTING: Creating UDP socket\n");
         errno = 0;
-        *csocket = socket(AF_INET, SOCK_DGRAM, 0);
+        *csocket = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
         // syslog(LOG_DEBUG, "Client Socket: %d ", *csocket);
         if (0 > *csocket)
         {
@@ -261,57 +388,36 @@ bool send_barsmToAacmInit(int32_t csocket)
 /**
  * Used to receive the ackknoledgement message from the AACM.
  *
- * @param[in] csocket TCP socket
+ * @param[in] reader: the AACM TCP connection
  *
  * @return true/false whether a terminal error has occured
  */
-bool receive_barsmToAacmInitAck(int32_t csocket)
+bool receive_barsmToAacmInitAck(frame_reader *reader)
 {
     bool success = true;
-
-    enum barsmToAacmInitAck_params
-    {
-        CMD_ID          = 2,
-        LENGTH          = 2,
-        MSG_SIZE        =   CMD_ID +
-                            LENGTH,
-    };
-
-    ssize_t retBytes = 0;
-    uint8_t retData[ MAXBUFSIZE ];
-    uint8_t *ptr;
+    const uint8_t *frame = NULL;
+    size_t len = 0;
     uint32_t fullMsg = 0;
 
     printf("EXECUTING: Receiving BARSM TO AACM INIT ACK\n");
-    errno = 0;
-
-    retBytes = recv(csocket , retData , MSG_SIZE , 0 );
-    ptr = retData;
 
-    memcpy(&fullMsg, ptr, sizeof(fullMsg));
-    if ( -1 == retBytes )
-    {
-        syslog(LOG_ERR, "%s:%d ERROR: recv() failure! (%d: %s)",
-            __FUNCTION__, __LINE__, errno, strerror(errno));
-        success = false;
-    }
-    else if (0 == retBytes)
-    {
-        syslog(LOG_ERR, "%s:%d ERROR: 0 bytes received in recv()! (%d: %s) ",
-               __FUNCTION__, __LINE__, errno, strerror(errno));
-    }
-    else if ( 4 != retBytes || fullMsg != BARSM_TO_AACM_INIT_ACK_MSG )
-    {
-        syslog(LOG_ERR, "%s:%d ERROR: Message received was not expected ACK!",
-            __FUNCTION__, __LINE__);
-        success = false;
-        printf("Number of bytes in received ACK: %zd\n", retBytes);
-        printf("Full Message: %u\nExpected Message: %u\n",
-            fullMsg, BARSM_TO_AACM_INIT_ACK_MSG);
-    }
-    else
+    success = frame_wait(reader, &frame, &len);
+    if ( true == success )
     {
-        printf("SUCCESS: BARSM TO AACM INIT ACK received\n");
+        memcpy(&fullMsg, frame, sizeof(fullMsg));
+        if ( (sizeof(fullMsg) != len) || (BARSM_TO_AACM_INIT_ACK_MSG != fullMsg) )
+        {
+            syslog(LOG_ERR, "%s:%d ERROR: Message received was not expected ACK!",
+                __FUNCTION__, __LINE__);
+            success = false;
+            printf("Number of bytes in received ACK: %zu\n", len);
+            printf("Full Message: %u\nExpected Message: %u\n",
+                fullMsg, BARSM_TO_AACM_INIT_ACK_MSG);
+        }
+        else
+        {
+            printf("SUCCESS: BARSM TO AACM INIT ACK received\n");
+        }
     }
 
     return success;
@@ -320,140 +426,322 @@ bool receive_barsmToAacmInitAck(int32_t csocket)
 
 
 /**
- * Used to assign a name to each process in the system.
+ * Sizes the messages AACM sends to BARSM for the frame reader. AACM fills the
+ * LENGTH field with the size of the whole message, except that:
+ *  - the INIT ACK is sent with CMD_ID and LENGTH swapped (0x0000, 0x0011)
+ *  - the size of AACM_TO_BARSM is taken from its number of PIDs, which is what
+ *    its contents are parsed by
  *
- * @param[in] pName: The 4 character string to store the name in
- *            tmp_node: pointer position in the linked list where the first
- *                 process information is to be stored
- *            nth_node: pointer position in the linked list where the last 
- *                 process information is to be stored
+ * @param[in] data: the start of the message
+ * @param[in] len: the number of bytes received so far
  *
- * @return void
+ * @return the size of the message, 0 if more bytes are needed to tell, -1 if
+ *      this is not a valid message
  */
-void assign_procName( char * pName, child_pid_list *tmp_node, child_pid_list *nth_node)
+int32_t aacm_frameSize(const uint8_t *data, size_t len)
 {
-    int32_t i;
-    bool uniqueName = false;
+    enum aacmToBarsm_params
+    {
+        CMD_ID                  = 2,
+        LENGTH                  = 2,
+        PID                     = 4,
+        NUM_PROCESSES           = 2,
+        HEADER_SIZE             =   CMD_ID +
+                                    LENGTH +
+                                    PID +
+                                    NUM_PROCESSES,
+    };
+
+    int32_t size = 0;
+    uint16_t command = 0;
+    uint16_t length = 0;
+    uint16_t numProcs = 0;
 
-    do
+    if ( FRAME_HEADER_SIZE <= len )
     {
-        for ( i = 0; i < 4; i++ )
+        memcpy(&command, data, sizeof(command));
+        memcpy(&length, data + CMD_ID, sizeof(length));
+
+        if ( (0 == command) && (CMD_BARSM_TO_AACM_INIT_ACK == length) )
+        {
+            size = FRAME_HEADER_SIZE;
+        }
+        else if ( CMD_AACM_TO_BARSM == command )
+        {
+            if ( HEADER_SIZE <= len )
+            {
+                memcpy(&numProcs, data + CMD_ID + LENGTH + PID, sizeof(numProcs));
+                size = HEADER_SIZE + (PID * (int32_t)numProcs);
+            }
+        }
+        else if ( FRAME_HEADER_SIZE <= length )
+        {
+            size = length;
+        }
+        else
         {
-            pName[i] = rand_letter();
+            size = -1;
         }
-        pName[4] = '\0';
+    }
 
-        uniqueName = validName(pName, tmp_node, nth_node);
+    return size;
+}
 
-    }while (!uniqueName);
 
-}
 
 /**
- * Used to check if a name is already assigned to process in the system.
+ * Used to assign a name to each process in the system. Names come from the
+ * process table's name allocator and are derived from key, so an item keeps
+ * the same name every time it is launched.
  *
- * @param[in] pName: The 4 character string that stores the name
- *            tmp_node: pointer position in the linked list where the first
- *                 process information is to be stored
- *            nth_node: pointer position in the linked list where the last 
- *                 process information is to be stored
+ * @param[out] pName: The 4 character string to store the name in
+ * @param[in] key: string identifying the item, e.g. its path
+ * @param[in] table: the process table holding the names already in use
  *
- * @return bool
+ * @return true/false whether a name could be assigned
  */
-bool validName( char pName[4], child_pid_list *tmp_node, child_pid_list *nth_node)
+bool assign_procName( char *pName, const char *key, proc_table *table )
 {
-    bool    isValid = true;
-    int32_t val = 0;
-
-    //syslog(LOG_DEBUG, "DEBUG: suggested pName : %s", pName);
+    bool success = true;
 
-    while ( nth_node != tmp_node )
+    success = names_alloc(&table->names, key, pName);
+    if ( true != success )
     {
-        //syslog(LOG_DEBUG, "DEBUG: in use proc_name: %s", tmp_node->proc_name);
-        val = strcmp(tmp_node->proc_name, pName);
-
-        if (0 == val)
-        {
-            isValid = false;
-        }
-
-        tmp_node = tmp_node->next;
+        syslog(LOG_ERR, "%s:%d ERROR: no process name left for %s! (%d in use)",
+            __FUNCTION__, __LINE__, key, table->names.num_used);
+        printf("ERROR: no process name left for %s!\n", key);
     }
 
-    return isValid;
+    return success;
 }
 
+
+
 /**
- * Returns a random character from the alphabet.
+ * Starts a new process for the process table node that was send in the input
+ * parameters and waits for its exec to complete. The new PID is copied in
+ * place and 'alive' status updated. If the exec fails without leaving a child
+ * behind to exit, the failure is handed to the restart policy here since no
+ * SIGCHLD will report it.
  *
- * @param[in] void
+ * @param[in] tmp_node: the process table node where the new process
+ *      information needs to be stored
  *
- * @return char: randomly selected letter of the alphabet
+ * @return true/false whether a terminal error has occured
  */
-char rand_letter(void)
+bool start_process(proc_node *tmp_node)
 {
-    char returnVal = NULL;
+    bool success;
+
+    /* a restart that was still waiting out its backoff is superseded */
+    restart_cancel(tmp_node);
 
-    returnVal = 'a' + (rand() % 26);
+    success = launch_process(tmp_node);
+    if (true == success)
+    {
+        tmp_node->exec_errno = confirm_exec(tmp_node);
+        if ( (0 != tmp_node->exec_errno) && (0 == tmp_node->child_pid) )
+        {
+            restart_schedule(&procTable, tmp_node);
+        }
+    }
 
-    return returnVal;
+    return success;
 }
 
 
 
 /**
- * Starts a new process in the linked list position that was send in the input
- * parameters. The new PID is copied in place and 'alive' status updated.
+ * Spawns a new process for the process table node that was send in the input
+ * parameters with the SPAWN_DEFAULT_BACKEND backend. With the fork() backend
+ * the exec has not necessarily happened yet when this returns, its outcome is
+ * collected by confirm_exec(). A failed exec is not a terminal error, it is
+ * left in tmp_node->exec_errno. Items that signal their own readiness are
+ * given the write end of a new readiness pipe, whose read end is left in
+ * tmp_node->ready_fd. Items with a heartbeat deadline are given a heartbeat
+ * counter of their own and watched from the moment they are launched. Items
+ * with sockets= are given the sockets BARSM holds for them; if those cannot be
+ * created the item is launched without them and sets up its own. Every item
+ * is placed in a cgroup of its own when there is one, see barsm_cgroup.c.
+ * Shared object items are forked from the zygote instead, see barsm_zygote.c.
  *
- * @param[in] tmp_node: pointer position in the linked list wehre the new
- *      process information needs to be stored
+ * @param[in] tmp_node: the process table node where the new process
+ *      information needs to be stored
  *
  * @return true/false whether a terminal error has occured
  */
-bool start_process(child_pid_list *tmp_node)
+bool launch_process(proc_node *tmp_node)
 {
     bool success = true;
-
-    /* fork a new process to start the module back up */
-    pid_t new_pid;
-    printf("EXECUTING: Forking a new process to replace %s\n", tmp_node->item_name);
-    new_pid = fork();
-    if (0 == new_pid)
+    int32_t rc;
+    int32_t status_fd = -1;
+    int32_t ready_pipe[2] = { -1, -1 };
+    int32_t numVars = 0;
+    pid_t new_pid = 0;
+    char *argv[3];
+    char *vars[6];
+    char nameVar[sizeof(SPAWN_PROC_NAME_ENV) + PROC_NAME_LEN + 1];
+    char readyVar[sizeof(SPAWN_READY_FD_ENV) + 12];
+    char heartbeatVar[sizeof(SPAWN_HEARTBEAT_FD_ENV) + 12];
+    char listenVar[sizeof(SPAWN_LISTEN_FDS_ENV) + 12];
+    char mlockVar[] = SPAWN_MLOCK_ENV "=1";
+    char **envp;
+    spawn_request req;
+
+    argv[0] = tmp_node->item_name;
+    argv[1] = tmp_node->proc_name;
+    argv[2] = NULL;
+
+    snprintf(nameVar, sizeof(nameVar), "%s=%s", SPAWN_PROC_NAME_ENV, tmp_node->proc_name);
+    vars[numVars++] = nameVar;
+
+    if ( readyNotify == tmp_node->ready )
     {
-        /* execute the file again in the new child process */
+        if ( 0 <= tmp_node->ready_fd )
+        {
+            close(tmp_node->ready_fd);
+            tmp_node->ready_fd = -1;
+        }
+
         errno = 0;
-        if ( (0 != execl(tmp_node->dir, tmp_node->item_name, tmp_node->proc_name, (char *)NULL)) )
+        if ( 0 != pipe2(ready_pipe, O_CLOEXEC) )
         {
-            syslog(LOG_ERR, "ERROR: 'execl()' failed for %s! (%d:%s)",
+            syslog(LOG_ERR, "ERROR: Failed to create readiness pipe for %s! (%d:%s)",
                 tmp_node->dir, errno, strerror(errno));
-            printf("ERROR: 'execl()' failed for %s! (%d:%s)\n",
-                tmp_node->dir, errno, strerror(errno));
-            /* force the spawned process to exit */
-            exit(-errno);
         }
+        else
+        {
+            snprintf(readyVar, sizeof(readyVar), "%s=%d", SPAWN_READY_FD_ENV, SPAWN_READY_FD);
+            vars[numVars++] = readyVar;
+        }
+    }
+    if ( true == tmp_node->sched.mlock )
+    {
+        vars[numVars++] = mlockVar;
     }
-    else if (-1 == new_pid)
+    req.heartbeat_fd = heartbeat_open(tmp_node);
+    if ( 0 <= req.heartbeat_fd )
     {
-        syslog(LOG_ERR, "ERROR: Failed to fork child process for %s! (%d:%s)",
-            tmp_node->dir, errno, strerror(errno));
+        snprintf(heartbeatVar, sizeof(heartbeatVar), "%s=%d",
+                 SPAWN_HEARTBEAT_FD_ENV, SPAWN_HEARTBEAT_FD);
+        vars[numVars++] = heartbeatVar;
+    }
+    if ( true != sockets_open(tmp_node) )
+    {
+        printf("ERROR: Failed to create the sockets of %s, it has to create its own\n",
+            tmp_node->dir);
+    }
+    req.listen_fds = tmp_node->listen_fds;
+    req.num_listen_fds = tmp_node->num_listen_fds;
+    req.cgroup_fd = (true == cgroup_open(tmp_node)) ? tmp_node->cgroup_fd : -1;
+    if ( 0 < tmp_node->num_listen_fds )
+    {
+        snprintf(listenVar, sizeof(listenVar), "%s=%d", SPAWN_LISTEN_FDS_ENV,
+                 tmp_node->num_listen_fds);
+        vars[numVars++] = listenVar;
+    }
+    vars[numVars] = NULL;
 
-        success = false;
+    /* if the environment cannot be built the child just inherits BARSM's */
+    envp = spawn_env(vars);
+
+    req.path = tmp_node->dir;
+    req.argv = argv;
+    req.envp = envp;
+    req.ready_fd = ready_pipe[1];
+    req.sched = &tmp_node->sched;
+
+    printf("EXECUTING: Spawning a new process to replace %s\n", tmp_node->item_name);
+    if ( NULL != tmp_node->zygote )
+    {
+        rc = zygote_spawn(&req, tmp_node->zygote, &new_pid, &status_fd);
+    }
+    else
+    {
+        rc = spawn_process(SPAWN_DEFAULT_BACKEND, &req, &new_pid, &status_fd);
+    }
+    free(envp);
+
+    if ( 0 <= req.heartbeat_fd )
+    {
+        /* only the child and BARSM's mapping keep the counter */
+        close(req.heartbeat_fd);
+    }
+
+    if ( 0 <= ready_pipe[1] )
+    {
+        /* only the child keeps the write end, so the read end sees end of
+         * file if it exits without ever signalling */
+        close(ready_pipe[1]);
+        tmp_node->ready_fd = ready_pipe[0];
+    }
+
+    proctable_setPid(&procTable, tmp_node, new_pid);
+    tmp_node->exec_fd = status_fd;
+    tmp_node->exec_errno = rc;
+    tmp_node->start_ms = timer_nowMs();
+    metrics_launched(tmp_node);
+    heartbeat_start(tmp_node);
+
+    if ( 0 != rc )
+    {
+        syslog(LOG_ERR, "ERROR: Failed to spawn child process for %s! (%d:%s)",
+            tmp_node->dir, rc, strerror(rc));
     }
     else
     {
         syslog(LOG_DEBUG, "SUCCESS: launched %s with name %s with PID %d",
                tmp_node->dir, tmp_node->proc_name, new_pid);
-        printf("SUCCESS: New process with PID %d forked successfully\n", new_pid);
+        printf("SUCCESS: New process with PID %d spawned successfully\n", new_pid);
+    }
 
-        tmp_node->child_pid = new_pid;
-        /* alive == 0 indicates that the process has been restarted and should be good */
+    /* alive == 0 indicates that the process has been restarted and should be good */
+    if ( launchPending != tmp_node->alive )
+    {
         tmp_node->alive = normal;
     }
+
     return success;
 }
 
 
 
+/**
+ * Collects the outcome of the exec started by launch_process(). With the fork()
+ * backend this waits for the child to either complete its exec or report the
+ * errno of a failed one; otherwise the outcome is already known.
+ *
+ * @param[in] tmp_node: the process table node of the child
+ *
+ * @return int: 0 if the exec succeeded, otherwise the errno it failed with
+ */
+int32_t confirm_exec(proc_node *tmp_node)
+{
+    int32_t exec_errno = tmp_node->exec_errno;
+
+    if ( 0 <= tmp_node->exec_fd )
+    {
+        exec_errno = spawn_confirm(tmp_node->exec_fd);
+        tmp_node->exec_fd = -1;
+    }
+
+    if ( 0 != exec_errno )
+    {
+        syslog(LOG_ERR, "ERROR: 'execl()' failed for %s! (%d:%s)",
+            tmp_node->dir, exec_errno, strerror(exec_errno));
+        printf("ERROR: 'execl()' failed for %s! (%d:%s)\n",
+            tmp_node->dir, exec_errno, strerror(exec_errno));
+    }
+    else if ( readyNotify != tmp_node->ready )
+    {
+        metrics_ready(tmp_node);
+    }
+
+    return exec_errno;
+}
+
+
+
 /**
  * Used to package data for sending open UDP message.
  *
@@ -530,13 +818,15 @@ bool process_openUDP(int32_t csocket)
 
 
 /**
- * Receives the system initialization message from AACM
+ * Receives the system initialization message from AACM. The wait ends early if
+ * stop_fd becomes readable; what is there is left for the caller to read.
  *
  * @param[in] csocket UDP socket
+ * @param[in] stop_fd: the signalfd of the stop signals
  *
  * @return true/false whether the message was received
  */
-bool process_sysInit( int32_t csocket )
+bool process_sysInit( int32_t csocket, int32_t stop_fd )
 {
     bool gotMsg = false;
 
@@ -555,13 +845,36 @@ bool process_sysInit( int32_t csocket )
     uint8_t retData[ MAXBUFSIZE ] = { 0 };
     uint8_t *ptr;
     socklen_t toRcvUDP_size;
+    struct pollfd pfd[2];
 
     toRcvUDP_size = sizeof (toRcvUDP);
     printf("EXECUTING: Receiving SYS INIT message\n");
 
+    pfd[0].fd = csocket;
+    pfd[0].events = POLLIN;
+    pfd[1].fd = stop_fd;
+    pfd[1].events = POLLIN;
+
     // WAIT TO RECEIVE RESPONSE ...
     while ( true != gotMsg )
     {
+        errno = 0;
+        if ( -1 == poll(pfd, 2, -1) )
+        {
+            if ( EINTR != errno )
+            {
+                syslog(LOG_ERR, "%s:%d ERROR: poll() failed! (%d: %s)",
+                    __FUNCTION__, __LINE__, errno, strerror(errno));
+                break;
+            }
+            continue;
+        }
+        if ( 0 != pfd[1].revents )
+        {
+            syslog(LOG_NOTICE, "NOTICE: Asked to stop while waiting for SYS INIT");
+            break;
+        }
+
         retBytes = recvfrom(csocket, retData, MSG_SIZE, 0,
                             (struct sockaddr *)&toRcvUDP , &toRcvUDP_size);
 
@@ -620,14 +933,14 @@ bool process_sysInit( int32_t csocket )
  * and type values immediately after the SYS_INIT message is received.
  *
  * @param[in] csocket: TCP socket
- * @param[in] tmp_node: the pointer to the first item in the linked list
+ * @param[in] table: the process table
  * @param[in] dirs[]: list of directories for making the process type parameters
  * @param[in] barsm_name[4]: the random 4 char string assigned to barsm (the
- *      name not stored in the linked list)
+ *      name not stored in the process table)
  *
  * @return true/false whether a terminal error has occured
  */
-bool send_barsmToAacmProcesses( int32_t csocket, child_pid_list *tmp_node,
+bool send_barsmToAacmProcesses( int32_t csocket, proc_table *table,
     const char *dirs[], char barsm_name[] )
 {
     bool success = true;
@@ -642,11 +955,15 @@ bool send_barsmToAacmProcesses( int32_t csocket, child_pid_list *tmp_node,
         PROC_TYPE               = 4,
     };
 
-    uint8_t sendData[ MAXBUFSIZE ];
+    /* room for BARSM plus every entry of the process table */
+    uint8_t sendData[ CMD_ID + LENGTH + NUM_PROCESSES +
+                      (MAX_PROCS + 1) * (PID + PROC_NAME + PROC_TYPE) ];
     uint8_t *ptr;
     uint16_t val16;
     uint8_t *msgLenPtr;
     uint8_t *numProcsPtr;
+    proc_node *tmp_node;
+    int32_t i;
     pid_t tmpPid;
     uint32_t type;
     /* Start at 1 for BARSM */
@@ -669,7 +986,7 @@ bool send_barsmToAacmProcesses( int32_t csocket, child_pid_list *tmp_node,
     numProcsPtr = ptr;
     ptr += NUM_PROCESSES;
 
-    /* BARSM's info is not stored in the linked list so it needs to be handled
+    /* BARSM's info is not stored in the process table so it needs to be handled
      * outside of the loop */
     tmpPid = (uint32_t)getpid();
     memcpy(ptr, &tmpPid, sizeof(uint32_t));
@@ -690,8 +1007,9 @@ bool send_barsmToAacmProcesses( int32_t csocket, child_pid_list *tmp_node,
     memcpy(ptr, &type, sizeof(type));
     ptr += PROC_TYPE;
 
-    while ( NULL != tmp_node->next )
+    for ( i = 0; i < table->num_nodes; i++ )
     {
+        tmp_node = &table->nodes[i];
         if ( downPermanently != tmp_node->alive )
         {
             num_procs += 1;
@@ -740,8 +1058,7 @@ bool send_barsmToAacmProcesses( int32_t csocket, child_pid_list *tmp_node,
             memcpy(ptr, &type, sizeof(type));
             ptr += PROC_TYPE;
         }
-        tmp_node = tmp_node->next;
-    } /* while ( NULL != tmp_node->next ) */
+    } /* for ( i = 0; i < table->num_nodes; i++ ) */
 
     memcpy(numProcsPtr, &num_procs, sizeof(uint16_t));
     actualLength = NUM_PROCESSES + num_procs * (PID + PROC_TYPE + PROC_NAME);
@@ -769,157 +1086,138 @@ bool send_barsmToAacmProcesses( int32_t csocket, child_pid_list *tmp_node,
 
 
 /**
- * Goes through the entire list of modules once, checking if each successfully
- * started module is still running, and restarts those that have stopped.
+ * Handles the exit of a child process: AACM is told about it and what it used,
+ * and the matching module/application is restarted.
  *
- * @param[in] tmp_node: a pointer to the first item in the linked list
+ * @param[in] reader: the AACM TCP connection
+ * @param[in] table: the process table
+ * @param[in] pid: the PID of the child that exited
+ * @param[in] rc: its wait status, JOURNAL_STATUS_UNKNOWN for an adopted child
+ * @param[in] rusage: its resource usage, NULL for an adopted child
  *
  * @return true/false whether a terminal error has occurred
  */
-bool check_modules(int32_t csocket, child_pid_list *tmp_node)
+bool child_exited(frame_reader *reader, proc_table *table, pid_t pid, int32_t rc,
+    const struct rusage *rusage)
 {
     bool success = true;
-    int32_t rc;
-    int32_t waitreturn;
+    bool sent;
+    uint64_t sent_us;
+    proc_node *dead_node;
+    cgroup_usage usage;
 
-    /* check status of the child processes that are supposed to be running */
-    // printf("\n\n in check_modules\n\n");
-
-    while( NULL != tmp_node->next )
+    dead_node = proctable_findPid(table, pid);
+    if ( NULL != dead_node )
     {
-        if ( downPermanently != tmp_node->alive )
-        {
-            errno = 0;
-            waitreturn = waitpid(tmp_node->child_pid, &rc, WNOHANG);
-
-            if (-1 == waitreturn)
-            {
-                tmp_node->alive = handledByBarsmToAacm;
-
-                syslog(LOG_ERR, "ERROR: Process for %s with PID %d no longer exists! (%d:%s)",
-                    tmp_node->dir, tmp_node->child_pid, errno, strerror(errno));
-                printf("\nERROR: Process for %s with PID %d no longer exists! (%d:%s)\n",
-                    tmp_node->dir, tmp_node->child_pid, errno, strerror(errno));
-            }
-            else if (0 < waitreturn)
-            {
-                tmp_node->alive = handledByBarsmToAacm;
-
-                syslog(LOG_ERR, "ERROR: Process for %s with PID %d has changed state! (%d:%s)",
-                    tmp_node->dir, tmp_node->child_pid, errno, strerror(errno));
-                printf("\nERROR: Process for %s with PID %d has changed state! (%d:%s)\n",
-                    tmp_node->dir, tmp_node->child_pid, errno, strerror(errno));
-            }
-            else
-            {
-
-
-                /* Process is alive and has not changed state. No action required */
-            }
-
-            if ( handledByBarsmToAacm == tmp_node->alive)
-            {
-                /* Send Message to AACM*/
-                if (true == success)
-                {
-                    syslog(LOG_DEBUG, "sending barsm to aacm message");
-                    success = send_barsmToAacm(csocket, tmp_node);
-                }
-                else
-                {
-                    break;
-                }
-
-                /* The "receive_barsmToAacmAck()" function also handles the restarting
-                 * of all modules that need restarting
-                 */
-                if (true == success)
-                {
-                    syslog(LOG_DEBUG, "Receiving barsm to aacm ack");
-                    success = receive_barsmToAacmAck(csocket, tmp_node);
-                    syslog(LOG_DEBUG, "Got barsm to aacm ack");
-                }
-                else
-                {
-                    break;
-                }
-
-            } /* if ( handledByBarsmToAacm == tmp_node->alive) */
-        } /* if ( downPermanently != tmp_node->alive ) */
-
-        tmp_node = tmp_node->next;
-    } /* while( NULL != tmp_node->next ) */
-
-    return success;
-} /* bool check_modules(child_pid_list *tmp_node) */
-
-
-bool receive_barsmToAacmAck(int32_t csocket, child_pid_list *tmp_node)
-{
+        /* the PID is reaped, nothing may signal it any more */
+        heartbeat_stop(dead_node);
+        cgroup_collect(dead_node, rusage, &usage);
+        metrics_exited(dead_node, rc, &usage);
+    }
 
-    enum barsmToAacmAck_params
+    /* processes that were already replaced are no longer in the table and
+     * only need to be reaped, the ones AACM asked to have restarted are
+     * handled by the restart batch */
+    if ( (NULL != dead_node) && (true == restart_batchExited(table, dead_node)) )
     {
-        CMD_ID          = 2,
-        LENGTH          = 2,
-        ERROR           = 2,
-    };
+        syslog(LOG_DEBUG, "%s with PID %d exited for its restart (status 0x%x)",
+            dead_node->dir, pid, rc);
+    }
+    else if ( (NULL != dead_node) && (downPermanently != dead_node->alive) )
+    {
+        dead_node->alive = handledByBarsmToAacm;
 
-    bool success = true;
-    uint8_t retData[ MAXBUFSIZE ];
-    uint16_t command = 0;
-    uint16_t action = 0;
-    uint16_t actualLength = 0;
-    ssize_t retBytes = 0;
-    uint8_t *ptr;
+        syslog(LOG_ERR, "ERROR: Process for %s with PID %d has changed state! (status 0x%x)",
+            dead_node->dir, dead_node->child_pid, rc);
+        printf("\nERROR: Process for %s with PID %d has changed state! (status 0x%x)\n",
+            dead_node->dir, dead_node->child_pid, rc);
 
+        /* Send Message to AACM*/
+        syslog(LOG_DEBUG, "sending barsm to aacm message");
+        sent_us = metrics_nowUs();
+        sent = send_barsmToAacm(reader->fd, dead_node);
 
-    printf("EXECUTING: Receiving BARSM to AACM ACK message\n");
-    // WAIT TO RECEIVE RESPONSE ...
-    
-        /* wait for ACK */
-        errno = 0;
-        retBytes = recv( csocket , retData , MAXBUFSIZE , 0 );
-        if ( -1 == retBytes )
+        /* the PID has been reaped and may be reused by now, nothing may
+         * signal it or report it as running while the restart is backed off */
+        proctable_setPid(table, dead_node, 0);
+
+        if ( (true == sent) && (0 != AACM_USAGE_REPORT) )
         {
-            syslog(LOG_ERR, "%s:%d ERROR: In recv()! (%d: %s) ",
-                   __FUNCTION__, __LINE__, errno, strerror(errno));
+            send_barsmToAacmUsage(reader->fd, dead_node, pid, &usage);
         }
-        else if (0 == retBytes)
+
+        /* the restart itself is left to the restart policy so that a
+         * process in a crash loop is backed off instead of relaunched on
+         * every exit. It starts once AACM has acknowledged the message,
+         * which is received by the event loop like any other. */
+        if ( true == sent )
         {
-            syslog(LOG_ERR, "%s:%d ERROR: 0 bytes received in recv()! (%d: %s) ",
-                   __FUNCTION__, __LINE__, errno, strerror(errno));
+            restart_awaitAck(dead_node, pid, sent_us);
         }
         else
         {
-            printf("SUCCESS: BARSM to AACM ACK message received (%zd bytes)\n", retBytes);
+            restart_schedule(table, dead_node);
+        }
+    }
+    else if ( NULL != dead_node )
+    {
+        /* a removed or disabled item, it is no longer supervised */
+        restart_cancel(dead_node);
+        proctable_setPid(table, dead_node, 0);
+        cgroup_close(dead_node);
+    }
 
-            ptr = retData;
-            memcpy(&command, ptr, sizeof(command));
-            ptr += CMD_ID;
+    return success;
+} /* bool child_exited(...) */
 
-            memcpy(&actualLength, ptr, sizeof(actualLength));
-            ptr += LENGTH;
+/**
+ * Reaps every child process that has exited since the last SIGCHLD and
+ * restarts the matching modules/applications. Called from the BARSM event loop
+ * when the SIGCHLD signalfd, or the pidfd of an adopted child, becomes
+ * readable, so only the children that have actually exited are visited.
+ *
+ * @param[in] reader: the AACM TCP connection
+ * @param[in] table: the process table
+ *
+ * @return true/false whether a terminal error has occurred
+ */
+bool check_modules(frame_reader *reader, proc_table *table)
+{
+    bool success = true;
+    int32_t rc;
+    pid_t waitreturn;
+    struct rusage rusage;
 
-            memcpy(&action, ptr, sizeof(action));
-            ptr += ERROR;
+    /* a single SIGCHLD may stand for several children, reap until none left */
+    errno = 0;
+    waitreturn = wait4(-1, &rc, WNOHANG, &rusage);
+    while ( (0 < waitreturn) && (true == success) )
+    {
+        success = child_exited(reader, table, waitreturn, rc, &rusage);
 
-            syslog(LOG_NOTICE, "NOTICE: Restarting %s...", tmp_node->item_name);
+        errno = 0;
+        waitreturn = wait4(-1, &rc, WNOHANG, &rusage);
+    } /* while ( (0 < waitreturn) && (true == success) ) */
 
-            printf("EXECUTING: Restarting %s...", tmp_node->item_name);
-            if ( ! start_process(tmp_node) )
-            {
-                success = false;
-            }
-            else
-            {
-                printf("SUCCESS: Restart completed\n");
-            }
-        }
+    if ( (-1 == waitreturn) && (ECHILD != errno) )
+    {
+        syslog(LOG_ERR, "%s:%d ERROR: wait4() failed! (%d:%s)",
+            __FUNCTION__, __LINE__, errno, strerror(errno));
+    }
+
+    /* children adopted from a crashed BARSM are reaped by the supervisor */
+    waitreturn = (true == success) ? journal_reapAdopted(table) : 0;
+    while ( 0 < waitreturn )
+    {
+        success = child_exited(reader, table, waitreturn, JOURNAL_STATUS_UNKNOWN, NULL);
+        waitreturn = (true == success) ? journal_reapAdopted(table) : 0;
+    }
 
     return success;
-}
+} /* bool check_modules(frame_reader *reader, proc_table *table) */
+
 
-bool send_barsmToAacm(int32_t csocket, child_pid_list *tmp_node)
+bool send_barsmToAacm(int32_t csocket, proc_node *tmp_node)
 {
     bool success = true;
 
@@ -971,11 +1269,13 @@ bool send_barsmToAacm(int32_t csocket, child_pid_list *tmp_node)
     {
         syslog(LOG_ERR, "%s:%d ERROR: Sending of BARSM_TO_AACM MSG failed! (%d: %s)",
             __FUNCTION__, __LINE__, errno, strerror(errno));
+        success = false;
     }
     else if ( MSG_SIZE != sentBytes )
     {
         syslog(LOG_ERR, "%s:%d ERROR: During sending of BARSM_TO_AACM MSG!",
             __FUNCTION__, __LINE__);
+        success = false;
     }
 
     syslog(LOG_DEBUG, "DEBUG: Message sent with APP name: %c%c%c%c", tmp_node->proc_name[0], 
@@ -984,18 +1284,112 @@ bool send_barsmToAacm(int32_t csocket, child_pid_list *tmp_node)
     return success;
 }
 
+/**
+ * Tells AACM what the process of a BARSM_TO_AACM message used. The message is
+ * not acknowledged. Times are in milliseconds and sizes in kilobytes, each
+ * saturated at UINT32_MAX; the cgroup values are 0 without a cgroup.
+ *
+ * @param[in] csocket: the AACM connection
+ * @param[in] tmp_node: the process table node of the process that exited
+ * @param[in] pid: the PID it had, the node no longer holds it
+ * @param[in] usage: what it used, see cgroup_collect()
+ *
+ * @return true/false whether a terminal error has occurred
+ */
+bool send_barsmToAacmUsage(int32_t csocket, const proc_node *tmp_node, pid_t pid,
+    const cgroup_usage *usage)
+{
+    bool success = true;
+
+    enum barsmToAacmUsage_params
+    {
+        CMD_ID                  = 2,
+        LENGTH                  = 2,
+        SRC_PID                 = 4,
+        SRC_APPNAME             = 4,
+        NUM_VALUES              = 8,
+        VALUE                   = 4,
+        MSG_SIZE                =   CMD_ID +
+                                    LENGTH +
+                                    SRC_PID +
+                                    SRC_APPNAME +
+                                    NUM_VALUES * VALUE,
+    };
+
+    uint8_t sendData[ MAXBUFSIZE ];
+    uint8_t *ptr;
+    uint16_t val16 = 0;
+    uint32_t val32 = 0;
+    uint64_t values[NUM_VALUES];
+    int32_t sentBytes = 0;
+    int32_t i;
+
+    /* in the order of the message */
+    values[0] = usage->user_us / 1000u;
+    values[1] = usage->system_us / 1000u;
+    values[2] = usage->max_rss_kb;
+    values[3] = usage->voluntary_cs;
+    values[4] = usage->involuntary_cs;
+    values[5] = usage->cgroup_cpu_us / 1000u;
+    values[6] = usage->memory_peak / 1024u;
+    values[7] = usage->oom_kills;
+
+    ptr = sendData;
+    val16 = CMD_BARSM_TO_AACM_USAGE;
+    memcpy(ptr, &val16, sizeof(val16));
+    ptr += CMD_ID;
+
+    val16 = MSG_SIZE - CMD_ID - LENGTH;
+    memcpy(ptr, &val16, sizeof(val16));
+    ptr += LENGTH;
+
+    memcpy(ptr, &pid, sizeof(uint32_t));
+    ptr += SRC_PID;
+
+    memcpy(ptr, &tmp_node->proc_name[0], SRC_APPNAME);
+    ptr += SRC_APPNAME;
+
+    for ( i = 0; i < NUM_VALUES; i++ )
+    {
+        val32 = (UINT32_MAX < values[i]) ? UINT32_MAX : (uint32_t)values[i];
+        memcpy(ptr, &val32, sizeof(val32));
+        ptr += VALUE;
+    }
+
+    errno = 0;
+    sentBytes = send(csocket, sendData, MSG_SIZE, 0);
+    if ( MSG_SIZE != sentBytes )
+    {
+        syslog(LOG_ERR, "%s:%d ERROR: Sending of BARSM_TO_AACM_USAGE MSG failed! (%d: %s)",
+            __FUNCTION__, __LINE__, errno, strerror(errno));
+    }
+    else
+    {
+        syslog(LOG_DEBUG, "DEBUG: %.4s used %u+%u ms CPU, %u kB RSS, %u/%u context switches",
+            tmp_node->proc_name, (uint32_t)values[0], (uint32_t)values[1],
+            (uint32_t)values[2], (uint32_t)values[3], (uint32_t)values[4]);
+    }
+
+    return success;
+}
+
 
 
 /**
- * Waits for error messages from the AACM, and restarts or terminates modules
- * and applications as directed in the messages.
+ * Handles one complete message received from AACM. The processes listed in an
+ * AACM_TO_BARSM message are handed to the restart batch, which acknowledges the
+ * message once they have all been replaced. A BARSM_TO_AACM ACK lets the
+ * restart of the process it is for go ahead.
  *
- * @param[in] csocket: TCP socket
- * @param[in] tmp_node: a pointer to the first item in the linked list
+ * @param[in] reader: the AACM TCP connection
+ * @param[in] table: the process table
+ * @param[in] frame: the message
+ * @param[in] len: the size of the message
  *
- * @return bool
+ * @return true if the message was an AACM_TO_BARSM message
  */
-bool receive_aacmToBarsm( int32_t csocket, child_pid_list *tmp_node )
+bool dispatch_aacmMsg( frame_reader *reader, proc_table *table,
+    const uint8_t *frame, size_t len )
 {
     enum aacmToBarsm_params
     {
@@ -1003,50 +1397,25 @@ bool receive_aacmToBarsm( int32_t csocket, child_pid_list *tmp_node )
         LENGTH                  = 2,
         PID                     = 4,
         NUM_PROCESSES           = 2,
+        ACK_ERROR               = 2,
     };
 
     bool     handleError = false;
     uint16_t command = 0;
-    uint16_t actualLength = 0;
     uint16_t numErrors = 0;
-    uint8_t retData[ MAXBUFSIZE ];
-    uint8_t *ptr;
+    uint16_t action = 0;
+    const uint8_t *ptr;
     pid_t srcPid = 0;
-    pid_t tmpPid = 0;
-    ssize_t retBytes = 0;
-
-    struct timeval minTimeout, noTimeout;      
-    minTimeout.tv_sec  = 60;
-    minTimeout.tv_usec = 0;
-    noTimeout.tv_sec   = 0;
-    noTimeout.tv_usec  = 0;
-
-    printf("EXECUTING: Receiving AACM TO BARSM message\n");
-
-    // WAIT TO RECEIVE RESPONSE ...
-
-    /* make socket timeout to one minute */
-    setsockopt (csocket, SOL_SOCKET, SO_RCVTIMEO, (char *)&minTimeout,
-            sizeof(minTimeout));
+    pid_t pids[MAX_PROCS];
+    uint16_t i;
 
-    retBytes = recv( csocket , retData , MAXBUFSIZE , 0 );
+    ptr = frame;
+    memcpy(&command, ptr, sizeof(command));
+    ptr += CMD_ID + LENGTH;
 
-    /* make socket not have a timeout */
-    setsockopt (csocket, SOL_SOCKET, SO_RCVTIMEO, (char *)&noTimeout,
-            sizeof(noTimeout));
-
-    if  ( 0 < retBytes ) /* recv successful */
+    if ( CMD_AACM_TO_BARSM == command )
     {
-        /* TODO: Confirm the command received and only do this
-         * processing if it is the expected message */
-        printf("SUCCESS: AACM TO BARSM message received (%zd bytes)\n", retBytes);
-
-        ptr = retData;
-        memcpy(&command, ptr, sizeof(command));
-        ptr += CMD_ID;
-
-        memcpy(&actualLength, ptr, sizeof(actualLength));
-        ptr += LENGTH;
+        printf("SUCCESS: AACM TO BARSM message received (%zu bytes)\n", len);
 
         memcpy(&srcPid, ptr, sizeof(srcPid));
         ptr += PID;
@@ -1057,21 +1426,84 @@ bool receive_aacmToBarsm( int32_t csocket, child_pid_list *tmp_node )
         printf("EXECUTING: Restarting all %d apps indicated in AACM TO BARSM message\n",
                numErrors);
 
-        for (int16_t i = 0; i < numErrors; i++)
+        /* there cannot be more distinct processes than the table holds */
+        if ( MAX_PROCS < numErrors )
+        {
+            syslog(LOG_ERR, "%s:%d ERROR: %d PIDs in AACM TO BARSM, only the first %d are restarted!",
+                __FUNCTION__, __LINE__, numErrors, MAX_PROCS);
+            numErrors = MAX_PROCS;
+        }
+
+        /* the frame reader only returns the message once all of it is there */
+        for ( i = 0; i < numErrors; i++ )
         {
-            memcpy(&tmpPid, ptr, sizeof(tmpPid));
+            memcpy(&pids[i], ptr, sizeof(pids[i]));
             ptr += PID;
-            start_select(tmpPid, tmp_node);
         }
+        restart_batchAdd(table, reader->fd, pids, numErrors);
         handleError = true;
-        printf("SUCCESS: Restarting of apps complete\n");
-    } /* recv successful */
+    }
+    else if ( (CMD_BARSM_TO_AACM_ACK == command) && ((CMD_ID + LENGTH + PID + ACK_ERROR) <= len) )
+    {
+        printf("SUCCESS: BARSM to AACM ACK message received (%zu bytes)\n", len);
+
+        memcpy(&srcPid, ptr, sizeof(srcPid));
+        ptr += PID;
+        memcpy(&action, ptr, sizeof(action));
+
+        syslog(LOG_DEBUG, "BARSM to AACM ACK for PID %d (action 0x%x)", srcPid, action);
+        if ( false == restart_acked(table, srcPid) )
+        {
+            syslog(LOG_NOTICE, "%s:%d NOTICE: BARSM to AACM ACK for PID %d received while not waiting for one",
+                __FUNCTION__, __LINE__, srcPid);
+        }
+    }
     else
+    {
+        syslog(LOG_ERR, "%s:%d ERROR: unexpected message 0x%x (%zu bytes) from AACM!",
+            __FUNCTION__, __LINE__, command, len);
+    }
+
+    return handleError;
+}
+
+
+
+/**
+ * Receives the error messages AACM has sent, and restarts or terminates
+ * modules and applications as directed in the messages. Called when the AACM
+ * socket is readable; everything available is received with a single recv()
+ * and every complete message in it is handled, whatever is left of a partial
+ * message stays buffered for the next call.
+ *
+ * @param[in] reader: the AACM TCP connection
+ * @param[in] table: the process table
+ *
+ * @return true if at least one AACM_TO_BARSM message was handled
+ */
+bool receive_aacmToBarsm( frame_reader *reader, proc_table *table )
+{
+    bool     handleError = false;
+    const uint8_t *frame = NULL;
+    size_t len = 0;
+    ssize_t retBytes = 0;
+
+    printf("EXECUTING: Receiving AACM TO BARSM message\n");
+
+    retBytes = frame_fill(reader, MSG_DONTWAIT);
+    if ( 0 >= retBytes )
     {
         syslog(LOG_DEBUG, "%s:%d No data to receive in recv()! ",
                __FUNCTION__, __LINE__);
     }
 
+    while ( 1 == frame_next(reader, &frame, &len) )
+    {
+        if ( true == dispatch_aacmMsg(reader, table, frame, len) )
+        {
+            handleError = true;
+        }
+    }
 
     return handleError;
 }
@@ -1140,48 +1572,3 @@ void send_aacmToBarsmAck( int32_t csocket )
     }
 }
 
-
-
-/**
- * Selects the item in the linked list that matches the given PID, and calls
- * the start_process() with that item of the linked list.
- *
- * @param[in] pid: the PID of the process that needs to be replaced/restarted
- * @param[in] tmp_node: a pointer to the first item in the linked list
- *
- * @return true/false whether a terminal error occured
- */
-bool start_select(pid_t pid, child_pid_list *tmp_node)
-{
-    bool success = false;
-
-    while (NULL != tmp_node->next)
-    {
-        if (pid == tmp_node->child_pid)
-        {
-            /* check that the old process was terminated before starting a new
-             * process */
-            errno = 0;
-            if ( -1 == kill(tmp_node->child_pid , SIGTERM) )
-            {
-                printf("%s:%d ERROR! Not able to kill process with PID %d (%d:%s)",
-                    __FUNCTION__, __LINE__, tmp_node->child_pid , errno, strerror(errno));
-            }
-            else
-            {
-                printf("SUCCESS: Process with PID %d eliminated successfully \n",
-                    tmp_node->child_pid );
-            }
-
-            printf("EXECUTING: Starting new process for old process with PID %d \n", pid);
-            success = start_process(tmp_node);
-
-            break;
-        }
-
-        tmp_node = tmp_node->next;
-    } /* while (NULL != tmp_node->next) */
-
-    return success;
-}
-
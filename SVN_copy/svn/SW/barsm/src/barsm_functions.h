@@ -1,7 +1,20 @@
+#include "barsm_proctable.h"
+#include "barsm_frame.h"
+#include "barsm_cgroup.h"
+
 #define BARSM_TO_AACM_INIT_ACK_MSG 0x00110000
 #define UNUSED(x) (x)__attribute__((unused))
 
 #define MAXBUFSIZE  1000
+/* Path of AACM's AF_UNIX SOCK_SEQPACKET control socket. When set, BARSM and
+ * the items it launches use it instead of TCP to 127.0.0.1:8000 */
+#define AACM_SOCKET_ENV "RC360_AACM_SOCKET"
+/* Follow every BARSM_TO_AACM message with the resource usage of the process
+ * that exited. An AACM that does not know the message treats it as an error,
+ * so it is only sent by a build with -DAACM_USAGE_REPORT=1 */
+#ifndef AACM_USAGE_REPORT
+#define AACM_USAGE_REPORT 0
+#endif
 
 enum WhichMsg 
 {
@@ -13,6 +26,7 @@ enum WhichMsg
     CMD_BARSM_TO_AACM_INIT          = 0x0010,
     CMD_BARSM_TO_AACM_INIT_ACK      = 0x0011,
     CMD_BARSM_TO_AACM_PROCESSES     = 0x0012,
+    CMD_BARSM_TO_AACM_USAGE         = 0x0013,
     CMD_SYSINIT                     = 0x000B,   // send
 };
 
@@ -33,17 +47,6 @@ enum errorCodes
     GE_AACM_TO_BARSM_ERR                = 0x0C,
 };
 
-struct child_pid_list_struct
-{
-    pid_t child_pid;
-    char *dir;
-    char *item_name;
-    char proc_name[5];
-    int32_t alive;
-    struct child_pid_list_struct *next;
-};
-typedef struct child_pid_list_struct child_pid_list;
-
 /* 'alive' VALUE ENUMS */
 enum e_alive
 {
@@ -51,31 +54,40 @@ enum e_alive
     normal                  = 0,
     handledByBarsmToAacm    = 1,
     handledByAacmToBarsm    = 2,
+    launchPending           = 3,
+    launchWaiting           = 4,
 };
 
 /* From barsm_functions.c */
+bool AACMsetup(int32_t *csocket);
 bool TCPsetup(int32_t *csocket);
+bool UNIXsetup(int32_t *csocket, const char *path);
 bool UDPsetup(int32_t *csocket);
 
 bool send_barsmToAacmInit(int32_t csocket);
-bool receive_barsmToAacmInitAck(int32_t csocket);
+bool receive_barsmToAacmInitAck(frame_reader *reader);
+int32_t aacm_frameSize(const uint8_t *data, size_t len);
 
-void assign_procName( char * pName, child_pid_list *first_node, child_pid_list *nth_node);
-bool validName( char pName[4], child_pid_list *tmp_node, child_pid_list *nth_node);
-char rand_letter(void);
+bool assign_procName( char *pName, const char *key, proc_table *table );
 
-bool start_process(child_pid_list *tmp_node);
+bool start_process(proc_node *tmp_node);
+bool launch_process(proc_node *tmp_node);
+int32_t confirm_exec(proc_node *tmp_node);
 
 bool process_openUDP(int32_t csocket);
-bool process_sysInit(int32_t csocket);
-bool send_barsmToAacmProcesses(int32_t csocket, child_pid_list *tmp_node, const char *dirs[], \
+bool process_sysInit(int32_t csocket, int32_t stop_fd);
+bool send_barsmToAacmProcesses(int32_t csocket, proc_table *table, const char *dirs[], \
     char barsm_name[4]);
 
-bool check_modules(int32_t csocket, child_pid_list *tmp_node);
-bool send_barsmToAacm(int32_t csocket, child_pid_list *tmp_node);
-bool receive_barsmToAacmAck(int32_t csocket, child_pid_list *tmp_node);
+bool child_exited(frame_reader *reader, proc_table *table, pid_t pid, int32_t rc,
+    const struct rusage *rusage);
+bool check_modules(frame_reader *reader, proc_table *table);
+bool send_barsmToAacm(int32_t csocket, proc_node *tmp_node);
+bool send_barsmToAacmUsage(int32_t csocket, const proc_node *tmp_node, pid_t pid,
+    const cgroup_usage *usage);
 
-bool receive_aacmToBarsm(int32_t csocket, child_pid_list *tmp_node);
+bool dispatch_aacmMsg(frame_reader *reader, proc_table *table, const uint8_t *frame,
+    size_t len);
+bool receive_aacmToBarsm(frame_reader *reader, proc_table *table);
 void send_aacmToBarsmAck(int32_t csocket);
-bool start_select(pid_t pid, child_pid_list *tmp_node);
 
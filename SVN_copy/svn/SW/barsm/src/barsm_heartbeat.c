@@ -0,0 +1,271 @@
+/**
+ * File: barsm_heartbeat.c
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ *
+ * Description:
+ *   This file contains the liveness watchdog for modules/applications. A
+ *   process that is deadlocked or blocked forever is still running, so the exit
+ *   based health monitoring never notices it. A process with a heartbeat=
+ *   deadline in its manifest is given a counter of its own at
+ *   SPAWN_HEARTBEAT_FD, a memfd that no other process is given, which it maps
+ *   and increments from the loop whose progress matters. Beating costs the
+ *   child a single store, no system call and no wakeup of BARSM, and a child
+ *   can neither hide another one that hung nor get a healthy one killed. The
+ *   memfd is sealed at its size, so the child cannot truncate it under BARSM's
+ *   read only mapping either.
+ *
+ *   BARSM compares the counter with its previous value once per deadline, on
+ *   the timer wheel of the event loop. A counter that has not moved means the
+ *   process is hung: it is sent SIGKILL and its exit is then handled like any
+ *   other, AACM is notified and the process is restarted. The watch ends when
+ *   the exit is reaped, before the PID can be reused.
+ *
+ *   A process has to keep SPAWN_HEARTBEAT_FD open: a BARSM restarted by the
+ *   supervisor takes the counter of an adopted process back from it through
+ *   its pidfd.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <syslog.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include "barsm_timer.h"
+#include "barsm_spawn.h"
+#include "barsm_heartbeat.h"
+
+extern timer_wheel timerWheel;
+
+/****************
+* PRIVATE FUNCTION PROTOTYPES
+****************/
+static void heartbeat_check(void *arg);
+static bool heartbeat_map(proc_node *node, int32_t fd);
+
+
+
+/**
+ * Timer callback run once per heartbeat deadline of a process.
+ *
+ * @param[in] arg: the process table node
+ *
+ * @return void
+ */
+void heartbeat_check(void *arg)
+{
+    proc_node *node = (proc_node *)arg;
+    uint64_t count;
+
+    if ( (0 != node->child_pid) && (NULL != node->heartbeat) )
+    {
+        count = *node->heartbeat;
+        if ( count != node->heartbeat_seen )
+        {
+            node->heartbeat_seen = count;
+            timer_add(&timerWheel, &node->heartbeat_timer, (uint32_t)node->heartbeat_ms);
+        }
+        else
+        {
+            /* the exit is picked up by check_modules(), which restarts the
+             * process and relaunching it starts a new watch */
+            syslog(LOG_ERR, "%s:%d ERROR: %s (PID %d) missed its %d ms heartbeat, killing it!",
+                __FUNCTION__, __LINE__, node->dir, node->child_pid, node->heartbeat_ms);
+            printf("ERROR: %s (PID %d) missed its %d ms heartbeat, killing it!\n",
+                node->dir, node->child_pid, node->heartbeat_ms);
+
+            errno = 0;
+            if ( -1 == kill(node->child_pid, SIGKILL) )
+            {
+                syslog(LOG_ERR, "%s:%d ERROR! Not able to kill process with PID %d (%d:%s)",
+                    __FUNCTION__, __LINE__, node->child_pid, errno, strerror(errno));
+            }
+        }
+    }
+}
+
+/**
+ * Maps the counter of a process read only. The descriptor must be one BARSM
+ * sealed, a counter that could shrink would fault BARSM when it is read.
+ *
+ * @param[in] node: the process table node
+ * @param[in] fd: the counter's memfd
+ *
+ * @return true/false whether the counter was mapped
+ */
+bool heartbeat_map(proc_node *node, int32_t fd)
+{
+    bool success = true;
+    void *page;
+    struct stat st;
+
+    if ( (HEARTBEAT_SEALS != (fcntl(fd, F_GET_SEALS) & HEARTBEAT_SEALS)) ||
+         (0 != fstat(fd, &st)) || ((off_t)HEARTBEAT_SIZE != st.st_size) )
+    {
+        syslog(LOG_ERR, "%s:%d ERROR: heartbeat counter of %s is not sealed!",
+            __FUNCTION__, __LINE__, node->dir);
+        success = false;
+    }
+
+    if ( true == success )
+    {
+        errno = 0;
+        page = mmap(NULL, HEARTBEAT_SIZE, PROT_READ, MAP_SHARED, fd, 0);
+        if ( MAP_FAILED == page )
+        {
+            syslog(LOG_ERR, "%s:%d ERROR: mmap() failed! (%d: %s)",
+                __FUNCTION__, __LINE__, errno, strerror(errno));
+            success = false;
+        }
+        else
+        {
+            node->heartbeat = (const volatile uint64_t *)page;
+        }
+    }
+
+    return success;
+}
+
+
+
+/**
+ * Creates the counter of a process about to be launched, if it has a heartbeat
+ * deadline. Any previous watch of the node is dropped. Without a counter the
+ * process is launched unwatched, which is logged but not a terminal error.
+ *
+ * @param[in] node: the process table node
+ *
+ * @return the counter's descriptor to give to the child, close-on-exec and at
+ *      least SPAWN_FD_MAX, -1 if the process is not watched
+ */
+int32_t heartbeat_open(proc_node *node)
+{
+    int32_t fd = -1;
+    int32_t tmpFd;
+
+    heartbeat_stop(node);
+
+    if ( 0 < node->heartbeat_ms )
+    {
+        errno = 0;
+        tmpFd = memfd_create("barsm_heartbeat", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+        if ( -1 == tmpFd )
+        {
+            syslog(LOG_ERR, "%s:%d ERROR: memfd_create() failed! (%d: %s)",
+                __FUNCTION__, __LINE__, errno, strerror(errno));
+        }
+        else
+        {
+            /* moved out of the way of the descriptors it is dup'd onto in the
+             * child, see spawn_request */
+            fd = fcntl(tmpFd, F_DUPFD_CLOEXEC, SPAWN_FD_MAX);
+            close(tmpFd);
+        }
+    }
+
+    if ( (0 <= fd) &&
+         ((0 != ftruncate(fd, (off_t)HEARTBEAT_SIZE)) ||
+          (0 != fcntl(fd, F_ADD_SEALS, HEARTBEAT_SEALS)) ||
+          (true != heartbeat_map(node, fd))) )
+    {
+        syslog(LOG_ERR, "%s:%d ERROR: unable to set up the heartbeat counter of %s! (%d: %s)",
+            __FUNCTION__, __LINE__, node->dir, errno, strerror(errno));
+        close(fd);
+        fd = -1;
+    }
+
+    if ( (0 < node->heartbeat_ms) && (-1 == fd) )
+    {
+        printf("ERROR: No heartbeat counter for %s, it is not watched\n", node->dir);
+    }
+
+    return fd;
+}
+
+/**
+ * Takes back the counter of a process adopted from a crashed BARSM, from the
+ * descriptor the process was given it at.
+ *
+ * @param[in] node: the process table node, its heartbeat_ms from the manifest
+ * @param[in] pid_fd: pidfd of the process
+ *
+ * @return true if the process can be adopted: it has no heartbeat deadline, or
+ *      its counter was mapped
+ */
+bool heartbeat_adopt(proc_node *node, int32_t pid_fd)
+{
+    bool success = true;
+    int32_t fd = -1;
+
+    heartbeat_stop(node);
+
+    if ( 0 < node->heartbeat_ms )
+    {
+#ifdef SYS_pidfd_getfd
+        errno = 0;
+        fd = (int32_t)syscall(SYS_pidfd_getfd, pid_fd, SPAWN_HEARTBEAT_FD, 0);
+#else
+        (void)pid_fd;
+        errno = ENOSYS;
+#endif
+        if ( -1 == fd )
+        {
+            syslog(LOG_ERR, "%s:%d ERROR: unable to get the heartbeat counter of %s back! (%d: %s)",
+                __FUNCTION__, __LINE__, node->dir, errno, strerror(errno));
+            success = false;
+        }
+        else
+        {
+            success = heartbeat_map(node, fd);
+            close(fd);
+        }
+    }
+
+    return success;
+}
+
+/**
+ * Starts watching a process that was just launched or adopted. It has one
+ * deadline to move its counter from where it is now.
+ *
+ * @param[in] node: the process table node
+ *
+ * @return void
+ */
+void heartbeat_start(proc_node *node)
+{
+    if ( (NULL != node->heartbeat) && (0 != node->child_pid) )
+    {
+        node->heartbeat_seen = *node->heartbeat;
+        timer_setup(&node->heartbeat_timer, heartbeat_check, node);
+        timer_add(&timerWheel, &node->heartbeat_timer, (uint32_t)node->heartbeat_ms);
+    }
+}
+
+/**
+ * Stops watching a process and releases its counter. Must be called once its
+ * exit is reaped, before anything else can get its PID.
+ *
+ * @param[in] node: the process table node
+ *
+ * @return void
+ */
+void heartbeat_stop(proc_node *node)
+{
+    timer_cancel(&timerWheel, &node->heartbeat_timer);
+
+    if ( NULL != node->heartbeat )
+    {
+        /* munmap() does not take a pointer to volatile */
+        munmap((void *)(uintptr_t)node->heartbeat, HEARTBEAT_SIZE);
+        node->heartbeat = NULL;
+    }
+}
@@ -0,0 +1,33 @@
+/** @file barsm_heartbeat.h
+ * Liveness watchdog for modules/applications that report a heartbeat.
+ *
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ */
+
+#ifndef __BARSM_HEARTBEAT_H__
+#define __BARSM_HEARTBEAT_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <fcntl.h>
+
+#include "barsm_proctable.h"
+
+/****************
+* CONSTANTS
+****************/
+/* Every watched process gets a memfd of its own holding one 64 bit counter,
+ * which it increments at least once per heartbeat period. The size is sealed
+ * so that the child cannot make BARSM's mapping fault. */
+#define HEARTBEAT_SIZE          sizeof(uint64_t)
+#define HEARTBEAT_SEALS         (F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL)
+
+/****************
+* FUNCTION PROTOTYPES
+****************/
+int32_t heartbeat_open(proc_node *node);
+bool heartbeat_adopt(proc_node *node, int32_t pid_fd);
+void heartbeat_start(proc_node *node);
+void heartbeat_stop(proc_node *node);
+
+#endif
@@ -0,0 +1,418 @@
+/**
+ * File: barsm_journal.c
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ *
+ * Description:
+ *   This file contains the journal of the process table. The journal is a
+ *   shared anonymous mapping created by the supervisor before it forks BARSM,
+ *   so it outlives a BARSM that crashes and is inherited by the one that
+ *   replaces it. BARSM records the PID, name, path and state of a node every
+ *   time the node's PID changes.
+ *
+ *   The children of a crashed BARSM are re-parented to the supervisor, which is
+ *   their subreaper. A restarted BARSM cannot wait for them, so it adopts them
+ *   through a pidfd, which becomes readable when the process exits whoever its
+ *   parent is. The start time of every journaled PID is checked against
+ *   /proc before a process is adopted or signalled, so a PID that was reused in
+ *   the meantime is never mistaken for the original process.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <syslog.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "barsm_functions.h"
+#include "barsm_journal.h"
+#include "barsm_heartbeat.h"
+
+/****************
+* PRIVATE GLOBALS
+****************/
+/* shared with the supervisor and every BARSM it starts, NULL if unsupervised */
+static journal *jrnl = NULL;
+
+/****************
+* PRIVATE FUNCTION PROTOTYPES
+****************/
+static uint64_t start_ticks(pid_t pid);
+static bool entry_running(const journal_entry *entry);
+
+
+
+/**
+ * Reads the start time of a process, in clock ticks since boot.
+ *
+ * @param[in] pid: the process
+ *
+ * @return the start time, 0 if the process does not exist
+ */
+uint64_t start_ticks(pid_t pid)
+{
+    char path[32];
+    char stat[512];
+    char *field;
+    unsigned long long ticks = 0;
+    int32_t num;
+    FILE *file;
+    size_t len;
+
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+    file = fopen(path, "r");
+    if ( NULL != file )
+    {
+        len = fread(stat, 1, sizeof(stat) - 1, file);
+        stat[len] = '\0';
+        fclose(file);
+
+        /* the name in parentheses may contain spaces, the fields are counted
+         * from after it: state is field 3 and starttime field 22 */
+        field = strrchr(stat, ')');
+        for ( num = 2; (NULL != field) && (num < 22); num++ )
+        {
+            field = strchr(field + 1, ' ');
+        }
+        if ( (NULL != field) && (1 != sscanf(field, " %llu", &ticks)) )
+        {
+            ticks = 0;
+        }
+    }
+
+    return (uint64_t)ticks;
+}
+
+/**
+ * Checks whether a journal entry names a process that is still the one that
+ * was journaled.
+ *
+ * @param[in] entry: the journal entry
+ *
+ * @return true if the process is running
+ */
+bool entry_running(const journal_entry *entry)
+{
+    return (0 == (entry->seq & 1)) && (0 != entry->pid) &&
+           (0 != entry->start_ticks) && (start_ticks(entry->pid) == entry->start_ticks);
+}
+
+
+
+/**
+ * Creates the journal. Called by the supervisor before it starts BARSM.
+ *
+ * @param[in] void
+ *
+ * @return true/false whether the journal could be created
+ */
+bool journal_init(void)
+{
+    bool success = true;
+    void *mem;
+
+    errno = 0;
+    mem = mmap(NULL, sizeof(journal), PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if ( MAP_FAILED == mem )
+    {
+        syslog(LOG_ERR, "%s:%d ERROR: mmap() failed! (%d: %s)",
+            __FUNCTION__, __LINE__, errno, strerror(errno));
+        success = false;
+    }
+    else
+    {
+        jrnl = (journal *)mem;
+    }
+
+    return success;
+}
+
+/**
+ * Records that BARSM was restarted by the supervisor.
+ *
+ * @param[in] void
+ *
+ * @return void
+ */
+void journal_restarted(void)
+{
+    if ( NULL != jrnl )
+    {
+        jrnl->restarts++;
+    }
+}
+
+/**
+ * Tells whether this BARSM replaces one that crashed.
+ *
+ * @param[in] void
+ *
+ * @return true if the supervisor restarted BARSM
+ */
+bool journal_isRestart(void)
+{
+    return (NULL != jrnl) && (0 < jrnl->restarts);
+}
+
+/**
+ * Tells whether the crashed BARSM had completed its boot sequence with AACM.
+ *
+ * @param[out] barsm_name: the name BARSM had reported to AACM
+ *
+ * @return true if the boot sequence had completed
+ */
+bool journal_booted(char barsm_name[PROC_NAME_LEN + 1])
+{
+    bool booted = false;
+
+    if ( (NULL != jrnl) && (true == jrnl->booted) )
+    {
+        memcpy(barsm_name, jrnl->barsm_name, PROC_NAME_LEN + 1);
+        booted = true;
+    }
+
+    return booted;
+}
+
+/**
+ * Records that the boot sequence with AACM has completed.
+ *
+ * @param[in] barsm_name: the name BARSM reported to AACM
+ *
+ * @return void
+ */
+void journal_setBooted(const char *barsm_name)
+{
+    if ( NULL != jrnl )
+    {
+        memcpy(jrnl->barsm_name, barsm_name, PROC_NAME_LEN);
+        jrnl->barsm_name[PROC_NAME_LEN] = '\0';
+        jrnl->booted = true;
+    }
+}
+
+/**
+ * Records the current state of a node, called whenever its PID changes.
+ *
+ * @param[in] table: the process table
+ * @param[in] node: the node
+ *
+ * @return void
+ */
+void journal_record(proc_table *table, proc_node *node)
+{
+    journal_entry *entry;
+
+    if ( NULL != jrnl )
+    {
+        entry = &jrnl->entries[node - table->nodes];
+
+        __atomic_store_n(&entry->seq, entry->seq + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+
+        entry->pid = node->child_pid;
+        entry->start_ticks = (0 != node->child_pid) ? start_ticks(node->child_pid) : 0;
+        entry->alive = node->alive;
+        memcpy(entry->proc_name, node->proc_name, sizeof(entry->proc_name));
+        entry->dir[0] = '\0';
+        if ( strlen(node->dir) < sizeof(entry->dir) )
+        {
+            strcpy(entry->dir, node->dir);
+        }
+
+        __atomic_store_n(&entry->seq, entry->seq + 1, __ATOMIC_RELEASE);
+    }
+}
+
+/**
+ * Signals every journaled process that is still running and forgets them all,
+ * used when the crashed BARSM was not far enough into its boot to be resumed.
+ *
+ * @param[in] sig: the signal to send
+ *
+ * @return void
+ */
+void journal_killAll(int32_t sig)
+{
+    journal_entry *entry;
+    int32_t i;
+
+    if ( NULL != jrnl )
+    {
+        for ( i = 0; i < MAX_PROCS; i++ )
+        {
+            entry = &jrnl->entries[i];
+            if ( true == entry_running(entry) )
+            {
+                syslog(LOG_NOTICE, "NOTICE: Stopping %s (PID %d) left by the previous BARSM",
+                    entry->dir, entry->pid);
+                kill(entry->pid, sig);
+            }
+        }
+
+        memset(jrnl->entries, 0, sizeof(jrnl->entries));
+        jrnl->booted = false;
+    }
+}
+
+/**
+ * Adopts the processes the journal lists into a process table that was just
+ * read from the directories. A journaled process is adopted by the node with
+ * the same path, and gets its name back. Nodes that were disabled stay
+ * disabled; every other node is left waiting to be launched. Journaled
+ * processes whose item no longer exists, or that cannot be adopted, are
+ * stopped.
+ *
+ * @param[in] table: the process table
+ *
+ * @return the number of processes adopted
+ */
+int32_t journal_adopt(proc_table *table)
+{
+    /* recording the adopted nodes rewrites the journal, work on a copy */
+    static journal_entry previous[MAX_PROCS];
+    bool used[MAX_PROCS];
+    int32_t numAdopted = 0;
+    int32_t pidFd;
+    int32_t i;
+    int32_t j;
+    proc_node *node;
+    journal_entry *entry;
+
+    if ( NULL != jrnl )
+    {
+        memcpy(previous, jrnl->entries, sizeof(previous));
+        memset(used, 0, sizeof(used));
+
+        /* names come from the journal, not from the directory scan, and the
+         * name BARSM reported to AACM stays taken */
+        for ( i = 0; i < table->num_nodes; i++ )
+        {
+            proctable_releaseName(table, &table->nodes[i]);
+        }
+        if ( true == jrnl->booted )
+        {
+            names_claim(&table->names, jrnl->barsm_name);
+        }
+
+        for ( i = 0; i < table->num_nodes; i++ )
+        {
+            node = &table->nodes[i];
+            entry = NULL;
+            for ( j = 0; (j < MAX_PROCS) && (NULL == entry); j++ )
+            {
+                if ( (false == used[j]) && (0 == (previous[j].seq & 1)) &&
+                     (0 == strcmp(previous[j].dir, node->dir)) )
+                {
+                    entry = &previous[j];
+                    used[j] = true;
+                }
+            }
+
+            if ( (NULL != entry) && (downPermanently == entry->alive) && (0 == entry->pid) )
+            {
+                node->alive = downPermanently;
+            }
+            else if ( (NULL != entry) && (true == entry_running(entry)) )
+            {
+                /* the start time is checked again once the pidfd is open, so
+                 * that the pidfd cannot refer to a process that reused the PID */
+                pidFd = (int32_t)syscall(SYS_pidfd_open, entry->pid, 0);
+                if ( (0 <= pidFd) && (true == entry_running(entry)) &&
+                     (true == heartbeat_adopt(node, pidFd)) &&
+                     (true == names_claim(&table->names, entry->proc_name)) )
+                {
+                    proctable_setName(table, node, entry->proc_name);
+                    node->pid_fd = pidFd;
+                    node->alive = normal;
+                    node->start_ms = timer_nowMs();
+                    proctable_setPid(table, node, entry->pid);
+                    numAdopted++;
+
+                    syslog(LOG_NOTICE, "SUCCESS: Adopted %s (PID %d) as %s",
+                        node->dir, node->child_pid, node->proc_name);
+                    printf("SUCCESS: Adopted %s (PID %d) as %s\n",
+                        node->dir, node->child_pid, node->proc_name);
+                }
+                else
+                {
+                    syslog(LOG_ERR, "%s:%d ERROR: Unable to adopt %s (PID %d), relaunching it (%d:%s)",
+                        __FUNCTION__, __LINE__, entry->dir, entry->pid, errno, strerror(errno));
+                    if ( 0 <= pidFd )
+                    {
+                        close(pidFd);
+                    }
+                    used[entry - previous] = false;
+                }
+            }
+            else
+            {
+                /* nothing was running, the node is launched again */
+            }
+        } /* for ( i = 0; i < table->num_nodes; i++ ) */
+
+        for ( i = 0; i < table->num_nodes; i++ )
+        {
+            node = &table->nodes[i];
+            if ( ('\0' == node->proc_name[0]) && (downPermanently != node->alive) &&
+                 (true == assign_procName(node->proc_name, node->dir, table)) )
+            {
+                proctable_setName(table, node, node->proc_name);
+            }
+        }
+
+        for ( j = 0; j < MAX_PROCS; j++ )
+        {
+            if ( (false == used[j]) && (true == entry_running(&previous[j])) )
+            {
+                syslog(LOG_NOTICE, "NOTICE: Stopping %s (PID %d), it is no longer installed",
+                    previous[j].dir, previous[j].pid);
+                kill(previous[j].pid, SIGTERM);
+            }
+        }
+    } /* if ( NULL != jrnl ) */
+
+    return numAdopted;
+}
+
+/**
+ * Finds an adopted process that has exited. Its pidfd is closed, the process
+ * itself is reaped by the supervisor.
+ *
+ * @param[in] table: the process table
+ *
+ * @return the PID of the process, 0 if no adopted process has exited
+ */
+pid_t journal_reapAdopted(proc_table *table)
+{
+    struct pollfd pfd;
+    pid_t pid = 0;
+    int32_t i;
+    proc_node *node;
+
+    pfd.events = POLLIN;
+    for ( i = 0; (i < table->num_nodes) && (0 == pid); i++ )
+    {
+        node = &table->nodes[i];
+        if ( 0 <= node->pid_fd )
+        {
+            pfd.fd = node->pid_fd;
+            pfd.revents = 0;
+            if ( 0 < poll(&pfd, 1, 0) )
+            {
+                close(node->pid_fd);
+                node->pid_fd = -1;
+                pid = node->child_pid;
+            }
+        }
+    }
+
+    return pid;
+}
@@ -0,0 +1,70 @@
+/** @file barsm_journal.h
+ * Shared memory journal of the process table, used to re-adopt the children
+ * of a BARSM that crashed.
+ *
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ */
+
+#ifndef __BARSM_JOURNAL_H__
+#define __BARSM_JOURNAL_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include "barsm_proctable.h"
+
+/****************
+* CONSTANTS
+****************/
+/* Longest item path the journal can record, longer ones are not adopted */
+#define JOURNAL_DIR_MAX         256
+/* Exit status reported for an adopted process, whose real status only its
+ * parent, the supervisor, gets to see */
+#define JOURNAL_STATUS_UNKNOWN  (-1)
+
+/* pidfd_open() is not wrapped by older C libraries */
+#ifndef SYS_pidfd_open
+#define SYS_pidfd_open          434
+#endif
+
+/****************
+* DATA TYPES
+****************/
+/* One entry per process table node, at the same index. seq is odd while the
+ * entry is being written, so an entry torn by a crash is recognised and
+ * skipped. */
+struct journal_entry_struct
+{
+    uint32_t seq;
+    pid_t pid;                  /* 0 if no process is running */
+    uint64_t start_ticks;       /* start time of pid, to detect PID reuse */
+    int32_t alive;              /* as of the last change of pid */
+    char proc_name[PROC_NAME_LEN + 1];
+    char dir[JOURNAL_DIR_MAX];
+};
+typedef struct journal_entry_struct journal_entry;
+
+struct journal_struct
+{
+    int32_t restarts;           /* how often the supervisor restarted BARSM */
+    bool booted;                /* the boot sequence with AACM had completed */
+    char barsm_name[PROC_NAME_LEN + 1];
+    journal_entry entries[MAX_PROCS];
+};
+typedef struct journal_struct journal;
+
+/****************
+* FUNCTION PROTOTYPES
+****************/
+bool journal_init(void);
+void journal_restarted(void);
+bool journal_isRestart(void);
+bool journal_booted(char barsm_name[PROC_NAME_LEN + 1]);
+void journal_setBooted(const char *barsm_name);
+void journal_record(proc_table *table, proc_node *node);
+void journal_killAll(int32_t sig);
+int32_t journal_adopt(proc_table *table);
+pid_t journal_reapAdopted(proc_table *table);
+
+#endif
@@ -0,0 +1,447 @@
+/**
+ * File: barsm_manifest.c
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ *
+ * Description:
+ *   This file contains the reader for the optional boot manifest of an
+ *   application/module directory. The manifest only refines the items that
+ *   were found in the directory; a directory without one, or an item the
+ *   manifest does not mention, keeps the default settings.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <errno.h>
+
+#include "barsm_manifest.h"
+#include "barsm_sockets.h"
+#include "barsm_cgroup.h"
+
+/****************
+* PRIVATE FUNCTION PROTOTYPES
+****************/
+static proc_node *find_item(proc_table *table, int32_t start_index,
+    int32_t end_index, const char *item);
+static bool parse_number(const char *value, long min, long max, long *number);
+static bool parse_cpus(const char *value, cpu_set_t *cpus);
+static bool parse_policy(const char *value, int32_t *policy);
+static bool apply_setting(proc_node *node, const char *key, const char *value);
+
+
+
+/**
+ * Finds an item of the directory by file name.
+ *
+ * @param[in] table: the process table
+ * @param[in] start_index: first node of the directory
+ * @param[in] end_index: the index after the last node of the directory
+ * @param[in] item: the file name to look for
+ *
+ * @return the matching node, NULL if the directory has no such item
+ */
+proc_node *find_item(proc_table *table, int32_t start_index,
+    int32_t end_index, const char *item)
+{
+    proc_node *found = NULL;
+    int32_t i;
+
+    for ( i = start_index; (i < end_index) && (NULL == found); i++ )
+    {
+        if ( 0 == strcmp(table->nodes[i].item_name, item) )
+        {
+            found = &table->nodes[i];
+        }
+    }
+
+    return found;
+}
+
+/**
+ * Parses a decimal setting value.
+ *
+ * @param[in] value: the setting value
+ * @param[in] min: the smallest value allowed
+ * @param[in] max: the largest value allowed
+ * @param[out] number: the parsed value
+ *
+ * @return true/false whether value is a number between min and max
+ */
+bool parse_number(const char *value, long min, long max, long *number)
+{
+    char *end;
+
+    errno = 0;
+    *number = strtol(value, &end, 10);
+
+    return (0 == errno) && (end != value) && ('\0' == *end) &&
+           (min <= *number) && (max >= *number);
+}
+
+/**
+ * Parses a CPU list such as "1" or "0,2-3".
+ *
+ * @param[in] value: the setting value
+ * @param[out] cpus: the CPUs in the list
+ *
+ * @return true/false whether the list is valid
+ */
+bool parse_cpus(const char *value, cpu_set_t *cpus)
+{
+    bool success = true;
+    const char *ptr = value;
+    char *end;
+    long first;
+    long last;
+    long cpu;
+
+    CPU_ZERO(cpus);
+
+    while ( (true == success) && ('\0' != *ptr) )
+    {
+        errno = 0;
+        first = strtol(ptr, &end, 10);
+        last = first;
+        if ( (0 == errno) && (end != ptr) && ('-' == *end) )
+        {
+            ptr = end + 1;
+            last = strtol(ptr, &end, 10);
+        }
+
+        if ( (0 != errno) || (end == ptr) || (0 > first) || (first > last) ||
+             (CPU_SETSIZE <= last) || (('\0' != *end) && (',' != *end)) )
+        {
+            success = false;
+        }
+        else
+        {
+            for ( cpu = first; cpu <= last; cpu++ )
+            {
+                CPU_SET((size_t)cpu, cpus);
+            }
+            ptr = ('\0' == *end) ? end : end + 1;
+        }
+    }
+
+    return (true == success) && (0 < CPU_COUNT(cpus));
+}
+
+/**
+ * Parses the name of a scheduling policy.
+ *
+ * @param[in] value: the setting value
+ * @param[out] policy: the SCHED_* value
+ *
+ * @return true/false whether the policy is known
+ */
+bool parse_policy(const char *value, int32_t *policy)
+{
+    bool success = true;
+
+    if ( 0 == strcmp(value, "other") )
+    {
+        *policy = SCHED_OTHER;
+    }
+    else if ( 0 == strcmp(value, "batch") )
+    {
+        *policy = SCHED_BATCH;
+    }
+    else if ( 0 == strcmp(value, "idle") )
+    {
+        *policy = SCHED_IDLE;
+    }
+    else if ( 0 == strcmp(value, "fifo") )
+    {
+        *policy = SCHED_FIFO;
+    }
+    else if ( 0 == strcmp(value, "rr") )
+    {
+        *policy = SCHED_RR;
+    }
+    else if ( 0 == strcmp(value, "deadline") )
+    {
+        *policy = SCHED_DEADLINE;
+    }
+    else
+    {
+        success = false;
+    }
+
+    return success;
+}
+
+/**
+ * Applies one key=value setting of a manifest line to a node.
+ *
+ * @param[in] node: the node the line is for
+ * @param[in] key: the setting name
+ * @param[in] value: the setting value
+ *
+ * @return true/false whether the setting was understood
+ */
+bool apply_setting(proc_node *node, const char *key, const char *value)
+{
+    bool success = true;
+    long number;
+
+    if ( 0 == strcmp(key, "after") )
+    {
+        free(node->after);
+        node->after = strdup(value);
+        success = (NULL != node->after);
+    }
+    else if ( 0 == strcmp(key, "ready") )
+    {
+        if ( 0 == strcmp(value, "settle") )
+        {
+            node->ready = readySettle;
+        }
+        else if ( 0 == strcmp(value, "exec") )
+        {
+            node->ready = readyExec;
+        }
+        else if ( 0 == strcmp(value, "notify") )
+        {
+            node->ready = readyNotify;
+        }
+        else
+        {
+            success = false;
+        }
+    }
+    else if ( 0 == strcmp(key, "timeout") )
+    {
+        success = parse_number(value, 0, INT32_MAX, &number);
+        if ( true == success )
+        {
+            node->ready_timeout_ms = (int32_t)number;
+        }
+    }
+    else if ( 0 == strcmp(key, "zygote") )
+    {
+        free(node->zygote);
+        node->zygote = strdup(value);
+        success = (NULL != node->zygote);
+    }
+    else if ( 0 == strcmp(key, "sockets") )
+    {
+        success = sockets_valid(value);
+        if ( true == success )
+        {
+            free(node->sockets);
+            node->sockets = strdup(value);
+            success = (NULL != node->sockets);
+        }
+    }
+    else if ( 0 == strcmp(key, "cpu.max") )
+    {
+        success = cgroup_validCpuMax(value);
+        if ( true == success )
+        {
+            free(node->cpu_max);
+            node->cpu_max = strdup(value);
+            success = (NULL != node->cpu_max);
+        }
+    }
+    else if ( 0 == strcmp(key, "memory.max") )
+    {
+        success = cgroup_validMemoryMax(value);
+        if ( true == success )
+        {
+            free(node->memory_max);
+            node->memory_max = strdup(value);
+            success = (NULL != node->memory_max);
+        }
+    }
+    else if ( 0 == strcmp(key, "io.weight") )
+    {
+        success = parse_number(value, CGROUP_IO_WEIGHT_MIN, CGROUP_IO_WEIGHT_MAX, &number);
+        if ( true == success )
+        {
+            node->io_weight = (int32_t)number;
+        }
+    }
+    else if ( 0 == strcmp(key, "heartbeat") )
+    {
+        success = parse_number(value, 0, INT32_MAX, &number);
+        if ( true == success )
+        {
+            node->heartbeat_ms = (int32_t)number;
+        }
+    }
+    else if ( 0 == strcmp(key, "critical") )
+    {
+        if ( 0 == strcmp(value, "yes") )
+        {
+            node->critical = true;
+        }
+        else if ( 0 == strcmp(value, "no") )
+        {
+            node->critical = false;
+        }
+        else
+        {
+            success = false;
+        }
+    }
+    else if ( 0 == strcmp(key, "cpus") )
+    {
+        success = parse_cpus(value, &node->sched.cpus);
+        node->sched.set_cpus = success;
+    }
+    else if ( 0 == strcmp(key, "sched") )
+    {
+        success = parse_policy(value, &node->sched.policy);
+        node->sched.set_policy = success;
+    }
+    else if ( 0 == strcmp(key, "priority") )
+    {
+        success = parse_number(value, 0, 99, &number);
+        if ( true == success )
+        {
+            node->sched.priority = (int32_t)number;
+        }
+    }
+    else if ( (0 == strcmp(key, "runtime")) || (0 == strcmp(key, "deadline")) ||
+              (0 == strcmp(key, "period")) )
+    {
+        success = parse_number(value, 1, MANIFEST_MAX_US, &number);
+        if ( true == success )
+        {
+            if ( 'r' == key[0] )
+            {
+                node->sched.runtime_ns = (uint64_t)number * 1000u;
+            }
+            else if ( 'd' == key[0] )
+            {
+                node->sched.deadline_ns = (uint64_t)number * 1000u;
+            }
+            else
+            {
+                node->sched.period_ns = (uint64_t)number * 1000u;
+            }
+        }
+    }
+    else if ( 0 == strcmp(key, "nice") )
+    {
+        success = parse_number(value, -20, 19, &number);
+        if ( true == success )
+        {
+            node->sched.nice = (int32_t)number;
+            node->sched.set_nice = true;
+        }
+    }
+    else if ( 0 == strcmp(key, "mlock") )
+    {
+        if ( 0 == strcmp(value, "yes") )
+        {
+            node->sched.mlock = true;
+        }
+        else if ( 0 == strcmp(value, "no") )
+        {
+            node->sched.mlock = false;
+        }
+        else
+        {
+            success = false;
+        }
+    }
+    else
+    {
+        success = false;
+    }
+
+    return success;
+}
+
+
+
+/**
+ * Reads the manifest of a directory, if it has one, and applies it to the
+ * items that were found in that directory. Mistakes in the manifest are logged
+ * and skipped so that a bad line never keeps the rest of the system down.
+ *
+ * @param[in] table: the process table
+ * @param[in] start_index: first node of the directory
+ * @param[in] end_index: the index after the last node of the directory
+ * @param[in] directory: the directory the items were read from
+ *
+ * @return void
+ */
+void manifest_load(proc_table *table, int32_t start_index, int32_t end_index,
+    const char *directory)
+{
+    char path[MANIFEST_LINE_MAX];
+    char line[MANIFEST_LINE_MAX];
+    char *savePtr;
+    char *item;
+    char *setting;
+    char *value;
+    int32_t lineNum = 0;
+    proc_node *node;
+    FILE *manifest;
+
+    snprintf(path, sizeof(path), "%s/%s", directory, MANIFEST_NAME);
+
+    errno = 0;
+    manifest = fopen(path, "r");
+    if ( NULL == manifest )
+    {
+        if ( ENOENT != errno )
+        {
+            syslog(LOG_ERR, "%s:%d ERROR: unable to open %s (%d:%s)",
+                __FUNCTION__, __LINE__, path, errno, strerror(errno));
+        }
+    }
+    else
+    {
+        printf("EXECUTING: Reading boot manifest %s\n", path);
+
+        while ( NULL != fgets(line, sizeof(line), manifest) )
+        {
+            lineNum++;
+
+            item = strtok_r(line, " \t\r\n", &savePtr);
+            if ( (NULL == item) || ('#' == item[0]) )
+            {
+                continue;
+            }
+
+            node = find_item(table, start_index, end_index, item);
+            if ( NULL == node )
+            {
+                syslog(LOG_NOTICE, "NOTICE: %s:%d names %s which is not in %s",
+                    path, lineNum, item, directory);
+                continue;
+            }
+
+            setting = strtok_r(NULL, " \t\r\n", &savePtr);
+            while ( NULL != setting )
+            {
+                value = strchr(setting, '=');
+                if ( NULL == value )
+                {
+                    syslog(LOG_ERR, "%s:%d ERROR: %s:%d setting '%s' is not key=value",
+                        __FUNCTION__, __LINE__, path, lineNum, setting);
+                }
+                else
+                {
+                    *value = '\0';
+                    value++;
+                    if ( true != apply_setting(node, setting, value) )
+                    {
+                        syslog(LOG_ERR, "%s:%d ERROR: %s:%d bad setting %s=%s for %s",
+                            __FUNCTION__, __LINE__, path, lineNum, setting, value, item);
+                    }
+                }
+
+                setting = strtok_r(NULL, " \t\r\n", &savePtr);
+            }
+        } /* while ( NULL != fgets(line, sizeof(line), manifest) ) */
+
+        fclose(manifest);
+    }
+}
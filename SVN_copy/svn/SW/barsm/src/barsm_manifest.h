@@ -0,0 +1,83 @@
+/** @file barsm_manifest.h
+ * Optional per-directory boot manifest read by BARSM.
+ *
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ */
+
+#ifndef __BARSM_MANIFEST_H__
+#define __BARSM_MANIFEST_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "barsm_proctable.h"
+
+/****************
+* CONSTANTS
+****************/
+/* The manifest is a dot file so that the directory scan does not try to
+ * launch it. Each line names an item followed by key=value settings:
+ *
+ *   # item     settings
+ *   simm       after=aacm ready=notify timeout=2000 critical=yes
+ *   tpaapp     after=simm,fdl
+ *
+ * after=     comma separated item names the item has to wait for. Without it
+ *            an item waits for every item of the previous non-empty directory.
+ *            Items outside the system directory always wait for AACM.
+ * ready=     settle (default): alive LAUNCH_SETTLE_MS after its exec
+ *            exec: as soon as its exec succeeded
+ *            notify: once it writes to fd SPAWN_READY_FD or closes it
+ * timeout=   milliseconds to wait for ready=notify, default READY_TIMEOUT_MS
+ * critical=  yes/no, BARSM exits if a critical item cannot be started.
+ *            Defaults to yes in the system directory and no elsewhere.
+ * heartbeat= milliseconds within which the item has to bump its heartbeat
+ *            counter, 0 (default) to not watch it. A process that misses the
+ *            deadline is killed and restarted, see barsm_heartbeat.c
+ * zygote=    the item is a shared object and this is its entry symbol, an
+ *            int entry(int argc, char *argv[]). It is forked ready to run from
+ *            the zygote instead of being exec'd, see barsm_zygote.c
+ * sockets=   comma separated tcp:[address:]port and udp:[address:]port
+ *            sockets BARSM creates and passes to the item from fd
+ *            SPAWN_LISTEN_FD on, see barsm_sockets.c
+ * cpu.max=   CPU time of the item's cgroup, max or quota[/period] in
+ *            microseconds, e.g. 20000/100000 for a fifth of a CPU
+ * memory.max= memory limit of the item's cgroup, max or bytes with an
+ *            optional K, M or G suffix
+ * io.weight= 1-10000, share of the disk bandwidth of the item's cgroup, see
+ *            barsm_cgroup.c
+ *
+ * The remaining keys are applied to the child before it execs, see
+ * barsm_spawn.c. Without them the child inherits BARSM's settings.
+ *
+ * cpus=      CPU affinity list, e.g. 3 or 0,2-3
+ * sched=     other, batch, idle, fifo, rr or deadline
+ * priority=  1-99 for sched=fifo/rr
+ * runtime=   microseconds of CPU time per period for sched=deadline
+ * deadline=  microseconds from the start of a period for sched=deadline
+ * period=    microseconds between activations for sched=deadline
+ * nice=      -20 to 19
+ * mlock=     yes/no, lock all of the child's memory, see SPAWN_MLOCK_ENV
+ *
+ *   simm       sched=fifo priority=80 cpus=1 mlock=yes
+ */
+#define MANIFEST_NAME           ".manifest"
+#define MANIFEST_LINE_MAX       512
+#define READY_TIMEOUT_MS        5000
+#define MANIFEST_MAX_US         10000000
+
+/* 'ready' VALUE ENUMS */
+enum e_ready
+{
+    readySettle             = 0,
+    readyExec               = 1,
+    readyNotify             = 2,
+};
+
+/****************
+* FUNCTION PROTOTYPES
+****************/
+void manifest_load(proc_table *table, int32_t start_index, int32_t end_index,
+    const char *directory);
+
+#endif
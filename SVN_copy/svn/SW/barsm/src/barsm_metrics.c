@@ -0,0 +1,437 @@
+/**
+ * File: barsm_metrics.c
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ *
+ * Description:
+ *   This file contains the metrics BARSM keeps about its supervision: per
+ *   child how often it was launched and restarted, how its last process
+ *   exited, what it used and how long its last launch took to become ready,
+ *   plus histograms of the launch to ready latency and of the AACM round trip
+ *   of every BARSM_TO_AACM message. The per child metrics are indexed like the
+ *   process table nodes and are only written from the BARSM event loop.
+ *
+ *   The metrics are queried on the AF_UNIX datagram socket
+ *   METRICS_SOCKET_PATH. A query is one byte, METRICS_QUERY_BINARY for the
+ *   compact metrics_header/metrics_child format or METRICS_QUERY_TEXT for a
+ *   line per histogram and per child, and is answered with one datagram to
+ *   the address it came from. Datagrams keep BARSM free of per client state
+ *   and a client that does not read its reply cannot block the event loop.
+ *   The barsmstat tool in tools/ queries and prints them.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "barsm_metrics.h"
+
+/****************
+* PRIVATE DATA TYPES
+****************/
+struct metrics_entry_struct
+{
+    uint64_t launch_us;         /* when the current process was launched */
+    uint32_t launches;
+    uint32_t exits;
+    int32_t last_status;
+    uint32_t last_ready_us;
+    cgroup_usage usage;         /* of the last process to exit */
+};
+typedef struct metrics_entry_struct metrics_entry;
+
+/****************
+* PRIVATE GLOBALS
+****************/
+static proc_table *metricsTable = NULL;
+static int32_t metricsSock = -1;
+static uint64_t bootUs = 0;
+static metrics_entry entries[MAX_PROCS];
+static uint32_t histograms[METRICS_HISTOGRAMS][METRICS_BUCKETS];
+static uint8_t reply[METRICS_REPLY_MAX];
+
+/****************
+* PRIVATE FUNCTION PROTOTYPES
+****************/
+static void record(enum metrics_histogram histogram, uint64_t us);
+static metrics_entry *entry_of(const proc_node *node);
+static size_t build_binary(uint8_t *buf, size_t size);
+static size_t build_text(char *buf, size_t size);
+static uint32_t clamp32(uint64_t value);
+
+
+
+/**
+ * Adds a sample to a histogram.
+ *
+ * @param[in] histogram: the histogram
+ * @param[in] us: the sample in microseconds
+ *
+ * @return void
+ */
+void record(enum metrics_histogram histogram, uint64_t us)
+{
+    int32_t bucket = 0;
+
+    while ( (0 != us) && (METRICS_BUCKETS - 1 > bucket) )
+    {
+        us >>= 1;
+        bucket++;
+    }
+    histograms[histogram][bucket]++;
+}
+
+/**
+ * Finds the metrics of a process table node.
+ *
+ * @param[in] node: the node
+ *
+ * @return the metrics, NULL if the node is not in the table
+ */
+metrics_entry *entry_of(const proc_node *node)
+{
+    metrics_entry *entry = NULL;
+
+    if ( (NULL != metricsTable) && (node >= metricsTable->nodes) &&
+         (node < &metricsTable->nodes[MAX_PROCS]) )
+    {
+        entry = &entries[node - metricsTable->nodes];
+    }
+
+    return entry;
+}
+
+/**
+ * Narrows a counter to the 32 bits of the binary reply.
+ *
+ * @param[in] value: the counter
+ *
+ * @return the counter, UINT32_MAX if it does not fit
+ */
+uint32_t clamp32(uint64_t value)
+{
+    return (UINT32_MAX < value) ? UINT32_MAX : (uint32_t)value;
+}
+
+/**
+ * Builds the binary reply.
+ *
+ * @param[out] buf: the reply
+ * @param[in] size: the size of buf
+ *
+ * @return the size of the reply
+ */
+size_t build_binary(uint8_t *buf, size_t size)
+{
+    metrics_header header;
+    metrics_child child;
+    const proc_node *node;
+    size_t len = sizeof(header);
+    size_t itemLen;
+    int32_t i;
+
+    memset(&header, 0, sizeof(header));
+    header.magic = METRICS_MAGIC;
+    header.version = METRICS_VERSION;
+    header.num_histograms = METRICS_HISTOGRAMS;
+    header.num_buckets = METRICS_BUCKETS;
+    header.uptime_ms = (metrics_nowUs() - bootUs) / 1000u;
+    memcpy(header.histograms, histograms, sizeof(histograms));
+
+    for ( i = 0; (i < metricsTable->num_nodes) && (len + sizeof(child) <= size); i++ )
+    {
+        node = &metricsTable->nodes[i];
+        memset(&child, 0, sizeof(child));
+        memcpy(child.proc_name, node->proc_name, PROC_NAME_LEN);
+        itemLen = strlen(node->item_name);
+        memcpy(child.item, node->item_name,
+               (METRICS_ITEM_LEN < itemLen) ? METRICS_ITEM_LEN : itemLen);
+        child.pid = node->child_pid;
+        child.alive = node->alive;
+        child.launches = entries[i].launches;
+        child.restarts = (0 < entries[i].launches) ? entries[i].launches - 1 : 0;
+        child.exits = entries[i].exits;
+        child.last_status = entries[i].last_status;
+        child.last_ready_us = entries[i].last_ready_us;
+        child.user_ms = clamp32(entries[i].usage.user_us / 1000u);
+        child.system_ms = clamp32(entries[i].usage.system_us / 1000u);
+        child.max_rss_kb = clamp32(entries[i].usage.max_rss_kb);
+        child.voluntary_cs = clamp32(entries[i].usage.voluntary_cs);
+        child.involuntary_cs = clamp32(entries[i].usage.involuntary_cs);
+        child.cgroup_cpu_ms = clamp32(entries[i].usage.cgroup_cpu_us / 1000u);
+        child.memory_peak_kb = clamp32(entries[i].usage.memory_peak / 1024u);
+        child.oom_kills = clamp32(entries[i].usage.oom_kills);
+
+        memcpy(&buf[len], &child, sizeof(child));
+        len += sizeof(child);
+        header.num_children++;
+    }
+
+    memcpy(buf, &header, sizeof(header));
+
+    return len;
+}
+
+/**
+ * Builds the text reply: the uptime, a line per histogram with the non-empty
+ * buckets as upper bound:count, and a line per child.
+ *
+ * @param[out] buf: the reply
+ * @param[in] size: the size of buf
+ *
+ * @return the size of the reply
+ */
+size_t build_text(char *buf, size_t size)
+{
+    static const char *names[METRICS_HISTOGRAMS] = { "launch_ready_us", "aacm_rtt_us" };
+    const proc_node *node;
+    size_t len;
+    int32_t h;
+    int32_t b;
+    int32_t i;
+
+    len = (size_t)snprintf(buf, size, "uptime_ms %llu\n",
+                           (unsigned long long)((metrics_nowUs() - bootUs) / 1000u));
+
+    for ( h = 0; (h < METRICS_HISTOGRAMS) && (len < size); h++ )
+    {
+        len += (size_t)snprintf(&buf[len], size - len, "histogram %s", names[h]);
+        for ( b = 0; (b < METRICS_BUCKETS) && (len < size); b++ )
+        {
+            if ( 0 != histograms[h][b] )
+            {
+                len += (size_t)snprintf(&buf[len], size - len, " %llu:%u",
+                                        1ull << b, histograms[h][b]);
+            }
+        }
+        if ( len < size )
+        {
+            len += (size_t)snprintf(&buf[len], size - len, "\n");
+        }
+    }
+
+    for ( i = 0; (i < metricsTable->num_nodes) && (len < size); i++ )
+    {
+        node = &metricsTable->nodes[i];
+        len += (size_t)snprintf(&buf[len], size - len,
+            "child %.*s %s pid %d alive %d launches %u restarts %u exits %u"
+            " status 0x%x ready_us %u user_us %llu system_us %llu max_rss_kb %llu"
+            " voluntary_cs %llu involuntary_cs %llu cgroup_cpu_us %llu"
+            " memory_peak %llu oom_kills %llu\n",
+            PROC_NAME_LEN, node->proc_name, node->item_name, node->child_pid,
+            node->alive, entries[i].launches,
+            (0 < entries[i].launches) ? entries[i].launches - 1 : 0,
+            entries[i].exits, (uint32_t)entries[i].last_status,
+            entries[i].last_ready_us,
+            (unsigned long long)entries[i].usage.user_us,
+            (unsigned long long)entries[i].usage.system_us,
+            (unsigned long long)entries[i].usage.max_rss_kb,
+            (unsigned long long)entries[i].usage.voluntary_cs,
+            (unsigned long long)entries[i].usage.involuntary_cs,
+            (unsigned long long)entries[i].usage.cgroup_cpu_us,
+            (unsigned long long)entries[i].usage.memory_peak,
+            (unsigned long long)entries[i].usage.oom_kills);
+    }
+
+    /* a truncated dump still ends where the buffer does */
+    return (len < size) ? len : size - 1;
+}
+
+
+
+/**
+ * Starts keeping the metrics of a process table and opens the socket they are
+ * queried on. The metrics are kept even if the socket cannot be opened.
+ *
+ * @param[in] table: the process table
+ *
+ * @return true/false whether the socket is open
+ */
+bool metrics_init(proc_table *table)
+{
+    bool success = true;
+    struct sockaddr_un addr;
+
+    metricsTable = table;
+    bootUs = metrics_nowUs();
+    memset(entries, 0, sizeof(entries));
+    memset(histograms, 0, sizeof(histograms));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, METRICS_SOCKET_PATH, sizeof(addr.sun_path) - 1);
+
+    errno = 0;
+    metricsSock = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if ( -1 != metricsSock )
+    {
+        /* left behind by an earlier BARSM */
+        unlink(addr.sun_path);
+        if ( 0 != bind(metricsSock, (struct sockaddr *)&addr, sizeof(addr)) )
+        {
+            close(metricsSock);
+            metricsSock = -1;
+        }
+    }
+
+    if ( -1 == metricsSock )
+    {
+        syslog(LOG_ERR, "%s:%d ERROR: unable to open %s, no metrics queries! (%d:%s)",
+            __FUNCTION__, __LINE__, METRICS_SOCKET_PATH, errno, strerror(errno));
+        success = false;
+    }
+
+    return success;
+}
+
+/**
+ * Returns the socket the metrics are queried on.
+ *
+ * @param[in] void
+ *
+ * @return the socket, -1 if it is not open
+ */
+int32_t metrics_fd(void)
+{
+    return metricsSock;
+}
+
+/**
+ * Answers every query waiting on the metrics socket. Called from the BARSM
+ * event loop when the socket is readable.
+ *
+ * @param[in] void
+ *
+ * @return void
+ */
+void metrics_serve(void)
+{
+    uint8_t query;
+    size_t len;
+    struct sockaddr_un from;
+    socklen_t fromLen = sizeof(from);
+
+    while ( 0 < recvfrom(metricsSock, &query, sizeof(query), MSG_DONTWAIT,
+                         (struct sockaddr *)&from, &fromLen) )
+    {
+        if ( sizeof(sa_family_t) >= fromLen )
+        {
+            /* an unbound client cannot be answered */
+        }
+        else
+        {
+            if ( METRICS_QUERY_TEXT == query )
+            {
+                len = build_text((char *)reply, sizeof(reply));
+            }
+            else
+            {
+                len = build_binary(reply, sizeof(reply));
+            }
+
+            if ( -1 == sendto(metricsSock, reply, len, MSG_DONTWAIT,
+                              (struct sockaddr *)&from, fromLen) )
+            {
+                syslog(LOG_DEBUG, "%s:%d metrics reply dropped (%d:%s)",
+                    __FUNCTION__, __LINE__, errno, strerror(errno));
+            }
+        }
+
+        fromLen = sizeof(from);
+    }
+}
+
+/**
+ * Reads the monotonic clock.
+ *
+ * @param[in] void
+ *
+ * @return the current CLOCK_MONOTONIC time in microseconds
+ */
+uint64_t metrics_nowUs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return ((uint64_t)now.tv_sec * 1000000u) + ((uint64_t)now.tv_nsec / 1000u);
+}
+
+/**
+ * Records that a new process was launched for a node.
+ *
+ * @param[in] node: the node
+ *
+ * @return void
+ */
+void metrics_launched(const proc_node *node)
+{
+    metrics_entry *entry = entry_of(node);
+
+    if ( NULL != entry )
+    {
+        entry->launch_us = metrics_nowUs();
+        entry->launches++;
+    }
+}
+
+/**
+ * Records that the process of a node became ready.
+ *
+ * @param[in] node: the node
+ *
+ * @return void
+ */
+void metrics_ready(const proc_node *node)
+{
+    metrics_entry *entry = entry_of(node);
+    uint64_t us;
+
+    if ( (NULL != entry) && (0 != entry->launch_us) )
+    {
+        us = metrics_nowUs() - entry->launch_us;
+        entry->last_ready_us = (UINT32_MAX < us) ? UINT32_MAX : (uint32_t)us;
+        record(METRICS_LAUNCH_READY, us);
+    }
+}
+
+/**
+ * Records that the process of a node exited.
+ *
+ * @param[in] node: the node
+ * @param[in] status: its waitpid() status
+ * @param[in] usage: what it used
+ *
+ * @return void
+ */
+void metrics_exited(const proc_node *node, int32_t status, const cgroup_usage *usage)
+{
+    metrics_entry *entry = entry_of(node);
+
+    if ( NULL != entry )
+    {
+        entry->exits++;
+        entry->last_status = status;
+        entry->usage = *usage;
+    }
+}
+
+/**
+ * Records the round trip of a message AACM has acknowledged.
+ *
+ * @param[in] sent_us: metrics_nowUs() when the message was sent
+ *
+ * @return void
+ */
+void metrics_aacmRtt(uint64_t sent_us)
+{
+    record(METRICS_AACM_RTT, metrics_nowUs() - sent_us);
+}
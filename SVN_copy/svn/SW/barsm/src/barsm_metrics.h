@@ -0,0 +1,103 @@
+/** @file barsm_metrics.h
+ * Supervision metrics of BARSM and the local socket they are queried on.
+ *
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ */
+
+#ifndef __BARSM_METRICS_H__
+#define __BARSM_METRICS_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "barsm_proctable.h"
+#include "barsm_cgroup.h"
+
+/****************
+* CONSTANTS
+****************/
+/* AF_UNIX datagram socket the metrics are queried on, build with
+ * -DMETRICS_SOCKET_PATH=\"...\" to move it */
+#ifndef METRICS_SOCKET_PATH
+#define METRICS_SOCKET_PATH     "/var/run/barsm.metrics"
+#endif
+
+/* A query is a single byte, answered with a single datagram */
+#define METRICS_QUERY_BINARY    'b'
+#define METRICS_QUERY_TEXT      't'
+
+/* Histogram bucket 0 counts 0 us, bucket b > 0 counts [2^(b-1), 2^b) us and
+ * the last bucket everything above */
+#define METRICS_BUCKETS         26
+#define METRICS_ITEM_LEN        16
+
+#define METRICS_MAGIC           0x4D525342u     /* "BSRM" */
+#define METRICS_VERSION         2
+
+/* Largest reply: the binary format, or the text dump of a full table */
+#define METRICS_REPLY_MAX       (48 * 1024)
+
+/****************
+* DATA TYPES
+****************/
+enum metrics_histogram
+{
+    METRICS_LAUNCH_READY    = 0,    /* launch until exec'd, or notified for
+                                     * ready=notify items at boot */
+    METRICS_AACM_RTT        = 1,    /* BARSM_TO_AACM until its ACK */
+    METRICS_HISTOGRAMS      = 2,
+};
+
+/* The binary reply is a metrics_header followed by num_children
+ * metrics_child records, in the byte order of the target */
+struct metrics_header_struct
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t num_children;
+    uint16_t num_histograms;
+    uint16_t num_buckets;
+    uint32_t reserved;
+    uint64_t uptime_ms;
+    uint32_t histograms[METRICS_HISTOGRAMS][METRICS_BUCKETS];
+};
+typedef struct metrics_header_struct metrics_header;
+
+struct metrics_child_struct
+{
+    char proc_name[PROC_NAME_LEN];
+    char item[METRICS_ITEM_LEN];    /* NUL padded, not always terminated */
+    int32_t pid;                    /* 0 if not running */
+    int32_t alive;                  /* see enum e_alive */
+    uint32_t launches;
+    uint32_t restarts;              /* launches after the first one */
+    uint32_t exits;
+    int32_t last_status;            /* waitpid() status of the last exit, -1
+                                     * for an adopted child */
+    uint32_t last_ready_us;         /* launch to ready of the last launch */
+    uint32_t reserved;
+    /* what the last process to exit used, see cgroup_usage */
+    uint32_t user_ms;
+    uint32_t system_ms;
+    uint32_t max_rss_kb;
+    uint32_t voluntary_cs;
+    uint32_t involuntary_cs;
+    uint32_t cgroup_cpu_ms;
+    uint32_t memory_peak_kb;
+    uint32_t oom_kills;
+};
+typedef struct metrics_child_struct metrics_child;
+
+/****************
+* FUNCTION PROTOTYPES
+****************/
+bool metrics_init(proc_table *table);
+int32_t metrics_fd(void);
+void metrics_serve(void);
+uint64_t metrics_nowUs(void);
+void metrics_launched(const proc_node *node);
+void metrics_ready(const proc_node *node);
+void metrics_exited(const proc_node *node, int32_t status, const cgroup_usage *usage);
+void metrics_aacmRtt(uint64_t sent_us);
+
+#endif
@@ -0,0 +1,235 @@
+/**
+ * File: barsm_names.c
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ *
+ * Description:
+ *   This file contains the allocator for the 4 character process names. Every
+ *   name in the 26^4 space has one bit in a bitmap. A request starts at a slot
+ *   hashed from the item's path and takes the first free name from there, so
+ *   the same item is given the same name every time BARSM starts it and the
+ *   search ends after a word or two because the space is nearly empty.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "barsm_names.h"
+
+/****************
+* PRIVATE FUNCTION PROTOTYPES
+****************/
+static uint32_t name_hash(const char *key);
+static int32_t name_toIndex(const char *pName);
+static void name_fromIndex(int32_t index, char pName[PROC_NAME_LEN + 1]);
+static int32_t find_free(const name_allocator *names, int32_t start);
+
+
+
+/**
+ * 32 bit FNV-1a hash of a string.
+ *
+ * @param[in] key: the string to hash
+ *
+ * @return the hash value
+ */
+uint32_t name_hash(const char *key)
+{
+    uint32_t hash = 2166136261u;
+
+    while ( '\0' != *key )
+    {
+        hash ^= (uint8_t)*key;
+        hash *= 16777619u;
+        key++;
+    }
+
+    return hash;
+}
+
+/**
+ * Converts a 4 character name to its position in the name space.
+ *
+ * @param[in] pName: the 4 character process name
+ *
+ * @return the index of the name, -1 if it is not 4 lower case letters
+ */
+int32_t name_toIndex(const char *pName)
+{
+    int32_t index = 0;
+    int32_t i;
+
+    for ( i = 0; (i < PROC_NAME_LEN) && (-1 != index); i++ )
+    {
+        if ( ('a' <= pName[i]) && ('z' >= pName[i]) )
+        {
+            index = (index * 26) + (pName[i] - 'a');
+        }
+        else
+        {
+            index = -1;
+        }
+    }
+
+    return index;
+}
+
+/**
+ * Converts a position in the name space to its 4 character name.
+ *
+ * @param[in] index: the index of the name
+ * @param[out] pName: the 4 character process name, NUL terminated
+ *
+ * @return void
+ */
+void name_fromIndex(int32_t index, char pName[PROC_NAME_LEN + 1])
+{
+    int32_t i;
+
+    for ( i = PROC_NAME_LEN - 1; i >= 0; i-- )
+    {
+        pName[i] = (char)('a' + (index % 26));
+        index /= 26;
+    }
+    pName[PROC_NAME_LEN] = '\0';
+}
+
+/**
+ * Finds the first free name at or after start, wrapping around at the end of
+ * the name space. Whole words are skipped while they are full.
+ *
+ * @param[in] names: the name allocator
+ * @param[in] start: the index to start looking from
+ *
+ * @return the index of a free name, -1 if every name is in use
+ */
+int32_t find_free(const name_allocator *names, int32_t start)
+{
+    int32_t found = -1;
+    int32_t word = start / 64;
+    int32_t checked;
+    uint64_t freeBits;
+
+    /* ignore the bits below start in the first word, they are checked last */
+    freeBits = ~names->used[word] & (~0ULL << (start % 64));
+
+    for ( checked = 0; (checked <= PROC_NAME_WORDS) && (-1 == found); checked++ )
+    {
+        if ( 0 != freeBits )
+        {
+            found = (word * 64) + __builtin_ctzll(freeBits);
+            if ( PROC_NAME_SPACE <= found )
+            {
+                /* padding bits past the end of the name space */
+                found = -1;
+            }
+        }
+
+        if ( -1 == found )
+        {
+            word = (word + 1) % PROC_NAME_WORDS;
+            freeBits = ~names->used[word];
+        }
+    }
+
+    return found;
+}
+
+
+
+/**
+ * Marks every name as free.
+ *
+ * @param[in] names: the name allocator
+ *
+ * @return void
+ */
+void names_init(name_allocator *names)
+{
+    memset(names->used, 0, sizeof(names->used));
+    names->num_used = 0;
+}
+
+/**
+ * Hands out a name that is not in use. The search starts at a slot hashed from
+ * key, so an item that is launched again gets its previous name back as long
+ * as no other item took it in the meantime.
+ *
+ * @param[in] names: the name allocator
+ * @param[in] key: a string that identifies the item, e.g. its path
+ * @param[out] pName: the 4 character process name, NUL terminated
+ *
+ * @return true if a name was allocated, false if the name space is full
+ */
+bool names_alloc(name_allocator *names, const char *key, char pName[PROC_NAME_LEN + 1])
+{
+    bool success = true;
+    int32_t index;
+
+    index = find_free(names, (int32_t)(name_hash(key) % PROC_NAME_SPACE));
+    if ( -1 == index )
+    {
+        success = false;
+    }
+    else
+    {
+        names->used[index / 64] |= 1ULL << (index % 64);
+        names->num_used++;
+        name_fromIndex(index, pName);
+    }
+
+    return success;
+}
+
+/**
+ * Hands out a specific name, used to give a process back the name it already
+ * had before BARSM was restarted.
+ *
+ * @param[in] names: the name allocator
+ * @param[in] pName: the 4 character process name
+ *
+ * @return true if the name was free and is now in use
+ */
+bool names_claim(name_allocator *names, const char *pName)
+{
+    bool success = false;
+    int32_t index = name_toIndex(pName);
+    uint64_t bit;
+
+    if ( -1 != index )
+    {
+        bit = 1ULL << (index % 64);
+        if ( 0 == (names->used[index / 64] & bit) )
+        {
+            names->used[index / 64] |= bit;
+            names->num_used++;
+            success = true;
+        }
+    }
+
+    return success;
+}
+
+/**
+ * Returns a name to the allocator so that it can be handed out again.
+ *
+ * @param[in] names: the name allocator
+ * @param[in] pName: the 4 character process name
+ *
+ * @return void
+ */
+void names_release(name_allocator *names, const char *pName)
+{
+    int32_t index = name_toIndex(pName);
+    uint64_t bit;
+
+    if ( -1 != index )
+    {
+        bit = 1ULL << (index % 64);
+        if ( 0 != (names->used[index / 64] & bit) )
+        {
+            names->used[index / 64] &= ~bit;
+            names->num_used--;
+        }
+    }
+}
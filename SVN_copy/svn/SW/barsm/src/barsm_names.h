@@ -0,0 +1,40 @@
+/** @file barsm_names.h
+ * Allocator for the 4 character process names BARSM reports to AACM.
+ *
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ */
+
+#ifndef __BARSM_NAMES_H__
+#define __BARSM_NAMES_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/****************
+* CONSTANTS
+****************/
+/* Names are 4 lower case letters, so there are 26^4 of them */
+#define PROC_NAME_LEN           4
+#define PROC_NAME_SPACE         (26 * 26 * 26 * 26)
+#define PROC_NAME_WORDS         ((PROC_NAME_SPACE + 63) / 64)
+
+/****************
+* DATA TYPES
+****************/
+/* One bit per possible name, set while the name is handed out */
+struct name_allocator_struct
+{
+    uint64_t used[PROC_NAME_WORDS];
+    int32_t num_used;
+};
+typedef struct name_allocator_struct name_allocator;
+
+/****************
+* FUNCTION PROTOTYPES
+****************/
+void names_init(name_allocator *names);
+bool names_alloc(name_allocator *names, const char *key, char pName[PROC_NAME_LEN + 1]);
+bool names_claim(name_allocator *names, const char *pName);
+void names_release(name_allocator *names, const char *pName);
+
+#endif
@@ -0,0 +1,322 @@
+/**
+ * File: barsm_proctable.c
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ *
+ * Description:
+ *   This file contains the process table BARSM uses to keep track of the
+ *   modules/applications it launched. Nodes live in one contiguous array and
+ *   are indexed by PID and by process name through chained hash buckets, so
+ *   both lookups are O(1) regardless of how many items are installed.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "barsm_proctable.h"
+#include "barsm_journal.h"
+
+/****************
+* PRIVATE FUNCTION PROTOTYPES
+****************/
+static uint32_t hash_key(uint32_t key);
+static uint32_t name_key(const char *pName);
+static void unlink_node(int16_t *bucket, int16_t index, bool byPid, proc_node *nodes);
+
+
+
+/**
+ * Multiplicative (Fibonacci) hash of a 32 bit key into a bucket index.
+ *
+ * @param[in] key: the value to hash
+ *
+ * @return bucket index in the range 0 to PROC_HASH_SIZE-1
+ */
+uint32_t hash_key(uint32_t key)
+{
+    return (key * 2654435761u) >> (32 - PROC_HASH_BITS);
+}
+
+/**
+ * Packs a 4 character process name into a 32 bit key.
+ *
+ * @param[in] pName: the 4 character process name
+ *
+ * @return the name as a 32 bit value
+ */
+uint32_t name_key(const char *pName)
+{
+    uint32_t key;
+
+    memcpy(&key, pName, sizeof(key));
+
+    return key;
+}
+
+/**
+ * Removes a node from the hash chain starting at bucket.
+ *
+ * @param[in] bucket: the head of the chain the node is in
+ * @param[in] index: the index of the node to remove
+ * @param[in] byPid: true to follow the PID chain, false for the name chain
+ * @param[in] nodes: the node storage of the table
+ *
+ * @return void
+ */
+void unlink_node(int16_t *bucket, int16_t index, bool byPid, proc_node *nodes)
+{
+    int16_t *link = bucket;
+
+    while ( PROC_NONE != *link )
+    {
+        if ( index == *link )
+        {
+            *link = byPid ? nodes[index].pid_next : nodes[index].name_next;
+            break;
+        }
+
+        link = byPid ? &nodes[*link].pid_next : &nodes[*link].name_next;
+    }
+}
+
+
+
+/**
+ * Empties the process table.
+ *
+ * @param[in] table: the process table
+ *
+ * @return void
+ */
+void proctable_init(proc_table *table)
+{
+    int32_t i;
+
+    memset(table->nodes, 0, sizeof(table->nodes));
+    table->num_nodes = 0;
+
+    for ( i = 0; i < PROC_HASH_SIZE; i++ )
+    {
+        table->pid_buckets[i] = PROC_NONE;
+        table->name_buckets[i] = PROC_NONE;
+    }
+
+    names_init(&table->names);
+}
+
+/**
+ * Frees the strings and descriptors owned by the nodes and empties the process
+ * table.
+ *
+ * @param[in] table: the process table
+ *
+ * @return void
+ */
+void proctable_free(proc_table *table)
+{
+    int32_t i;
+    int32_t j;
+
+    for ( i = 0; i < table->num_nodes; i++ )
+    {
+        free(table->nodes[i].dir);
+        free(table->nodes[i].item_name);
+        free(table->nodes[i].after);
+        free(table->nodes[i].zygote);
+        free(table->nodes[i].sockets);
+        free(table->nodes[i].cpu_max);
+        free(table->nodes[i].memory_max);
+        for ( j = 0; j < table->nodes[i].num_listen_fds; j++ )
+        {
+            close(table->nodes[i].listen_fds[j]);
+        }
+        if ( 0 <= table->nodes[i].ready_fd )
+        {
+            close(table->nodes[i].ready_fd);
+        }
+        if ( 0 <= table->nodes[i].pid_fd )
+        {
+            close(table->nodes[i].pid_fd);
+        }
+        if ( 0 <= table->nodes[i].cgroup_fd )
+        {
+            close(table->nodes[i].cgroup_fd);
+        }
+    }
+
+    proctable_init(table);
+}
+
+/**
+ * Appends a new, empty node to the table. The node is not in either index
+ * until proctable_setPid() and proctable_setName() are called for it.
+ *
+ * @param[in] table: the process table
+ *
+ * @return pointer to the new node, NULL if the table is full
+ */
+proc_node *proctable_add(proc_table *table)
+{
+    proc_node *node = NULL;
+
+    if ( MAX_PROCS > table->num_nodes )
+    {
+        node = &table->nodes[table->num_nodes];
+        table->num_nodes++;
+
+        memset(node, 0, sizeof(*node));
+        node->exec_fd = -1;
+        node->ready_fd = -1;
+        node->pid_fd = -1;
+        node->cgroup_fd = -1;
+        node->pid_next = PROC_NONE;
+        node->name_next = PROC_NONE;
+    }
+
+    return node;
+}
+
+/**
+ * Records a new PID for a node and moves it to the matching PID bucket. The
+ * node is journaled, see barsm_journal.c.
+ *
+ * @param[in] table: the process table
+ * @param[in] node: the node whose process was (re)started
+ * @param[in] pid: the new PID, 0 to only remove the node from the index
+ *
+ * @return void
+ */
+void proctable_setPid(proc_table *table, proc_node *node, pid_t pid)
+{
+    int16_t index = (int16_t)(node - table->nodes);
+    uint32_t bucket;
+
+    if ( 0 != node->child_pid )
+    {
+        bucket = hash_key((uint32_t)node->child_pid);
+        unlink_node(&table->pid_buckets[bucket], index, true, table->nodes);
+    }
+
+    node->child_pid = pid;
+    node->pid_next = PROC_NONE;
+
+    if ( 0 != pid )
+    {
+        bucket = hash_key((uint32_t)pid);
+        node->pid_next = table->pid_buckets[bucket];
+        table->pid_buckets[bucket] = index;
+    }
+
+    journal_record(table, node);
+}
+
+/**
+ * Records the 4 character process name of a node and adds it to the name
+ * index. A node keeps its name for its whole life.
+ *
+ * @param[in] table: the process table
+ * @param[in] node: the node to name
+ * @param[in] pName: the 4 character process name
+ *
+ * @return void
+ */
+void proctable_setName(proc_table *table, proc_node *node, const char *pName)
+{
+    int16_t index = (int16_t)(node - table->nodes);
+    uint32_t bucket;
+
+    if ( '\0' != node->proc_name[0] )
+    {
+        bucket = hash_key(name_key(node->proc_name));
+        unlink_node(&table->name_buckets[bucket], index, false, table->nodes);
+    }
+
+    memcpy(node->proc_name, pName, PROC_NAME_LEN);
+    node->proc_name[PROC_NAME_LEN] = '\0';
+
+    bucket = hash_key(name_key(node->proc_name));
+    node->name_next = table->name_buckets[bucket];
+    table->name_buckets[bucket] = index;
+}
+
+/**
+ * Removes a node from the name index and gives its name back to the name
+ * allocator, so that it can be reused by another item. Used once a node has
+ * been disabled permanently.
+ *
+ * @param[in] table: the process table
+ * @param[in] node: the node whose name is no longer needed
+ *
+ * @return void
+ */
+void proctable_releaseName(proc_table *table, proc_node *node)
+{
+    int16_t index = (int16_t)(node - table->nodes);
+    uint32_t bucket;
+
+    if ( '\0' != node->proc_name[0] )
+    {
+        bucket = hash_key(name_key(node->proc_name));
+        unlink_node(&table->name_buckets[bucket], index, false, table->nodes);
+        names_release(&table->names, node->proc_name);
+        node->proc_name[0] = '\0';
+        node->name_next = PROC_NONE;
+
+        journal_record(table, node);
+    }
+}
+
+/**
+ * Finds the node that currently owns a PID.
+ *
+ * @param[in] table: the process table
+ * @param[in] pid: the PID to look for
+ *
+ * @return pointer to the matching node, NULL if no node has that PID
+ */
+proc_node *proctable_findPid(proc_table *table, pid_t pid)
+{
+    proc_node *found = NULL;
+    int16_t index = table->pid_buckets[hash_key((uint32_t)pid)];
+
+    while ( (NULL == found) && (PROC_NONE != index) )
+    {
+        if ( pid == table->nodes[index].child_pid )
+        {
+            found = &table->nodes[index];
+        }
+
+        index = table->nodes[index].pid_next;
+    }
+
+    return found;
+}
+
+/**
+ * Finds the node that has a given 4 character process name.
+ *
+ * @param[in] table: the process table
+ * @param[in] pName: the 4 character process name to look for
+ *
+ * @return pointer to the matching node, NULL if no node has that name
+ */
+proc_node *proctable_findName(proc_table *table, const char *pName)
+{
+    proc_node *found = NULL;
+    int16_t index = table->name_buckets[hash_key(name_key(pName))];
+
+    while ( (NULL == found) && (PROC_NONE != index) )
+    {
+        if ( 0 == memcmp(pName, table->nodes[index].proc_name, PROC_NAME_LEN) )
+        {
+            found = &table->nodes[index];
+        }
+
+        index = table->nodes[index].name_next;
+    }
+
+    return found;
+}
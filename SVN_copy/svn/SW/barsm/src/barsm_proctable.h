@@ -0,0 +1,103 @@
+/** @file barsm_proctable.h
+ * Process table used by BARSM to track every module/application it launched.
+ *
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ */
+
+#ifndef __BARSM_PROCTABLE_H__
+#define __BARSM_PROCTABLE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include "barsm_names.h"
+#include "barsm_timer.h"
+#include "barsm_spawn.h"
+
+/****************
+* CONSTANTS
+****************/
+/* Maximum number of items BARSM can launch across all directories */
+#define MAX_PROCS               128
+/* Number of hash buckets per index, must be a power of 2 */
+#define PROC_HASH_BITS          8
+#define PROC_HASH_SIZE          (1 << PROC_HASH_BITS)
+/* End of a hash chain / empty bucket */
+#define PROC_NONE               (-1)
+
+/****************
+* DATA TYPES
+****************/
+struct proc_node_struct
+{
+    pid_t child_pid;
+    char *dir;
+    char *item_name;
+    char proc_name[PROC_NAME_LEN + 1];
+    int32_t alive;
+    int32_t exec_fd;            /* exec status descriptor, -1 if none, see barsm_spawn.c */
+    int32_t exec_errno;         /* errno of a failed exec, 0 on success */
+    const char *directory;      /* the dirs[] entry the item was found in */
+    char *after;                /* manifest dependencies, NULL for the default */
+    int32_t ready;              /* readiness signal, see barsm_manifest.h */
+    int32_t ready_timeout_ms;   /* how long to wait for a readiness notification */
+    int32_t ready_fd;           /* read end of the readiness pipe, -1 if none */
+    int32_t pid_fd;             /* pidfd of an adopted process, -1 if none */
+    int32_t wave;               /* boot wave the item was launched in */
+    bool critical;              /* BARSM cannot run without this item */
+    spawn_sched sched;          /* affinity/scheduling applied before the exec */
+    uint64_t start_ms;          /* when the current process was launched */
+    int32_t crash_count;        /* exits in a row shortly after being launched */
+    timer_entry restart_timer;  /* pending restart, see barsm_restart.c */
+    pid_t ack_pid;              /* PID of a BARSM_TO_AACM AACM has not
+                                 * acknowledged yet, 0 if none */
+    uint64_t ack_sent_us;       /* when that BARSM_TO_AACM was sent */
+    int32_t heartbeat_ms;       /* liveness deadline, 0 if not watched */
+    char *zygote;               /* entry symbol of a shared object item forked
+                                 * from the zygote, NULL to exec the item */
+    char *sockets;              /* sockets= of the manifest, NULL if none */
+    int32_t listen_fds[SPAWN_MAX_LISTEN_FDS]; /* sockets passed to every process,
+                                 * see barsm_sockets.c */
+    int32_t num_listen_fds;     /* 0 until the sockets are created */
+    char *cpu_max;              /* cpu.max= of the manifest, NULL if none */
+    char *memory_max;           /* memory.max= of the manifest, NULL if none */
+    int32_t io_weight;          /* io.weight= of the manifest, 0 if none */
+    int32_t cgroup_fd;          /* cgroup v2 leaf of the item, -1 until it is
+                                 * created, see barsm_cgroup.c */
+    const volatile uint64_t *heartbeat; /* read only mapping of the process'
+                                 * heartbeat counter, NULL if not watched */
+    uint64_t heartbeat_seen;    /* heartbeat counter at the last check */
+    timer_entry heartbeat_timer; /* next liveness check, see barsm_heartbeat.c */
+    int16_t pid_next;           /* next node in the same PID hash bucket */
+    int16_t name_next;          /* next node in the same name hash bucket */
+};
+typedef struct proc_node_struct proc_node;
+
+/* The nodes are stored contiguously in launch order so that sweeps over every
+ * child walk a single array. The two bucket arrays index the same nodes by PID
+ * and by 4 character process name; both are chained through the nodes. The
+ * names themselves are handed out by the table's name allocator. */
+struct proc_table_struct
+{
+    proc_node nodes[MAX_PROCS];
+    int32_t num_nodes;
+    name_allocator names;
+    int16_t pid_buckets[PROC_HASH_SIZE];
+    int16_t name_buckets[PROC_HASH_SIZE];
+};
+typedef struct proc_table_struct proc_table;
+
+/****************
+* FUNCTION PROTOTYPES
+****************/
+void proctable_init(proc_table *table);
+void proctable_free(proc_table *table);
+proc_node *proctable_add(proc_table *table);
+void proctable_setPid(proc_table *table, proc_node *node, pid_t pid);
+void proctable_setName(proc_table *table, proc_node *node, const char *pName);
+void proctable_releaseName(proc_table *table, proc_node *node);
+proc_node *proctable_findPid(proc_table *table, pid_t pid);
+proc_node *proctable_findName(proc_table *table, const char *pName);
+
+#endif
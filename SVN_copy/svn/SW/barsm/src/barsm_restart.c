@@ -0,0 +1,583 @@
+/**
+ * File: barsm_restart.c
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ *
+ * Description:
+ *   This file contains the restart policy for modules/applications that exit
+ *   while BARSM is supervising them. Restarts are scheduled on the timer wheel
+ *   of the event loop rather than done in place, so a process that keeps
+ *   crashing is backed off exponentially and eventually disabled without
+ *   delaying the supervision of any other process. The backoff of a process
+ *   BARSM has reported to AACM only starts once AACM has acknowledged the
+ *   report, which arrives through the event loop like any other message.
+ *
+ *   It also contains the batch used to restart the processes listed in
+ *   AACM_TO_BARSM messages. Every listed process is sent SIGTERM at once, their
+ *   exits are collected by the event loop as they happen, and a timer sends
+ *   SIGKILL to whatever is still running at the deadline. Only once all of
+ *   them are gone are the replacements spawned, together, and AACM is sent its
+ *   ACK, so a restart of many processes costs AACM a single round trip.
+ *   Processes of removed items are stopped with the same SIGTERM, SIGKILL
+ *   deadline, but are not replaced.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <syslog.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/types.h>
+
+#include "barsm_functions.h"
+#include "barsm_timer.h"
+#include "barsm_metrics.h"
+#include "barsm_restart.h"
+
+extern proc_table procTable;
+extern timer_wheel timerWheel;
+
+/****************
+* PRIVATE DATA TYPES
+****************/
+/* The AACM_TO_BARSM restart in progress. Messages that arrive while it is
+ * still waiting for processes to exit join it, and each is acknowledged when
+ * the whole batch is done. */
+struct restart_batch_struct
+{
+    proc_node *nodes[MAX_PROCS];    /* every process being restarted */
+    int32_t num_nodes;
+    int32_t num_running;            /* how many have not exited yet */
+    int32_t num_acks;               /* AACM_TO_BARSM messages to acknowledge */
+    int32_t csocket;                /* where to send the ACKs */
+    bool killed;                    /* SIGKILL was sent to the stragglers */
+    timer_entry deadline;
+};
+typedef struct restart_batch_struct restart_batch;
+
+static restart_batch batch;
+
+/****************
+* PRIVATE FUNCTION PROTOTYPES
+****************/
+static void restart_fire(void *arg);
+static void ack_timeout(void *arg);
+static uint32_t restart_delay(int32_t crash_count);
+static void batch_deadline(void *arg);
+static void batch_finish(proc_table *table);
+static void stop_deadline(void *arg);
+
+
+
+/**
+ * Timer callback that relaunches a process once its backoff has run out.
+ *
+ * @param[in] arg: the process table node to relaunch
+ *
+ * @return void
+ */
+void restart_fire(void *arg)
+{
+    proc_node *node = (proc_node *)arg;
+
+    syslog(LOG_NOTICE, "NOTICE: Restarting %s...", node->item_name);
+    printf("EXECUTING: Restarting %s...", node->item_name);
+
+    if ( true != start_process(node) )
+    {
+        /* fork() itself failed, treat it like another crash so that it is
+         * retried after a backoff or eventually disabled */
+        syslog(LOG_ERR, "%s:%d ERROR: Restart of %s failed!",
+            __FUNCTION__, __LINE__, node->dir);
+        node->start_ms = timer_nowMs();
+        restart_schedule(&procTable, node);
+    }
+    else
+    {
+        printf("SUCCESS: Restart completed\n");
+    }
+}
+
+/**
+ * Works out how long to wait before the next restart of a process.
+ *
+ * @param[in] crash_count: number of crash loop exits in a row, at least 1
+ *
+ * @return delay in milliseconds
+ */
+uint32_t restart_delay(int32_t crash_count)
+{
+    uint32_t delay = 0;
+    int32_t i;
+
+    if ( 1 < crash_count )
+    {
+        delay = RESTART_BACKOFF_MIN_MS;
+        for ( i = 2; (i < crash_count) && (RESTART_BACKOFF_MAX_MS > delay); i++ )
+        {
+            delay *= 2;
+        }
+
+        if ( RESTART_BACKOFF_MAX_MS < delay )
+        {
+            delay = RESTART_BACKOFF_MAX_MS;
+        }
+    }
+
+    return delay;
+}
+
+
+
+/**
+ * Applies the restart policy to a process that has exited. The process is
+ * either scheduled to be relaunched after its backoff, or, if it has been
+ * crashing in a loop, disabled permanently.
+ *
+ * @param[in] table: the process table
+ * @param[in] node: the node of the process that exited
+ *
+ * @return true if a restart was scheduled, false if the process was disabled
+ */
+bool restart_schedule(proc_table *table, proc_node *node)
+{
+    bool scheduled = true;
+    uint64_t uptime;
+    uint32_t delay;
+
+    uptime = timer_nowMs() - node->start_ms;
+    if ( RESTART_CRASH_WINDOW_MS <= uptime )
+    {
+        node->crash_count = 0;
+    }
+    node->crash_count++;
+
+    if ( RESTART_MAX_CRASHES < node->crash_count )
+    {
+        syslog(LOG_ERR, "NOTICE: Process for %s disabled permanently! (%d exits within %d ms of launch)",
+            node->dir, RESTART_MAX_CRASHES, RESTART_CRASH_WINDOW_MS);
+        printf("NOTICE: Process for %s disabled permanently! (%d exits within %d ms of launch)\n",
+            node->dir, RESTART_MAX_CRASHES, RESTART_CRASH_WINDOW_MS);
+
+        restart_cancel(node);
+        node->alive = downPermanently;
+        proctable_setPid(table, node, 0);
+        proctable_releaseName(table, node);
+        scheduled = false;
+    }
+    else
+    {
+        delay = restart_delay(node->crash_count);
+        syslog(LOG_DEBUG, "Restart of %s in %u ms (exit %d in a row after %llu ms)",
+            node->dir, delay, node->crash_count, (unsigned long long)uptime);
+
+        restart_cancel(node);
+        timer_setup(&node->restart_timer, restart_fire, node);
+        timer_add(&timerWheel, &node->restart_timer, delay);
+    }
+
+    return scheduled;
+}
+
+/**
+ * Drops a pending restart, or the wait for the ACK that would schedule one,
+ * used when a process is relaunched or stopped by other means.
+ *
+ * @param[in] node: the process table node
+ *
+ * @return void
+ */
+void restart_cancel(proc_node *node)
+{
+    timer_cancel(&timerWheel, &node->restart_timer);
+    node->ack_pid = 0;
+}
+
+
+
+/**
+ * Timer callback for a BARSM_TO_AACM that AACM has not acknowledged in time.
+ * The process is restarted without the ACK.
+ *
+ * @param[in] arg: the process table node the message was about
+ *
+ * @return void
+ */
+void ack_timeout(void *arg)
+{
+    proc_node *node = (proc_node *)arg;
+
+    syslog(LOG_ERR, "%s:%d ERROR: No BARSM to AACM ACK for %s (PID %d) within %d ms, restarting it anyway!",
+        __FUNCTION__, __LINE__, node->dir, node->ack_pid, RESTART_ACK_TIMEOUT_MS);
+    printf("ERROR: No BARSM to AACM ACK for %s (PID %d) within %d ms\n",
+        node->dir, node->ack_pid, RESTART_ACK_TIMEOUT_MS);
+
+    node->ack_pid = 0;
+    restart_schedule(&procTable, node);
+}
+
+/**
+ * Holds the restart of a process back until AACM has acknowledged the
+ * BARSM_TO_AACM that reported its exit, see restart_acked(), or
+ * RESTART_ACK_TIMEOUT_MS has passed.
+ *
+ * @param[in] node: the node of the process that exited
+ * @param[in] pid: the PID the message reported
+ * @param[in] sent_us: when the message was sent, see metrics_nowUs()
+ *
+ * @return void
+ */
+void restart_awaitAck(proc_node *node, pid_t pid, uint64_t sent_us)
+{
+    restart_cancel(node);
+    node->ack_pid = pid;
+    node->ack_sent_us = sent_us;
+    timer_setup(&node->restart_timer, ack_timeout, node);
+    timer_add(&timerWheel, &node->restart_timer, RESTART_ACK_TIMEOUT_MS);
+}
+
+/**
+ * Applies the restart policy to the process a BARSM_TO_AACM ACK is for.
+ *
+ * @param[in] table: the process table
+ * @param[in] pid: the PID in the ACK
+ *
+ * @return true if a process was waiting for the ACK
+ */
+bool restart_acked(proc_table *table, pid_t pid)
+{
+    proc_node *node = NULL;
+    int32_t i;
+
+    for ( i = 0; (i < table->num_nodes) && (NULL == node); i++ )
+    {
+        if ( (0 != pid) && (pid == table->nodes[i].ack_pid) )
+        {
+            node = &table->nodes[i];
+        }
+    }
+
+    if ( NULL != node )
+    {
+        metrics_aacmRtt(node->ack_sent_us);
+        restart_cancel(node);
+        restart_schedule(table, node);
+    }
+
+    return (NULL != node);
+}
+
+/**
+ * Restarts every process still waiting for a BARSM_TO_AACM ACK once the AACM
+ * connection is lost, as those ACKs can no longer arrive.
+ *
+ * @param[in] table: the process table
+ *
+ * @return void
+ */
+void restart_ackLost(proc_table *table)
+{
+    proc_node *node;
+    int32_t i;
+
+    for ( i = 0; i < table->num_nodes; i++ )
+    {
+        node = &table->nodes[i];
+        if ( 0 != node->ack_pid )
+        {
+            syslog(LOG_ERR, "%s:%d ERROR: AACM connection lost before the BARSM to AACM ACK for %s (PID %d)!",
+                __FUNCTION__, __LINE__, node->dir, node->ack_pid);
+            restart_cancel(node);
+            restart_schedule(table, node);
+        }
+    }
+}
+
+
+
+/**
+ * Timer callback for the batch deadline. The first time, every process of the
+ * batch that is still running is sent SIGKILL; the second time the processes
+ * that survived even that are given up on and the batch is finished anyway.
+ *
+ * @param[in] arg: unused
+ *
+ * @return void
+ */
+void batch_deadline(void *arg)
+{
+    proc_node *node;
+    int32_t i;
+
+    (void)arg;
+
+    for ( i = 0; i < batch.num_nodes; i++ )
+    {
+        node = batch.nodes[i];
+        if ( (handledByAacmToBarsm == node->alive) && (0 != node->child_pid) )
+        {
+            if ( false == batch.killed )
+            {
+                syslog(LOG_NOTICE, "NOTICE: %s (PID %d) ignored SIGTERM, sending SIGKILL",
+                    node->dir, node->child_pid);
+                kill(node->child_pid, SIGKILL);
+            }
+            else
+            {
+                syslog(LOG_ERR, "%s:%d ERROR: %s (PID %d) did not exit, replacing it anyway!",
+                    __FUNCTION__, __LINE__, node->dir, node->child_pid);
+            }
+        }
+    }
+
+    if ( false == batch.killed )
+    {
+        batch.killed = true;
+        timer_setup(&batch.deadline, batch_deadline, NULL);
+        timer_add(&timerWheel, &batch.deadline, RESTART_TERM_TIMEOUT_MS);
+    }
+    else
+    {
+        batch_finish(&procTable);
+    }
+}
+
+/**
+ * Spawns the replacements of every process in the batch and acknowledges the
+ * AACM_TO_BARSM messages that asked for them. All replacements are spawned
+ * before the first exec is confirmed, so their start up overlaps.
+ *
+ * @param[in] table: the process table
+ *
+ * @return void
+ */
+void batch_finish(proc_table *table)
+{
+    proc_node *node;
+    int32_t i;
+
+    timer_cancel(&timerWheel, &batch.deadline);
+
+    printf("EXECUTING: Starting %d new processes\n", batch.num_nodes);
+    for ( i = 0; i < batch.num_nodes; i++ )
+    {
+        node = batch.nodes[i];
+        /* a process that never exited is left to be reaped whenever it does */
+        proctable_setPid(table, node, 0);
+        node->alive = normal;
+        launch_process(node);
+    }
+
+    for ( i = 0; i < batch.num_nodes; i++ )
+    {
+        node = batch.nodes[i];
+        node->exec_errno = confirm_exec(node);
+        if ( (0 != node->exec_errno) && (0 == node->child_pid) )
+        {
+            restart_schedule(table, node);
+        }
+    }
+    printf("SUCCESS: Restarting of apps complete\n");
+
+    for ( i = 0; i < batch.num_acks; i++ )
+    {
+        send_aacmToBarsmAck(batch.csocket);
+    }
+
+    batch.num_nodes = 0;
+    batch.num_running = 0;
+    batch.num_acks = 0;
+    batch.killed = false;
+}
+
+
+
+/**
+ * Adds the processes listed in an AACM_TO_BARSM message to the restart batch
+ * and sends each of them SIGTERM. PIDs that are not in the process table, or
+ * that are already being restarted, are skipped. The message is acknowledged
+ * once the batch is done, right away if there is nothing to wait for.
+ *
+ * @param[in] table: the process table
+ * @param[in] csocket: the AACM TCP socket to acknowledge on, -1 for a restart
+ *      BARSM decided on by itself that is not acknowledged
+ * @param[in] pids: the PIDs listed in the message
+ * @param[in] count: the number of PIDs
+ *
+ * @return void
+ */
+void restart_batchAdd(proc_table *table, int32_t csocket, const pid_t *pids,
+    int32_t count)
+{
+    proc_node *node;
+    int32_t i;
+
+    for ( i = 0; i < count; i++ )
+    {
+        node = proctable_findPid(table, pids[i]);
+        if ( NULL == node )
+        {
+            syslog(LOG_NOTICE, "NOTICE: AACM asked to restart unknown PID %d", pids[i]);
+        }
+        else if ( handledByAacmToBarsm != node->alive )
+        {
+            restart_cancel(node);
+            node->alive = handledByAacmToBarsm;
+            batch.nodes[batch.num_nodes] = node;
+            batch.num_nodes++;
+            batch.num_running++;
+
+            errno = 0;
+            if ( -1 == kill(node->child_pid, SIGTERM) )
+            {
+                /* it has exited already, its SIGCHLD is on the way */
+                printf("%s:%d ERROR! Not able to kill process with PID %d (%d:%s)\n",
+                    __FUNCTION__, __LINE__, node->child_pid, errno, strerror(errno));
+            }
+            else
+            {
+                printf("SUCCESS: Process with PID %d signalled successfully \n",
+                    node->child_pid);
+            }
+        }
+        else
+        {
+            /* listed twice, it is already being restarted */
+        }
+    }
+
+    if ( 0 <= csocket )
+    {
+        batch.csocket = csocket;
+        batch.num_acks++;
+    }
+
+    if ( 0 == batch.num_running )
+    {
+        batch_finish(table);
+    }
+    else if ( false == batch.killed )
+    {
+        /* give processes added to a running batch their full grace period */
+        timer_cancel(&timerWheel, &batch.deadline);
+        timer_setup(&batch.deadline, batch_deadline, NULL);
+        timer_add(&timerWheel, &batch.deadline, RESTART_TERM_TIMEOUT_MS);
+    }
+    else
+    {
+        /* the batch is past SIGKILL already, so are the new ones */
+        for ( i = 0; i < batch.num_nodes; i++ )
+        {
+            node = batch.nodes[i];
+            if ( 0 != node->child_pid )
+            {
+                kill(node->child_pid, SIGKILL);
+            }
+        }
+    }
+}
+
+/**
+ * Reports the exit of a process to the restart batch. Called for every child
+ * that is reaped; anything that is not part of the batch is left alone.
+ *
+ * @param[in] table: the process table
+ * @param[in] node: the node of the process that exited
+ *
+ * @return true if the process belonged to the batch
+ */
+bool restart_batchExited(proc_table *table, proc_node *node)
+{
+    bool member = false;
+
+    if ( handledByAacmToBarsm == node->alive )
+    {
+        member = true;
+        proctable_setPid(table, node, 0);
+        batch.num_running--;
+
+        if ( 0 == batch.num_running )
+        {
+            batch_finish(table);
+        }
+    }
+
+    return member;
+}
+
+
+
+/**
+ * Timer callback for the deadline of a process that is being stopped for
+ * good, which is sent SIGKILL if it is still running.
+ *
+ * @param[in] arg: the process table node of the process
+ *
+ * @return void
+ */
+void stop_deadline(void *arg)
+{
+    proc_node *node = (proc_node *)arg;
+
+    if ( 0 != node->child_pid )
+    {
+        syslog(LOG_NOTICE, "NOTICE: %s (PID %d) ignored SIGTERM, sending SIGKILL",
+            node->dir, node->child_pid);
+        kill(node->child_pid, SIGKILL);
+    }
+}
+
+/**
+ * Stops the process of an item that is no longer supervised. If it is part of
+ * the restart batch it is taken out of it, so the batch neither waits for it
+ * nor relaunches it. The process is sent SIGTERM and, like the processes of
+ * the batch, SIGKILL if it has not exited RESTART_TERM_TIMEOUT_MS later. Its
+ * PID is kept until it is reaped.
+ *
+ * @param[in] table: the process table
+ * @param[in] node: the node of the process to stop
+ *
+ * @return void
+ */
+void restart_stop(proc_table *table, proc_node *node)
+{
+    bool waiting = (0 < batch.num_running);
+    int32_t i;
+    int32_t kept = 0;
+
+    restart_cancel(node);
+    if ( handledByAacmToBarsm == node->alive )
+    {
+        for ( i = 0; i < batch.num_nodes; i++ )
+        {
+            if ( node != batch.nodes[i] )
+            {
+                batch.nodes[kept] = batch.nodes[i];
+                kept++;
+            }
+        }
+        batch.num_nodes = kept;
+
+        /* a process that has exited already was counted by
+         * restart_batchExited() */
+        if ( 0 != node->child_pid )
+        {
+            batch.num_running--;
+        }
+    }
+    node->alive = downPermanently;
+
+    if ( 0 != node->child_pid )
+    {
+        kill(node->child_pid, SIGTERM);
+        timer_setup(&node->restart_timer, stop_deadline, node);
+        timer_add(&timerWheel, &node->restart_timer, RESTART_TERM_TIMEOUT_MS);
+    }
+
+    if ( (true == waiting) && (0 == batch.num_running) )
+    {
+        /* the batch was only waiting for this one */
+        batch_finish(table);
+    }
+}
@@ -0,0 +1,48 @@
+/** @file barsm_restart.h
+ * Restart policy applied to modules/applications that exit on their own.
+ *
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ */
+
+#ifndef __BARSM_RESTART_H__
+#define __BARSM_RESTART_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "barsm_proctable.h"
+
+/****************
+* CONSTANTS
+****************/
+/* A process that exits within this many milliseconds of being launched counts
+ * towards a crash loop, one that ran longer starts over with a clean record */
+#define RESTART_CRASH_WINDOW_MS     10000
+/* Number of crash loop exits in a row before a process is disabled */
+#define RESTART_MAX_CRASHES         8
+/* The first exit is restarted right away, the following ones wait
+ * RESTART_BACKOFF_MIN_MS, doubling each time up to RESTART_BACKOFF_MAX_MS */
+#define RESTART_BACKOFF_MIN_MS      250
+#define RESTART_BACKOFF_MAX_MS      30000
+/* Processes AACM asks to have restarted are sent SIGTERM and given this long to
+ * exit before they are sent SIGKILL, and as long again before they are
+ * replaced whether they have exited or not */
+#define RESTART_TERM_TIMEOUT_MS     2000
+/* A process that exited on its own is restarted once AACM has acknowledged the
+ * BARSM_TO_AACM reporting it, or after this long without the ACK */
+#define RESTART_ACK_TIMEOUT_MS      2000
+
+/****************
+* FUNCTION PROTOTYPES
+****************/
+bool restart_schedule(proc_table *table, proc_node *node);
+void restart_cancel(proc_node *node);
+void restart_awaitAck(proc_node *node, pid_t pid, uint64_t sent_us);
+bool restart_acked(proc_table *table, pid_t pid);
+void restart_ackLost(proc_table *table);
+void restart_batchAdd(proc_table *table, int32_t csocket, const pid_t *pids,
+    int32_t count);
+bool restart_batchExited(proc_table *table, proc_node *node);
+void restart_stop(proc_table *table, proc_node *node);
+
+#endif
@@ -0,0 +1,399 @@
+/**
+ * File: barsm_shutdown.c
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ *
+ * Description:
+ *   This file contains the shutdown of every child BARSM launched. Children are
+ *   stopped in stages, in the reverse order of the dirs[] directories, so the
+ *   applications are gone before the modules they use and AACM goes last.
+ *   Within a stage the children are stopped in the reverse order of the boot
+ *   waves they were launched in, so an item is gone before the items it was
+ *   launched after. Every child of a wave is sent SIGTERM at once and their
+ *   exits are reaped as they are reported on the SIGCHLD signalfd. The stages
+ *   share a single deadline: each stage may use an equal part of the time that
+ *   is left, and each wave an equal part of what is left of its stage, after
+ *   which whatever is still running in it is sent SIGKILL. The time each child
+ *   took to stop is logged.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <syslog.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/signalfd.h>
+
+#include "barsm_functions.h"
+#include "barsm_timer.h"
+#include "barsm_journal.h"
+#include "barsm_shutdown.h"
+
+/****************
+* PRIVATE FUNCTION PROTOTYPES
+****************/
+static int32_t stage_of(const proc_node *node, const char *const dirs[], int32_t num_dirs);
+static int32_t stage_waves(proc_table *table, const char *const dirs[], int32_t num_dirs,
+    int32_t stage, int32_t *waves);
+static int32_t signal_stage(proc_table *table, const char *const dirs[], int32_t num_dirs,
+    int32_t stage, int32_t wave, int32_t sig, uint64_t *signalled);
+static void log_stopped(proc_table *table, proc_node *node, const uint64_t *signalled,
+    bool killed);
+static void reap_exited(proc_table *table, const uint64_t *signalled);
+static bool wait_stage(proc_table *table, const char *const dirs[], int32_t num_dirs,
+    int32_t stage, int32_t wave, int32_t sigchld_fd, uint64_t deadline,
+    const uint64_t *signalled);
+
+
+
+/**
+ * Works out in which stage a child is stopped.
+ *
+ * @param[in] node: the process table node of the child
+ * @param[in] dirs: the directories, in launch order
+ * @param[in] num_dirs: the number of directories
+ *
+ * @return the index of the node's directory, num_dirs if it is in none of them
+ */
+int32_t stage_of(const proc_node *node, const char *const dirs[], int32_t num_dirs)
+{
+    int32_t stage;
+
+    for ( stage = 0; stage < num_dirs; stage++ )
+    {
+        if ( dirs[stage] == node->directory )
+        {
+            break;
+        }
+    }
+
+    return stage;
+}
+
+/**
+ * Lists the boot waves that have a running child in a stage, the last
+ * launched first.
+ *
+ * @param[in] table: the process table
+ * @param[in] dirs: the directories, in launch order
+ * @param[in] num_dirs: the number of directories
+ * @param[in] stage: the stage
+ * @param[out] waves: the waves, room for MAX_PROCS
+ *
+ * @return the number of waves
+ */
+int32_t stage_waves(proc_table *table, const char *const dirs[], int32_t num_dirs,
+    int32_t stage, int32_t *waves)
+{
+    int32_t numWaves = 0;
+    int32_t wave;
+    int32_t i;
+    int32_t j;
+
+    for ( i = 0; i < table->num_nodes; i++ )
+    {
+        if ( (0 != table->nodes[i].child_pid) &&
+             (stage == stage_of(&table->nodes[i], dirs, num_dirs)) )
+        {
+            /* insert in descending order, once */
+            wave = table->nodes[i].wave;
+            for ( j = numWaves; (0 < j) && (waves[j - 1] < wave); j-- )
+            {
+            }
+            if ( (0 == j) || (waves[j - 1] != wave) )
+            {
+                memmove(&waves[j + 1], &waves[j], sizeof(waves[0]) * (size_t)(numWaves - j));
+                waves[j] = wave;
+                numWaves++;
+            }
+        }
+    }
+
+    return numWaves;
+}
+
+/**
+ * Sends a signal to every running child of one wave of a stage.
+ *
+ * @param[in] table: the process table
+ * @param[in] dirs: the directories, in launch order
+ * @param[in] num_dirs: the number of directories
+ * @param[in] stage: the stage to signal
+ * @param[in] wave: the boot wave to signal
+ * @param[in] sig: the signal to send
+ * @param[out] signalled: when each node was sent SIGTERM, set for SIGTERM only
+ *
+ * @return the number of children signalled
+ */
+int32_t signal_stage(proc_table *table, const char *const dirs[], int32_t num_dirs,
+    int32_t stage, int32_t wave, int32_t sig, uint64_t *signalled)
+{
+    int32_t count = 0;
+    int32_t i;
+    proc_node *node;
+
+    for ( i = 0; i < table->num_nodes; i++ )
+    {
+        node = &table->nodes[i];
+        if ( (0 != node->child_pid) && (wave == node->wave) &&
+             (stage == stage_of(node, dirs, num_dirs)) )
+        {
+            if ( SIGKILL == sig )
+            {
+                syslog(LOG_NOTICE, "NOTICE: %s (PID %d) did not stop in time, sending SIGKILL",
+                    node->dir, node->child_pid);
+                printf("NOTICE: %s (PID %d) did not stop in time, sending SIGKILL\n",
+                    node->dir, node->child_pid);
+            }
+            else
+            {
+                printf("EXECUTING: Stopping process with PID %d\n", node->child_pid);
+                signalled[i] = timer_nowMs();
+            }
+
+            errno = 0;
+            if ( -1 == kill(node->child_pid, sig) )
+            {
+                syslog(LOG_ERR, "%s:%d ERROR! Not able to kill process with PID %d (%d:%s)",
+                    __FUNCTION__, __LINE__, node->child_pid, errno, strerror(errno));
+            }
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/**
+ * Logs how long a child took to stop and removes it from the PID index.
+ *
+ * @param[in] table: the process table
+ * @param[in] node: the process table node of the child
+ * @param[in] signalled: when each node was sent SIGTERM
+ * @param[in] killed: whether the child was killed by SIGKILL
+ *
+ * @return void
+ */
+void log_stopped(proc_table *table, proc_node *node, const uint64_t *signalled,
+    bool killed)
+{
+    uint64_t latency;
+
+    latency = timer_nowMs() - signalled[node - table->nodes];
+    syslog(LOG_NOTICE, "SUCCESS: %s (PID %d) stopped in %llu ms%s",
+        node->dir, node->child_pid, (unsigned long long)latency, killed ? " (killed)" : "");
+    printf("SUCCESS: %s (PID %d) stopped in %llu ms%s\n",
+        node->dir, node->child_pid, (unsigned long long)latency, killed ? " (killed)" : "");
+    proctable_setPid(table, node, 0);
+}
+
+/**
+ * Reaps every child that has exited, adopted ones included, and logs how long
+ * it took to stop.
+ *
+ * @param[in] table: the process table
+ * @param[in] signalled: when each node was sent SIGTERM
+ *
+ * @return void
+ */
+void reap_exited(proc_table *table, const uint64_t *signalled)
+{
+    int32_t status;
+    pid_t pid;
+    proc_node *node;
+
+    pid = waitpid(-1, &status, WNOHANG);
+    while ( 0 < pid )
+    {
+        node = proctable_findPid(table, pid);
+        if ( NULL != node )
+        {
+            log_stopped(table, node, signalled,
+                WIFSIGNALED(status) && (SIGKILL == WTERMSIG(status)));
+        }
+
+        pid = waitpid(-1, &status, WNOHANG);
+    }
+
+    /* the exit status of an adopted child goes to the supervisor */
+    pid = journal_reapAdopted(table);
+    while ( 0 < pid )
+    {
+        node = proctable_findPid(table, pid);
+        if ( NULL != node )
+        {
+            log_stopped(table, node, signalled, false);
+        }
+
+        pid = journal_reapAdopted(table);
+    }
+}
+
+/**
+ * Waits for every child of one wave of a stage to exit, reaping children of
+ * any stage as their exits are reported by SIGCHLD or, for adopted children,
+ * their pidfd.
+ *
+ * @param[in] table: the process table
+ * @param[in] dirs: the directories, in launch order
+ * @param[in] num_dirs: the number of directories
+ * @param[in] stage: the stage to wait for
+ * @param[in] wave: the boot wave to wait for
+ * @param[in] sigchld_fd: the SIGCHLD signalfd
+ * @param[in] deadline: timer_nowMs() time to give up at
+ * @param[in] signalled: when each node was sent SIGTERM
+ *
+ * @return true if the whole wave has exited, false if the deadline passed
+ */
+bool wait_stage(proc_table *table, const char *const dirs[], int32_t num_dirs,
+    int32_t stage, int32_t wave, int32_t sigchld_fd, uint64_t deadline,
+    const uint64_t *signalled)
+{
+    bool running = true;
+    struct pollfd pfd[MAX_PROCS + 1];
+    struct signalfd_siginfo siginfo;
+    uint64_t now;
+    nfds_t numFds;
+    int32_t i;
+
+    reap_exited(table, signalled);
+    now = timer_nowMs();
+    while ( true == running )
+    {
+        running = false;
+        for ( i = 0; (i < table->num_nodes) && (false == running); i++ )
+        {
+            running = (0 != table->nodes[i].child_pid) &&
+                      (wave == table->nodes[i].wave) &&
+                      (stage == stage_of(&table->nodes[i], dirs, num_dirs));
+        }
+
+        pfd[0].fd = sigchld_fd;
+        pfd[0].events = POLLIN;
+        numFds = 1;
+        for ( i = 0; i < table->num_nodes; i++ )
+        {
+            if ( 0 <= table->nodes[i].pid_fd )
+            {
+                pfd[numFds].fd = table->nodes[i].pid_fd;
+                pfd[numFds].events = POLLIN;
+                numFds++;
+            }
+        }
+
+        if ( (true == running) && (now < deadline) )
+        {
+            /* a single SIGCHLD may stand for several exits, reap them all */
+            if ( (0 < poll(pfd, numFds, (int)(deadline - now))) && (0 != pfd[0].revents) )
+            {
+                while ( sizeof(siginfo) == read(sigchld_fd, &siginfo, sizeof(siginfo)) )
+                {
+                }
+            }
+            reap_exited(table, signalled);
+            now = timer_nowMs();
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    return (false == running);
+}
+
+
+
+/**
+ * Stops every child in the process table, stage by stage and wave by wave in
+ * reverse launch order, within SHUTDOWN_TIMEOUT_MS plus the SIGKILL waits. Nothing is
+ * restarted while this runs, so it must only be called once BARSM has left its
+ * event loop.
+ *
+ * @param[in] table: the process table
+ * @param[in] dirs: the directories, in launch order
+ * @param[in] num_dirs: the number of directories
+ * @param[in] sigchld_fd: the SIGCHLD signalfd, SIGCHLD has to be blocked
+ *
+ * @return void
+ */
+void shutdown_children(proc_table *table, const char *const dirs[], int32_t num_dirs,
+    int32_t sigchld_fd)
+{
+    uint64_t signalled[MAX_PROCS];
+    uint64_t start;
+    uint64_t deadline;
+    uint64_t stageDeadline = 0;
+    uint64_t waveDeadline;
+    uint64_t now;
+    int32_t waves[MAX_PROCS];
+    int32_t numWaves;
+    int32_t stage;
+    int32_t numLeft = 0;
+    int32_t i;
+
+    memset(signalled, 0, sizeof(signalled));
+    start = timer_nowMs();
+    deadline = start + SHUTDOWN_TIMEOUT_MS;
+
+    printf("EXECUTING: Stopping all children\n");
+
+    /* children in none of the directories are stopped first */
+    for ( stage = num_dirs; stage >= 0; stage-- )
+    {
+        numWaves = stage_waves(table, dirs, num_dirs, stage, waves);
+        if ( 0 < numWaves )
+        {
+            /* leave this stage and each one after it an equal share of the
+             * time that is left */
+            now = timer_nowMs();
+            stageDeadline = now;
+            if ( deadline > now )
+            {
+                stageDeadline += (deadline - now) / (uint64_t)(stage + 1);
+            }
+        }
+
+        for ( i = 0; i < numWaves; i++ )
+        {
+            if ( 0 < signal_stage(table, dirs, num_dirs, stage, waves[i], SIGTERM, signalled) )
+            {
+                /* and likewise each wave of the stage */
+                now = timer_nowMs();
+                waveDeadline = now;
+                if ( stageDeadline > now )
+                {
+                    waveDeadline += (stageDeadline - now) / (uint64_t)(numWaves - i);
+                }
+
+                if ( true != wait_stage(table, dirs, num_dirs, stage, waves[i], sigchld_fd,
+                                        waveDeadline, signalled) )
+                {
+                    signal_stage(table, dirs, num_dirs, stage, waves[i], SIGKILL, signalled);
+                    wait_stage(table, dirs, num_dirs, stage, waves[i], sigchld_fd,
+                               timer_nowMs() + SHUTDOWN_KILL_WAIT_MS, signalled);
+                }
+            }
+        }
+    }
+
+    for ( i = 0; i < table->num_nodes; i++ )
+    {
+        if ( 0 != table->nodes[i].child_pid )
+        {
+            syslog(LOG_ERR, "%s:%d ERROR: %s (PID %d) could not be stopped!",
+                __FUNCTION__, __LINE__, table->nodes[i].dir, table->nodes[i].child_pid);
+            numLeft++;
+        }
+    }
+
+    syslog(LOG_NOTICE, "COMPLETED: All children stopped in %llu ms (%d left running)",
+        (unsigned long long)(timer_nowMs() - start), numLeft);
+    printf("COMPLETED: All children stopped in %llu ms (%d left running)\n",
+        (unsigned long long)(timer_nowMs() - start), numLeft);
+}
@@ -0,0 +1,31 @@
+/** @file barsm_shutdown.h
+ * Orderly stop of every module/application when BARSM exits.
+ *
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ */
+
+#ifndef __BARSM_SHUTDOWN_H__
+#define __BARSM_SHUTDOWN_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "barsm_proctable.h"
+
+/****************
+* CONSTANTS
+****************/
+/* Every child, of every stage, has to have exited within this many
+ * milliseconds of the start of the shutdown, or it is sent SIGKILL */
+#define SHUTDOWN_TIMEOUT_MS         5000
+/* How long each wave of a stage waits for the exits of the children it sent
+ * SIGKILL */
+#define SHUTDOWN_KILL_WAIT_MS       1000
+
+/****************
+* FUNCTION PROTOTYPES
+****************/
+void shutdown_children(proc_table *table, const char *const dirs[], int32_t num_dirs,
+    int32_t sigchld_fd);
+
+#endif
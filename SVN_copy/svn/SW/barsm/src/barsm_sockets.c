@@ -0,0 +1,313 @@
+/**
+ * File: barsm_sockets.c
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ *
+ * Description:
+ *   This file contains the sockets BARSM creates for modules/applications. An
+ *   item with sockets= in its manifest does not set up those sockets itself:
+ *   BARSM creates them the first time the item is launched, binds them, joins
+ *   their multicast groups and listens on them, and hands them to every
+ *   process of the item from SPAWN_LISTEN_FD on. The number of sockets is
+ *   passed in SPAWN_LISTEN_FDS_ENV, in the style of systemd's LISTEN_FDS.
+ *
+ *   BARSM keeps its own copy of each socket for as long as the item is
+ *   installed. A restarted process therefore starts with sockets that are
+ *   already bound and joined, and the port is never released, so it cannot
+ *   collide with the bind of another process on the restart path.
+ *
+ *   sockets= takes a comma separated list of up to SPAWN_MAX_LISTEN_FDS
+ *   sockets, each tcp:[address:]port for a listening TCP socket or
+ *   udp:[address:]port for a bound UDP socket. A UDP socket with a multicast
+ *   address is bound to the port on every interface and joins that group:
+ *
+ *   simm       sockets=udp:225.0.0.37:4097
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "barsm_spawn.h"
+#include "barsm_sockets.h"
+
+/****************
+* PRIVATE CONSTANTS
+****************/
+/* Longest single entry of sockets=, e.g. udp:255.255.255.255:65535 */
+#define SOCKETS_SPEC_MAX        32
+
+/****************
+* PRIVATE DATA TYPES
+****************/
+struct socket_spec_struct
+{
+    int32_t type;               /* SOCK_STREAM or SOCK_DGRAM */
+    struct in_addr addr;        /* address to bind, or multicast group to join */
+    uint16_t port;
+};
+typedef struct socket_spec_struct socket_spec;
+
+/****************
+* PRIVATE FUNCTION PROTOTYPES
+****************/
+static bool parse_spec(const char *spec, size_t len, socket_spec *out);
+static bool parse_list(const char *value, socket_spec specs[SPAWN_MAX_LISTEN_FDS],
+    int32_t *num);
+static int32_t open_socket(const socket_spec *spec);
+
+
+
+/**
+ * Parses one entry of sockets=.
+ *
+ * @param[in] spec: the entry, not NUL terminated
+ * @param[in] len: the length of the entry
+ * @param[out] out: the parsed socket
+ *
+ * @return true/false whether the entry is valid
+ */
+bool parse_spec(const char *spec, size_t len, socket_spec *out)
+{
+    bool success = true;
+    char buf[SOCKETS_SPEC_MAX];
+    char *port;
+    char *end;
+    long number;
+
+    if ( sizeof(buf) <= len )
+    {
+        success = false;
+    }
+    else
+    {
+        memcpy(buf, spec, len);
+        buf[len] = '\0';
+
+        if ( 0 == strncmp(buf, "tcp:", 4) )
+        {
+            out->type = SOCK_STREAM;
+        }
+        else if ( 0 == strncmp(buf, "udp:", 4) )
+        {
+            out->type = SOCK_DGRAM;
+        }
+        else
+        {
+            success = false;
+        }
+    }
+
+    if ( true == success )
+    {
+        out->addr.s_addr = htonl(INADDR_ANY);
+        port = strrchr(buf, ':');
+        if ( &buf[3] != port )
+        {
+            /* an address between the protocol and the port */
+            *port = '\0';
+            success = (1 == inet_pton(AF_INET, &buf[4], &out->addr));
+        }
+
+        errno = 0;
+        number = strtol(port + 1, &end, 10);
+        if ( (0 != errno) || (end == port + 1) || ('\0' != *end) ||
+             (1 > number) || (65535 < number) )
+        {
+            success = false;
+        }
+        out->port = (uint16_t)number;
+    }
+
+    return success;
+}
+
+/**
+ * Parses the value of sockets=.
+ *
+ * @param[in] value: the comma separated list of sockets
+ * @param[out] specs: the parsed sockets
+ * @param[out] num: the number of sockets
+ *
+ * @return true/false whether every entry is valid
+ */
+bool parse_list(const char *value, socket_spec specs[SPAWN_MAX_LISTEN_FDS], int32_t *num)
+{
+    bool success = true;
+    const char *spec = value;
+    size_t len;
+
+    *num = 0;
+    while ( (true == success) && ('\0' != *spec) )
+    {
+        len = strcspn(spec, ",");
+        if ( SPAWN_MAX_LISTEN_FDS <= *num )
+        {
+            success = false;
+        }
+        else
+        {
+            success = parse_spec(spec, len, &specs[*num]);
+            (*num)++;
+        }
+
+        spec += len;
+        if ( ',' == *spec )
+        {
+            spec++;
+        }
+    }
+
+    return success;
+}
+
+/**
+ * Creates one socket and moves it where it can be passed to a child.
+ *
+ * @param[in] spec: the socket to create
+ *
+ * @return the descriptor, -1 if the socket could not be set up
+ */
+int32_t open_socket(const socket_spec *spec)
+{
+    bool success = true;
+    int32_t fd;
+    int32_t movedFd = -1;
+    int32_t reuse = 1;
+    bool multicast;
+    struct sockaddr_in addr;
+    struct ip_mreq mreq;
+
+    multicast = (SOCK_DGRAM == spec->type) && (IN_MULTICAST(ntohl(spec->addr.s_addr)));
+
+    errno = 0;
+    fd = socket(AF_INET, spec->type | SOCK_CLOEXEC, 0);
+    if ( (-1 == fd) ||
+         (0 != setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse))) )
+    {
+        success = false;
+    }
+
+    if ( true == success )
+    {
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(spec->port);
+        addr.sin_addr.s_addr = (true == multicast) ? htonl(INADDR_ANY) : spec->addr.s_addr;
+        success = (0 == bind(fd, (struct sockaddr *)&addr, sizeof(addr)));
+    }
+
+    if ( (true == success) && (true == multicast) )
+    {
+        mreq.imr_multiaddr = spec->addr;
+        mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+        success = (0 == setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)));
+    }
+
+    if ( (true == success) && (SOCK_STREAM == spec->type) )
+    {
+        success = (0 == listen(fd, SOCKETS_BACKLOG));
+    }
+
+    if ( true == success )
+    {
+        movedFd = fcntl(fd, F_DUPFD_CLOEXEC, SPAWN_FD_MAX);
+    }
+
+    if ( -1 == movedFd )
+    {
+        syslog(LOG_ERR, "%s:%d ERROR: unable to set up %s socket on port %u! (%d:%s)",
+            __FUNCTION__, __LINE__, (SOCK_STREAM == spec->type) ? "TCP" : "UDP",
+            spec->port, errno, strerror(errno));
+    }
+
+    if ( -1 != fd )
+    {
+        close(fd);
+    }
+
+    return movedFd;
+}
+
+
+
+/**
+ * Checks the value of sockets= when the manifest is read.
+ *
+ * @param[in] value: the comma separated list of sockets
+ *
+ * @return true/false whether the value is valid
+ */
+bool sockets_valid(const char *value)
+{
+    socket_spec specs[SPAWN_MAX_LISTEN_FDS];
+    int32_t num;
+
+    return parse_list(value, specs, &num);
+}
+
+/**
+ * Creates the sockets of an item, unless they were created by an earlier
+ * launch of the item.
+ *
+ * @param[in] node: the process table node of the item
+ *
+ * @return true/false whether the item has all of its sockets
+ */
+bool sockets_open(proc_node *node)
+{
+    bool success = true;
+    socket_spec specs[SPAWN_MAX_LISTEN_FDS];
+    int32_t num = 0;
+    int32_t i;
+
+    if ( (NULL != node->sockets) && (0 == node->num_listen_fds) )
+    {
+        success = parse_list(node->sockets, specs, &num);
+        for ( i = 0; (i < num) && (true == success); i++ )
+        {
+            node->listen_fds[i] = open_socket(&specs[i]);
+            success = (-1 != node->listen_fds[i]);
+            node->num_listen_fds = (true == success) ? (i + 1) : i;
+        }
+
+        if ( true == success )
+        {
+            syslog(LOG_DEBUG, "SUCCESS: %d sockets created for %s", num, node->dir);
+        }
+        else
+        {
+            sockets_close(node);
+        }
+    }
+
+    return success;
+}
+
+/**
+ * Closes the sockets of an item, which releases their ports once the last
+ * process of the item that uses them has exited.
+ *
+ * @param[in] node: the process table node of the item
+ *
+ * @return void
+ */
+void sockets_close(proc_node *node)
+{
+    int32_t i;
+
+    for ( i = 0; i < node->num_listen_fds; i++ )
+    {
+        close(node->listen_fds[i]);
+    }
+    node->num_listen_fds = 0;
+}
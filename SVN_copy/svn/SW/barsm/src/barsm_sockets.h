@@ -0,0 +1,28 @@
+/** @file barsm_sockets.h
+ * Sockets BARSM creates and owns on behalf of the modules/applications.
+ *
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ */
+
+#ifndef __BARSM_SOCKETS_H__
+#define __BARSM_SOCKETS_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "barsm_proctable.h"
+
+/****************
+* CONSTANTS
+****************/
+/* Backlog of the listening TCP sockets */
+#define SOCKETS_BACKLOG         16
+
+/****************
+* FUNCTION PROTOTYPES
+****************/
+bool sockets_valid(const char *value);
+bool sockets_open(proc_node *node);
+void sockets_close(proc_node *node);
+
+#endif
@@ -0,0 +1,608 @@
+/**
+ * File: barsm_spawn.c
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ *
+ * Description:
+ *   This file contains the backends BARSM can use to start a child process.
+ *   fork() has to duplicate the page tables of the whole BARSM address space
+ *   before the child can exec, which grows with every string and socket BARSM
+ *   holds. posix_spawn() runs the child on the parent's memory (vfork style)
+ *   until it has exec'd, so its cost does not depend on the size of BARSM.
+ *
+ *   Both backends give the child an empty signal mask and default SIGCHLD and
+ *   SIGPIPE dispositions, since BARSM blocks SIGCHLD for its signalfd and the
+ *   mask survives exec. Only descriptors without FD_CLOEXEC are inherited, so
+ *   every descriptor BARSM opens for itself must be created close-on-exec. The
+ *   exceptions are the optional readiness pipe, heartbeat counter and sockets,
+ *   which are moved to SPAWN_READY_FD, SPAWN_HEARTBEAT_FD and SPAWN_LISTEN_FD
+ *   on in the child.
+ *
+ *   A child can also be given its own CPU affinity, scheduling policy, nice
+ *   value and memory locking limit, which are all set between the fork and the
+ *   exec so that the new program never runs with BARSM's settings. posix_spawn()
+ *   can only set the policy, so a child that needs anything else is started
+ *   with fork() whatever the backend asked for.
+ *
+ *   A child with a cgroup v2 directory is created in it, rather than moved
+ *   there after the fork: posix_spawn() does so where the C library has
+ *   posix_spawnattr_setcgroup_np(), the fork() backend with clone3() and
+ *   CLONE_INTO_CGROUP. Only on a kernel without either does the child write
+ *   itself to cgroup.procs before the exec.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sched.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#include "barsm_spawn.h"
+
+/****************
+* PRIVATE DATA TYPES
+****************/
+/* Argument of the sched_setattr() system call, which the C library does not
+ * wrap */
+struct spawn_sched_attr_struct
+{
+    uint32_t size;
+    uint32_t sched_policy;
+    uint64_t sched_flags;
+    int32_t sched_nice;
+    uint32_t sched_priority;
+    uint64_t sched_runtime;
+    uint64_t sched_deadline;
+    uint64_t sched_period;
+};
+typedef struct spawn_sched_attr_struct spawn_sched_attr;
+
+/* Argument of the clone3() system call, which the C library does not wrap
+ * either */
+struct spawn_clone_args_struct
+{
+    uint64_t flags;
+    uint64_t pidfd;
+    uint64_t child_tid;
+    uint64_t parent_tid;
+    uint64_t exit_signal;
+    uint64_t stack;
+    uint64_t stack_size;
+    uint64_t tls;
+    uint64_t set_tid;
+    uint64_t set_tid_size;
+    uint64_t cgroup;
+};
+typedef struct spawn_clone_args_struct spawn_clone_args;
+
+/****************
+* PRIVATE CONSTANTS
+****************/
+/* not defined by older kernel headers */
+#ifndef CLONE_INTO_CGROUP
+#define CLONE_INTO_CGROUP       0x200000000ULL
+#endif
+
+/* whether posix_spawn() can start a child in its cgroup */
+#ifdef POSIX_SPAWN_SETCGROUP
+#define SPAWN_POSIX_CGROUP      true
+#else
+#define SPAWN_POSIX_CGROUP      false
+#endif
+
+/****************
+* PRIVATE FUNCTION PROTOTYPES
+****************/
+static bool posix_capable(const spawn_sched *sched);
+static pid_t spawn_forkInto(int32_t cgroup_fd, bool *joined);
+static int32_t spawn_fork(const spawn_request *req, pid_t *pid, int32_t *status_fd);
+static int32_t spawn_posix(const spawn_request *req, pid_t *pid);
+
+
+
+/**
+ * Checks whether posix_spawn() can apply the scheduling settings of a request.
+ *
+ * @param[in] sched: the settings, NULL for none
+ *
+ * @return true if at most a non-deadline policy has to be set
+ */
+bool posix_capable(const spawn_sched *sched)
+{
+    return (NULL == sched) ||
+           ((false == sched->set_cpus) && (false == sched->set_nice) &&
+            (false == sched->mlock) &&
+            ((false == sched->set_policy) || (SCHED_DEADLINE != sched->policy)));
+}
+
+/**
+ * Forks the calling process, into a cgroup v2 directory if one is given. The
+ * child is created in it by clone3() where the kernel supports
+ * CLONE_INTO_CGROUP, so that it is never charged to BARSM's cgroup and no
+ * migration is needed. Elsewhere it is a plain fork() and the child has to
+ * join the cgroup itself.
+ *
+ * @param[in] cgroup_fd: the directory, -1 for none
+ * @param[out] joined: whether the child is in the directory already
+ *
+ * @return what fork() returns
+ */
+pid_t spawn_forkInto(int32_t cgroup_fd, bool *joined)
+{
+    pid_t new_pid = -1;
+    spawn_clone_args args;
+
+    *joined = false;
+
+#ifdef SYS_clone3
+    if ( 0 <= cgroup_fd )
+    {
+        memset(&args, 0, sizeof(args));
+        args.flags = CLONE_INTO_CGROUP;
+        args.exit_signal = SIGCHLD;
+        args.cgroup = (uint64_t)cgroup_fd;
+
+        errno = 0;
+        new_pid = (pid_t)syscall(SYS_clone3, &args, sizeof(args));
+
+        /* ENOSYS before Linux 5.3, E2BIG or EINVAL before 5.7 */
+        *joined = ( (-1 != new_pid) ||
+                    ((ENOSYS != errno) && (E2BIG != errno) && (EINVAL != errno)) );
+    }
+#else
+    (void)args;
+#endif
+
+    if ( false == *joined )
+    {
+        new_pid = fork();
+    }
+
+    return new_pid;
+}
+
+/**
+ * Starts a child with fork() and execve(). The outcome of execve() is reported
+ * through a close-on-exec status pipe: it is closed by a successful exec and
+ * carries errno when the exec fails. A scheduling setting that cannot be
+ * applied is reported the same way, so a child is never left running without
+ * the priority it was configured with.
+ *
+ * @param[in] req: what to execute
+ * @param[out] pid: the PID of the child
+ * @param[out] status_fd: the read end of the status pipe, see spawn_confirm()
+ *
+ * @return 0 if the child was forked, otherwise the errno of the failure
+ */
+int32_t spawn_fork(const spawn_request *req, pid_t *pid, int32_t *status_fd)
+{
+    int32_t rc = 0;
+    int32_t status_pipe[2];
+    int32_t exec_errno;
+    int32_t i;
+    sigset_t emptyMask;
+    pid_t new_pid;
+    bool joined;
+
+    errno = 0;
+    if ( 0 != pipe2(status_pipe, O_CLOEXEC) )
+    {
+        rc = errno;
+    }
+
+    if ( 0 == rc )
+    {
+        new_pid = spawn_forkInto(req->cgroup_fd, &joined);
+        if ( 0 == new_pid )
+        {
+            sigemptyset(&emptyMask);
+            sigprocmask(SIG_SETMASK, &emptyMask, NULL);
+            signal(SIGCHLD, SIG_DFL);
+            signal(SIGPIPE, SIG_DFL);
+            close(status_pipe[0]);
+            if ( SPAWN_FD_MAX > status_pipe[1] )
+            {
+                /* out of the way of the sockets */
+                status_pipe[1] = fcntl(status_pipe[1], F_DUPFD_CLOEXEC, SPAWN_FD_MAX);
+            }
+
+            /* before the dup2()s below can land on the cgroup descriptor */
+            exec_errno = (true == joined) ? 0 : spawn_joinCgroup(req->cgroup_fd);
+
+            /* dup2() clears FD_CLOEXEC on the copy so it survives the exec */
+            if ( (0 <= req->ready_fd) && (SPAWN_READY_FD != req->ready_fd) )
+            {
+                dup2(req->ready_fd, SPAWN_READY_FD);
+            }
+            if ( 0 <= req->heartbeat_fd )
+            {
+                dup2(req->heartbeat_fd, SPAWN_HEARTBEAT_FD);
+            }
+            for ( i = 0; i < req->num_listen_fds; i++ )
+            {
+                dup2(req->listen_fds[i], SPAWN_LISTEN_FD + i);
+            }
+
+            if ( (0 == exec_errno) && (NULL != req->sched) )
+            {
+                exec_errno = spawn_applySched(req->sched);
+            }
+
+            if ( 0 == exec_errno )
+            {
+                execve(req->path, req->argv, (NULL != req->envp) ? req->envp : environ);
+
+                /* only returns if the exec failed */
+                exec_errno = errno;
+            }
+
+            if ( sizeof(exec_errno) != write(status_pipe[1], &exec_errno, sizeof(exec_errno)) )
+            {
+                /* nothing else can be done, the parent sees a short read */
+            }
+            _exit(127);
+        }
+        else if ( -1 == new_pid )
+        {
+            rc = errno;
+            close(status_pipe[0]);
+            close(status_pipe[1]);
+        }
+        else
+        {
+            close(status_pipe[1]);
+            *pid = new_pid;
+            *status_fd = status_pipe[0];
+        }
+    }
+
+    return rc;
+}
+
+/**
+ * Starts a child with posix_spawn(). The parent does not return until the
+ * child has exec'd, and a failed exec is returned by posix_spawn() itself after
+ * the child has been reaped, so no status pipe is needed. A cgroup is only
+ * applied where SPAWN_POSIX_CGROUP is true.
+ *
+ * @param[in] req: what to execute
+ * @param[out] pid: the PID of the child
+ *
+ * @return 0 if the child is running the new program, otherwise the errno of
+ *      the failure
+ */
+int32_t spawn_posix(const spawn_request *req, pid_t *pid)
+{
+    int32_t rc;
+    short flags = POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF;
+    posix_spawnattr_t attr;
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_t *actionsPtr = NULL;
+    sigset_t emptyMask;
+    sigset_t defaultSigs;
+    struct sched_param param;
+    pid_t new_pid;
+    int32_t i;
+
+    rc = posix_spawnattr_init(&attr);
+    if ( 0 == rc )
+    {
+#ifdef POSIX_SPAWN_USEVFORK
+        /* implied by newer glibc, required by older ones to avoid fork() */
+        flags |= POSIX_SPAWN_USEVFORK;
+#endif
+        sigemptyset(&emptyMask);
+        sigemptyset(&defaultSigs);
+        sigaddset(&defaultSigs, SIGCHLD);
+        sigaddset(&defaultSigs, SIGPIPE);
+
+        if ( (NULL != req->sched) && (true == req->sched->set_policy) )
+        {
+            flags |= POSIX_SPAWN_SETSCHEDULER;
+            memset(&param, 0, sizeof(param));
+            param.sched_priority = req->sched->priority;
+            posix_spawnattr_setschedpolicy(&attr, req->sched->policy);
+            posix_spawnattr_setschedparam(&attr, &param);
+        }
+
+#ifdef POSIX_SPAWN_SETCGROUP
+        if ( 0 <= req->cgroup_fd )
+        {
+            flags |= POSIX_SPAWN_SETCGROUP;
+            posix_spawnattr_setcgroup_np(&attr, req->cgroup_fd);
+        }
+#endif
+
+        posix_spawnattr_setsigmask(&attr, &emptyMask);
+        posix_spawnattr_setsigdefault(&attr, &defaultSigs);
+        posix_spawnattr_setflags(&attr, flags);
+
+        if ( ((0 <= req->ready_fd) && (SPAWN_READY_FD != req->ready_fd)) ||
+             (0 <= req->heartbeat_fd) || (0 < req->num_listen_fds) )
+        {
+            posix_spawn_file_actions_init(&actions);
+            if ( (0 <= req->ready_fd) && (SPAWN_READY_FD != req->ready_fd) )
+            {
+                posix_spawn_file_actions_adddup2(&actions, req->ready_fd, SPAWN_READY_FD);
+            }
+            if ( 0 <= req->heartbeat_fd )
+            {
+                posix_spawn_file_actions_adddup2(&actions, req->heartbeat_fd,
+                                                 SPAWN_HEARTBEAT_FD);
+            }
+            for ( i = 0; i < req->num_listen_fds; i++ )
+            {
+                posix_spawn_file_actions_adddup2(&actions, req->listen_fds[i],
+                                                 SPAWN_LISTEN_FD + i);
+            }
+            actionsPtr = &actions;
+        }
+
+        rc = posix_spawn(&new_pid, req->path, actionsPtr, &attr, req->argv,
+                         (NULL != req->envp) ? req->envp : environ);
+        if ( 0 == rc )
+        {
+            *pid = new_pid;
+        }
+
+        if ( NULL != actionsPtr )
+        {
+            posix_spawn_file_actions_destroy(actionsPtr);
+        }
+        posix_spawnattr_destroy(&attr);
+    }
+
+    return rc;
+}
+
+
+
+/**
+ * Starts a child process with the given backend. Children with scheduling
+ * settings posix_spawn() cannot apply, or with a cgroup when the C library
+ * cannot start one in it, are always started with fork().
+ *
+ * @param[in] backend: SPAWN_FORK or SPAWN_POSIX
+ * @param[in] req: what to execute
+ * @param[out] pid: the PID of the child, 0 if there is no child
+ * @param[out] status_fd: -1, or a descriptor to pass to spawn_confirm() when
+ *      the outcome of the exec is not known yet
+ *
+ * @return 0 on success, otherwise the errno of the failure. With SPAWN_POSIX
+ *      this includes a failed exec.
+ */
+int32_t spawn_process(enum spawn_backend backend, const spawn_request *req,
+    pid_t *pid, int32_t *status_fd)
+{
+    int32_t rc;
+
+    *pid = 0;
+    *status_fd = -1;
+
+    if ( (SPAWN_FORK == backend) || (false == posix_capable(req->sched)) ||
+         ((0 <= req->cgroup_fd) && (false == SPAWN_POSIX_CGROUP)) )
+    {
+        rc = spawn_fork(req, pid, status_fd);
+    }
+    else
+    {
+        rc = spawn_posix(req, pid);
+    }
+
+    return rc;
+}
+
+/**
+ * Waits for a child started by spawn_fork() to either complete its exec, which
+ * closes the status pipe, or report the errno of a failed exec. The status pipe
+ * is closed afterwards.
+ *
+ * @param[in] status_fd: the status descriptor returned by spawn_process()
+ *
+ * @return 0 if the exec succeeded, otherwise the errno it failed with
+ */
+int32_t spawn_confirm(int32_t status_fd)
+{
+    int32_t exec_errno = 0;
+    ssize_t retBytes;
+
+    do
+    {
+        errno = 0;
+        retBytes = read(status_fd, &exec_errno, sizeof(exec_errno));
+    } while ( (-1 == retBytes) && (EINTR == errno) );
+
+    if ( 0 == retBytes )
+    {
+        /* end of file, the exec closed the pipe */
+        exec_errno = 0;
+    }
+    else if ( sizeof(exec_errno) != retBytes )
+    {
+        exec_errno = (0 != errno) ? errno : EIO;
+    }
+    else
+    {
+        /* the exec failed and the child sent its errno */
+    }
+
+    close(status_fd);
+
+    return exec_errno;
+}
+
+/**
+ * Builds the environment for a child: a copy of BARSM's own environment with
+ * the given "NAME=value" strings added, replacing any inherited value of the
+ * same variables. The array points at vars and environ, so vars has to outlive
+ * the spawn and the result is released with a single free().
+ *
+ * @param[in] vars: NULL terminated list of "NAME=value" strings
+ *
+ * @return the NULL terminated environment, NULL if it could not be allocated
+ */
+char **spawn_env(char *const *vars)
+{
+    char **envp;
+    size_t numEnv = 0;
+    size_t numVars = 0;
+    size_t nameLen;
+    size_t i;
+    size_t j = 0;
+    size_t k;
+    bool replaced;
+
+    while ( NULL != environ[numEnv] )
+    {
+        numEnv++;
+    }
+    while ( NULL != vars[numVars] )
+    {
+        numVars++;
+    }
+
+    envp = (char **)malloc((numEnv + numVars + 1) * sizeof(char *));
+    if ( NULL != envp )
+    {
+        for ( i = 0; i < numEnv; i++ )
+        {
+            replaced = false;
+            for ( k = 0; (k < numVars) && (false == replaced); k++ )
+            {
+                nameLen = strcspn(vars[k], "=") + 1;
+                replaced = (0 == strncmp(environ[i], vars[k], nameLen));
+            }
+
+            if ( false == replaced )
+            {
+                envp[j] = environ[i];
+                j++;
+            }
+        }
+
+        for ( k = 0; k < numVars; k++ )
+        {
+            envp[j] = vars[k];
+            j++;
+        }
+        envp[j] = NULL;
+    }
+
+    return envp;
+}
+
+/**
+ * Applies scheduling settings to the calling process. Used in the child
+ * between fork() and execve(), everything set here is kept across the exec,
+ * and in the children of the zygote, see barsm_zygote.c.
+ *
+ * @param[in] sched: the settings to apply
+ *
+ * @return 0 on success, otherwise the errno of the setting that failed
+ */
+int32_t spawn_applySched(const spawn_sched *sched)
+{
+    int32_t rc = 0;
+    struct rlimit memlock;
+    struct sched_param param;
+    spawn_sched_attr attr;
+
+    errno = 0;
+    if ( (true == sched->set_cpus) &&
+         (0 != sched_setaffinity(0, sizeof(sched->cpus), &sched->cpus)) )
+    {
+        rc = errno;
+    }
+
+    if ( (0 == rc) && (true == sched->set_nice) &&
+         (0 != setpriority(PRIO_PROCESS, 0, sched->nice)) )
+    {
+        rc = errno;
+    }
+
+    if ( (0 == rc) && (true == sched->mlock) )
+    {
+        /* without CAP_SYS_RESOURCE only the soft limit can be raised, the
+         * child's own mlockall() reports it if that is not enough */
+        memlock.rlim_cur = RLIM_INFINITY;
+        memlock.rlim_max = RLIM_INFINITY;
+        if ( (0 != setrlimit(RLIMIT_MEMLOCK, &memlock)) &&
+             (0 == getrlimit(RLIMIT_MEMLOCK, &memlock)) )
+        {
+            memlock.rlim_cur = memlock.rlim_max;
+            setrlimit(RLIMIT_MEMLOCK, &memlock);
+        }
+    }
+
+    if ( (0 == rc) && (true == sched->set_policy) )
+    {
+        if ( SCHED_DEADLINE == sched->policy )
+        {
+#ifdef SYS_sched_setattr
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.sched_policy = SCHED_DEADLINE;
+            attr.sched_runtime = sched->runtime_ns;
+            attr.sched_deadline = sched->deadline_ns;
+            attr.sched_period = sched->period_ns;
+            if ( 0 != syscall(SYS_sched_setattr, 0, &attr, 0) )
+            {
+                rc = errno;
+            }
+#else
+            (void)attr;
+            rc = ENOSYS;
+#endif
+        }
+        else
+        {
+            memset(&param, 0, sizeof(param));
+            param.sched_priority = sched->priority;
+            if ( 0 != sched_setscheduler(0, sched->policy, &param) )
+            {
+                rc = errno;
+            }
+        }
+    }
+
+    return rc;
+}
+
+/**
+ * Moves the calling process into a cgroup v2 directory. Used like
+ * spawn_applySched() before the exec, so it only makes async-signal-safe
+ * calls.
+ *
+ * @param[in] cgroup_fd: the directory, -1 to stay in the current cgroup
+ *
+ * @return 0 on success, otherwise the errno of the failure
+ */
+int32_t spawn_joinCgroup(int32_t cgroup_fd)
+{
+    int32_t rc = 0;
+    int32_t fd;
+
+    if ( 0 <= cgroup_fd )
+    {
+        /* "0" stands for the process that writes it */
+        fd = openat(cgroup_fd, "cgroup.procs", O_WRONLY | O_CLOEXEC);
+        if ( (-1 == fd) || (1 != write(fd, "0", 1)) )
+        {
+            rc = errno;
+        }
+        if ( -1 != fd )
+        {
+            close(fd);
+        }
+    }
+
+    return rc;
+}
@@ -0,0 +1,112 @@
+/** @file barsm_spawn.h
+ * Process spawning backends used by BARSM to launch modules/applications.
+ *
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ */
+
+#ifndef __BARSM_SPAWN_H__
+#define __BARSM_SPAWN_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sched.h>
+#include <sys/types.h>
+
+/****************
+* CONSTANTS
+****************/
+enum spawn_backend
+{
+    /* fork() + execl(), the child reports a failed exec over a status pipe */
+    SPAWN_FORK              = 0,
+    /* posix_spawn(), the parent is suspended until the child has exec'd so no
+     * page tables are copied and exec failures are returned directly */
+    SPAWN_POSIX             = 1,
+};
+
+/* Backend used by launch_process(), build with -DSPAWN_DEFAULT_BACKEND=SPAWN_FORK
+ * to go back to fork() */
+#ifndef SPAWN_DEFAULT_BACKEND
+#define SPAWN_DEFAULT_BACKEND   SPAWN_POSIX
+#endif
+
+/* Environment variable that tells a child the 4 character name BARSM reported
+ * for it to AACM */
+#define SPAWN_PROC_NAME_ENV     "RC360_PROC_NAME"
+/* Descriptor a child started with a readiness pipe writes to once it is ready,
+ * also passed in the environment */
+#define SPAWN_READY_FD          3
+#define SPAWN_READY_FD_ENV      "RC360_READY_FD"
+/* Descriptor of the heartbeat counter given to a child that BARSM watches
+ * for liveness, also passed in the environment, see barsm_heartbeat.c */
+#define SPAWN_HEARTBEAT_FD      4
+#define SPAWN_HEARTBEAT_FD_ENV  "RC360_HEARTBEAT_FD"
+/* Sockets BARSM created for a child, see barsm_sockets.c, are given to it from
+ * SPAWN_LISTEN_FD on, in the order of its manifest, and their number is
+ * passed in the environment */
+#define SPAWN_LISTEN_FD         5
+#define SPAWN_MAX_LISTEN_FDS    4
+#define SPAWN_LISTEN_FDS_ENV    "RC360_LISTEN_FDS"
+/* Descriptors passed to a spawn request must be at least this, so that none
+ * of them is overwritten by another being moved into place in the child */
+#define SPAWN_FD_MAX            (SPAWN_LISTEN_FD + SPAWN_MAX_LISTEN_FDS)
+/* mlockall() does not survive exec, so a child that should lock its memory is
+ * told so in its environment and calls mlockall() itself. Its RLIMIT_MEMLOCK is
+ * raised before the exec so that this also works without CAP_IPC_LOCK. */
+#define SPAWN_MLOCK_ENV         "RC360_MLOCKALL"
+
+/* not defined by older C libraries */
+#ifndef SCHED_DEADLINE
+#define SCHED_DEADLINE          6
+#endif
+
+/****************
+* DATA TYPES
+****************/
+/* Scheduling settings applied to a child before it execs; a zeroed structure
+ * leaves everything inherited from BARSM */
+struct spawn_sched_struct
+{
+    bool set_cpus;              /* restrict the child to cpus */
+    cpu_set_t cpus;
+    bool set_policy;            /* change the scheduling policy to policy */
+    int32_t policy;             /* SCHED_OTHER/BATCH/IDLE/FIFO/RR/DEADLINE */
+    int32_t priority;           /* SCHED_FIFO and SCHED_RR priority */
+    uint64_t runtime_ns;        /* SCHED_DEADLINE parameters */
+    uint64_t deadline_ns;
+    uint64_t period_ns;
+    bool set_nice;              /* change the nice value to nice */
+    int32_t nice;
+    bool mlock;                 /* the child locks its memory, see SPAWN_MLOCK_ENV */
+};
+typedef struct spawn_sched_struct spawn_sched;
+
+struct spawn_request_struct
+{
+    const char *path;           /* file to execute */
+    char *const *argv;          /* NULL terminated argument list */
+    char *const *envp;          /* NULL terminated environment, NULL to inherit */
+    int32_t ready_fd;           /* given to the child as SPAWN_READY_FD, -1 for none,
+                                 * must not already be SPAWN_READY_FD */
+    int32_t heartbeat_fd;       /* given to the child as SPAWN_HEARTBEAT_FD, -1 for
+                                 * none, must be at least SPAWN_FD_MAX */
+    const int32_t *listen_fds;  /* given to the child from SPAWN_LISTEN_FD on, each
+                                 * must be at least SPAWN_FD_MAX */
+    int32_t num_listen_fds;     /* at most SPAWN_MAX_LISTEN_FDS */
+    const spawn_sched *sched;   /* scheduling settings, NULL to inherit */
+    int32_t cgroup_fd;          /* cgroup v2 directory the child joins, -1 to
+                                 * stay in BARSM's */
+};
+typedef struct spawn_request_struct spawn_request;
+
+/****************
+* FUNCTION PROTOTYPES
+****************/
+int32_t spawn_process(enum spawn_backend backend, const spawn_request *req,
+    pid_t *pid, int32_t *status_fd);
+int32_t spawn_confirm(int32_t status_fd);
+int32_t spawn_applySched(const spawn_sched *sched);
+int32_t spawn_joinCgroup(int32_t cgroup_fd);
+char **spawn_env(char *const *vars);
+
+#endif
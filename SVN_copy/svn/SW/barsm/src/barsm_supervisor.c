@@ -0,0 +1,293 @@
+/**
+ * File: barsm_supervisor.c
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ *
+ * Description:
+ *   This file contains the supervisor BARSM runs under. The process started as
+ *   BARSM becomes the supervisor: it makes itself the child subreaper, creates
+ *   the journal and forks the BARSM that does the actual work. When that BARSM
+ *   crashes its children are re-parented to the supervisor instead of init, so
+ *   they keep running, and a new BARSM is forked that adopts them from the
+ *   journal.
+ *
+ *   The supervisor also keeps the descriptors a new BARSM cannot recreate on
+ *   its own without going through the boot sequence again: the AACM
+ *   connections. BARSM sends them over a socket pair once they are set up and
+ *   a new BARSM inherits them across the fork.
+ *
+ *   Signals to stop BARSM are forwarded to the running BARSM and the
+ *   supervisor exits with BARSM's exit status. A BARSM that keeps crashing is
+ *   not restarted for ever: after SUPERVISOR_MAX_CRASHES crashes within
+ *   SUPERVISOR_WINDOW_MS every child is killed and the supervisor gives up.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
+
+#include "barsm_timer.h"
+#include "barsm_journal.h"
+#include "barsm_supervisor.h"
+
+/****************
+* PRIVATE GLOBALS
+****************/
+/* descriptors kept by the supervisor, inherited by every BARSM it forks */
+static int32_t kept[KEEP_MAX] = { -1, -1 };
+/* BARSM's end of the socket pair, -1 when running unsupervised */
+static int32_t keepSocket = -1;
+static volatile sig_atomic_t workerPid = 0;
+static volatile sig_atomic_t stopRequested = 0;
+
+/****************
+* PRIVATE FUNCTION PROTOTYPES
+****************/
+static void forward_signal(int sig);
+static void receive_kept(int32_t sock);
+
+
+
+/**
+ * Handler of the supervisor's stop signals, BARSM stops its children itself.
+ *
+ * @param[in] sig: the signal
+ *
+ * @return void
+ */
+void forward_signal(int sig)
+{
+    stopRequested = 1;
+    if ( 0 != workerPid )
+    {
+        kill((pid_t)workerPid, sig);
+    }
+}
+
+/**
+ * Takes every descriptor BARSM has sent to be kept. A descriptor replaces the
+ * one kept before it under the same tag.
+ *
+ * @param[in] sock: the supervisor's end of the socket pair
+ *
+ * @return void
+ */
+void receive_kept(int32_t sock)
+{
+    int32_t tag;
+    int32_t fd;
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    char control[CMSG_SPACE(sizeof(int32_t))];
+
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = &tag;
+    iov.iov_len = sizeof(tag);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    while ( (ssize_t)sizeof(tag) == recvmsg(sock, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC) )
+    {
+        cmsg = CMSG_FIRSTHDR(&msg);
+        if ( (NULL != cmsg) && (SCM_RIGHTS == cmsg->cmsg_type) )
+        {
+            memcpy(&fd, CMSG_DATA(cmsg), sizeof(fd));
+            if ( (0 <= tag) && (KEEP_MAX > tag) )
+            {
+                if ( 0 <= kept[tag] )
+                {
+                    close(kept[tag]);
+                }
+                kept[tag] = fd;
+            }
+            else
+            {
+                close(fd);
+            }
+        }
+
+        msg.msg_controllen = sizeof(control);
+    }
+}
+
+
+
+/**
+ * Turns the calling process into the supervisor. Returns only in the BARSM
+ * processes it forks, or straight away if BARSM has to run unsupervised; the
+ * supervisor itself exits once BARSM has.
+ *
+ * @param[in] void
+ *
+ * @return void
+ */
+void supervisor_run(void)
+{
+    bool supervised = (1 == BARSM_SUPERVISOR);
+    int32_t sv[2] = { -1, -1 };
+    int32_t status = 0;
+    int32_t numCrashes = 0;
+    uint64_t crashes[SUPERVISOR_MAX_CRASHES];
+    struct sigaction action;
+    pid_t pid;
+
+    if ( (true == supervised) && (0 != prctl(PR_SET_CHILD_SUBREAPER, 1, 0, 0, 0)) )
+    {
+        syslog(LOG_ERR, "%s:%d ERROR: prctl(PR_SET_CHILD_SUBREAPER) failed, running unsupervised! (%d:%s)",
+            __FUNCTION__, __LINE__, errno, strerror(errno));
+        supervised = false;
+    }
+
+    if ( (true == supervised) &&
+         ((true != journal_init()) || (0 != socketpair(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0, sv))) )
+    {
+        syslog(LOG_ERR, "%s:%d ERROR: no journal, running unsupervised! (%d:%s)",
+            __FUNCTION__, __LINE__, errno, strerror(errno));
+        supervised = false;
+    }
+
+    if ( true == supervised )
+    {
+        keepSocket = sv[1];
+
+        memset(&action, 0, sizeof(action));
+        action.sa_handler = forward_signal;
+        sigemptyset(&action.sa_mask);
+        sigaction(SIGTERM, &action, NULL);
+        sigaction(SIGINT, &action, NULL);
+
+        while ( true )
+        {
+            pid = fork();
+            if ( 0 == pid )
+            {
+                /* BARSM: its own signal handling is set up in main() */
+                action.sa_handler = SIG_DFL;
+                sigaction(SIGTERM, &action, NULL);
+                sigaction(SIGINT, &action, NULL);
+                close(sv[0]);
+                break;
+            }
+            else if ( -1 == pid )
+            {
+                syslog(LOG_ERR, "%s:%d ERROR: fork() failed! (%d:%s)",
+                    __FUNCTION__, __LINE__, errno, strerror(errno));
+                journal_killAll(SIGKILL);
+                exit(EXIT_FAILURE);
+            }
+            else
+            {
+                workerPid = pid;
+                syslog(LOG_NOTICE, "NOTICE: Supervisor started BARSM (PID %d)", pid);
+            }
+
+            /* children of a crashed BARSM are re-parented here, reap them
+             * until BARSM itself exits */
+            do
+            {
+                pid = waitpid(-1, &status, 0);
+            } while ( ((0 < pid) && (pid != (pid_t)workerPid)) || ((-1 == pid) && (EINTR == errno)) );
+
+            workerPid = 0;
+            receive_kept(sv[0]);
+
+            if ( (-1 == pid) || (true == WIFEXITED(status)) )
+            {
+                exit((-1 == pid) ? EXIT_FAILURE : WEXITSTATUS(status));
+            }
+
+            if ( 0 != stopRequested )
+            {
+                /* stopped before it had taken over the stop signals */
+                journal_killAll(SIGTERM);
+                exit(EXIT_FAILURE);
+            }
+
+            syslog(LOG_ERR, "ERROR: BARSM (PID %d) crashed on signal %d, restarting it",
+                pid, WTERMSIG(status));
+            printf("ERROR: BARSM (PID %d) crashed on signal %d, restarting it\n",
+                pid, WTERMSIG(status));
+
+            /* the oldest of the last SUPERVISOR_MAX_CRASHES crashes */
+            if ( (SUPERVISOR_MAX_CRASHES <= numCrashes) &&
+                 (timer_nowMs() - crashes[numCrashes % SUPERVISOR_MAX_CRASHES] < SUPERVISOR_WINDOW_MS) )
+            {
+                syslog(LOG_ERR, "ERROR: BARSM crashed %d times within %d ms, giving up!",
+                    SUPERVISOR_MAX_CRASHES, SUPERVISOR_WINDOW_MS);
+                journal_killAll(SIGKILL);
+                exit(EXIT_FAILURE);
+            }
+            crashes[numCrashes % SUPERVISOR_MAX_CRASHES] = timer_nowMs();
+            numCrashes++;
+
+            journal_restarted();
+        } /* while ( true ) */
+    } /* if ( true == supervised ) */
+} /* void supervisor_run(void) */
+
+/**
+ * Hands a descriptor to the supervisor, so that the next BARSM inherits it if
+ * this one crashes. Does nothing when running unsupervised.
+ *
+ * @param[in] tag: what the descriptor is
+ * @param[in] fd: the descriptor
+ *
+ * @return void
+ */
+void supervisor_keep(keep_tag tag, int32_t fd)
+{
+    int32_t msgTag = (int32_t)tag;
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    char control[CMSG_SPACE(sizeof(int32_t))];
+
+    if ( (0 <= keepSocket) && (0 <= fd) )
+    {
+        memset(&msg, 0, sizeof(msg));
+        memset(control, 0, sizeof(control));
+        iov.iov_base = &msgTag;
+        iov.iov_len = sizeof(msgTag);
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int32_t));
+        memcpy(CMSG_DATA(cmsg), &fd, sizeof(fd));
+
+        errno = 0;
+        if ( -1 == sendmsg(keepSocket, &msg, 0) )
+        {
+            syslog(LOG_ERR, "%s:%d ERROR: sendmsg() failed! (%d:%s)",
+                __FUNCTION__, __LINE__, errno, strerror(errno));
+        }
+    }
+}
+
+/**
+ * Returns a descriptor the supervisor kept from a BARSM that crashed.
+ *
+ * @param[in] tag: what the descriptor is
+ *
+ * @return the descriptor, -1 if none was kept
+ */
+int32_t supervisor_kept(keep_tag tag)
+{
+    return kept[tag];
+}
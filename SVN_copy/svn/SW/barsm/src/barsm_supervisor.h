@@ -0,0 +1,45 @@
+/** @file barsm_supervisor.h
+ * Supervisor process that restarts BARSM if it crashes, without taking down
+ * the modules/applications BARSM launched.
+ *
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ */
+
+#ifndef __BARSM_SUPERVISOR_H__
+#define __BARSM_SUPERVISOR_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/****************
+* CONSTANTS
+****************/
+/* Set to 0 to build a BARSM that runs without a supervisor */
+#ifndef BARSM_SUPERVISOR
+#define BARSM_SUPERVISOR        1
+#endif
+
+/* BARSM is given up on after this many crashes within the window */
+#define SUPERVISOR_MAX_CRASHES  5
+#define SUPERVISOR_WINDOW_MS    60000
+
+/****************
+* DATA TYPES
+****************/
+/* Descriptors the supervisor keeps for the next BARSM */
+enum keep_tag_enum
+{
+    KEEP_AACM_TCP = 0,
+    KEEP_AACM_UDP,
+    KEEP_MAX
+};
+typedef enum keep_tag_enum keep_tag;
+
+/****************
+* FUNCTION PROTOTYPES
+****************/
+void supervisor_run(void);
+void supervisor_keep(keep_tag tag, int32_t fd);
+int32_t supervisor_kept(keep_tag tag);
+
+#endif
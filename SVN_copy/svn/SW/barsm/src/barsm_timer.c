@@ -0,0 +1,282 @@
+/**
+ * File: barsm_timer.c
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ *
+ * Description:
+ *   This file contains the timer wheel BARSM uses to schedule deferred work,
+ *   such as delayed restarts, without blocking its event loop. Timers hash into
+ *   a fixed ring of slots by their expiry tick, so arming and cancelling are
+ *   O(1) and each tick only looks at the timers in one slot. The event loop
+ *   uses timer_nextTimeout() as its epoll_wait() timeout and calls
+ *   timer_advance() every time it wakes up.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+#include "barsm_timer.h"
+
+/****************
+* PRIVATE FUNCTION PROTOTYPES
+****************/
+static void slot_insert(timer_wheel *wheel, timer_entry *entry);
+static void slot_remove(timer_wheel *wheel, timer_entry *entry);
+
+
+
+/**
+ * Links a timer into the slot of its expiry tick.
+ *
+ * @param[in] wheel: the timer wheel
+ * @param[in] entry: the timer to link, expires must already be set
+ *
+ * @return void
+ */
+void slot_insert(timer_wheel *wheel, timer_entry *entry)
+{
+    timer_entry **slot = &wheel->slots[entry->expires & (TIMER_SLOTS - 1)];
+
+    entry->prev = NULL;
+    entry->next = *slot;
+    if ( NULL != *slot )
+    {
+        (*slot)->prev = entry;
+    }
+    *slot = entry;
+}
+
+/**
+ * Unlinks a timer from the slot it is in.
+ *
+ * @param[in] wheel: the timer wheel
+ * @param[in] entry: the timer to unlink
+ *
+ * @return void
+ */
+void slot_remove(timer_wheel *wheel, timer_entry *entry)
+{
+    if ( NULL != entry->prev )
+    {
+        entry->prev->next = entry->next;
+    }
+    else
+    {
+        wheel->slots[entry->expires & (TIMER_SLOTS - 1)] = entry->next;
+    }
+
+    if ( NULL != entry->next )
+    {
+        entry->next->prev = entry->prev;
+    }
+
+    entry->next = NULL;
+    entry->prev = NULL;
+}
+
+
+
+/**
+ * Reads the monotonic clock.
+ *
+ * @param[in] void
+ *
+ * @return the current CLOCK_MONOTONIC time in milliseconds
+ */
+uint64_t timer_nowMs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return ((uint64_t)now.tv_sec * 1000u) + ((uint64_t)now.tv_nsec / 1000000u);
+}
+
+/**
+ * Empties the timer wheel and starts it at the current time.
+ *
+ * @param[in] wheel: the timer wheel
+ *
+ * @return void
+ */
+void timer_init(timer_wheel *wheel)
+{
+    int32_t i;
+
+    for ( i = 0; i < TIMER_SLOTS; i++ )
+    {
+        wheel->slots[i] = NULL;
+    }
+
+    wheel->current = timer_nowMs() / TIMER_TICK_MS;
+    wheel->num_armed = 0;
+}
+
+/**
+ * Prepares a timer before its first use.
+ *
+ * @param[in] entry: the timer
+ * @param[in] callback: the function called when the timer fires
+ * @param[in] arg: passed to callback
+ *
+ * @return void
+ */
+void timer_setup(timer_entry *entry, timer_callback callback, void *arg)
+{
+    entry->next = NULL;
+    entry->prev = NULL;
+    entry->expires = 0;
+    entry->armed = false;
+    entry->callback = callback;
+    entry->arg = arg;
+}
+
+/**
+ * Arms a timer to fire delay_ms from now, re-arming it if it was already
+ * pending. The delay is rounded up to the next tick.
+ *
+ * @param[in] wheel: the timer wheel
+ * @param[in] entry: the timer
+ * @param[in] delay_ms: how long from now the timer should fire
+ *
+ * @return void
+ */
+void timer_add(timer_wheel *wheel, timer_entry *entry, uint32_t delay_ms)
+{
+    uint64_t now = timer_nowMs();
+
+    timer_cancel(wheel, entry);
+
+    entry->expires = (now + delay_ms + TIMER_TICK_MS - 1) / TIMER_TICK_MS;
+    /* the current tick was already processed, so the earliest a timer can
+     * fire is the next one */
+    if ( entry->expires <= wheel->current )
+    {
+        entry->expires = wheel->current + 1;
+    }
+
+    slot_insert(wheel, entry);
+    entry->armed = true;
+    wheel->num_armed++;
+}
+
+/**
+ * Disarms a timer. Cancelling a timer that is not armed does nothing.
+ *
+ * @param[in] wheel: the timer wheel
+ * @param[in] entry: the timer
+ *
+ * @return void
+ */
+void timer_cancel(timer_wheel *wheel, timer_entry *entry)
+{
+    if ( true == entry->armed )
+    {
+        slot_remove(wheel, entry);
+        entry->armed = false;
+        wheel->num_armed--;
+    }
+}
+
+/**
+ * Fires every timer whose tick has been reached. The callbacks may arm or
+ * cancel timers, including the one that fired.
+ *
+ * @param[in] wheel: the timer wheel
+ *
+ * @return void
+ */
+void timer_advance(timer_wheel *wheel)
+{
+    uint64_t target = timer_nowMs() / TIMER_TICK_MS;
+    uint64_t steps;
+    timer_entry *entry;
+    timer_entry *next;
+    timer_entry *expired = NULL;
+
+    /* after a long stall every slot is visited once, that is enough to find
+     * all the timers that are due */
+    steps = target - wheel->current;
+    if ( TIMER_SLOTS < steps )
+    {
+        steps = TIMER_SLOTS;
+    }
+
+    while ( (0 < steps) && (0 < wheel->num_armed) )
+    {
+        entry = wheel->slots[(wheel->current + steps) & (TIMER_SLOTS - 1)];
+        while ( NULL != entry )
+        {
+            next = entry->next;
+            if ( entry->expires <= target )
+            {
+                /* collect first so that the callbacks can touch the wheel */
+                slot_remove(wheel, entry);
+                entry->armed = false;
+                wheel->num_armed--;
+                entry->next = expired;
+                expired = entry;
+            }
+            entry = next;
+        }
+        steps--;
+    }
+
+    wheel->current = target;
+
+    while ( NULL != expired )
+    {
+        entry = expired;
+        expired = entry->next;
+        entry->next = NULL;
+        entry->callback(entry->arg);
+    }
+}
+
+/**
+ * Works out how long the event loop may sleep before the next timer is due.
+ *
+ * @param[in] wheel: the timer wheel
+ *
+ * @return timeout in milliseconds for epoll_wait(), -1 if no timer is armed
+ */
+int32_t timer_nextTimeout(timer_wheel *wheel)
+{
+    int32_t timeout = -1;
+    uint64_t now;
+    uint64_t tick;
+    uint64_t i;
+    timer_entry *entry;
+
+    if ( 0 < wheel->num_armed )
+    {
+        /* only timers within one turn of the wheel are looked for, anything
+         * further out just wakes the loop up once per turn */
+        tick = wheel->current + TIMER_SLOTS;
+        for ( i = 1; (i <= TIMER_SLOTS) && (tick == wheel->current + TIMER_SLOTS); i++ )
+        {
+            entry = wheel->slots[(wheel->current + i) & (TIMER_SLOTS - 1)];
+            while ( NULL != entry )
+            {
+                if ( entry->expires <= wheel->current + i )
+                {
+                    tick = wheel->current + i;
+                }
+                entry = entry->next;
+            }
+        }
+
+        now = timer_nowMs();
+        if ( (tick * TIMER_TICK_MS) <= now )
+        {
+            timeout = 0;
+        }
+        else
+        {
+            timeout = (int32_t)((tick * TIMER_TICK_MS) - now);
+        }
+    }
+
+    return timeout;
+}
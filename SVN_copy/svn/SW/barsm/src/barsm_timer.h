@@ -0,0 +1,58 @@
+/** @file barsm_timer.h
+ * Timer wheel used to run deferred work from the BARSM event loop.
+ *
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ */
+
+#ifndef __BARSM_TIMER_H__
+#define __BARSM_TIMER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/****************
+* CONSTANTS
+****************/
+/* Resolution of the wheel in milliseconds */
+#define TIMER_TICK_MS           10
+/* Number of slots, must be a power of 2. One turn covers 2.56 seconds, longer
+ * timers stay in their slot until the wheel reaches their tick. */
+#define TIMER_SLOTS             256
+
+/****************
+* DATA TYPES
+****************/
+typedef void (*timer_callback)(void *arg);
+
+/* Embedded in the object that owns the timer, so arming never allocates */
+struct timer_entry_struct
+{
+    struct timer_entry_struct *next;
+    struct timer_entry_struct *prev;
+    uint64_t expires;           /* absolute tick the timer fires on */
+    bool armed;
+    timer_callback callback;
+    void *arg;
+};
+typedef struct timer_entry_struct timer_entry;
+
+struct timer_wheel_struct
+{
+    timer_entry *slots[TIMER_SLOTS];
+    uint64_t current;           /* last tick that was processed */
+    int32_t num_armed;
+};
+typedef struct timer_wheel_struct timer_wheel;
+
+/****************
+* FUNCTION PROTOTYPES
+****************/
+uint64_t timer_nowMs(void);
+void timer_init(timer_wheel *wheel);
+void timer_setup(timer_entry *entry, timer_callback callback, void *arg);
+void timer_add(timer_wheel *wheel, timer_entry *entry, uint32_t delay_ms);
+void timer_cancel(timer_wheel *wheel, timer_entry *entry);
+void timer_advance(timer_wheel *wheel);
+int32_t timer_nextTimeout(timer_wheel *wheel);
+
+#endif
@@ -0,0 +1,169 @@
+/**
+ * File: barsm_watch.c
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ *
+ * Description:
+ *   This file contains the inotify watch BARSM keeps on the application/module
+ *   directories once the system is up, so that items can be installed, replaced
+ *   or removed in the field without restarting BARSM and everything under it.
+ *   The watch only reports which item changed; what to do about it is left to
+ *   the callback.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <syslog.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+#include "barsm_watch.h"
+
+/****************
+* PRIVATE FUNCTION PROTOTYPES
+****************/
+static bool item_present(const char *directory, const char *item);
+
+
+
+/**
+ * Checks whether an item is a regular file BARSM is able to execute.
+ *
+ * @param[in] directory: the directory of the item
+ * @param[in] item: the file name of the item
+ *
+ * @return true if the item can be launched
+ */
+bool item_present(const char *directory, const char *item)
+{
+    char path[PATH_MAX];
+    struct stat info;
+
+    snprintf(path, sizeof(path), "%s/%s", directory, item);
+
+    return (0 == stat(path, &info)) && (S_ISREG(info.st_mode)) &&
+           (0 == access(path, X_OK));
+}
+
+
+
+/**
+ * Creates the inotify descriptor and watches every directory on it. A
+ * directory that cannot be watched is logged and skipped.
+ *
+ * @param[in] set: the watch set
+ * @param[in] dirs: the directories to watch, they have to outlive the set
+ * @param[in] num_dirs: the number of directories, at most WATCH_MAX_DIRS
+ *
+ * @return true/false whether the inotify descriptor could be created
+ */
+bool watch_init(watch_set *set, const char *const dirs[], int32_t num_dirs)
+{
+    bool success = true;
+    int32_t i;
+
+    set->num_dirs = 0;
+
+    errno = 0;
+    set->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if ( -1 == set->fd )
+    {
+        syslog(LOG_ERR, "%s:%d ERROR: inotify_init1() failed! (%d: %s)",
+            __FUNCTION__, __LINE__, errno, strerror(errno));
+        success = false;
+    }
+
+    for ( i = 0; (i < num_dirs) && (i < WATCH_MAX_DIRS) && (true == success); i++ )
+    {
+        set->dirs[i] = dirs[i];
+
+        errno = 0;
+        set->wds[i] = inotify_add_watch(set->fd, dirs[i], WATCH_EVENTS | IN_ONLYDIR);
+        if ( -1 == set->wds[i] )
+        {
+            syslog(LOG_ERR, "%s:%d ERROR: unable to watch %s (%d: %s)",
+                __FUNCTION__, __LINE__, dirs[i], errno, strerror(errno));
+        }
+        set->num_dirs++;
+    }
+
+    return success;
+}
+
+/**
+ * Reads every pending inotify event and reports the items that changed.
+ * Dot files, such as the boot manifest, are not items and are skipped.
+ *
+ * @param[in] set: the watch set
+ * @param[in] callback: called once per changed item
+ *
+ * @return void
+ */
+void watch_read(watch_set *set, watch_callback callback)
+{
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    const struct inotify_event *event;
+    const char *directory;
+    ssize_t retBytes;
+    ssize_t offset;
+    bool present;
+    int32_t i;
+
+    errno = 0;
+    retBytes = read(set->fd, buf, sizeof(buf));
+    while ( 0 < retBytes )
+    {
+        for ( offset = 0; offset < retBytes;
+              offset += (ssize_t)(sizeof(struct inotify_event) + event->len) )
+        {
+            event = (const struct inotify_event *)&buf[offset];
+
+            if ( 0 != (event->mask & IN_Q_OVERFLOW) )
+            {
+                syslog(LOG_ERR, "%s:%d ERROR: inotify queue overflow, changes were missed!",
+                    __FUNCTION__, __LINE__);
+                continue;
+            }
+
+            directory = NULL;
+            for ( i = 0; (i < set->num_dirs) && (NULL == directory); i++ )
+            {
+                if ( event->wd == set->wds[i] )
+                {
+                    directory = set->dirs[i];
+                }
+            }
+
+            if ( (NULL == directory) || (0 == event->len) || ('.' == event->name[0]) )
+            {
+                continue;
+            }
+
+            if ( 0 != (event->mask & (IN_DELETE | IN_MOVED_FROM)) )
+            {
+                present = false;
+            }
+            else
+            {
+                present = item_present(directory, event->name);
+            }
+
+            syslog(LOG_DEBUG, "inotify 0x%x for %s/%s (%s)", event->mask, directory,
+                event->name, (true == present) ? "present" : "gone");
+            callback(directory, event->name, present, event->mask);
+        }
+
+        errno = 0;
+        retBytes = read(set->fd, buf, sizeof(buf));
+    }
+
+    if ( (-1 == retBytes) && (EAGAIN != errno) && (EWOULDBLOCK != errno) )
+    {
+        syslog(LOG_ERR, "%s:%d ERROR: reading inotify events failed! (%d: %s)",
+            __FUNCTION__, __LINE__, errno, strerror(errno));
+    }
+}
@@ -0,0 +1,48 @@
+/** @file barsm_watch.h
+ * inotify watch on the application/module directories.
+ *
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ */
+
+#ifndef __BARSM_WATCH_H__
+#define __BARSM_WATCH_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/inotify.h>
+
+/****************
+* CONSTANTS
+****************/
+#define WATCH_MAX_DIRS          8
+/* Events that can make an item appear or disappear. New items should be
+ * installed by writing them elsewhere and rename()ing them into place, which
+ * reports a single IN_MOVED_TO once the file is complete. */
+#define WATCH_EVENTS            (IN_CLOSE_WRITE | IN_MOVED_TO | IN_ATTRIB | \
+                                 IN_DELETE | IN_MOVED_FROM)
+
+/****************
+* DATA TYPES
+****************/
+/* Called for every change to an item of a watched directory. present tells
+ * whether the item is now there and executable, mask holds the inotify event
+ * that reported the change. */
+typedef void (*watch_callback)(const char *directory, const char *item,
+    bool present, uint32_t mask);
+
+struct watch_set_struct
+{
+    int32_t fd;                             /* the inotify descriptor */
+    int32_t num_dirs;
+    int32_t wds[WATCH_MAX_DIRS];            /* watch descriptor of each dir */
+    const char *dirs[WATCH_MAX_DIRS];
+};
+typedef struct watch_set_struct watch_set;
+
+/****************
+* FUNCTION PROTOTYPES
+****************/
+bool watch_init(watch_set *set, const char *const dirs[], int32_t num_dirs);
+void watch_read(watch_set *set, watch_callback callback);
+
+#endif
@@ -0,0 +1,825 @@
+/**
+ * File: barsm_zygote.c
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ *
+ * Description:
+ *   This file contains the zygote, a template process BARSM forks once and
+ *   then starts shared object items from. An item with a zygote= entry symbol
+ *   in its manifest is a shared object rather than a program. The zygote loads
+ *   it with dlopen() and resolves its entry symbol ahead of time, so starting
+ *   or restarting the item only costs a fork of the small zygote: there is no
+ *   exec, no dynamic linking and no loading of the libraries it needs.
+ *
+ *   BARSM sends the zygote the same request it would give spawn_process(),
+ *   with the readiness pipe, heartbeat counter, sockets and exec status pipe
+ *   passed over a SOCK_SEQPACKET socket pair. The zygote clones the child with
+ *   CLONE_PARENT, which makes it a child of BARSM rather than of the zygote:
+ *   its exit is reported on BARSM's SIGCHLD signalfd and handled like that of
+ *   any other item. The clone goes through glibc's clone() rather than the raw
+ *   system call, and needs a glibc that does not cache the PID (2.25 or
+ *   later), as the child runs the item without an exec. The child sets up its descriptors, scheduling and
+ *   environment as the exec backends do, closes the status pipe and calls
+ *   int entry(int argc, char *argv[]), whose return value is its exit status.
+ *
+ *   A shared object is loaded again if it was replaced since it was loaded. A
+ *   zygote that died or stopped answering is replaced by a new one the next
+ *   time it is needed.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <syslog.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <dlfcn.h>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/prctl.h>
+#include <sys/mman.h>
+
+#include "barsm_functions.h"
+#include "barsm_zygote.h"
+
+extern proc_table procTable;
+
+/* the child calls getpid() and friends without an exec, which only answer
+ * for the child once glibc stopped caching the PID */
+#ifdef __GLIBC__
+#if !__GLIBC_PREREQ(2, 25)
+#error "the zygote needs glibc 2.25 or later"
+#endif
+#endif
+
+/****************
+* PRIVATE CONSTANTS
+****************/
+/* How long BARSM waits for the zygote to answer a request */
+#define ZYGOTE_TIMEOUT_MS       2000
+/* Arguments of one child, NULL included */
+#define ZYGOTE_MAX_ARGS         8
+/* Descriptors sent with a request: the exec status pipe, the readiness pipe,
+ * the heartbeat counter, the cgroup and the sockets */
+#define ZYGOTE_MAX_FDS          (4 + SPAWN_MAX_LISTEN_FDS)
+/* The stack a child starts on, as large as a main thread's default stack */
+#define ZYGOTE_STACK_SIZE       (8 * 1024 * 1024)
+
+/****************
+* PRIVATE DATA TYPES
+****************/
+typedef int (*zygote_entry)(int argc, char *argv[]);
+
+/* The arguments are followed by the environment in strings, each string
+ * terminated by a NUL */
+struct zygote_request_struct
+{
+    char path[PATH_MAX];
+    char symbol[ZYGOTE_SYMBOL_MAX];
+    char strings[ZYGOTE_STRINGS_MAX];
+    int32_t argc;
+    int32_t envc;
+    bool has_sched;
+    spawn_sched sched;
+    bool has_ready;             /* a readiness pipe follows the status pipe */
+    bool has_heartbeat;         /* the heartbeat counter follows them */
+    bool has_cgroup;            /* then the cgroup the child joins */
+    int32_t num_listen;         /* the sockets come last */
+};
+typedef struct zygote_request_struct zygote_request;
+
+struct zygote_reply_struct
+{
+    int32_t rc;                 /* 0, or the errno the child was not started with */
+    pid_t pid;
+};
+typedef struct zygote_reply_struct zygote_reply;
+
+/* A shared object loaded in the zygote */
+struct zygote_lib_struct
+{
+    char path[PATH_MAX];
+    char symbol[ZYGOTE_SYMBOL_MAX];
+    dev_t dev;                  /* identify the file that was loaded, so that */
+    ino_t ino;                  /* a replacement is noticed */
+    struct timespec mtime;
+    void *handle;
+    zygote_entry entry;
+};
+typedef struct zygote_lib_struct zygote_lib;
+
+/* What run_child() is called with in a child started by clone() */
+struct zygote_child_struct
+{
+    int32_t sock;
+    const zygote_lib *lib;
+    zygote_request *request;
+    const int32_t *fds;
+};
+typedef struct zygote_child_struct zygote_child;
+
+/****************
+* PRIVATE GLOBALS
+****************/
+/* BARSM's end of the socket pair, -1 if no zygote is running */
+static int32_t zygoteSock = -1;
+static pid_t zygotePid = 0;
+/* what the zygote has loaded, only used in the zygote itself */
+static zygote_lib libs[ZYGOTE_MAX_LIBS];
+static int32_t numLibs = 0;
+/* the stack the children start on, mapped once in the zygote. Every child gets
+ * its own copy of it, as clone() is not given CLONE_VM */
+static uint8_t *childStack = NULL;
+
+/****************
+* PRIVATE FUNCTION PROTOTYPES
+****************/
+static void close_inherited(int32_t keep);
+static zygote_lib *load_lib(const char *path, const char *symbol);
+static void run_child(int32_t sock, const zygote_lib *lib, zygote_request *request,
+    const int32_t *fds);
+static int child_start(void *arg);
+static bool zygote_serve(int32_t sock);
+static void zygote_main(int32_t sock, proc_table *table);
+static void zygote_stop(void);
+static int32_t send_request(const zygote_request *request, const int32_t *fds,
+    int32_t numFds, zygote_reply *reply);
+
+
+
+/**
+ * Closes every descriptor the zygote inherited from BARSM, except for the
+ * standard ones and its end of the socket pair.
+ *
+ * @param[in] keep: the descriptor to keep open
+ *
+ * @return void
+ */
+void close_inherited(int32_t keep)
+{
+    DIR *dir;
+    struct dirent *entry;
+    int32_t fd;
+
+    dir = opendir("/proc/self/fd");
+    if ( NULL != dir )
+    {
+        entry = readdir(dir);
+        while ( NULL != entry )
+        {
+            fd = (int32_t)strtol(entry->d_name, NULL, 10);
+            if ( (2 < fd) && (keep != fd) && (dirfd(dir) != fd) )
+            {
+                close(fd);
+            }
+            entry = readdir(dir);
+        }
+        closedir(dir);
+    }
+}
+
+/**
+ * Loads a shared object and resolves its entry symbol, unless the same file is
+ * already loaded.
+ *
+ * @param[in] path: the shared object
+ * @param[in] symbol: the entry symbol
+ *
+ * @return the loaded shared object, NULL if it cannot be loaded
+ */
+zygote_lib *load_lib(const char *path, const char *symbol)
+{
+    zygote_lib *lib = NULL;
+    struct stat info;
+    void *sym;
+    int32_t i;
+
+    if ( (sizeof(libs[0].path) > strlen(path)) && (sizeof(libs[0].symbol) > strlen(symbol)) &&
+         (0 == stat(path, &info)) )
+    {
+        for ( i = 0; (i < numLibs) && (NULL == lib); i++ )
+        {
+            if ( (0 == strcmp(libs[i].path, path)) && (0 == strcmp(libs[i].symbol, symbol)) )
+            {
+                lib = &libs[i];
+            }
+        }
+
+        if ( (NULL != lib) &&
+             ((lib->dev != info.st_dev) || (lib->ino != info.st_ino) ||
+              (lib->mtime.tv_sec != info.st_mtim.tv_sec) ||
+              (lib->mtime.tv_nsec != info.st_mtim.tv_nsec)) )
+        {
+            /* replaced since it was loaded, the running children keep their
+             * own copy of the old one */
+            dlclose(lib->handle);
+            lib->handle = NULL;
+        }
+        else if ( (NULL == lib) && (ZYGOTE_MAX_LIBS > numLibs) )
+        {
+            lib = &libs[numLibs++];
+            strcpy(lib->path, path);
+            strcpy(lib->symbol, symbol);
+        }
+        else
+        {
+            /* already loaded, or no room for another one */
+        }
+    }
+
+    if ( (NULL != lib) && (NULL == lib->handle) )
+    {
+        lib->handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+        sym = (NULL != lib->handle) ? dlsym(lib->handle, symbol) : NULL;
+        if ( NULL == sym )
+        {
+            syslog(LOG_ERR, "%s:%d ERROR: unable to load %s in %s! (%s)",
+                __FUNCTION__, __LINE__, symbol, path, dlerror());
+            if ( NULL != lib->handle )
+            {
+                dlclose(lib->handle);
+                lib->handle = NULL;
+            }
+            lib = NULL;
+        }
+        else
+        {
+            /* ISO C has no conversion from an object pointer to a function
+             * pointer, dlsym() returns one anyway */
+            memcpy(&lib->entry, &sym, sizeof(lib->entry));
+            lib->dev = info.st_dev;
+            lib->ino = info.st_ino;
+            lib->mtime = info.st_mtim;
+        }
+    }
+
+    return lib;
+}
+
+/**
+ * Runs in a child of the zygote: applies the request like the exec backends do
+ * and calls the entry of the shared object. Never returns.
+ *
+ * @param[in] sock: the zygote's end of the socket pair
+ * @param[in] lib: the loaded shared object
+ * @param[in] request: the request the child was started for
+ * @param[in] fds: the status pipe, then the optional readiness pipe,
+ *      heartbeat counter, cgroup and sockets, all at least SPAWN_FD_MAX
+ *
+ * @return void
+ */
+void run_child(int32_t sock, const zygote_lib *lib, zygote_request *request,
+    const int32_t *fds)
+{
+    char *argv[ZYGOTE_MAX_ARGS];
+    char *string = request->strings;
+    int32_t numFds = 1;
+    int32_t exec_errno = 0;
+    int32_t i;
+
+    close(sock);
+
+    if ( true == request->has_ready )
+    {
+        dup2(fds[numFds++], SPAWN_READY_FD);
+    }
+    if ( true == request->has_heartbeat )
+    {
+        dup2(fds[numFds++], SPAWN_HEARTBEAT_FD);
+    }
+    if ( true == request->has_cgroup )
+    {
+        exec_errno = spawn_joinCgroup(fds[numFds++]);
+    }
+    for ( i = 0; i < request->num_listen; i++ )
+    {
+        dup2(fds[numFds++], SPAWN_LISTEN_FD + i);
+    }
+
+    /* an exec would have closed the originals, the item only keeps the copies
+     * above and the status pipe is closed last */
+    for ( i = 1; i < numFds; i++ )
+    {
+        close(fds[i]);
+    }
+
+    if ( (0 == exec_errno) && (true == request->has_sched) )
+    {
+        exec_errno = spawn_applySched(&request->sched);
+    }
+
+    if ( 0 == exec_errno )
+    {
+        for ( i = 0; i < request->argc; i++ )
+        {
+            argv[i] = string;
+            string += strlen(string) + 1;
+        }
+        argv[i] = NULL;
+
+        clearenv();
+        for ( i = 0; i < request->envc; i++ )
+        {
+            putenv(string);
+            string += strlen(string) + 1;
+        }
+
+        prctl(PR_SET_NAME, argv[0], 0, 0, 0);
+
+        /* closing the status pipe is what an exec would have done */
+        close(fds[0]);
+        exit(lib->entry(request->argc, argv));
+    }
+
+    if ( sizeof(exec_errno) != write(fds[0], &exec_errno, sizeof(exec_errno)) )
+    {
+        /* nothing else can be done, BARSM sees a short read */
+    }
+    _exit(127);
+}
+
+/**
+ * Entry point of a child started by clone(). Never returns.
+ *
+ * @param[in] arg: the zygote_child to call run_child() with
+ *
+ * @return never
+ */
+int child_start(void *arg)
+{
+    zygote_child *child = (zygote_child *)arg;
+
+    run_child(child->sock, child->lib, child->request, child->fds);
+
+    return 127;
+}
+
+/**
+ * Handles one request from BARSM.
+ *
+ * @param[in] sock: the zygote's end of the socket pair
+ *
+ * @return false once BARSM has closed its end
+ */
+bool zygote_serve(int32_t sock)
+{
+    static zygote_request request;
+    bool running = true;
+    zygote_reply reply;
+    zygote_lib *lib = NULL;
+    zygote_child child;
+    int32_t fds[ZYGOTE_MAX_FDS];
+    int32_t numFds = 0;
+    int32_t fd;
+    int32_t i;
+    ssize_t len;
+    pid_t pid;
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    char control[CMSG_SPACE(ZYGOTE_MAX_FDS * sizeof(int32_t))];
+
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = &request;
+    iov.iov_len = sizeof(request);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    len = recvmsg(sock, &msg, 0);
+    if ( 0 < len )
+    {
+        cmsg = CMSG_FIRSTHDR(&msg);
+        if ( (NULL != cmsg) && (SCM_RIGHTS == cmsg->cmsg_type) )
+        {
+            numFds = (int32_t)((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int32_t));
+            memcpy(fds, CMSG_DATA(cmsg), (size_t)numFds * sizeof(int32_t));
+        }
+
+        /* out of the way of the descriptors the child dup's them onto */
+        for ( i = 0; i < numFds; i++ )
+        {
+            fd = fcntl(fds[i], F_DUPFD_CLOEXEC, SPAWN_FD_MAX);
+            close(fds[i]);
+            fds[i] = fd;
+        }
+
+        reply.rc = 0;
+        reply.pid = 0;
+        if ( ((ssize_t)sizeof(request) != len) ||
+             (numFds != 1 + (int32_t)request.has_ready + (int32_t)request.has_heartbeat +
+                        (int32_t)request.has_cgroup + request.num_listen) )
+        {
+            reply.rc = EINVAL;
+        }
+        else
+        {
+            lib = load_lib(request.path, request.symbol);
+            reply.rc = (NULL != lib) ? 0 : ENOEXEC;
+        }
+        if ( (0 == reply.rc) && (NULL == childStack) )
+        {
+            reply.rc = ENOMEM;
+        }
+
+        if ( 0 == reply.rc )
+        {
+            /* the child is BARSM's, so BARSM gets its SIGCHLD and reaps it */
+            child.sock = sock;
+            child.lib = lib;
+            child.request = &request;
+            child.fds = fds;
+            pid = clone(child_start, childStack + ZYGOTE_STACK_SIZE,
+                CLONE_PARENT | SIGCHLD, &child);
+            if ( -1 == pid )
+            {
+                reply.rc = errno;
+            }
+            else
+            {
+                reply.pid = pid;
+            }
+        }
+
+        for ( i = 0; i < numFds; i++ )
+        {
+            close(fds[i]);
+        }
+
+        if ( sizeof(reply) != send(sock, &reply, sizeof(reply), MSG_NOSIGNAL) )
+        {
+            running = false;
+        }
+    }
+    else if ( (0 == len) || (EINTR != errno) )
+    {
+        running = false;
+    }
+    else
+    {
+        /* interrupted, wait for the request again */
+    }
+
+    return running;
+}
+
+/**
+ * Runs in the zygote: drops what it inherited from BARSM, loads the shared
+ * object items and serves BARSM's requests until BARSM goes away. Never
+ * returns.
+ *
+ * @param[in] sock: the zygote's end of the socket pair
+ * @param[in] table: the process table as it was when the zygote was forked
+ *
+ * @return void
+ */
+void zygote_main(int32_t sock, proc_table *table)
+{
+    sigset_t emptyMask;
+    int32_t i;
+
+    prctl(PR_SET_PDEATHSIG, SIGKILL, 0, 0, 0);
+    prctl(PR_SET_NAME, "barsm_zygote", 0, 0, 0);
+
+    /* the children inherit all of this, make it what an exec'd child gets */
+    sigemptyset(&emptyMask);
+    sigprocmask(SIG_SETMASK, &emptyMask, NULL);
+    signal(SIGCHLD, SIG_DFL);
+    signal(SIGPIPE, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    signal(SIGINT, SIG_DFL);
+
+    /* syslog's socket is closed with the rest, it is reopened on first use */
+    closelog();
+    close_inherited(sock);
+    openlog("barsm_zygote", LOG_CONS, LOG_LOCAL0);
+
+    childStack = (uint8_t *)mmap(NULL, ZYGOTE_STACK_SIZE, PROT_READ | PROT_WRITE,
+        MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+    if ( MAP_FAILED == childStack )
+    {
+        syslog(LOG_ERR, "%s:%d ERROR: unable to map the child stack! (%d:%s)",
+            __FUNCTION__, __LINE__, errno, strerror(errno));
+        childStack = NULL;
+    }
+
+    for ( i = 0; i < table->num_nodes; i++ )
+    {
+        if ( (NULL != table->nodes[i].zygote) && (downPermanently != table->nodes[i].alive) )
+        {
+            load_lib(table->nodes[i].dir, table->nodes[i].zygote);
+        }
+    }
+
+    while ( true == zygote_serve(sock) )
+    {
+    }
+
+    _exit(0);
+}
+
+/**
+ * Kills a zygote that does not answer, a new one is started when needed.
+ *
+ * @param[in] void
+ *
+ * @return void
+ */
+void zygote_stop(void)
+{
+    if ( 0 <= zygoteSock )
+    {
+        syslog(LOG_ERR, "%s:%d ERROR: zygote (PID %d) lost, replacing it",
+            __FUNCTION__, __LINE__, zygotePid);
+        kill(zygotePid, SIGKILL);
+        close(zygoteSock);
+        zygoteSock = -1;
+        zygotePid = 0;
+    }
+}
+
+/**
+ * Sends one request to the zygote and waits for its reply.
+ *
+ * @param[in] request: the request
+ * @param[in] fds: the descriptors to pass with it
+ * @param[in] numFds: the number of descriptors
+ * @param[out] reply: the reply
+ *
+ * @return 0, or the errno of a failure to talk to the zygote
+ */
+int32_t send_request(const zygote_request *request, const int32_t *fds,
+    int32_t numFds, zygote_reply *reply)
+{
+    int32_t rc = 0;
+    struct msghdr msg;
+    struct iovec iov;
+    struct cmsghdr *cmsg;
+    char control[CMSG_SPACE(ZYGOTE_MAX_FDS * sizeof(int32_t))];
+    ssize_t len;
+
+    memset(&msg, 0, sizeof(msg));
+    memset(control, 0, sizeof(control));
+    iov.iov_base = (void *)(uintptr_t)request;
+    iov.iov_len = sizeof(*request);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = CMSG_SPACE((size_t)numFds * sizeof(int32_t));
+
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN((size_t)numFds * sizeof(int32_t));
+    memcpy(CMSG_DATA(cmsg), fds, (size_t)numFds * sizeof(int32_t));
+
+    errno = 0;
+    if ( -1 == sendmsg(zygoteSock, &msg, MSG_NOSIGNAL) )
+    {
+        rc = errno;
+    }
+
+    if ( 0 == rc )
+    {
+        do
+        {
+            errno = 0;
+            len = recv(zygoteSock, reply, sizeof(*reply), 0);
+        } while ( (-1 == len) && (EINTR == errno) );
+
+        if ( sizeof(*reply) != len )
+        {
+            rc = (0 != errno) ? errno : EPIPE;
+        }
+    }
+
+    return rc;
+}
+
+
+
+/**
+ * Forks the zygote if any item of the process table is started from it and it
+ * is not running yet.
+ *
+ * @param[in] table: the process table
+ *
+ * @return true/false whether the zygote is running or not needed
+ */
+bool zygote_start(proc_table *table)
+{
+    bool success = true;
+    bool needed = false;
+    int32_t sv[2];
+    int32_t i;
+    struct timeval timeout;
+    pid_t pid;
+
+    for ( i = 0; (i < table->num_nodes) && (false == needed); i++ )
+    {
+        needed = (NULL != table->nodes[i].zygote);
+    }
+
+    if ( (true == needed) && (-1 == zygoteSock) )
+    {
+        errno = 0;
+        if ( 0 != socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) )
+        {
+            syslog(LOG_ERR, "%s:%d ERROR: socketpair() failed! (%d:%s)",
+                __FUNCTION__, __LINE__, errno, strerror(errno));
+            success = false;
+        }
+
+        if ( true == success )
+        {
+            /* whatever is buffered would be written again by every child */
+            fflush(NULL);
+
+            pid = fork();
+            if ( 0 == pid )
+            {
+                close(sv[0]);
+                zygote_main(sv[1], table);
+            }
+            else if ( -1 == pid )
+            {
+                syslog(LOG_ERR, "%s:%d ERROR: fork() failed! (%d:%s)",
+                    __FUNCTION__, __LINE__, errno, strerror(errno));
+                close(sv[0]);
+                close(sv[1]);
+                success = false;
+            }
+            else
+            {
+                close(sv[1]);
+                zygoteSock = sv[0];
+                zygotePid = pid;
+
+                timeout.tv_sec = ZYGOTE_TIMEOUT_MS / 1000;
+                timeout.tv_usec = (ZYGOTE_TIMEOUT_MS % 1000) * 1000;
+                setsockopt(zygoteSock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+                syslog(LOG_NOTICE, "SUCCESS: zygote started with PID %d", pid);
+                printf("SUCCESS: zygote started with PID %d\n", pid);
+            }
+        }
+    }
+
+    return success;
+}
+
+/**
+ * Starts a shared object item from the zygote. Takes the same request as
+ * spawn_process() and returns the same way as its fork() backend: the child
+ * has not necessarily called the entry yet, which is confirmed with
+ * spawn_confirm().
+ *
+ * @param[in] req: what to start, path being the shared object
+ * @param[in] symbol: the entry symbol
+ * @param[out] pid: the PID of the child, 0 if there is no child
+ * @param[out] status_fd: -1, or a descriptor to pass to spawn_confirm()
+ *
+ * @return 0 on success, otherwise the errno of the failure
+ */
+int32_t zygote_spawn(const spawn_request *req, const char *symbol, pid_t *pid,
+    int32_t *status_fd)
+{
+    static zygote_request request;
+    int32_t rc = 0;
+    int32_t attempt;
+    int32_t fds[ZYGOTE_MAX_FDS];
+    int32_t numFds = 1;
+    int32_t status_pipe[2] = { -1, -1 };
+    char *const *envp = (NULL != req->envp) ? req->envp : environ;
+    size_t used = 0;
+    size_t len;
+    int32_t i;
+    zygote_reply reply;
+
+    *pid = 0;
+    *status_fd = -1;
+
+    memset(&request, 0, sizeof(request));
+    if ( (sizeof(request.path) <= strlen(req->path)) ||
+         (sizeof(request.symbol) <= strlen(symbol)) )
+    {
+        rc = ENAMETOOLONG;
+    }
+    else
+    {
+        strcpy(request.path, req->path);
+        strcpy(request.symbol, symbol);
+    }
+
+    for ( i = 0; (0 == rc) && (NULL != req->argv[i]); i++ )
+    {
+        len = strlen(req->argv[i]) + 1;
+        if ( (ZYGOTE_MAX_ARGS - 1 <= i) || (sizeof(request.strings) - used < len) )
+        {
+            rc = E2BIG;
+        }
+        else
+        {
+            memcpy(&request.strings[used], req->argv[i], len);
+            used += len;
+            request.argc++;
+        }
+    }
+    for ( i = 0; (0 == rc) && (NULL != envp[i]); i++ )
+    {
+        len = strlen(envp[i]) + 1;
+        if ( sizeof(request.strings) - used < len )
+        {
+            rc = E2BIG;
+        }
+        else
+        {
+            memcpy(&request.strings[used], envp[i], len);
+            used += len;
+            request.envc++;
+        }
+    }
+
+    if ( NULL != req->sched )
+    {
+        request.has_sched = true;
+        request.sched = *req->sched;
+    }
+
+    errno = 0;
+    if ( (0 == rc) && (0 != pipe2(status_pipe, O_CLOEXEC)) )
+    {
+        rc = errno;
+    }
+
+    if ( 0 == rc )
+    {
+        fds[0] = status_pipe[1];
+        if ( 0 <= req->ready_fd )
+        {
+            request.has_ready = true;
+            fds[numFds++] = req->ready_fd;
+        }
+        if ( 0 <= req->heartbeat_fd )
+        {
+            request.has_heartbeat = true;
+            fds[numFds++] = req->heartbeat_fd;
+        }
+        if ( 0 <= req->cgroup_fd )
+        {
+            request.has_cgroup = true;
+            fds[numFds++] = req->cgroup_fd;
+        }
+        request.num_listen = req->num_listen_fds;
+        for ( i = 0; i < req->num_listen_fds; i++ )
+        {
+            fds[numFds++] = req->listen_fds[i];
+        }
+
+        /* a zygote that died since the last request is replaced once */
+        rc = EPIPE;
+        for ( attempt = 0; (attempt < 2) && (EPIPE == rc); attempt++ )
+        {
+            rc = (true == zygote_start(&procTable)) ? 0 : EAGAIN;
+            if ( (0 == rc) && (-1 == zygoteSock) )
+            {
+                rc = ENOEXEC;
+            }
+            if ( 0 == rc )
+            {
+                rc = send_request(&request, fds, numFds, &reply);
+                if ( 0 != rc )
+                {
+                    zygote_stop();
+                    rc = EPIPE;
+                }
+                else
+                {
+                    rc = reply.rc;
+                }
+            }
+        }
+
+        close(status_pipe[1]);
+        if ( 0 == rc )
+        {
+            *pid = reply.pid;
+            *status_fd = status_pipe[0];
+        }
+        else
+        {
+            close(status_pipe[0]);
+        }
+    }
+
+    return rc;
+}
@@ -0,0 +1,34 @@
+/** @file barsm_zygote.h
+ * Pre-forked template process that starts shared object items without an exec.
+ *
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ */
+
+#ifndef __BARSM_ZYGOTE_H__
+#define __BARSM_ZYGOTE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include "barsm_proctable.h"
+#include "barsm_spawn.h"
+
+/****************
+* CONSTANTS
+****************/
+/* Longest entry symbol, and room for the arguments and environment of one
+ * child, in a request to the zygote */
+#define ZYGOTE_SYMBOL_MAX       64
+#define ZYGOTE_STRINGS_MAX      4096
+/* Number of shared objects the zygote keeps loaded */
+#define ZYGOTE_MAX_LIBS         32
+
+/****************
+* FUNCTION PROTOTYPES
+****************/
+bool zygote_start(proc_table *table);
+int32_t zygote_spawn(const spawn_request *req, const char *symbol, pid_t *pid,
+    int32_t *status_fd);
+
+#endif
@@ -0,0 +1,286 @@
+/**
+ * File: barsmstat.c
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ *
+ * Description:
+ *   Queries the supervision metrics of a running BARSM, see barsm_metrics.c.
+ *   By default the binary reply is decoded into a table of the children, a
+ *   table of what their last processes used and the two latency histograms. -t prints BARSM's own text dump instead, one
+ *   line per histogram and per child for scripts, and -b writes the binary
+ *   reply to stdout as it is.
+ *
+ *   Usage: barsmstat [-t | -b] [socket]
+ *   Default socket: METRICS_SOCKET_PATH
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include "barsm_metrics.h"
+
+/* How long to wait for BARSM to answer */
+#define QUERY_TIMEOUT_MS        1000
+
+/****************
+* PRIVATE GLOBALS
+****************/
+static uint8_t reply[METRICS_REPLY_MAX];
+
+/****************
+* PRIVATE FUNCTION PROTOTYPES
+****************/
+static ssize_t query(const char *path, uint8_t request);
+static void print_histogram(const char *name, const uint32_t *buckets, uint16_t numBuckets);
+static void print_status(int32_t status, uint32_t exits);
+static bool print_binary(size_t len);
+
+
+
+/**
+ * Sends one query to BARSM and waits for the reply.
+ *
+ * @param[in] path: the metrics socket of BARSM
+ * @param[in] request: METRICS_QUERY_BINARY or METRICS_QUERY_TEXT
+ *
+ * @return the size of the reply in reply, -1 on failure
+ */
+ssize_t query(const char *path, uint8_t request)
+{
+    ssize_t len = -1;
+    int32_t fd;
+    sa_family_t family = AF_UNIX;
+    struct sockaddr_un addr;
+    struct timeval timeout = { QUERY_TIMEOUT_MS / 1000, (QUERY_TIMEOUT_MS % 1000) * 1000 };
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+    /* binding just the family autobinds an abstract address BARSM can
+     * answer to */
+    fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+    if ( (0 <= fd) &&
+         (0 == bind(fd, (struct sockaddr *)&family, sizeof(family))) &&
+         (0 == setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout))) &&
+         (1 == sendto(fd, &request, sizeof(request), 0, (struct sockaddr *)&addr, sizeof(addr))) )
+    {
+        len = recv(fd, reply, sizeof(reply), 0);
+    }
+
+    if ( -1 == len )
+    {
+        fprintf(stderr, "ERROR: no reply from BARSM on %s (%d:%s)\n",
+            path, errno, strerror(errno));
+    }
+
+    if ( 0 <= fd )
+    {
+        close(fd);
+    }
+
+    return len;
+}
+
+/**
+ * Prints the non-empty buckets of a histogram, with the count and mean of
+ * its samples.
+ *
+ * @param[in] name: label for the output
+ * @param[in] buckets: the bucket counts
+ * @param[in] numBuckets: the number of buckets
+ *
+ * @return void
+ */
+void print_histogram(const char *name, const uint32_t *buckets, uint16_t numBuckets)
+{
+    uint32_t total = 0;
+    uint16_t b;
+
+    for ( b = 0; b < numBuckets; b++ )
+    {
+        total += buckets[b];
+    }
+
+    printf("%s: %u samples\n", name, total);
+    for ( b = 0; b < numBuckets; b++ )
+    {
+        if ( 0 == buckets[b] )
+        {
+            /* only the buckets with samples */
+        }
+        else if ( b + 1 == numBuckets )
+        {
+            printf("  >= %10llu us %8u\n", 1ull << (b - 1), buckets[b]);
+        }
+        else
+        {
+            printf("  <  %10llu us %8u\n", 1ull << b, buckets[b]);
+        }
+    }
+}
+
+/**
+ * Prints how the last process of a child exited.
+ *
+ * @param[in] status: its waitpid() status
+ * @param[in] exits: how many processes of the child exited
+ *
+ * @return void
+ */
+void print_status(int32_t status, uint32_t exits)
+{
+    char text[16];
+
+    if ( 0 == exits )
+    {
+        snprintf(text, sizeof(text), "-");
+    }
+    else if ( -1 == status )
+    {
+        snprintf(text, sizeof(text), "adopted");
+    }
+    else if ( WIFEXITED(status) )
+    {
+        snprintf(text, sizeof(text), "exit %d", WEXITSTATUS(status));
+    }
+    else if ( WIFSIGNALED(status) )
+    {
+        snprintf(text, sizeof(text), "signal %d", WTERMSIG(status));
+    }
+    else
+    {
+        snprintf(text, sizeof(text), "0x%x", (uint32_t)status);
+    }
+
+    printf(" %-10s", text);
+}
+
+/**
+ * Decodes and prints a binary reply.
+ *
+ * @param[in] len: the size of the reply
+ *
+ * @return true/false whether the reply was valid
+ */
+bool print_binary(size_t len)
+{
+    bool success = true;
+    metrics_header header;
+    metrics_child child;
+    uint16_t i;
+
+    memcpy(&header, reply, (sizeof(header) <= len) ? sizeof(header) : len);
+    if ( (sizeof(header) > len) || (METRICS_MAGIC != header.magic) ||
+         (METRICS_VERSION != header.version) || (METRICS_HISTOGRAMS != header.num_histograms) ||
+         (METRICS_BUCKETS != header.num_buckets) ||
+         (sizeof(header) + (header.num_children * sizeof(child)) > len) )
+    {
+        fprintf(stderr, "ERROR: unexpected reply of %zu bytes\n", len);
+        success = false;
+    }
+
+    if ( true == success )
+    {
+        printf("BARSM up %llu.%03llu s\n\n",
+            (unsigned long long)(header.uptime_ms / 1000u),
+            (unsigned long long)(header.uptime_ms % 1000u));
+        printf("%-4s %-16s %7s %5s %8s %8s %5s %-10s %10s\n",
+            "NAME", "ITEM", "PID", "ALIVE", "LAUNCHES", "RESTARTS", "EXITS",
+            "LAST EXIT", "READY us");
+
+        for ( i = 0; i < header.num_children; i++ )
+        {
+            memcpy(&child, &reply[sizeof(header) + (i * sizeof(child))], sizeof(child));
+            printf("%-4.*s %-16.*s %7d %5d %8u %8u %5u",
+                PROC_NAME_LEN, child.proc_name, METRICS_ITEM_LEN, child.item,
+                child.pid, child.alive, child.launches, child.restarts, child.exits);
+            print_status(child.last_status, child.exits);
+            printf(" %10u\n", child.last_ready_us);
+        }
+
+        printf("\n%-4s %9s %9s %9s %9s %9s %9s %9s %4s\n",
+            "NAME", "USER ms", "SYS ms", "RSS kB", "VCSW", "IVCSW", "CG CPU ms",
+            "PEAK kB", "OOM");
+        for ( i = 0; i < header.num_children; i++ )
+        {
+            memcpy(&child, &reply[sizeof(header) + (i * sizeof(child))], sizeof(child));
+            printf("%-4.*s %9u %9u %9u %9u %9u %9u %9u %4u\n",
+                PROC_NAME_LEN, child.proc_name, child.user_ms, child.system_ms,
+                child.max_rss_kb, child.voluntary_cs, child.involuntary_cs,
+                child.cgroup_cpu_ms, child.memory_peak_kb, child.oom_kills);
+        }
+
+        printf("\n");
+        print_histogram("launch to ready", header.histograms[METRICS_LAUNCH_READY],
+                        header.num_buckets);
+        print_histogram("AACM round trip", header.histograms[METRICS_AACM_RTT],
+                        header.num_buckets);
+    }
+
+    return success;
+}
+
+/**
+ * Queries BARSM and prints the reply.
+ *
+ * @param[in] argc: number of arguments
+ * @param[in] argv: [-t | -b] [socket]
+ *
+ * @return 0 on success, 1 on failure
+ */
+int main(int argc, char *argv[])
+{
+    bool success = true;
+    uint8_t request = METRICS_QUERY_BINARY;
+    bool raw = false;
+    const char *path = METRICS_SOCKET_PATH;
+    ssize_t len;
+    int32_t opt;
+
+    while ( -1 != (opt = getopt(argc, argv, "tb")) )
+    {
+        if ( 't' == opt )
+        {
+            request = METRICS_QUERY_TEXT;
+        }
+        else if ( 'b' == opt )
+        {
+            raw = true;
+        }
+        else
+        {
+            fprintf(stderr, "Usage: %s [-t | -b] [socket]\n", argv[0]);
+            success = false;
+        }
+    }
+    if ( optind < argc )
+    {
+        path = argv[optind];
+    }
+
+    len = (true == success) ? query(path, request) : -1;
+    if ( 0 > len )
+    {
+        success = false;
+    }
+    else if ( (METRICS_QUERY_TEXT == request) || (true == raw) )
+    {
+        success = ((size_t)len == fwrite(reply, 1, (size_t)len, stdout));
+    }
+    else
+    {
+        success = print_binary((size_t)len);
+    }
+
+    return (true == success) ? 0 : 1;
+}
@@ -12,6 +12,7 @@
 #define __FDL_H__
 #include <time.h>
 #include <sys/socket.h>
+#include "publish_wheel.h"
 
 /****************
 * GLOBALS
@@ -27,7 +28,7 @@
 
 #define UNUSED(x) (x)__attribute__((unused))
                                                 // MILLSECONDS
-#define MINPER                                  1000    // using this for now, while each MP must have the same PERIOD
+#define MINPER                                  1000    // an MP carries one sample per whole MINPER of its period
 #define MINPER_PFP_VALUE                        1000
 #define MINPER_PTLT_TEMPERATURE                 1000
 #define MINPER_PTRT_TEMPERATURE                 1000
@@ -57,6 +58,8 @@
 #define MAX_fdl_TO_PUBLISH                      14
 #define MAX_fdl_SUBSCRIPTION                    10  //24   sending 14, subscribing for 10
 #define MAX_TIMESTAMPS                          9    
+#define PUBLISH_HDR_SIZE                        14      // CMD_ID, LENGTH, TOPIC_ID, NUM_MPS, SEQ_NUM
+#define PUBLISHBUFSIZE                          8192    // largest PUBLISH, buildPublishData() keeps topics within it
 
 #define HO_REAL                                 0
 #define HO_IMAG                                 1
@@ -76,6 +79,11 @@ typedef struct
     uint32_t numSamples;
     bool logical;
     bool valid;
+    bool due;                   // goes out with the next publish of its topic
+    wheelEntry schedule;        // valid MPs are scheduled on their period
+    int32_t **source;           // FDL data of the MP, real part at first, imaginary part next
+    uint32_t first;
+    float (*encode)(int32_t realVal, int32_t imagVal);
 } MPinfo;
 
 //SUBSCRIBE TOPIC INFO
@@ -86,7 +94,8 @@ typedef struct
     uint32_t period;
     uint32_t numMPs;
     MPinfo *topicSubscription;
-    bool publishReady;
+    bool publishReady;          // some MP is due, the topic is on the ready list
+    int32_t nextReady;          // next topic on the ready list, -1 at the end
 } topicToPublish;
 
 extern topicToPublish *publishMe;
@@ -132,9 +141,6 @@ extern int32_t fromSubAckTopicID;
 extern uint32_t num_topics_total;
 extern uint32_t num_topics_atCurrentRate;
 extern uint32_t currentTopic;
-extern int32_t maxPublishPeriod; 
-extern int32_t prevPeriodChk;
-extern int32_t nextPublishPeriod;
 
 extern char fdlAppName[];
 extern pid_t fdlPid;
@@ -245,11 +251,19 @@ enum topicIDs
 };
 
 
+// set by BARSM for a process it watches for liveness, see liveness_init()
+#define LIVENESS_FD_ENV     "RC360_HEARTBEAT_FD"
+
+// set by BARSM for a process it created sockets for, see UDPsetup()
+#define LISTEN_FDS_ENV      "RC360_LISTEN_FDS"
+#define LISTEN_FD_START     5
+
+// set by BARSM when AACM listens on an AF_UNIX socket instead of TCP, see AACMsetup()
+#define AACM_SOCKET_ENV     "RC360_AACM_SOCKET"
+
 /****************
 * PRIVATE FUNCTION PROTOTYPES
 ****************/
-int32_t getVarPeriod(void); 
-
 // at boot API processing
 bool process_registerApp( int32_t csocket , struct timespec goTime );
 bool process_registerApp_ack(int32_t csocket );
@@ -265,16 +279,23 @@ bool process_getPublish( int32_t csocket );
 
 // run-time API processing
 void process_sendPublish( int32_t csocket , struct sockaddr_in addr_in , int32_t topic_to_pub );
+int32_t serializePublish( int32_t topic_to_pub , uint8_t *sendData );
 bool process_getSubscribe( int32_t csocket );
 bool process_sendSubscribe_ack( int32_t csocket );
 bool process_HeartBeat( int32_t csocket, int32_t HeartBeat );
 bool numSecondsHaveElapsed( struct timespec startTime , struct timespec stopTime , int32_t numSeconds );
+bool compilePublishPlan( MPinfo *mpInfo );
 bool buildPublishData(void);
 int32_t getTopicId(uint32_t subAppName);
 int32_t publishManager(void);
+int32_t nextReadyTopic(void);
+uint32_t publishIdleTicks(uint32_t limit);
+bool liveness_init(void);
+void liveness_beat(void);
 
 float getAmplitude(int32_t realVal, int32_t imagVal);
 float getPhase(int32_t realVal, int32_t imagVal);
 float getPower(float amplitude);
+float getEnergy(int32_t realVal, int32_t imagVal);
 
 #endif
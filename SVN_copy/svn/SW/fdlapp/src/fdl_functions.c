@@ -25,7 +25,9 @@
 #include <syslog.h>
 #include <unistd.h>
 #include <stdint.h>
+#include <stddef.h>
 #include <math.h>
+#include <sys/mman.h>
 #include "fdl.h"
 
 
@@ -34,6 +36,9 @@
 ****************/
 #define MAXBUFSIZE  1000
 
+// this process's counter on the BARSM heartbeat page, NULL if not watched
+static volatile uint64_t *livenessCounter = NULL;
+
 extern int32_t clientSocket;
 struct sockaddr_storage serverStorage_UDP;
 struct sockaddr_storage toRcvUDP;
@@ -50,11 +55,44 @@ int32_t src_app_name;
 uint32_t num_topics_total = 0;
 uint32_t num_topics_atCurrentRate;
 uint32_t currentTopic = 0;
-int32_t maxPublishPeriod;
-int32_t prevPeriodChk;
-int32_t nextPublishPeriod;
 int32_t fromSubAckTopicID;
 
+// when the valid MPs are due, and the topics with due MPs in the order they
+// became ready.  Both belong to pubMutex
+static publishWheel publishSchedule;
+static int32_t firstReadyTopic = -1;
+static int32_t lastReadyTopic = -1;
+
+// what every MP the FDL publishes is computed from: the FDLinfo array holding
+// its real and imaginary parts and the function combining them.
+// buildPublishData() copies the entry of each subscribed MP into its MPinfo
+// so a publish computes the value without looking the MP up again
+typedef struct
+{
+    uint32_t mp;
+    size_t field;               // offsetof the array in FDLinfo
+    uint32_t first;
+    float (*encode)(int32_t realVal, int32_t imagVal);
+} publishPlanEntry;
+
+static const publishPlanEntry publishPlan[] =
+{
+    { MP_COP_HALFORDER_AMPLITUDE        , offsetof(FDLinfo, cop)    , HO_REAL       , getAmplitude },
+    { MP_COP_HALFORDER_ENERGY           , offsetof(FDLinfo, cop)    , HO_REAL       , getEnergy },
+    { MP_COP_HALFORDER_PHASE            , offsetof(FDLinfo, cop)    , HO_REAL       , getPhase },
+    { MP_COP_FIRSTORDER_AMPLITUDE       , offsetof(FDLinfo, cop)    , FO_REAL       , getAmplitude },
+    { MP_COP_FIRSTORDER_ENERGY          , offsetof(FDLinfo, cop)    , FO_REAL       , getEnergy },
+    { MP_COP_FIRSTORDER_PHASE           , offsetof(FDLinfo, cop)    , FO_REAL       , getPhase },
+    { MP_CRANK_HALFORDER_AMPLITUDE      , offsetof(FDLinfo, crank)  , HO_REAL       , getAmplitude },
+    { MP_CRANK_HALFORDER_ENERGY         , offsetof(FDLinfo, crank)  , HO_REAL       , getEnergy },
+    { MP_CRANK_HALFORDER_PHASE          , offsetof(FDLinfo, crank)  , HO_REAL       , getPhase },
+    { MP_CRANK_FIRSTORDER_AMPLITUDE     , offsetof(FDLinfo, crank)  , FO_REAL       , getAmplitude },
+    { MP_CRANK_FIRSTORDER_ENERGY        , offsetof(FDLinfo, crank)  , FO_REAL       , getEnergy },
+    { MP_CRANK_FIRSTORDER_PHASE         , offsetof(FDLinfo, crank)  , FO_REAL       , getPhase },
+    { MP_TURBO_OIL_FIRSTORDER_AMPLITUDE , offsetof(FDLinfo, turbo)  , TURBO_REAL    , getAmplitude },
+    { MP_TURBO_OIL_FIRSTORDER_ENERGY    , offsetof(FDLinfo, turbo)  , TURBO_REAL    , getEnergy },
+};
+
 
 /**
  * Used to package data to be sent for registering the
@@ -932,6 +970,40 @@ bool process_sysInit( int32_t csocket )
  * @return void
  */
 void process_sendPublish( int32_t csocket , struct sockaddr_in addr_in , int32_t topic_to_pub )
+{
+    uint8_t sendData[ PUBLISHBUFSIZE ];
+    socklen_t toSendUDP_size;
+
+    int32_t cntBytes    = 0;
+    int32_t sendBytes   = 0;
+
+    printf("FROM PROCESS PUBLISH, publishMe[ %d ].numMPs: %d\n", topic_to_pub, publishMe[ topic_to_pub ].numMPs);
+    cntBytes = serializePublish( topic_to_pub , sendData );
+
+    toSendUDP_size = sizeof(addr_in);
+    sendBytes = sendto(csocket, sendData, cntBytes, 0, (struct sockaddr *)&addr_in, toSendUDP_size);
+    printf("FROM PUBLISH, sendBytes: %d\n", sendBytes);
+
+    if ( cntBytes != sendBytes )
+    {
+        printf("ERROR! PUBLISH: sent bytes don't equal message size\n");
+        syslog(LOG_ERR, "%s:%d ERROR! insufficient message data %u != %u", __FUNCTION__, __LINE__, sendBytes, cntBytes);
+    }
+}
+
+/**
+ * Builds the publish message of a topic from the MPs that are due, and
+ * clears their due flag.  Each MP computes its value once from the real and
+ * imaginary parts its publish plan points at, see compilePublishPlan(), and
+ * repeats it for every sample.
+ *
+ * @param[in] topic_to_pub topic id (per subscription) to
+ *       publish
+ * @param[out] sendData message, PUBLISHBUFSIZE bytes
+ *
+ * @return number of bytes of the message
+ */
+int32_t serializePublish( int32_t topic_to_pub , uint8_t *sendData )
 {
     enum publish_params
     {
@@ -942,43 +1014,20 @@ void process_sendPublish( int32_t csocket , struct sockaddr_in addr_in , int32_t
         SEQ_NUM                 = 2,
         MP                      = 4,
         MP_VAL                  = 4,
-        MSG_SIZE                =   CMD_ID +
-                                    LENGTH +
-                                    TOPIC_ID +
-                                    NUM_MPS +
-                                    SEQ_NUM +
-                                    5*(MP + MP_VAL),
     };
 
-    float copAmplitudeHO = 0;
-    float copPhaseHO = 0;
-    float copPowerHO = 0;
-    float copAmplitudeFO = 0;
-    float copPhaseFO = 0;
-    float copPowerFO = 0;
-
-    float crankAmplitudeHO = 0;
-    float crankPhaseHO = 0;
-    float crankPowerHO = 0;
-    float crankAmplitudeFO = 0;
-    float crankPhaseFO = 0;
-    float crankPowerFO = 0;
-
-    float turboAmplitudeFO = 0;
-    float turboPowerFO = 0;
-
+    MPinfo *mpInfo;
+    const int32_t *parts;
+    float value;
     uint8_t *ptr;
     int16_t val16;
     int32_t val32;
     uint8_t *msgLenPtr;
-    uint8_t sendData[ MAXBUFSIZE ];
     uint16_t actualLength = 0;
-    socklen_t toSendUDP_size;
 
     uint32_t i          = 0;
     uint32_t j          = 0;
     int32_t cntBytes    = 0;
-    int32_t sendBytes   = 0;
 
     ptr = sendData;
     val16 = CMD_PUBLISH;
@@ -995,7 +1044,15 @@ void process_sendPublish( int32_t csocket , struct sockaddr_in addr_in , int32_t
     ptr += TOPIC_ID;
     cntBytes += TOPIC_ID;
 
-    val32 = publishMe[ topic_to_pub ].numMPs;
+    // only the MPs that are due go out
+    val32 = 0;
+    for( i = 0 ; i < publishMe[ topic_to_pub ].numMPs ; i++ )
+    {
+        if (true == publishMe[ topic_to_pub ].topicSubscription[ i ].due)
+        {
+            val32++;
+        }
+    }
     memcpy(ptr, &val32, sizeof(val32));
     ptr += NUM_MPS;
     cntBytes += NUM_MPS;
@@ -1005,107 +1062,34 @@ void process_sendPublish( int32_t csocket , struct sockaddr_in addr_in , int32_t
     ptr += SEQ_NUM;
     cntBytes += SEQ_NUM;
 
-    printf("FROM PROCESS PUBLISH, publishMe[ %d ].numMPs: %d\n", topic_to_pub, publishMe[ topic_to_pub ].numMPs);
     for( i = 0 ; i < publishMe[ topic_to_pub ].numMPs ; i++ )
     {
-        val32 = publishMe[ topic_to_pub ].topicSubscription[ i ].mp;
-        memcpy(ptr, &val32, sizeof(val32));
-        ptr += MP;
-        cntBytes += MP;
-        for ( j = 0 ; j < publishMe[ topic_to_pub ].topicSubscription[ i ].numSamples ; j++ )
+        mpInfo = &publishMe[ topic_to_pub ].topicSubscription[ i ];
+        if (true == mpInfo->due)
         {
-            // logicals
-            if (publishMe[ topic_to_pub ].topicSubscription[ i ].mp == MP_COP_HALFORDER_AMPLITUDE )
-            {
-                copAmplitudeHO = getAmplitude(recvFDL[0].cop[0], recvFDL[0].cop[1]);
-                memcpy(ptr, &copAmplitudeHO, sizeof(copAmplitudeHO));
-            }
-            else if (publishMe[ topic_to_pub ].topicSubscription[ i ].mp == MP_COP_HALFORDER_ENERGY )
-            {
-                copPowerHO  = getPower(copAmplitudeHO);
-                memcpy(ptr, &copPowerHO, sizeof(copPowerHO));
-            }
-            else if (publishMe[ topic_to_pub ].topicSubscription[ i ].mp == MP_COP_HALFORDER_PHASE )
-            {
-                copPhaseHO = getPhase(recvFDL[0].cop[0], recvFDL[0].cop[1]);
-                memcpy(ptr, &copPhaseHO, sizeof(copPhaseHO));
-            }
-            else if (publishMe[ topic_to_pub ].topicSubscription[ i ].mp == MP_COP_FIRSTORDER_AMPLITUDE )
-            {
-                copAmplitudeFO = getAmplitude(recvFDL[0].cop[2], recvFDL[0].cop[3]);
-                memcpy(ptr, &copAmplitudeFO, sizeof(copAmplitudeFO));
-            }
-            else if (publishMe[ topic_to_pub ].topicSubscription[ i ].mp == MP_COP_FIRSTORDER_ENERGY )
-            {
-                copPowerFO = getPower(copAmplitudeFO);
-                memcpy(ptr, &copPowerFO, sizeof(copPowerFO));
-            }
-            else if (publishMe[ topic_to_pub ].topicSubscription[ i ].mp == MP_COP_FIRSTORDER_PHASE )
-            {
-                copPhaseFO = getPhase(recvFDL[0].cop[2], recvFDL[0].cop[3]);
-                memcpy(ptr, &copPhaseFO, sizeof(copPhaseFO));
-            }
-            if (publishMe[ topic_to_pub ].topicSubscription[ i ].mp == MP_CRANK_HALFORDER_AMPLITUDE )
-            {
-                crankAmplitudeHO = getAmplitude(recvFDL[0].crank[0], recvFDL[0].crank[1]);
-                memcpy(ptr, &crankAmplitudeHO, sizeof(crankAmplitudeHO));
-            }
-            else if (publishMe[ topic_to_pub ].topicSubscription[ i ].mp == MP_CRANK_HALFORDER_ENERGY )
-            {
-                crankPowerHO = getPower(crankAmplitudeHO);
-                memcpy(ptr, &crankPowerHO, sizeof(crankPowerHO));
-            }
-            else if (publishMe[ topic_to_pub ].topicSubscription[ i ].mp == MP_CRANK_HALFORDER_PHASE )
-            {
-                crankPhaseHO = getPhase(recvFDL[0].crank[0], recvFDL[0].crank[1]);
-                memcpy(ptr, &crankPhaseHO, sizeof(crankPhaseHO));
-            }
-            else if (publishMe[ topic_to_pub ].topicSubscription[ i ].mp == MP_CRANK_FIRSTORDER_AMPLITUDE )
-            {
-                crankAmplitudeFO = getAmplitude(recvFDL[0].crank[2], recvFDL[0].crank[3]);
-                memcpy(ptr, &crankAmplitudeFO, sizeof(crankAmplitudeFO));
-            }
-            else if (publishMe[ topic_to_pub ].topicSubscription[ i ].mp == MP_CRANK_FIRSTORDER_ENERGY )
-            {
-                crankPowerFO = getPower(crankAmplitudeFO);
-                memcpy(ptr, &crankPowerFO, sizeof(crankPowerFO));
-            }
-            else if (publishMe[ topic_to_pub ].topicSubscription[ i ].mp == MP_CRANK_FIRSTORDER_PHASE )
-            {
-                crankPhaseFO = getPhase(recvFDL[0].crank[2], recvFDL[0].crank[3]);
-                memcpy(ptr, &crankPhaseFO, sizeof(crankPhaseFO));
-            }
-            else if (publishMe[ topic_to_pub ].topicSubscription[ i ].mp == MP_TURBO_OIL_FIRSTORDER_AMPLITUDE )
-            {
-                turboAmplitudeFO = getAmplitude(recvFDL[0].turbo[0], recvFDL[0].turbo[1]);
-                memcpy(ptr, &turboAmplitudeFO, sizeof(turboAmplitudeFO));
-            }
-            else if (publishMe[ topic_to_pub ].topicSubscription[ i ].mp == MP_TURBO_OIL_FIRSTORDER_ENERGY )
+            mpInfo->due = false;
+
+            val32 = mpInfo->mp;
+            memcpy(ptr, &val32, sizeof(val32));
+            ptr += MP;
+            cntBytes += MP;
+
+            parts = *mpInfo->source + mpInfo->first;
+            value = mpInfo->encode( parts[ 0 ] , parts[ 1 ] );
+            for ( j = 0 ; j < mpInfo->numSamples ; j++ )
             {
-                turboPowerFO = getPower(turboAmplitudeFO);
-                memcpy(ptr, &turboPowerFO, sizeof(turboPowerFO));
+                memcpy(ptr, &value, MP_VAL);
+                ptr += MP_VAL;
             }
-            ptr += MP_VAL;
-            cntBytes += MP_VAL;
+            cntBytes += mpInfo->numSamples * MP_VAL;
         }
     }
-    *ptr = cntBytes;
-    ptr += cntBytes;
-
 
     // actual length
     actualLength = cntBytes - CMD_ID - LENGTH;
     memcpy( msgLenPtr , &actualLength , sizeof(uint16_t) );
 
-    toSendUDP_size = sizeof(addr_in);
-    sendBytes = sendto(csocket, sendData, cntBytes, 0, (struct sockaddr *)&addr_in, toSendUDP_size);
-    printf("FROM PUBLISH, sendBytes: %d\n", sendBytes);
-
-    if ( cntBytes != sendBytes )
-    {
-        printf("ERROR! PUBLISH: sent bytes don't equal message size\n");
-        syslog(LOG_ERR, "%s:%d ERROR! insufficient message data %u != %u", __FUNCTION__, __LINE__, sendBytes, cntBytes);
-    }
+    return cntBytes;
 }
 
 
@@ -1865,6 +1849,39 @@ bool process_HeartBeat( int32_t csocket, int32_t HeartBeat )
 }
 
 
+/**
+ * Looks up the FDL data and the computation an MP is published from and
+ * stores them in the MP, so serializePublish() produces its value without
+ * dispatching on the MP.
+ *
+ * @param[in] mpInfo subscribed MP, mp set
+ * @param[out] mpInfo source, first and encode set when the FDL publishes the MP
+ *
+ * @return true if the FDL publishes the MP, false otherwise
+ */
+bool compilePublishPlan( MPinfo *mpInfo )
+{
+    bool success = false;
+    uint32_t i;
+
+    mpInfo->source  = NULL;
+    mpInfo->first   = 0;
+    mpInfo->encode  = NULL;
+
+    for( i = 0 ; (i < sizeof(publishPlan)/sizeof(publishPlan[0])) && (false == success) ; i++ )
+    {
+        if ( publishPlan[ i ].mp == mpInfo->mp )
+        {
+            mpInfo->source  = (int32_t **)((uint8_t *)&recvFDL[0] + publishPlan[ i ].field);
+            mpInfo->first   = publishPlan[ i ].first;
+            mpInfo->encode  = publishPlan[ i ].encode;
+            success = true;
+        }
+    }
+
+    return success;
+}
+
 /**
  * This set of data (publishMe) is built based on the
  * current subscription.  After a SUBSCRIBE() and before
@@ -1882,27 +1899,10 @@ bool buildPublishData(void)
     bool success = true;
     uint32_t i;
     uint32_t  k;
-    int32_t periodVar;
-    int32_t numMPsMatching;
-    int32_t numSamplesToChk, remainder;
-
-    uint32_t fdlsubscriptionMP[ MAX_fdl_TO_PUBLISH ] =
-    {
-        MP_COP_HALFORDER_AMPLITUDE,
-        MP_COP_HALFORDER_ENERGY,
-        MP_COP_HALFORDER_PHASE,
-        MP_COP_FIRSTORDER_AMPLITUDE,
-        MP_COP_FIRSTORDER_ENERGY,
-        MP_COP_FIRSTORDER_PHASE,
-        MP_CRANK_HALFORDER_AMPLITUDE,
-        MP_CRANK_HALFORDER_ENERGY,
-        MP_CRANK_HALFORDER_PHASE,
-        MP_CRANK_FIRSTORDER_AMPLITUDE,
-        MP_CRANK_FIRSTORDER_ENERGY,
-        MP_CRANK_FIRSTORDER_PHASE,
-        MP_TURBO_OIL_FIRSTORDER_AMPLITUDE,
-        MP_TURBO_OIL_FIRSTORDER_ENERGY
-    };
+    bool schedulable;
+    int32_t numSamplesToChk;
+    uint32_t mpSize;
+    uint32_t publishSize = PUBLISH_HDR_SIZE;
 
     // for new topic/subscription
     publishMe = realloc(publishMe, sizeof(topicToPublish)*num_topics_total);
@@ -1917,6 +1917,7 @@ bool buildPublishData(void)
         publishMe[ currentTopic ].app_name     = src_app_name;
         publishMe[ currentTopic ].numMPs       = MPnum;
         publishMe[ currentTopic ].publishReady = false;
+        publishMe[ currentTopic ].nextReady    = -1;
 
         // for MPs
         publishMe[ currentTopic ].topicSubscription = malloc(sizeof(MPinfo)*publishMe[ currentTopic ].numMPs);
@@ -1949,6 +1950,7 @@ bool buildPublishData(void)
             publishMe[ currentTopic ].topicSubscription[ k ].period         = sub_mpPer[ k ];
             publishMe[ currentTopic ].topicSubscription[ k ].numSamples     = sub_mpNumSamples[ k ];
             publishMe[ currentTopic ].topicSubscription[ k ].valid          = false;
+            publishMe[ currentTopic ].topicSubscription[ k ].due            = false;
 
             if (    (publishMe[ currentTopic ].topicSubscription[ k ].mp == MP_COP_HO_REAL )    ||
                 (publishMe[ currentTopic ].topicSubscription[ k ].mp == MP_COP_HO_IMAG )    ||
@@ -1990,150 +1992,99 @@ bool buildPublishData(void)
     {
         for( k = 0 ; (k < publishMe[ currentTopic ].numMPs) && (true == success) ; k++ )
         {
-            numMPsMatching = 0;
-            for( i = 0 ; i < MAX_fdl_TO_PUBLISH ; i++ )
+            schedulable = compilePublishPlan( &publishMe[ currentTopic ].topicSubscription[ k ] );
+            mpSize = sizeof(uint32_t) * (1 + publishMe[ currentTopic ].topicSubscription[ k ].numSamples);
+
+            // checks numer of samples requested based on period requested: one per whole MINPER, at least one.
+            numSamplesToChk = publishMe[currentTopic].topicSubscription[k].period / MINPER;
+            if ( 0 == numSamplesToChk )
             {
-                if( fdlsubscriptionMP[ i ] == publishMe[ currentTopic ].topicSubscription[ k ].mp )
-                {
-                    numMPsMatching++;
-                }
+                numSamplesToChk = 1;
             }
-#if 0
-                    syslog(LOG_DEBUG, "%s:%d sub[%d][%d] (%d) match %d found at index %d",
-                           __FUNCTION__, __LINE__, currentTopic, k,
-                           fdlsubscriptionMP[i], numMPsMatching, i);
-#endif            
-
-            // checks numer of samples requested based on period requested and whatever the minimum period is configured.
-            numSamplesToChk = publishMe[currentTopic].topicSubscription[k].numSamples * MINPER;
-            remainder = publishMe[currentTopic].topicSubscription[k].period % MINPER;
 
 #if 0
-            syslog(LOG_DEBUG, "%s:%d sub[%d][%d] samples %d * %d = %d ?= period %d (remainder %d)",
+            syslog(LOG_DEBUG, "%s:%d sub[%d][%d] samples %d ?= %d for period %d",
                    __FUNCTION__, __LINE__, currentTopic, k,
-                   publishMe[currentTopic].topicSubscription[k].numSamples, MINPER, numSamplesToChk,
-                   publishMe[currentTopic].topicSubscription[k].period, remainder);
+                   publishMe[currentTopic].topicSubscription[k].numSamples, numSamplesToChk,
+                   publishMe[currentTopic].topicSubscription[k].period);
 #endif
 
-            if ( 0 == remainder )
+            if ( WHEEL_TICK_MS > publishMe[currentTopic].topicSubscription[k].period )
             {
-                if ( numSamplesToChk != publishMe[currentTopic].topicSubscription[k].period )
-                {
-                    printf("INVALID SUBSCRIPTION: MP number of samples doesn't correspond to the period requested \n");
-                    syslog(LOG_ERR, "%s:%d INVALID SUBSCRIPTION: sub[%d][%d] MP %d: invalid period %d * %d != %d",
-                           __FUNCTION__, __LINE__, currentTopic, k,
-                           publishMe[currentTopic].topicSubscription[k].mp,
-                           publishMe[currentTopic].topicSubscription[k].numSamples, MINPER,
-                           publishMe[currentTopic].topicSubscription[k].period);
-                    numSamplesToChk = 0;
-                }
+                printf("INVALID SUBSCRIPTION: MP PERIOD shorter than the minimum period allowed \n");
+                syslog(LOG_ERR, "%s:%d INVALID SUBSCRIPTION: sub[%d][%d] MP %d: invalid period %d < %d",
+                       __FUNCTION__, __LINE__, currentTopic, k,
+                       publishMe[currentTopic].topicSubscription[k].mp,
+                       publishMe[currentTopic].topicSubscription[k].period, WHEEL_TICK_MS);
+                numSamplesToChk = 0;
             }
-            else
+            else if ( (uint32_t)numSamplesToChk != publishMe[currentTopic].topicSubscription[k].numSamples )
             {
-                printf("INVALID SUBSCRIPTION: MP PERIOD not integer multiple of minimum period allowed \n");
-                syslog(LOG_ERR, "%s:%d INVALID SUBSCRIPTION: sub[%d][%d] MP %d: invalid period %d %% %d != 0",
+                printf("INVALID SUBSCRIPTION: MP number of samples doesn't correspond to the period requested \n");
+                syslog(LOG_ERR, "%s:%d INVALID SUBSCRIPTION: sub[%d][%d] MP %d: invalid samples %d != %d for period %d",
                        __FUNCTION__, __LINE__, currentTopic, k,
                        publishMe[currentTopic].topicSubscription[k].mp,
-                       publishMe[currentTopic].topicSubscription[k].period, MINPER);
+                       publishMe[currentTopic].topicSubscription[k].numSamples, numSamplesToChk,
+                       publishMe[currentTopic].topicSubscription[k].period);
+                numSamplesToChk = 0;
+            }
+            else if ( (true == schedulable) && (PUBLISHBUFSIZE < publishSize + mpSize) )
+            {
+                printf("INVALID SUBSCRIPTION: MP doesn't fit in the publish of its topic \n");
+                syslog(LOG_ERR, "%s:%d INVALID SUBSCRIPTION: sub[%d][%d] MP %d: publish size %u > %d",
+                       __FUNCTION__, __LINE__, currentTopic, k,
+                       publishMe[currentTopic].topicSubscription[k].mp,
+                       publishSize + mpSize, PUBLISHBUFSIZE);
                 numSamplesToChk = 0;
             }
 
-            // determines valid and invalid MPs based on (1) if MP is schedulable and (2) number of samples and period
-            if ( ( 0 == numMPsMatching ) || ( 0 == numSamplesToChk ) )
+            // determines valid and invalid MPs based on (1) if MP is schedulable, (2) number of samples and period
+            // and (3) room left in the publish
+            if ( ( false == schedulable ) || ( 0 == numSamplesToChk ) )
             {
                 publishMe[ currentTopic ].topicSubscription[ k ].valid = false;
             }
             else
             {
                 publishMe[ currentTopic ].topicSubscription[ k ].valid = true;
+                publishSize += mpSize;
             }
         } /* for( k = 0 ; (k < publishMe[ currentTopic ].numMPs) && (true == success) ; k++ ) */
 
-        periodVar = getVarPeriod();
-
+        // every valid MP is published on its own period, MPs of the topic that
+        // are due at the same tick go out in the same publish
+        publishMe[ currentTopic ].period    = 0;
+        publishMe[ currentTopic ].topic_id  = -1;
         for( i = 0 ; i < publishMe[currentTopic].numMPs ; i++ )
         {
-            if ( (0 == periodVar) ) // all periods the same?
+            if ( true == publishMe[ currentTopic ].topicSubscription[ i ].valid )
             {
-                publishMe[ currentTopic ].period = publishMe[ currentTopic ].topicSubscription[ 0 ].period;
                 publishMe[ currentTopic ].topic_id  = 1000 + currentTopic; // + getTopicId( publishMe[ currentTopic ].app_name );
 
-                // determine max publish period
-                if (publishMe[ currentTopic ].topicSubscription[ 0 ].period > prevPeriodChk)
+                // the topic period is the shortest one of its MPs
+                if ( (0 == publishMe[ currentTopic ].period) ||
+                     ((uint32_t)publishMe[ currentTopic ].topicSubscription[ i ].period < publishMe[ currentTopic ].period) )
                 {
-                    maxPublishPeriod = publishMe[ currentTopic ].topicSubscription[ 0 ].period;
+                    publishMe[ currentTopic ].period = publishMe[ currentTopic ].topicSubscription[ i ].period;
                 }
 
-                // set all 1 sec publish periods to true for "ready to publish"
-                if (1000 == publishMe[ currentTopic ].topicSubscription[ 0 ].period )
-                {
-                    publishMe[ currentTopic ].publishReady = true;
-                }
-                else
-                {
-                    publishMe[ currentTopic ].publishReady = false;
-                }
-            }
-            else
-            {
-                printf("ERROR! when building publish data - invalid subscription \n");
-                publishMe[ currentTopic ].topicSubscription[ i ].valid = false;
-                syslog(LOG_ERR, "%s:%d INVALID SUBSCRIPTION",__FUNCTION__, __LINE__);
-                publishMe[ currentTopic ].period    = 0;
-                publishMe[ currentTopic ].topic_id  = -1;
+                publishMe[ currentTopic ].topicSubscription[ i ].schedule.topic  = currentTopic;
+                publishMe[ currentTopic ].topicSubscription[ i ].schedule.mp     = i;
+                publishMe[ currentTopic ].topicSubscription[ i ].schedule.period = publishMe[ currentTopic ].topicSubscription[ i ].period / WHEEL_TICK_MS;
+                wheel_add( &publishSchedule , &publishMe[ currentTopic ].topicSubscription[ i ].schedule );
             }
         }
 
-        prevPeriodChk  = publishMe[ currentTopic ].topicSubscription[ 0 ].period;
+        if ( 0 == publishMe[ currentTopic ].period )
+        {
+            printf("ERROR! when building publish data - invalid subscription \n");
+            syslog(LOG_ERR, "%s:%d INVALID SUBSCRIPTION",__FUNCTION__, __LINE__);
+        }
     } /* if (true == success) */
 
     return success;
 }
 
-/**
- * Used to determine variance of subscribed periods.  Since they
- * should be the same, variance should equal 0.
- *
- *
- * @param[in] void
- * @param[out] var variance of subscribed periods
- *
- * @return variance of subscribed periods
- */
-int32_t getVarPeriod(void)
-{
-    uint32_t i;
-    int32_t avg;
-    int32_t sum;
-    int32_t var;
-    int32_t diff;
-    int32_t sq_diff;
-
-    avg = 0;
-    sum = 0;
-    var = 0;
-    diff = 0;
-    sq_diff = 0;
-
-    for( i = 0 ; i < publishMe[currentTopic].numMPs ; i++ )
-    {
-        sum = sum + publishMe[ currentTopic ].topicSubscription[ i ].period;
-    }
-
-    avg = sum / publishMe[currentTopic].numMPs;
-
-    for( i = 0 ; i < publishMe[currentTopic].numMPs ; i++ )
-    {
-        diff    = publishMe[ currentTopic ].topicSubscription[ i ].period - avg;
-        sq_diff = diff * diff;
-        var     = var + sq_diff;
-    }
-
-    var = var / ( publishMe[currentTopic].numMPs - 1 );
-    return var;
-}
-
-
 /**
  * Determines if numSeconds have elapsed.  If numSeconds have
  * elapsed, success is true.  Else, success if false.
@@ -2220,45 +2171,97 @@ int32_t getTopicId(uint32_t subAppName)
 }
 
 /**
- * Returns number of topics to publish during next 1 second
- * interval.  Flags the next set of available topics to publish.
+ * Advances the publish schedule by one tick of WHEEL_TICK_MS.  Flags
+ * the MPs that are due at the new tick and puts their topics on the
+ * ready list, see nextReadyTopic().  Costs the same however many
+ * topics are subscribed.
  *
  * @param[in] void
- * @param[out] numToPub Returns number of topics to publish
- * during next 1 second interval.
+ * @param[out] numToPub Returns number of topics that became ready
  *
- * @return Returns number of topics to publish during next 1 second
- * interval.
+ * @return Returns number of topics that became ready
  */
 int32_t publishManager(void)
 {
-    // determines next group of subscriptions to publish based on next possible time to publish (every second)
-    // publishMe holds the subscription data to publish
-
     int32_t numToPub = 0;
-    uint32_t i;
+    wheelEntry *entry;
+    wheelEntry *next;
 
-    // only happens once.
-    if ( 0 == nextPublishPeriod )
+    entry = wheel_tick( &publishSchedule );
+    while ( NULL != entry )
     {
-        nextPublishPeriod = 1000;
-    }
-
+        next = entry->next;
 
-    for( i = 0 ; i < num_topics_total ; i++ )
-    {
-        if ( (0 != publishMe[i].period) && (( nextPublishPeriod % publishMe[i].period ) == 0) )
+        publishMe[ entry->topic ].topicSubscription[ entry->mp ].due = true;
+        if ( false == publishMe[ entry->topic ].publishReady )
         {
-            publishMe[i].publishReady = true;
+            publishMe[ entry->topic ].publishReady = true;
+            publishMe[ entry->topic ].nextReady = -1;
+            if ( -1 == lastReadyTopic )
+            {
+                firstReadyTopic = entry->topic;
+            }
+            else
+            {
+                publishMe[ lastReadyTopic ].nextReady = entry->topic;
+            }
+            lastReadyTopic = entry->topic;
             numToPub++;
         }
-        else
+
+        // this tick is its expiration, so the next one stays on its grid
+        wheel_add( &publishSchedule , entry );
+        entry = next;
+    }
+
+    return numToPub;
+}
+
+/**
+ * Takes the next topic off the ready list.  Its due MPs are cleared
+ * by process_sendPublish().
+ *
+ * @param[in] void
+ * @param[out] topic index into publishMe, -1 when no topic is ready
+ *
+ * @return index into publishMe, -1 when no topic is ready
+ */
+int32_t nextReadyTopic(void)
+{
+    int32_t topic = firstReadyTopic;
+
+    if ( -1 != topic )
+    {
+        firstReadyTopic = publishMe[ topic ].nextReady;
+        if ( -1 == firstReadyTopic )
         {
-            publishMe[i].publishReady = false;
+            lastReadyTopic = -1;
         }
+        publishMe[ topic ].publishReady = false;
     }
 
-    return numToPub;
+    return topic;
+}
+
+/**
+ * Tells how many ticks the publish thread can sleep before publishManager()
+ * has anything to do.
+ *
+ * @param[in] limit most ticks the caller wants to sleep
+ * @param[out] ticks ticks to sleep, 0 while topics are on the ready list
+ *
+ * @return ticks to sleep, 0 while topics are on the ready list
+ */
+uint32_t publishIdleTicks(uint32_t limit)
+{
+    uint32_t ticks = 0;
+
+    if ( -1 == firstReadyTopic )
+    {
+        ticks = wheel_next( &publishSchedule , limit );
+    }
+
+    return ticks;
 }
 
 
@@ -2304,3 +2307,66 @@ float getPower(float amplitude)
     return power;
 }
 
+// power of the amplitude of realVal + j imagVal, the ENERGY MPs
+float getEnergy(int32_t realVal, int32_t imagVal)
+{
+    return getPower( getAmplitude(realVal , imagVal) );
+}
+
+
+
+/**
+ * Maps the heartbeat counter BARSM gives to the processes it watches for
+ * liveness. Without RC360_HEARTBEAT_FD in the environment the process is not
+ * watched and liveness_beat() does nothing.
+ *
+ * @param[in] void
+ * @param[out] success true/false status
+ *
+ * @return success true/false status of mapping the heartbeat counter
+ */
+bool liveness_init(void)
+{
+    bool success = true;
+    const char *fdVar = getenv(LIVENESS_FD_ENV);
+    void *page;
+
+    if ( NULL != fdVar )
+    {
+        // the descriptor stays open, a restarted BARSM takes the counter back
+        // from it
+        errno = 0;
+        page = mmap(NULL, sizeof(uint64_t), PROT_READ | PROT_WRITE, MAP_SHARED,
+                    atoi(fdVar), 0);
+        if ( MAP_FAILED == page )
+        {
+            syslog(LOG_ERR, "%s:%d unable to map the heartbeat counter (%d:%s)",
+                   __FUNCTION__, __LINE__, errno, strerror(errno));
+            success = false;
+        }
+        else
+        {
+            livenessCounter = (volatile uint64_t *)page;
+        }
+    }
+
+    return success;
+}
+
+
+/**
+ * Tells BARSM that the process is still making progress. Has to be called at
+ * least once per heartbeat= period of the process manifest.
+ *
+ * @param[in] void
+ * @param[out] void
+ *
+ * @return void
+ */
+void liveness_beat(void)
+{
+    if ( NULL != livenessCounter )
+    {
+        (*livenessCounter)++;
+    }
+}
@@ -0,0 +1,47 @@
+/** @file publish_wheel.h
+ * Hierarchical timing wheel that schedules the periodic publishes of the
+ * subscribed MPs.  See publish_wheel.c
+ *
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ */
+#ifndef __PUBLISH_WHEEL_H__
+#define __PUBLISH_WHEEL_H__
+
+#include <stdint.h>
+
+
+/****************
+* CONSTANTS
+****************/
+#define WHEEL_TICK_MS       1                       // periods are whole ticks
+#define WHEEL_BITS          8
+#define WHEEL_SLOTS         (1 << WHEEL_BITS)
+#define WHEEL_LEVELS        4                       // 4 x 8 bits cover any uint32_t period
+
+/****************
+* DATA TYPES
+****************/
+// one scheduled MP, lives in the subscription it belongs to
+typedef struct wheelEntry
+{
+    struct wheelEntry *next;
+    uint32_t expires;           // tick the entry is due
+    uint32_t period;            // ticks between two expirations, at least 1
+    uint32_t topic;             // index into publishMe
+    uint32_t mp;                // index into its topicSubscription
+} wheelEntry;
+
+typedef struct
+{
+    uint32_t now;               // ticks since start, wraps
+    wheelEntry *slots[ WHEEL_LEVELS ][ WHEEL_SLOTS ];
+} publishWheel;
+
+/****************
+* FUNCTION PROTOTYPES
+****************/
+void wheel_add( publishWheel *wheel , wheelEntry *entry );
+wheelEntry* wheel_tick( publishWheel *wheel );
+uint32_t wheel_next( const publishWheel *wheel , uint32_t limit );
+
+#endif
@@ -0,0 +1,387 @@
+/**
+ * File: publish_bench.c
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ *
+ * Description:
+ *   Measures building the PUBLISH message of a topic that subscribes every MP
+ *   of the SIMM with a full MAX_DATA_PERIOD of samples. The topic is set up
+ *   through buildPublishData() like a SUBSCRIBE would, then serialized both by
+ *   serializePublish() and by a copy of the MP if/else chain it replaced,
+ *   which dispatched on the MP once per sample. The chain reads arrays laid
+ *   out like the ones the SIMM kept before the sensor histories, one per
+ *   logical and one for the timestamps of every read, newest first, filled
+ *   from the same rows. Both messages must match byte for byte.
+ *
+ *   Usage: publish_bench [iterations]
+ *   Defaults: 100000 publishes with each serializer
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/types.h>
+#include <netinet/in.h>
+
+#include "simm_functions.h"
+#include "sensor.h"
+#include "bench_util.h"
+
+#define DEFAULT_ITERATIONS      100000
+#define BENCH_RUNS              5
+
+/****************
+* GLOBALS
+****************/
+/* normally defined by simm.c */
+char simmAppName[5] = { 's', 'i', 'm', 'm', '\0' };
+pid_t simmPid;
+topicToPublish *publishMe = NULL;
+
+/* the storage before sensor_history.c, newest sample first */
+static uint32_t pfp_values[ MAX_DATA_PERIOD ];
+static uint32_t ptlt_values[ MAX_DATA_PERIOD ];
+static uint32_t ptrt_values[ MAX_DATA_PERIOD ];
+static uint32_t tcmp_values[ MAX_DATA_PERIOD ];
+static uint32_t cop_values[ MAX_DATA_PERIOD ];
+static uint32_t cam_secs_chk[ MAX_DATA_PERIOD * MAX_TIMESTAMPS ];
+static uint32_t cam_nsecs_chk[ MAX_DATA_PERIOD * MAX_TIMESTAMPS ];
+
+static const uint32_t benchMPs[] =
+{
+    MP_PFP_VALUE,
+    MP_PTLT_TEMPERATURE,
+    MP_PTRT_TEMPERATURE,
+    MP_TCMP,
+    MP_CAM_SEC_1,
+    MP_CAM_NSEC_1,
+    MP_CAM_SEC_2,
+    MP_CAM_NSEC_2,
+    MP_CAM_SEC_3,
+    MP_CAM_NSEC_3,
+    MP_CAM_SEC_4,
+    MP_CAM_NSEC_4,
+    MP_CAM_SEC_5,
+    MP_CAM_NSEC_5,
+    MP_CAM_SEC_6,
+    MP_CAM_NSEC_6,
+    MP_CAM_SEC_7,
+    MP_CAM_NSEC_7,
+    MP_CAM_SEC_8,
+    MP_CAM_NSEC_8,
+    MP_CAM_SEC_9,
+    MP_CAM_NSEC_9,
+    MP_COP_PRESSURE
+};
+#define BENCH_NUM_MPS           (sizeof(benchMPs)/sizeof(benchMPs[0]))
+
+/****************
+* PRIVATE FUNCTION PROTOTYPES
+****************/
+static void baseline_push(const uint32_t *row);
+static bool setup_topic(void);
+static void set_due(void);
+static int32_t chain_serialize(int32_t topic_to_pub, uint8_t *sendData);
+static uint64_t run(bool chain, int32_t iterations, uint8_t *sendData);
+
+
+
+/**
+ * Stores one row in the arrays the SIMM kept before the sensor histories:
+ * every array is shifted by one read, then the read is written at the front,
+ * its MAX_TIMESTAMPS timestamps in order.
+ *
+ * @param[in] row: the row pushed to the histories
+ *
+ * @return void
+ */
+void baseline_push(const uint32_t *row)
+{
+    uint32_t i;
+
+    memmove(pfp_values + 1, pfp_values, sizeof(uint32_t) * (MAX_DATA_PERIOD - 1));
+    memmove(ptlt_values + 1, ptlt_values, sizeof(uint32_t) * (MAX_DATA_PERIOD - 1));
+    memmove(ptrt_values + 1, ptrt_values, sizeof(uint32_t) * (MAX_DATA_PERIOD - 1));
+    memmove(tcmp_values + 1, tcmp_values, sizeof(uint32_t) * (MAX_DATA_PERIOD - 1));
+    memmove(cop_values + 1, cop_values, sizeof(uint32_t) * (MAX_DATA_PERIOD - 1));
+    pfp_values[0] = row[ LOGICAL_PFP ];
+    ptlt_values[0] = row[ LOGICAL_PTLT ];
+    ptrt_values[0] = row[ LOGICAL_PTRT ];
+    tcmp_values[0] = row[ LOGICAL_TCMP ];
+    cop_values[0] = row[ LOGICAL_COP ];
+
+    memmove(cam_secs_chk + MAX_TIMESTAMPS, cam_secs_chk, sizeof(uint32_t) * (MAX_DATA_PERIOD - 1) * MAX_TIMESTAMPS);
+    memmove(cam_nsecs_chk + MAX_TIMESTAMPS, cam_nsecs_chk, sizeof(uint32_t) * (MAX_DATA_PERIOD - 1) * MAX_TIMESTAMPS);
+    for ( i = 0; i < MAX_TIMESTAMPS; i++ )
+    {
+        cam_secs_chk[ i ] = row[ TS_SEC_COLUMN(i) ];
+        cam_nsecs_chk[ i ] = row[ TS_NSEC_COLUMN(i) ];
+    }
+}
+
+/**
+ * Fills the sensor storage and subscribes topic 0 to every MP with
+ * MAX_DATA_PERIOD samples.
+ *
+ * @param[in] void
+ *
+ * @return true if every MP of the topic is valid
+ */
+bool setup_topic(void)
+{
+    bool success = subscribe_config();
+    uint32_t row[ HISTORY_MAX_COLUMNS ];
+    uint32_t i;
+    uint32_t j;
+
+    /* a full history that wrapped, so each column reads as two spans */
+    for ( i = 0; (true == success) && (i < MAX_DATA_PERIOD + MAX_DATA_PERIOD / 2); i++ )
+    {
+        for ( j = 0; j < HISTORY_MAX_COLUMNS; j++ )
+        {
+            row[j] = (j * 100000u) + i;
+        }
+        history_push(&logicalHistory, row);
+        history_push(&timestampHistory, row);
+        baseline_push(row);
+    }
+
+    if ( true == success )
+    {
+        MPnum = BENCH_NUM_MPS;
+        sub_mp = malloc(sizeof(*sub_mp) * BENCH_NUM_MPS);
+        sub_mpPer = malloc(sizeof(*sub_mpPer) * BENCH_NUM_MPS);
+        sub_mpNumSamples = malloc(sizeof(*sub_mpNumSamples) * BENCH_NUM_MPS);
+        success = (NULL != sub_mp) && (NULL != sub_mpPer) && (NULL != sub_mpNumSamples);
+    }
+
+    for ( i = 0; (true == success) && (i < BENCH_NUM_MPS); i++ )
+    {
+        sub_mp[i] = benchMPs[i];
+        sub_mpPer[i] = MAX_DATA_PERIOD * MINPER;
+        sub_mpNumSamples[i] = MAX_DATA_PERIOD;
+    }
+
+    if ( true == success )
+    {
+        num_topics_total = 1;
+        currentTopic = 0;
+        success = buildPublishData();
+    }
+
+    for ( i = 0; (true == success) && (i < BENCH_NUM_MPS); i++ )
+    {
+        success = publishMe[0].topicSubscription[i].valid;
+    }
+
+    return success;
+}
+
+/**
+ * Marks every MP of topic 0 due, as if they all expired on the same tick.
+ *
+ * @param[in] void
+ *
+ * @return void
+ */
+void set_due(void)
+{
+    uint32_t i;
+
+    for ( i = 0; i < publishMe[0].numMPs; i++ )
+    {
+        publishMe[0].topicSubscription[i].due = true;
+    }
+}
+
+/**
+ * The PUBLISH serialization as it was before serializePublish(): the source
+ * of every sample is found by comparing the MP against each MP the SIMM
+ * knows, and read from the storage of baseline_push().
+ *
+ * @param[in] topic_to_pub: index into publishMe
+ * @param[out] sendData: the message
+ *
+ * @return number of bytes of the message
+ */
+int32_t chain_serialize(int32_t topic_to_pub, uint8_t *sendData)
+{
+    MPinfo *mpInfo;
+    uint8_t *ptr = sendData;
+    uint8_t *msgLenPtr;
+    int16_t val16;
+    int32_t val32 = 0;
+    uint16_t actualLength;
+    uint32_t i;
+    uint32_t j;
+    int32_t cntBytes = 0;
+
+    val16 = CMD_PUBLISH;
+    memcpy(ptr, &val16, sizeof(val16));
+    ptr += 2;
+    msgLenPtr = ptr;
+    ptr += 2;
+    val32 = publishMe[ topic_to_pub ].topic_id;
+    memcpy(ptr, &val32, sizeof(val32));
+    ptr += 4;
+    val32 = 0;
+    for ( i = 0; i < publishMe[ topic_to_pub ].numMPs; i++ )
+    {
+        if ( true == publishMe[ topic_to_pub ].topicSubscription[ i ].due )
+        {
+            val32++;
+        }
+    }
+    memcpy(ptr, &val32, sizeof(val32));
+    ptr += 4;
+    val16 = 0;
+    memcpy(ptr, &val16, sizeof(val16));
+    ptr += 2;
+    cntBytes = PUBLISH_HDR_SIZE;
+
+    for ( i = 0; i < publishMe[ topic_to_pub ].numMPs; i++ )
+    {
+        mpInfo = &publishMe[ topic_to_pub ].topicSubscription[ i ];
+        if ( true == mpInfo->due )
+        {
+            mpInfo->due = false;
+
+            val32 = mpInfo->mp;
+            memcpy(ptr, &val32, sizeof(val32));
+            ptr += 4;
+            cntBytes += 4;
+            for ( j = 0; j < mpInfo->numSamples; j++ )
+            {
+                if ( MP_PFP_VALUE == mpInfo->mp ) { val32 = pfp_values[j]; memcpy(ptr, &val32, sizeof(val32)); }
+                else if ( MP_PTLT_TEMPERATURE == mpInfo->mp ) { val32 = ptlt_values[j]; memcpy(ptr, &val32, sizeof(val32)); }
+                else if ( MP_PTRT_TEMPERATURE == mpInfo->mp ) { val32 = ptrt_values[j]; memcpy(ptr, &val32, sizeof(val32)); }
+                else if ( MP_TCMP == mpInfo->mp ) { val32 = tcmp_values[j]; memcpy(ptr, &val32, sizeof(val32)); }
+                else if ( MP_COP_PRESSURE == mpInfo->mp ) { val32 = cop_values[j]; memcpy(ptr, &val32, sizeof(val32)); }
+                else if ( MP_CAM_SEC_1 == mpInfo->mp ) { val32 = cam_secs_chk[j*9+0]; memcpy(ptr, &val32, sizeof(val32)); }
+                else if ( MP_CAM_SEC_2 == mpInfo->mp ) { val32 = cam_secs_chk[j*9+1]; memcpy(ptr, &val32, sizeof(val32)); }
+                else if ( MP_CAM_SEC_3 == mpInfo->mp ) { val32 = cam_secs_chk[j*9+2]; memcpy(ptr, &val32, sizeof(val32)); }
+                else if ( MP_CAM_SEC_4 == mpInfo->mp ) { val32 = cam_secs_chk[j*9+3]; memcpy(ptr, &val32, sizeof(val32)); }
+                else if ( MP_CAM_SEC_5 == mpInfo->mp ) { val32 = cam_secs_chk[j*9+4]; memcpy(ptr, &val32, sizeof(val32)); }
+                else if ( MP_CAM_SEC_6 == mpInfo->mp ) { val32 = cam_secs_chk[j*9+5]; memcpy(ptr, &val32, sizeof(val32)); }
+                else if ( MP_CAM_SEC_7 == mpInfo->mp ) { val32 = cam_secs_chk[j*9+6]; memcpy(ptr, &val32, sizeof(val32)); }
+                else if ( MP_CAM_SEC_8 == mpInfo->mp ) { val32 = cam_secs_chk[j*9+7]; memcpy(ptr, &val32, sizeof(val32)); }
+                else if ( MP_CAM_SEC_9 == mpInfo->mp ) { val32 = cam_secs_chk[j*9+8]; memcpy(ptr, &val32, sizeof(val32)); }
+                else if ( MP_CAM_NSEC_1 == mpInfo->mp ) { val32 = cam_nsecs_chk[j*9+0]; memcpy(ptr, &val32, sizeof(val32)); }
+                else if ( MP_CAM_NSEC_2 == mpInfo->mp ) { val32 = cam_nsecs_chk[j*9+1]; memcpy(ptr, &val32, sizeof(val32)); }
+                else if ( MP_CAM_NSEC_3 == mpInfo->mp ) { val32 = cam_nsecs_chk[j*9+2]; memcpy(ptr, &val32, sizeof(val32)); }
+                else if ( MP_CAM_NSEC_4 == mpInfo->mp ) { val32 = cam_nsecs_chk[j*9+3]; memcpy(ptr, &val32, sizeof(val32)); }
+                else if ( MP_CAM_NSEC_5 == mpInfo->mp ) { val32 = cam_nsecs_chk[j*9+4]; memcpy(ptr, &val32, sizeof(val32)); }
+                else if ( MP_CAM_NSEC_6 == mpInfo->mp ) { val32 = cam_nsecs_chk[j*9+5]; memcpy(ptr, &val32, sizeof(val32)); }
+                else if ( MP_CAM_NSEC_7 == mpInfo->mp ) { val32 = cam_nsecs_chk[j*9+6]; memcpy(ptr, &val32, sizeof(val32)); }
+                else if ( MP_CAM_NSEC_8 == mpInfo->mp ) { val32 = cam_nsecs_chk[j*9+7]; memcpy(ptr, &val32, sizeof(val32)); }
+                else if ( MP_CAM_NSEC_9 == mpInfo->mp ) { val32 = cam_nsecs_chk[j*9+8]; memcpy(ptr, &val32, sizeof(val32)); }
+                ptr += 4;
+                cntBytes += 4;
+            }
+        }
+    }
+
+    actualLength = cntBytes - 4;
+    memcpy(msgLenPtr, &actualLength, sizeof(actualLength));
+
+    return cntBytes;
+}
+
+/**
+ * Times one serializer.
+ *
+ * @param[in] chain: true for chain_serialize(), false for serializePublish()
+ * @param[in] iterations: number of publishes
+ * @param[out] sendData: the message of the last publish
+ *
+ * @return the fastest of BENCH_RUNS runs, in nanoseconds per publish
+ */
+uint64_t run(bool chain, int32_t iterations, uint8_t *sendData)
+{
+    uint64_t best = UINT64_MAX;
+    uint64_t start;
+    uint64_t elapsed;
+    int32_t r;
+    int32_t i;
+
+    for ( r = 0; r < BENCH_RUNS; r++ )
+    {
+        start = now_ns();
+        for ( i = 0; i < iterations; i++ )
+        {
+            set_due();
+            if ( true == chain )
+            {
+                chain_serialize(0, sendData);
+            }
+            else
+            {
+                serializePublish(0, sendData);
+            }
+        }
+        elapsed = (now_ns() - start) / (uint64_t)iterations;
+        if ( elapsed < best )
+        {
+            best = elapsed;
+        }
+    }
+
+    return best;
+}
+
+/**
+ * Runs the benchmark.
+ *
+ * @param[in] argc: number of arguments
+ * @param[in] argv: optional number of iterations
+ *
+ * @return 0 on success, 1 if the setup failed or the messages differ
+ */
+int main(int argc, char *argv[])
+{
+    static uint8_t chainData[ PUBLISHBUFSIZE ];
+    static uint8_t planData[ PUBLISHBUFSIZE ];
+    int32_t iterations = (1 < argc) ? atoi(argv[1]) : DEFAULT_ITERATIONS;
+    int32_t chainBytes;
+    int32_t planBytes;
+    uint64_t chainNs;
+    uint64_t planNs;
+    int status = 1;
+
+    if ( 0 >= iterations )
+    {
+        iterations = DEFAULT_ITERATIONS;
+    }
+
+    if ( false == setup_topic() )
+    {
+        fprintf(stderr, "publish_bench: topic setup failed\n");
+    }
+    else
+    {
+        set_due();
+        chainBytes = chain_serialize(0, chainData);
+        set_due();
+        planBytes = serializePublish(0, planData);
+
+        if ( (chainBytes != planBytes) || (0 != memcmp(chainData, planData, (size_t)planBytes)) )
+        {
+            fprintf(stderr, "publish_bench: messages differ (%d vs %d bytes)\n", chainBytes, planBytes);
+        }
+        else
+        {
+            chainNs = run(true, iterations, chainData);
+            planNs = run(false, iterations, planData);
+
+            printf("topic of %u MPs x %u samples, %d bytes, %d publishes\n",
+                   (unsigned)BENCH_NUM_MPS, (unsigned)MAX_DATA_PERIOD, planBytes, iterations);
+            printf("  if/else chain     %8llu ns/publish\n", (unsigned long long)chainNs);
+            printf("  publish plan      %8llu ns/publish\n", (unsigned long long)planNs);
+            status = 0;
+        }
+    }
+
+    return status;
+}
@@ -44,8 +44,6 @@ int32_t cop_val;
 
 uint32_t returnVoltages[5];
 int32_t total_ts;
-int32_t logical_index;
-int32_t timestamp_index;
 
 uint32_t voltages[5];
 uint32_t timestamps[9];
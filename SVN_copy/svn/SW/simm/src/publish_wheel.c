@@ -0,0 +1,180 @@
+/** @file publish_wheel.c
+ * Hierarchical timing wheel for the publish thread.  Level 0 holds the
+ * entries due in the next WHEEL_SLOTS ticks, one slot per tick, and every
+ * level above covers WHEEL_SLOTS times the span of the one below.  When
+ * level 0 wraps, the next slot of level 1 is cascaded down and so on, so an
+ * entry moves at most WHEEL_LEVELS - 1 times before it expires.  Adding an
+ * entry and advancing a tick cost the same however many entries are
+ * scheduled.  wheel_next() tells how many ticks can pass before the next
+ * one that has work, so the caller can sleep through the idle ones.
+ *
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ */
+
+/****************
+* INCLUDES
+****************/
+#include <stdint.h>
+#include <stddef.h>
+#include "publish_wheel.h"
+
+/****************
+* PRIVATE FUNCTION PROTOTYPES
+****************/
+static void wheel_place( publishWheel *wheel , wheelEntry *entry );
+static void wheel_cascade( publishWheel *wheel , uint32_t level );
+
+
+/**
+ * Puts an entry in the slot of the lowest level that reaches its
+ * expiration.
+ *
+ * @param[in] wheel the wheel
+ * @param[in] entry entry with expires set
+ * @param[out] void
+ *
+ * @return void
+ */
+static void wheel_place( publishWheel *wheel , wheelEntry *entry )
+{
+    uint32_t delta = entry->expires - wheel->now;
+    uint32_t level = 0;
+    uint32_t slot;
+
+    while ( ((WHEEL_LEVELS - 1) > level) && ((delta >> ((level + 1) * WHEEL_BITS)) != 0) )
+    {
+        level++;
+    }
+
+    slot = (entry->expires >> (level * WHEEL_BITS)) & (WHEEL_SLOTS - 1);
+    entry->next = wheel->slots[ level ][ slot ];
+    wheel->slots[ level ][ slot ] = entry;
+}
+
+/**
+ * Moves the entries of the current slot of a level to the levels below.
+ *
+ * @param[in] wheel the wheel
+ * @param[in] level level 1 .. WHEEL_LEVELS - 1
+ * @param[out] void
+ *
+ * @return void
+ */
+static void wheel_cascade( publishWheel *wheel , uint32_t level )
+{
+    uint32_t slot = (wheel->now >> (level * WHEEL_BITS)) & (WHEEL_SLOTS - 1);
+    wheelEntry *entry = wheel->slots[ level ][ slot ];
+    wheelEntry *next;
+
+    wheel->slots[ level ][ slot ] = NULL;
+    while ( NULL != entry )
+    {
+        next = entry->next;
+        wheel_place( wheel , entry );
+        entry = next;
+    }
+}
+
+
+
+/**
+ * Schedules an entry to expire period ticks from now.  Entries that are
+ * re-added from the list wheel_tick() returned stay on their grid, as that
+ * tick is their expiration.
+ *
+ * @param[in] wheel the wheel
+ * @param[in] entry entry with period set, not scheduled yet
+ * @param[out] void
+ *
+ * @return void
+ */
+void wheel_add( publishWheel *wheel , wheelEntry *entry )
+{
+    if ( 0 == entry->period )
+    {
+        entry->period = 1;
+    }
+
+    entry->expires = wheel->now + entry->period;
+    wheel_place( wheel , entry );
+}
+
+/**
+ * Advances the wheel by one tick.
+ *
+ * @param[in] wheel the wheel
+ * @param[out] expired the entries due at the new tick, linked by next.  They
+ * are no longer scheduled.
+ *
+ * @return the entries due at the new tick, NULL if there are none
+ */
+wheelEntry* wheel_tick( publishWheel *wheel )
+{
+    wheelEntry *expired;
+    uint32_t level;
+    uint32_t slot;
+
+    wheel->now++;
+
+    // a level comes due when all the levels below it wrap, highest first so
+    // its entries can land in the slots cascaded after it
+    for ( level = WHEEL_LEVELS - 1 ; 0 < level ; level-- )
+    {
+        if ( 0 == (wheel->now & ((1u << (level * WHEEL_BITS)) - 1)) )
+        {
+            wheel_cascade( wheel , level );
+        }
+    }
+
+    slot = wheel->now & (WHEEL_SLOTS - 1);
+    expired = wheel->slots[ 0 ][ slot ];
+    wheel->slots[ 0 ][ slot ] = NULL;
+
+    return expired;
+}
+
+/**
+ * Tells how many ticks from now the wheel next needs wheel_tick() to look at
+ * it: the first tick an entry expires at, or one a higher level cascades an
+ * entry down at.  The wheel still has to be advanced through every tick up
+ * to it.
+ *
+ * @param[in] wheel the wheel
+ * @param[in] limit most ticks the caller wants to wait
+ * @param[out] void
+ *
+ * @return ticks until then, limit if nothing comes due before
+ */
+uint32_t wheel_next( const publishWheel *wheel , uint32_t limit )
+{
+    uint32_t next = limit;
+    uint32_t level;
+    uint32_t ticks;
+    uint32_t span;
+    uint32_t slot;
+
+    // level 0 has one slot per tick
+    for ( ticks = 1 ; (ticks < next) && (ticks < WHEEL_SLOTS) ; ticks++ )
+    {
+        if ( NULL != wheel->slots[ 0 ][ (wheel->now + ticks) & (WHEEL_SLOTS - 1) ] )
+        {
+            next = ticks;
+        }
+    }
+
+    // a slot of a higher level is cascaded when the levels below it wrap
+    for ( level = 1 ; level < WHEEL_LEVELS ; level++ )
+    {
+        span = 1u << (level * WHEEL_BITS);
+        for ( ticks = span - (wheel->now & (span - 1)) ; ticks < next ; ticks += span )
+        {
+            slot = ((wheel->now + ticks) >> (level * WHEEL_BITS)) & (WHEEL_SLOTS - 1);
+            if ( NULL != wheel->slots[ level ][ slot ] )
+            {
+                next = ticks;
+            }
+        }
+    }
+
+    return next;
+}
@@ -36,24 +36,18 @@
 #define TS_DEBUG_PRINT 2
 #define FULL_DEBUG_PRINT 2
 #define CLOCK_OFFSET_TOLERANCE 2    // in seconds
-#define MAX_DATA_PERIOD 60          // in seconds
 
-uint32_t *pfp_values = NULL;
-uint32_t *ptlt_values = NULL;
-uint32_t *ptrt_values = NULL;
-uint32_t *tcmp_values = NULL;
-uint32_t *cop_values = NULL;
-uint32_t *cam_secs = NULL;
-uint32_t *cam_nsecs = NULL;
-uint32_t *cam_secs_chk = NULL;
-uint32_t *cam_nsecs_chk = NULL;
+// one row per FPGA read, newest first, see sensor.h for the columns.  Both
+// are written by the sensor thread under sensorLock, see read_sensors()
+sensorHistory logicalHistory;
+sensorHistory timestampHistory;
+historyLock sensorLock;
 
 
 // MUTEXES
 pthread_mutex_t mutex_PublishedLogicals;
 pthread_mutex_t mutex_PublishedTimeStamps;
 
-const int32_t MAX_TS_PERIOD = MAX_DATA_PERIOD*9;
 static uint64_t offset = 0;
 
 /**
@@ -111,62 +105,25 @@ void timestamp_offset_config(void)
 bool subscribe_config(void)
 {
     bool success = true;
-    //int32_t i = 0;
 
-    // ALLOCATE SPACE FOR THE STORAGE OF THE LOGICAL VALUES
+    // ALLOCATE SPACE FOR THE STORAGE OF THE LOGICAL AND TIMESTAMP VALUES
     // = maximum period of collection time in seconds
-    //errno = 0;
-
-    pfp_values = (uint32_t *)malloc(MAX_DATA_PERIOD * sizeof(int32_t));
-    ptlt_values = (uint32_t *)malloc(MAX_DATA_PERIOD * sizeof(int32_t));
-    ptrt_values = (uint32_t *)malloc(MAX_DATA_PERIOD * sizeof(int32_t));
-    tcmp_values = (uint32_t *)malloc(MAX_DATA_PERIOD * sizeof(int32_t));
-    cop_values = (uint32_t *)malloc(MAX_DATA_PERIOD * sizeof(int32_t));
-
-    memset(pfp_values, 33, sizeof(int32_t));
-    memset(ptlt_values, 33, sizeof(int32_t));
-    memset(ptrt_values, 33, sizeof(int32_t));
-    memset(tcmp_values, 33, sizeof(int32_t));
-    memset(cop_values, 33, sizeof(int32_t));
+    errno = 0;
 
-    if ( NULL==pfp_values || NULL==ptlt_values || NULL==ptrt_values || NULL==tcmp_values || NULL==cop_values )
+    if ( false == history_init(&logicalHistory, NUM_LOGICALS, MAX_DATA_PERIOD) )
     {
-        //printf("\nERROR: malloc() failed for logical value storage! (%d: %s)\n\n", errno, strerror(errno));
         syslog(LOG_ERR, "%s:%d ERROR: malloc() failed for logical value storage! (%d: %s)", \
             __FUNCTION__, __LINE__, errno, strerror(errno));
         success = false;
     }
-    else
-    {
-        memset(pfp_values, 0xFF, sizeof(int32_t)*MAX_DATA_PERIOD);
-        memset(ptlt_values, 0xFF, sizeof(int32_t)*MAX_DATA_PERIOD);
-        memset(ptrt_values, 0xFF, sizeof(int32_t)*MAX_DATA_PERIOD);
-        memset(tcmp_values, 0xFF, sizeof(int32_t)*MAX_DATA_PERIOD);
-        memset(cop_values, 0xFF, sizeof(int32_t)*MAX_DATA_PERIOD);
-    }
-
-    logical_index = MAX_DATA_PERIOD - 1;
 
-    // ALLOCATE SPACE FOR THE STORAGE OF THE TIMESTAMP VALUES
-    // = maximum period of collection time in seconds * 9 values per second
-    errno = 0;
-
-    cam_secs = (uint32_t*)malloc(MAX_TS_PERIOD * sizeof(uint32_t));
-    cam_nsecs = (uint32_t*)malloc(MAX_TS_PERIOD * sizeof(uint32_t));
-
-    cam_secs_chk    = malloc(MAX_TS_PERIOD * sizeof(*cam_secs_chk));
-    cam_nsecs_chk   = malloc(MAX_TS_PERIOD * sizeof(*cam_nsecs_chk));
-
-    if ( NULL == cam_secs || NULL == cam_nsecs || NULL == cam_nsecs_chk || NULL == cam_nsecs_chk )
+    if ( false == history_init(&timestampHistory, 2 * MAX_TIMESTAMPS, MAX_DATA_PERIOD) )
     {
-        //printf("\nERROR: malloc() failed for timestamp value storage! (%d: %s)\n\n", errno, strerror(errno));
         syslog(LOG_ERR, "%s:%d ERROR: malloc() failed for timestamp value storage! (%d: %s)", \
             __FUNCTION__, __LINE__, errno, strerror(errno));
         success = false;
     }
 
-    timestamp_index = MAX_TS_PERIOD - 1;
-
     // SAVE VOLTAGE VALUES TO VARIABLES
     //pfp_val = convert_pfp(voltages[0]);
     returnVoltages[0] = pfp_val;
@@ -183,50 +140,8 @@ bool subscribe_config(void)
  */
 void subscribe_cleanup(void)
 {
-    if (NULL != pfp_values)
-    {
-        free(pfp_values);
-    }
-
-    if (NULL != ptlt_values)
-    {
-        free(ptlt_values);
-    }
-
-    if (NULL != ptrt_values)
-    {
-        free(ptrt_values);
-    }
-
-    if (NULL != tcmp_values)
-    {
-        free(tcmp_values);
-    }
-
-    if (NULL != cop_values)
-    {
-        free(cop_values);
-    }
-
-    if (NULL != cam_secs)
-    {
-        free(cam_secs);
-    }
-
-    if (NULL != cam_nsecs)
-    {
-        free(cam_nsecs);
-    }
-
-    if (NULL != cam_secs_chk)
-    {
-        free(cam_secs_chk);
-    }
-
-    if (NULL != cam_nsecs_chk)
-    {
-        free(cam_nsecs_chk);
-    }
+    history_free(&logicalHistory);
+    history_free(&timestampHistory);
 }
 
 /**
@@ -240,6 +155,7 @@ void subscribe_cleanup(void)
 //void make_logicals(uint32_t *voltages)
 void make_logicals(void)
 {
+    uint32_t row[ NUM_LOGICALS ];
 
     //int32_t i;
 
@@ -249,22 +165,13 @@ void make_logicals(void)
 //  printf("voltages[3]: %d\n",voltages[3]);
 //  printf("voltages[4]: %d\n",voltages[4]);
 
-    // keeps current at 0th element, shifts data over
-    memmove(pfp_values+1, pfp_values, sizeof(int32_t)*(MAX_DATA_PERIOD-1));
-    memmove(ptlt_values+1, ptlt_values, sizeof(int32_t)*(MAX_DATA_PERIOD-1));
-    memmove(ptrt_values+1, ptrt_values, sizeof(int32_t)*(MAX_DATA_PERIOD-1));
-    memmove(tcmp_values+1, tcmp_values, sizeof(int32_t)*(MAX_DATA_PERIOD-1));
-    memmove(cop_values+1, cop_values, sizeof(int32_t)*(MAX_DATA_PERIOD-1));
-
-    pfp_values[0]  = voltages_toGet[0];
-    ptlt_values[0] = voltages_toGet[1];
-    ptrt_values[0] = voltages_toGet[2];
-    tcmp_values[0] = voltages_toGet[3];
-    cop_values[0]  = voltages_toGet[4];
-
-
-    /* To compensate for storage rollover */
-    logical_index = (MAX_DATA_PERIOD-1 <= logical_index)? 0: logical_index+1;
+    // the newest row replaces the oldest one
+    row[ LOGICAL_PFP ]  = voltages_toGet[0];
+    row[ LOGICAL_PTLT ] = voltages_toGet[1];
+    row[ LOGICAL_PTRT ] = voltages_toGet[2];
+    row[ LOGICAL_TCMP ] = voltages_toGet[3];
+    row[ LOGICAL_COP ]  = voltages_toGet[4];
+    history_push(&logicalHistory, row);
 
 
     /* DEBUGGING */
@@ -433,25 +340,18 @@ void split_timestamps(uint64_t *ts_full)
 {
     int32_t dif;
     struct timespec real_time;
+    uint32_t row[ 2 * MAX_TIMESTAMPS ];
     int32_t i;
 
-    for(i = 0; i < 9; i++)
+    for(i = 0; i < MAX_TIMESTAMPS; i++)
     {
-        // keeps most current sample at 0th element.
-        memmove(cam_secs_chk+1, cam_secs_chk, sizeof(uint32_t)*(MAX_TS_PERIOD - 1));
-        memmove(cam_nsecs_chk+1, cam_nsecs_chk, sizeof(uint32_t)*(MAX_TS_PERIOD -1 ));
-
-        cam_secs_chk[ i ] = ts_full[i] / 100000000L;
-        cam_nsecs_chk[ i ]  = (ts_full[ i ] - cam_secs_chk[ i ] * 100000000L) * 10;
-
-        /* To compensate for storage rollover */
-        timestamp_index = (MAX_TS_PERIOD-1 <= timestamp_index)? 0: timestamp_index+1;
-
-        cam_secs[ timestamp_index ] = ts_full[i] / 100000000L;
-        cam_nsecs[ timestamp_index ] = (ts_full[i] - cam_secs[ timestamp_index ] * 100000000L) * 10;
-        // printf("Nano Stamps: %d\n", cam_nsecs[tot_stamps[1] + i]);
+        row[ TS_SEC_COLUMN(i) ]  = ts_full[i] / 100000000L;
+        row[ TS_NSEC_COLUMN(i) ] = (ts_full[i] - row[ TS_SEC_COLUMN(i) ] * 100000000L) * 10;
     }
 
+    // the newest row replaces the oldest one
+    history_push(&timestampHistory, row);
+
 //  /* DEBUGGING */
 //  // print out all stored values
 //  for (i = TS_DEBUG_PRINT-1; i >= 0; i--)
@@ -477,7 +377,7 @@ void split_timestamps(uint64_t *ts_full)
      * within CLOCK_OFFSET_TOLERANCE of the current time to ensure that the offset
      * was calculated and applied correctly. */
     clock_gettime(CLOCK_REALTIME, &real_time);
-    dif = real_time.tv_sec - cam_secs[timestamp_index-8];
+    dif = real_time.tv_sec - history_sample(&timestampHistory, TS_SEC_COLUMN(0), 0);
 
     if( abs(dif) > CLOCK_OFFSET_TOLERANCE )
     {
@@ -511,9 +411,10 @@ void check_ts_values(void)
     int32_t i;
     int32_t j;
 
-    for ( j = timestamp_index - 8, i = 0; j <= timestamp_index; j++, i++ )
+    for ( i = 0; i < MAX_TIMESTAMPS; i++ )
     {
-        new_stamps[i] = (cam_secs[j] * 1000000000L) + cam_nsecs[j];
+        new_stamps[i] = (history_sample(&timestampHistory, TS_SEC_COLUMN(i), 0) * 1000000000L) +
+                        history_sample(&timestampHistory, TS_NSEC_COLUMN(i), 0);
     }
 
     for ( i = 0; i < 9 && new_stamps[i] != 0; i++ )
@@ -7,6 +7,27 @@
 #ifndef __SENSORS_H__
 #define __SENSORS_H__
 
+#include "sensor_history.h"
+
+/****************
+* CONSTANTS
+****************/
+#define MAX_DATA_PERIOD 60          // in seconds, samples kept of each logical and timestamp
+
+// columns of logicalHistory
+enum logical_columns
+{
+    LOGICAL_PFP,
+    LOGICAL_PTLT,
+    LOGICAL_PTRT,
+    LOGICAL_TCMP,
+    LOGICAL_COP,
+    NUM_LOGICALS
+};
+
+// columns of timestampHistory, n = 0 .. MAX_TIMESTAMPS - 1
+#define TS_SEC_COLUMN(n)    (n)
+#define TS_NSEC_COLUMN(n)   (MAX_TIMESTAMPS + (n))
 
 /****************
 * DATA TYPES
@@ -17,18 +38,12 @@ extern int32_t ptrt_val;
 extern int32_t tcmp_val;
 extern int32_t cop_val;
 
-//int32_t *pfp_values;
-//int32_t *ptlt_values;
-//int32_t *ptrt_values;
-//int32_t *tcmp_values;
-//int32_t *cop_values;
-//uint32_t *cam_secs;
-//uint32_t *cam_nsecs;
+extern sensorHistory logicalHistory;
+extern sensorHistory timestampHistory;
+extern historyLock sensorLock;
 
 extern uint32_t returnVoltages[5];
 extern int32_t total_ts;
-extern int32_t logical_index; 
-extern int32_t timestamp_index;
 
 void timestamp_offset_config(void);
 bool subscribe_config(void);
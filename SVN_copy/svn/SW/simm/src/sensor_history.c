@@ -0,0 +1,232 @@
+/** @file sensor_history.c
+ * Ring buffers of sensor samples.  Every sample the FPGA delivers is a row of
+ * values, e.g. the five logicals, that is stored column by column so that a
+ * reader copies the history of one value with at most two memcpy().  Adding
+ * a row costs the same however many rows are kept: the oldest row is
+ * overwritten instead of every row being shifted.
+ *
+ * The sensor thread writes the histories while the publish thread reads
+ * them, so they are guarded by a seqlock: the writer never waits for a
+ * reader, and a reader that overlapped a write reads again.
+ *
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ */
+
+/****************
+* INCLUDES
+****************/
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include "sensor_history.h"
+
+
+/**
+ * Allocates the columns of a history and marks every row as not written.
+ *
+ * @param[in] history the history
+ * @param[in] numColumns values per row, 1 .. HISTORY_MAX_COLUMNS
+ * @param[in] depth rows kept, at least 1
+ * @param[out] void
+ *
+ * @return true on success, false if the history couldn't be allocated
+ */
+bool history_init( sensorHistory *history , uint32_t numColumns , uint32_t depth )
+{
+    bool success = false;
+    uint32_t *values = NULL;
+    uint32_t i;
+
+    memset( history , 0 , sizeof(*history) );
+
+    if ( (0 < numColumns) && (HISTORY_MAX_COLUMNS >= numColumns) && (0 < depth) )
+    {
+        values = malloc( sizeof(uint32_t) * numColumns * depth );
+    }
+
+    if ( NULL != values )
+    {
+        memset( values , 0xFF , sizeof(uint32_t) * numColumns * depth );
+
+        for ( i = 0 ; i < numColumns ; i++ )
+        {
+            history->column[ i ] = values + (i * depth);
+        }
+        history->numColumns = numColumns;
+        history->depth      = depth;
+        history->head       = 0;
+        history->count      = 0;
+        success = true;
+    }
+
+    return success;
+}
+
+/**
+ * Releases the columns of a history.
+ *
+ * @param[in] history the history, initialized or zeroed
+ * @param[out] void
+ *
+ * @return void
+ */
+void history_free( sensorHistory *history )
+{
+    // all the columns share the allocation of the first one
+    free( history->column[ 0 ] );
+    memset( history , 0 , sizeof(*history) );
+}
+
+/**
+ * Adds a row, overwriting the oldest one when the history is full.
+ *
+ * @param[in] history the history
+ * @param[in] row numColumns values
+ * @param[out] void
+ *
+ * @return void
+ */
+void history_push( sensorHistory *history , const uint32_t *row )
+{
+    uint32_t slot;
+    uint32_t i;
+
+    slot = (0 == history->head) ? (history->depth - 1) : (history->head - 1);
+    for ( i = 0 ; i < history->numColumns ; i++ )
+    {
+        history->column[ i ][ slot ] = row[ i ];
+    }
+
+    history->head = slot;
+    if ( history->depth > history->count )
+    {
+        history->count++;
+    }
+}
+
+/**
+ * Reads one value of a past row.
+ *
+ * @param[in] history the history
+ * @param[in] column column of the value
+ * @param[in] age 0 for the newest row, 1 for the one before, .. depth - 1
+ * @param[out] void
+ *
+ * @return the value, HISTORY_NO_SAMPLE if that row wasn't written yet
+ */
+uint32_t history_sample( const sensorHistory *history , uint32_t column , uint32_t age )
+{
+    uint32_t slot = history->head + age;
+
+    if ( slot >= history->depth )
+    {
+        slot -= history->depth;
+    }
+
+    return history->column[ column ][ slot ];
+}
+
+/**
+ * Gives the newest samples of a column without copying them.  The samples
+ * are contiguous unless they wrap around the end of the column, in which
+ * case the second span continues the first one.  Rows not written yet read
+ * as HISTORY_NO_SAMPLE.
+ *
+ * @param[in] history the history
+ * @param[in] column column to read
+ * @param[in] numSamples samples wanted, at most depth
+ * @param[out] spans 2 spans, newest samples first
+ *
+ * @return number of spans filled, 1 or 2
+ */
+uint32_t history_view( const sensorHistory *history , uint32_t column , uint32_t numSamples , historySpan *spans )
+{
+    uint32_t numSpans = 1;
+    uint32_t untilEnd = history->depth - history->head;
+
+    if ( numSamples > history->depth )
+    {
+        numSamples = history->depth;
+    }
+
+    spans[ 0 ].values = &history->column[ column ][ history->head ];
+    spans[ 0 ].count  = numSamples;
+
+    if ( numSamples > untilEnd )
+    {
+        spans[ 0 ].count  = untilEnd;
+        spans[ 1 ].values = history->column[ column ];
+        spans[ 1 ].count  = numSamples - untilEnd;
+        numSpans = 2;
+    }
+
+    return numSpans;
+}
+
+/**
+ * Starts changing the histories a lock covers.  Readers that overlap the
+ * change will retry, none of them is waited for.
+ *
+ * @param[in] lock the lock, only ever written by this thread
+ * @param[out] void
+ *
+ * @return void
+ */
+void history_write_begin( historyLock *lock )
+{
+    __atomic_store_n(&lock->sequence, lock->sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/**
+ * Publishes the changes made since history_write_begin().
+ *
+ * @param[in] lock the lock
+ * @param[out] void
+ *
+ * @return void
+ */
+void history_write_end( historyLock *lock )
+{
+    __atomic_store_n(&lock->sequence, lock->sequence + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Starts reading the histories a lock covers, once no write is in progress.
+ *
+ * @param[in] lock the lock
+ * @param[out] void
+ *
+ * @return the sequence to hand to history_read_retry()
+ */
+uint32_t history_read_begin( historyLock *lock )
+{
+    uint32_t sequence = __atomic_load_n(&lock->sequence, __ATOMIC_ACQUIRE);
+
+    while ( 0 != (sequence & 1) )
+    {
+        // the writer only holds it for one FPGA read, let it finish
+        sched_yield();
+        sequence = __atomic_load_n(&lock->sequence, __ATOMIC_ACQUIRE);
+    }
+
+    return sequence;
+}
+
+/**
+ * Tells whether what was read since history_read_begin() may mix two writes.
+ *
+ * @param[in] lock the lock
+ * @param[in] sequence what history_read_begin() returned
+ * @param[out] void
+ *
+ * @return true if the reads must be done again, false if they are consistent
+ */
+bool history_read_retry( historyLock *lock , uint32_t sequence )
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    return ( sequence != __atomic_load_n(&lock->sequence, __ATOMIC_RELAXED) );
+}
@@ -0,0 +1,62 @@
+/** @file sensor_history.h
+ * Ring buffers keeping the last samples the sensor thread produced for the
+ * publish thread, and the seqlock the publish thread reads them under.  See
+ * sensor_history.c
+ *
+ * Copyright (c) 2015, DornerWorks, Ltd.
+ */
+#ifndef __SENSOR_HISTORY_H__
+#define __SENSOR_HISTORY_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+
+
+/****************
+* CONSTANTS
+****************/
+#define HISTORY_MAX_COLUMNS     18                  // 9 seconds and 9 nanoseconds timestamps
+#define HISTORY_NO_SAMPLE       0xFFFFFFFF          // what a row holds before it is first written
+
+/****************
+* DATA TYPES
+****************/
+// the last depth rows of numColumns values, one array per column.  Rows are
+// written at decreasing slots so the newest first reads forward from head
+typedef struct
+{
+    uint32_t *column[ HISTORY_MAX_COLUMNS ];
+    uint32_t numColumns;
+    uint32_t depth;             // rows kept
+    uint32_t head;              // slot of the newest row
+    uint32_t count;             // rows written, at most depth
+} sensorHistory;
+
+// single writer, many readers.  sequence is odd while the writer changes the
+// histories it covers
+typedef struct
+{
+    uint32_t sequence;
+} historyLock;
+
+// consecutive samples of one column, newest first
+typedef struct
+{
+    const uint32_t *values;
+    uint32_t count;
+} historySpan;
+
+/****************
+* FUNCTION PROTOTYPES
+****************/
+bool history_init( sensorHistory *history , uint32_t numColumns , uint32_t depth );
+void history_free( sensorHistory *history );
+void history_push( sensorHistory *history , const uint32_t *row );
+uint32_t history_sample( const sensorHistory *history , uint32_t column , uint32_t age );
+uint32_t history_view( const sensorHistory *history , uint32_t column , uint32_t numSamples , historySpan *spans );
+void history_write_begin( historyLock *lock );
+void history_write_end( historyLock *lock );
+uint32_t history_read_begin( historyLock *lock );
+bool history_read_retry( historyLock *lock , uint32_t sequence );
+
+#endif
@@ -7,7 +7,10 @@
  *
  * Subscribe Thread: polls for a subscribe
  *
- * Publish Thread: every second, publish respective data
+ * Publish Thread: publishes the MPs that are due on their periods, and the
+ * heartbeat every second. It sleeps until the next tick of WHEEL_TICK_MS that
+ * has something due, on absolute deadlines of CLOCK_MONOTONIC so the
+ * publishes do not drift
  *
  * Sensors Thread: interfaces to FPGA to collect data.  Once
  * collected, generates logical MPs and timestamps in order to
@@ -22,6 +25,7 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
+#include <sys/un.h>
 #include <netinet/in.h>
 #include <dirent.h>
 #include <stdio.h>
@@ -36,6 +40,8 @@
 #include <signal.h>
 #include <time.h>
 #include <pthread.h>
+#include <sys/mman.h>
+#include <sys/timerfd.h>
 #include "simm_functions.h"
 #include "sensor.h"
 #include "fpga_read.h"
@@ -47,6 +53,10 @@
 char UDPAddress[]   = "225.0.0.37";
 int UDPPort_Bind         =  4097;
 int UDPPort_Dest         =  4096;
+// set by BARSM when SIMM has to lock its memory, mlockall() does not survive exec
+#define MLOCK_ENV           "RC360_MLOCKALL"
+// interval of the heartbeat of the publish thread
+#define PUBLISH_PERIOD_MS   1000
 
 // THREADS
 static pthread_t thread_publish;        // read, write TCP
@@ -71,6 +81,15 @@ bool publish = false;
 struct timespec goStart;
 char simmAppName[5] = { 's', 'i', 'm', 'm', '\0' };
 pid_t simmPid;
+// publish ticks that passed before the previous publish was done
+uint64_t publishOverruns = 0;
+// the publish thread sleeps on a one-shot timer until the next tick it has
+// work at. Ticks count WHEEL_TICK_MS from publishStart
+static int32_t publishTimerFd = -1;
+static struct timespec publishStart;
+static uint64_t publishTicks = 0;           // ticks the schedule was advanced through
+static uint64_t publishDeadline = 0;        // tick the timer is set to
+static uint64_t heartbeatTick = 0;          // tick the next heartbeat is due at
 
 topicToPublish *publishMe = NULL;
 
@@ -82,10 +101,16 @@ static void simm_shutdown(void);
 static bool setupPublishStructure(void);
 static void simm_run(void); // calls/setup the threads
 static void* simm_runtime_publish(void *param);
+static bool publishTimer_open(void);
+static void publishTimer_catchUp(void);
+static bool publishTimer_arm(void);
+static bool publishTimer_wait(void);
 static void* simm_runtime_subscribe(void *param);
 static void* read_sensors(void *param);
 bool UDPsetup(void);
 bool TCPsetup(void);
+bool UNIXsetup(const char *path);
+bool AACMsetup(void);
 
 /**
  * Calls SIMM init function.  If pass, start threads, else fail.
@@ -183,6 +208,28 @@ static bool simm_init(void) // 2.1
 
     clock_gettime( CLOCK_REALTIME , &goStart );
 
+    // lock every page now and later so the sensor thread never page faults
+    if ( NULL != getenv(MLOCK_ENV) )
+    {
+        errno = 0;
+        if ( 0 != mlockall(MCL_CURRENT | MCL_FUTURE) )
+        {
+            printf("mlockall() FAIL!\n");
+            syslog(LOG_ERR, "%s:%d unable to lock memory (%d:%s)",
+                   __FUNCTION__, __LINE__, errno, strerror(errno));
+        }
+        else
+        {
+            syslog(LOG_INFO, "%s:%d memory locked", __FUNCTION__, __LINE__);
+        }
+    }
+
+    // a SIMM that cannot be watched still runs, BARSM then only sees it exit
+    if ( false == liveness_init() )
+    {
+        printf("liveness_init() FAIL!\n");
+    }
+
 
     if (false != success)
     {
@@ -212,14 +259,14 @@ static bool simm_init(void) // 2.1
 
     if (false != success)
     {
-        success = TCPsetup();
+        success = AACMsetup();
         if (false == success)
         {
-            printf("TCPsetup() FAIL!\n");
+            printf("AACMsetup() FAIL!\n");
         }
         else
         {
-            printf("TCPsetup() SUCCESS!\n");
+            printf("AACMsetup() SUCCESS!\n");
         }
     }
 
@@ -527,6 +574,8 @@ static void* simm_runtime_subscribe(void * UNUSED(param) )
             numSub++;
             pthread_mutex_lock(&pubMutex);
 
+            // the new MPs are scheduled from the current tick
+            publishTimer_catchUp();
 
             num_topics_total++;
 
@@ -543,6 +592,8 @@ static void* simm_runtime_subscribe(void * UNUSED(param) )
             currentTopic++;
             printf("Incrementing currentTopic to %u\n", currentTopic);
 
+            // the new MPs may be due before the publish thread wakes
+            (void)publishTimer_arm();
             pthread_mutex_unlock(&pubMutex);
         }
     }
@@ -551,25 +602,156 @@ static void* simm_runtime_subscribe(void * UNUSED(param) )
 
 
 /**
- * PUBLISH thread.  Every second, publishes all available
- * topics/subscriptions ready to publish.  After publish is
- * made, determines next availble list of topics/subscriptions
- * to publish.
+ * Creates the timer of the publish thread and makes now tick 0 of the
+ * publish schedule. The timer is one-shot, see publishTimer_arm(). Called
+ * with pubMutex held.
+ *
+ * @param[in] void
+ * @param[out] success true/false status
+ *
+ * @return true/false whether the timer was created
+ */
+static bool publishTimer_open(void)
+{
+    bool success = true;
+
+    errno = 0;
+    publishTimerFd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if ( -1 == publishTimerFd )
+    {
+        syslog(LOG_ERR, "%s:%d ERROR: timerfd_create() failed! (%d: %s)", __FUNCTION__, __LINE__, errno, strerror(errno));
+        success = false;
+    }
+    else
+    {
+        clock_gettime(CLOCK_MONOTONIC, &publishStart);
+        publishTicks = 0;
+        publishDeadline = 0;
+        heartbeatTick = 0;
+    }
+
+    return success;
+}
+
+/**
+ * Advances the publish schedule through every tick that has passed since it
+ * was last advanced, flagging the MPs that came due on the way. Called with
+ * pubMutex held.
+ *
+ * @param[in] void
+ * @param[out] void
+ *
+ * @return void
+ */
+static void publishTimer_catchUp(void)
+{
+    struct timespec now;
+    int64_t elapsedNs;
+
+    if ( -1 != publishTimerFd )
+    {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        elapsedNs = ((int64_t)(now.tv_sec - publishStart.tv_sec) * 1000000000LL) +
+                    (now.tv_nsec - publishStart.tv_nsec);
+
+        while ( (int64_t)publishTicks < (elapsedNs / (WHEEL_TICK_MS * 1000000LL)) )
+        {
+            publishManager();
+            publishTicks++;
+        }
+    }
+}
+
+/**
+ * Sets the timer to the next tick the publish thread has work at: a topic
+ * on the ready list, an MP that comes due or the heartbeat. Ticks nothing is
+ * due at are slept through. The deadline is absolute on CLOCK_MONOTONIC, so a
+ * late wakeup does not move the ones after it. Called with pubMutex held,
+ * after publishTimer_catchUp().
+ *
+ * @param[in] void
+ * @param[out] success true/false status
+ *
+ * @return true/false whether the timer was set
+ */
+static bool publishTimer_arm(void)
+{
+    bool success = true;
+    uint64_t deadlineNs;
+    struct itimerspec deadline;
+
+    if ( -1 != publishTimerFd )
+    {
+        publishDeadline = publishTicks;
+        if ( heartbeatTick > publishTicks )
+        {
+            publishDeadline += publishIdleTicks( (uint32_t)(heartbeatTick - publishTicks) );
+        }
+
+        // a deadline that already passed expires right away
+        deadlineNs = (publishDeadline * WHEEL_TICK_MS * 1000000u) + (uint64_t)publishStart.tv_nsec;
+        memset(&deadline, 0, sizeof(deadline));
+        deadline.it_value.tv_sec = publishStart.tv_sec + (time_t)(deadlineNs / 1000000000u);
+        deadline.it_value.tv_nsec = (long)(deadlineNs % 1000000000u);
+
+        errno = 0;
+        if ( -1 == timerfd_settime(publishTimerFd, TFD_TIMER_ABSTIME, &deadline, NULL) )
+        {
+            syslog(LOG_ERR, "%s:%d ERROR: timerfd_settime() failed! (%d: %s)", __FUNCTION__, __LINE__, errno, strerror(errno));
+            success = false;
+        }
+    }
+
+    return success;
+}
+
+/**
+ * Sleeps until the deadline publishTimer_arm() set. The subscribe thread may
+ * move it earlier in the meantime.
+ *
+ * @param[in] void
+ * @param[out] success true/false status
+ *
+ * @return true/false whether the timer expired
+ */
+static bool publishTimer_wait(void)
+{
+    uint64_t expirations = 0;
+    ssize_t len;
+
+    do
+    {
+        errno = 0;
+        len = read(publishTimerFd, &expirations, sizeof(expirations));
+    } while ( (-1 == len) && (EINTR == errno) );
+
+    if ( sizeof(expirations) != len )
+    {
+        syslog(LOG_ERR, "%s:%d ERROR: reading the publish timer failed! (%d: %s)", __FUNCTION__, __LINE__, errno, strerror(errno));
+    }
+
+    return ( sizeof(expirations) == len );
+}
+
+/**
+ * PUBLISH thread.  Wakes at the next tick something is due at,
+ * advances the publish schedule to it and publishes the topics with
+ * MPs that came due.  Every second, sends the heartbeat.
  *
  * @param[in] void
  * @param[out] void
  *
  * @return void
  */
-// This is the thread for processing PUBLISH every second
+// This is the thread for processing PUBLISH
 static void* simm_runtime_publish(void * UNUSED(param) )
 {
     int32_t rc;
     int32_t hrtBt;
-    uint32_t numberToPublish, cntPublishes, i;
+    int32_t topic;
+    uint64_t overrunsReported;
     bool success = true;
-    bool timeHasElapsed = true;
-    struct timespec sec_begin, sec_end;
+    bool heartBeat;
 
     hrtBt = 0;
 
@@ -581,46 +763,71 @@ static void* simm_runtime_publish(void * UNUSED(param) )
     }
 
     //printf("PUBLISH THREAD STARTED!\n");
-    numberToPublish = 0;
-    nextPublishPeriod = 1000;
-    clock_gettime(CLOCK_REALTIME, &sec_begin);
+    overrunsReported = 0;
+    pthread_mutex_lock(&pubMutex);
+    if ( false == publishTimer_open() )
+    {
+        success = false;
+    }
+    pthread_mutex_unlock(&pubMutex);
 
+    // the first heartbeat is due at tick 0, right away
     while ( true == success )
     {
-        if (false == timeHasElapsed)
+        pthread_mutex_lock(&pubMutex);
+
+        publishTimer_catchUp();
+        if ( publishTicks > publishDeadline )
         {
-            clock_gettime(CLOCK_REALTIME, &sec_end);                        // time to check
-            timeHasElapsed = numSecondsHaveElapsed(sec_begin, sec_end, 1);     // check elapsed time of 1 second ... consider changing this based on nextPublishPeriod
+            publishOverruns += publishTicks - publishDeadline;
         }
-        else
+
+        heartBeat = (publishTicks >= heartbeatTick);
+        if ( true == heartBeat )
         {
             hrtBt++;
-            pthread_mutex_lock(&pubMutex);
-
             process_HeartBeat( clientSocket_TCP, hrtBt );
 
-            cntPublishes = 0;
-            for( i = 0 ; i < num_topics_total ; i++ )
+            // missed heartbeats are not made up for, the next one stays on its grid
+            while ( heartbeatTick <= publishTicks )
             {
-                if (true == publishMe[i].publishReady)
-                {
-                    //process_publish( clientSocket_UDP , DestAddr_UDP , Logicals , TimeStamp_s , TimeStamp_ns, i );
-                    process_publish( clientSocket_UDP , DestAddr_UDP , i );
-                    cntPublishes++;
-                }
-                if ( (numberToPublish == cntPublishes) && (numberToPublish == num_topics_total) )
-                {
-                    nextPublishPeriod = 0;
-                }
+                heartbeatTick += PUBLISH_PERIOD_MS / WHEEL_TICK_MS;
             }
-            pthread_mutex_unlock(&pubMutex);
-            //printf("\n\n\nFROM PUBLISH THREAD, nextPublishPeriod: %d\n", nextPublishPeriod);
-            timeHasElapsed = false;
-            clock_gettime(CLOCK_REALTIME, &sec_begin);
-            nextPublishPeriod += 1000;
-            numberToPublish = publishManager();
+        }
+
+        while ( -1 != (topic = nextReadyTopic()) )
+        {
+            process_publish( clientSocket_UDP , DestAddr_UDP , topic );
+        }
+
+        success = publishTimer_arm();
+        pthread_mutex_unlock(&pubMutex);
+
+        if ( true == heartBeat )
+        {
+            // only beats while publishing gets through pubMutex
+            liveness_beat();
+            if ( overrunsReported != publishOverruns )
+            {
+                syslog(LOG_WARNING, "%s:%d publish missed %llu tick(s), %llu in total", __FUNCTION__, __LINE__,
+                       (unsigned long long)(publishOverruns - overrunsReported), (unsigned long long)publishOverruns);
+                overrunsReported = publishOverruns;
+            }
+        }
+
+        if ( true == success )
+        {
+            success = publishTimer_wait();
         }
     }
+
+    pthread_mutex_lock(&pubMutex);
+    if ( -1 != publishTimerFd )
+    {
+        close(publishTimerFd);
+        publishTimerFd = -1;
+    }
+    pthread_mutex_unlock(&pubMutex);
     return 0;
 }
 
@@ -669,8 +876,9 @@ static void* read_sensors(void * UNUSED(param) )
 
         bufferFPGAdata();
 
-        // save copy to use
-        pthread_mutex_lock(&pubMutex);
+        // the publish thread reads the histories without waiting on us, and
+        // reads again if it overlapped this update
+        history_write_begin(&sensorLock);
 
         // GET LOGICAL VALUES FROM REGISTERS
         //make_logicals(&voltages[0]);
@@ -682,14 +890,16 @@ static void* read_sensors(void * UNUSED(param) )
         calculate_timestamps();
         // ADD ERROR CHECKING FOR STATUS
 
-        pthread_mutex_unlock(&pubMutex);
+        history_write_end(&sensorLock);
     }
     return 0;
 }
 
 
 /**
- * Establish UDP socket.
+ * Establish UDP socket. When BARSM created the socket for us (sockets= in the
+ * manifest) it is already bound and joined to the multicast group, and is
+ * used as it is.
  *
  * @param[in] void
  * @param[out] true/false
@@ -700,9 +910,22 @@ bool UDPsetup(void)
 {
 
     bool success = true;
+    bool adopted = false;
     struct ip_mreq mreq;
+    char *listenFds = getenv(LISTEN_FDS_ENV);
+    int sockType = 0;
+    socklen_t typeLen = sizeof(sockType);
 
-    if (true == success)
+    if ((NULL != listenFds) && (1 <= atoi(listenFds)) &&
+        (0 == getsockopt(LISTEN_FD_START, SOL_SOCKET, SO_TYPE, &sockType, &typeLen)) &&
+        (SOCK_DGRAM == sockType))
+    {
+        clientSocket_UDP = LISTEN_FD_START;
+        adopted = true;
+        syslog(LOG_INFO, "%s:%d using the UDP socket from BARSM", __FUNCTION__, __LINE__);
+    }
+
+    if ((true == success) && (false == adopted))
     {
         errno = 0;
         clientSocket_UDP = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
@@ -714,7 +937,7 @@ bool UDPsetup(void)
         }
     }
 
-    if (true == success)
+    if ((true == success) && (false == adopted))
     {
         int reuseAddr = 1;
         errno = 0;
@@ -726,7 +949,7 @@ bool UDPsetup(void)
         }
     }
 
-    if (true == success)
+    if ((true == success) && (false == adopted))
     {
         struct sockaddr_in bind_addr;
 
@@ -744,7 +967,7 @@ bool UDPsetup(void)
         }
     }
 
-    if (true == success)
+    if ((true == success) && (false == adopted))
     {
         errno = 0;
         mreq.imr_multiaddr.s_addr = inet_addr(UDPAddress);
@@ -821,6 +1044,81 @@ bool TCPsetup(void)
     return success;
 }
 
+/**
+ * Establish AF_UNIX SOCK_SEQPACKET socket to AACM. Every message is one
+ * packet, so each recv() returns exactly one message.
+ *
+ * @param[in] path: the path AACM listens on
+ * @param[out] true/false
+ *
+ * @return true/false status of socket setup.
+ */
+bool UNIXsetup(const char *path)
+{
+    bool success = true;
+    struct sockaddr_un addr;
+
+    if (sizeof(addr.sun_path) <= strlen(path))
+    {
+        printf("ERROR UNIX socket path too long \n");
+        success = false;
+        syslog(LOG_ERR, "%s:%d ERROR! AACM socket path %s is too long", __FUNCTION__, __LINE__, path);
+    }
+
+    if (true == success)
+    {
+        errno = 0;
+        clientSocket_TCP = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+        if (0 > clientSocket_TCP)
+        {
+            printf("ERROR WITH UNIX socket() config \n");
+            success = false;
+            syslog(LOG_ERR, "%s:%d ERROR! Failed to create socket %d (%d:%s) ", __FUNCTION__, __LINE__, clientSocket_TCP, errno, strerror(errno));
+        }
+    }
+
+    if (true == success)
+    {
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, path);
+
+        errno = 0;
+        if (0 != connect(clientSocket_TCP, (struct sockaddr *)&addr, sizeof(addr)))
+        {
+            printf("ERROR UNIX connect() \n");
+            success = false;
+            syslog(LOG_ERR, "%s:%d ERROR! UNIX socket failed to connect to %s (%d:%s) ", __FUNCTION__, __LINE__, path, errno, strerror(errno));
+        }
+    }
+    return success;
+}
+
+/**
+ * Establish the control connection to AACM, over the UNIX socket BARSM passes
+ * in AACM_SOCKET_ENV if it is set, over TCP otherwise.
+ *
+ * @param[in] void
+ * @param[out] true/false
+ *
+ * @return true/false status of socket setup.
+ */
+bool AACMsetup(void)
+{
+    bool success = true;
+    const char *path = getenv(AACM_SOCKET_ENV);
+
+    if ((NULL != path) && ('\0' != path[0]))
+    {
+        success = UNIXsetup(path);
+    }
+    else
+    {
+        success = TCPsetup();
+    }
+    return success;
+}
+
 /**
  * Initial allocation of publish structs and associated
  * elements.
@@ -834,7 +1132,6 @@ bool setupPublishStructure(void)
 {
     currentTopic        = 0;
     num_topics_total    = 0;
-    prevPeriodChk       = 0;
 
     return true;
 }
@@ -26,6 +26,7 @@
 #include <unistd.h>
 #include <stdint.h>
 #include <math.h>
+#include <sys/mman.h>
 #include "simm_functions.h"
 #include "sensor.h"
 
@@ -35,6 +36,9 @@
 ****************/
 #define MAXBUFSIZE  1000
 
+// this process's counter on the BARSM heartbeat page, NULL if not watched
+static volatile uint64_t *livenessCounter = NULL;
+
 extern int32_t clientSocket;
 struct sockaddr_storage serverStorage_UDP;
 struct sockaddr_storage toRcvUDP;
@@ -50,9 +54,52 @@ int32_t subAppName;
 uint32_t num_topics_total = 0;
 uint32_t num_topics_atCurrentRate;
 uint32_t currentTopic = 0;
-int32_t maxPublishPeriod;
-int32_t prevPeriodChk;
-int32_t nextPublishPeriod;
+
+// when the valid MPs are due, and the topics with due MPs in the order they
+// became ready.  Both belong to pubMutex
+static publishWheel publishSchedule;
+static int32_t firstReadyTopic = -1;
+static int32_t lastReadyTopic = -1;
+
+// where the samples of every MP the SIMM publishes are kept.
+// buildPublishData() copies the entry of each subscribed MP into its MPinfo
+// so a publish copies the samples without looking the MP up again
+typedef struct
+{
+    uint32_t mp;
+    const sensorHistory *history;
+    uint32_t column;
+} publishPlanEntry;
+
+static const publishPlanEntry publishPlan[] =
+{
+    // logicals, one per MINPER
+    { MP_PFP_VALUE          , &logicalHistory   , LOGICAL_PFP },
+    { MP_PTLT_TEMPERATURE   , &logicalHistory   , LOGICAL_PTLT },
+    { MP_PTRT_TEMPERATURE   , &logicalHistory   , LOGICAL_PTRT },
+    { MP_TCMP               , &logicalHistory   , LOGICAL_TCMP },
+    { MP_COP_PRESSURE       , &logicalHistory   , LOGICAL_COP },
+
+    // timestamps, MAX_TIMESTAMPS per MINPER
+    { MP_CAM_SEC_1          , &timestampHistory , TS_SEC_COLUMN(0) },
+    { MP_CAM_SEC_2          , &timestampHistory , TS_SEC_COLUMN(1) },
+    { MP_CAM_SEC_3          , &timestampHistory , TS_SEC_COLUMN(2) },
+    { MP_CAM_SEC_4          , &timestampHistory , TS_SEC_COLUMN(3) },
+    { MP_CAM_SEC_5          , &timestampHistory , TS_SEC_COLUMN(4) },
+    { MP_CAM_SEC_6          , &timestampHistory , TS_SEC_COLUMN(5) },
+    { MP_CAM_SEC_7          , &timestampHistory , TS_SEC_COLUMN(6) },
+    { MP_CAM_SEC_8          , &timestampHistory , TS_SEC_COLUMN(7) },
+    { MP_CAM_SEC_9          , &timestampHistory , TS_SEC_COLUMN(8) },
+    { MP_CAM_NSEC_1         , &timestampHistory , TS_NSEC_COLUMN(0) },
+    { MP_CAM_NSEC_2         , &timestampHistory , TS_NSEC_COLUMN(1) },
+    { MP_CAM_NSEC_3         , &timestampHistory , TS_NSEC_COLUMN(2) },
+    { MP_CAM_NSEC_4         , &timestampHistory , TS_NSEC_COLUMN(3) },
+    { MP_CAM_NSEC_5         , &timestampHistory , TS_NSEC_COLUMN(4) },
+    { MP_CAM_NSEC_6         , &timestampHistory , TS_NSEC_COLUMN(5) },
+    { MP_CAM_NSEC_7         , &timestampHistory , TS_NSEC_COLUMN(6) },
+    { MP_CAM_NSEC_8         , &timestampHistory , TS_NSEC_COLUMN(7) },
+    { MP_CAM_NSEC_9         , &timestampHistory , TS_NSEC_COLUMN(8) },
+};
 
 /**
  * Used to package data to be sent for registering the
@@ -1068,6 +1115,39 @@ bool process_sysInit( int32_t csocket )
  * @return void
  */
 void process_publish( int32_t csocket , struct sockaddr_in addr_in , int32_t topic_to_pub )
+{
+    uint8_t sendData[ PUBLISHBUFSIZE ];
+    socklen_t toSendUDP_size;
+
+    int32_t cntBytes    = 0;
+    int32_t sendBytes   = 0;
+
+    cntBytes = serializePublish( topic_to_pub , sendData );
+
+    toSendUDP_size = sizeof(addr_in);
+    sendBytes = sendto(csocket, sendData, cntBytes, 0, (struct sockaddr *)&addr_in, toSendUDP_size);
+
+    if ( cntBytes != sendBytes )
+    {
+        printf("ERROR, publish, sent bytes don't equal message size\n");
+        syslog(LOG_ERR, "%s:%d ERROR! insufficient message data %u != %u", __FUNCTION__, __LINE__, sendBytes, cntBytes);
+    }
+}
+
+/**
+ * Builds the publish message of a topic from the MPs that are due, and
+ * clears their due flag.  The samples of each MP are copied as its publish
+ * plan lays them out, see compilePublishPlan().  The sensor thread may push
+ * a row meanwhile: the samples are copied again until they all come from
+ * the same rows.
+ *
+ * @param[in] topic_to_pub topic id (per subscription) to
+ *       publish
+ * @param[out] sendData message, PUBLISHBUFSIZE bytes
+ *
+ * @return number of bytes of the message
+ */
+int32_t serializePublish( int32_t topic_to_pub , uint8_t *sendData )
 {
     enum publish_params
     {
@@ -1078,26 +1158,23 @@ void process_publish( int32_t csocket , struct sockaddr_in addr_in , int32_t top
         SEQ_NUM                 = 2,
         MP                      = 4,
         MP_VAL                  = 4,
-        MSG_SIZE                =   CMD_ID +
-                                    LENGTH +
-                                    TOPIC_ID +
-                                    NUM_MPS +
-                                    SEQ_NUM +
-                                    5*(MP + MP_VAL),
     };
 
+    MPinfo *mpInfo;
+    historySpan spans[ 2 ];
+    uint32_t numSpans;
+    uint32_t sequence;
+    uint8_t *mpStart;
+    int32_t mpStartBytes;
     uint8_t *ptr;
     int16_t val16;
     int32_t val32;
     uint8_t *msgLenPtr;
-    uint8_t sendData[ MAXBUFSIZE ];
     uint16_t actualLength = 0;
-    socklen_t toSendUDP_size;
 
     uint32_t i          = 0;
     uint32_t j          = 0;
     int32_t cntBytes    = 0;
-    int32_t sendBytes   = 0;
 
 
     ptr = sendData;
@@ -1115,7 +1192,15 @@ void process_publish( int32_t csocket , struct sockaddr_in addr_in , int32_t top
     ptr += TOPIC_ID;
     cntBytes += TOPIC_ID;
 
-    val32 = publishMe[ topic_to_pub ].numMPs;
+    // only the MPs that are due go out
+    val32 = 0;
+    for( i = 0 ; i < publishMe[ topic_to_pub ].numMPs ; i++ )
+    {
+        if (true == publishMe[ topic_to_pub ].topicSubscription[ i ].due)
+        {
+            val32++;
+        }
+    }
     memcpy(ptr, &val32, sizeof(val32));
     ptr += NUM_MPS;
     cntBytes += NUM_MPS;
@@ -1126,151 +1211,45 @@ void process_publish( int32_t csocket , struct sockaddr_in addr_in , int32_t top
     ptr += SEQ_NUM;
     cntBytes += SEQ_NUM;
 
-    for( i = 0 ; i < publishMe[ topic_to_pub ].numMPs ; i++ )
+    mpStart = ptr;
+    mpStartBytes = cntBytes;
+    do
     {
-        val32 = publishMe[ topic_to_pub ].topicSubscription[ i ].mp;
-        memcpy(ptr, &val32, sizeof(val32));
-        ptr += MP;
-        cntBytes += MP;
-        for ( j = 0 ; j < publishMe[ topic_to_pub ].topicSubscription[ i ].numSamples ; j++ )
+        sequence = history_read_begin( &sensorLock );
+        ptr = mpStart;
+        cntBytes = mpStartBytes;
+
+        for( i = 0 ; i < publishMe[ topic_to_pub ].numMPs ; i++ )
         {
-            // logicals
-            if (publishMe[ topic_to_pub ].topicSubscription[ i ].mp == MP_PFP_VALUE )
-            {
-                val32 = pfp_values[j];
-                memcpy(ptr, &val32, sizeof(val32));
-            }
-            else if (publishMe[ topic_to_pub ].topicSubscription[ i ].mp == MP_PTLT_TEMPERATURE )
-            {
-                val32 = pfp_values[j];
-                memcpy(ptr, &val32, sizeof(val32));
-            }
-            else if (publishMe[ topic_to_pub ].topicSubscription[ i ].mp == MP_PTRT_TEMPERATURE )
+            mpInfo = &publishMe[ topic_to_pub ].topicSubscription[ i ];
+            if (true == mpInfo->due)
             {
-                val32 = pfp_values[j];
+                val32 = mpInfo->mp;
                 memcpy(ptr, &val32, sizeof(val32));
-            }
-            else if (publishMe[ topic_to_pub ].topicSubscription[ i ].mp == MP_TCMP )
-            {
-                val32 = pfp_values[j];
-                memcpy(ptr, &val32, sizeof(val32));
-            }
-            else if (publishMe[ topic_to_pub ].topicSubscription[ i ].mp == MP_COP_PRESSURE )
-            {
-                val32 = pfp_values[j];
-                memcpy(ptr, &val32, sizeof(val32));
-            }
+                ptr += MP;
+                cntBytes += MP;
 
-            // timestamps
-            else if  (publishMe[ topic_to_pub ].topicSubscription[ i ].mp == MP_CAM_SEC_1)
-            {
-                val32 = cam_secs_chk[j*9+0];
-                memcpy(ptr, &val32, sizeof(val32));
-            }
-            else if (publishMe[ topic_to_pub ].topicSubscription[ i ].mp == MP_CAM_SEC_2 )
-            {
-                val32 = cam_secs_chk[j*9+1];
-                memcpy(ptr, &val32, sizeof(val32));
-            }
-            else if (publishMe[ topic_to_pub ].topicSubscription[ i ].mp == MP_CAM_SEC_3 )
-            {
-                val32 = cam_secs_chk[j*9+2];
-                memcpy(ptr, &val32, sizeof(val32));
-            }
-            else if (publishMe[ topic_to_pub ].topicSubscription[ i ].mp == MP_CAM_SEC_4 )
-            {
-                val32 = cam_secs_chk[j*9+3];
-                memcpy(ptr, &val32, sizeof(val32));
-            }
-            else if (publishMe[ topic_to_pub ].topicSubscription[ i ].mp == MP_CAM_SEC_5 )
-            {
-                val32 = cam_secs_chk[j*9+4];
-                memcpy(ptr, &val32, sizeof(val32));
-            }
-            else if (publishMe[ topic_to_pub ].topicSubscription[ i ].mp == MP_CAM_SEC_6 )
-            {
-                val32 = cam_secs_chk[j*9+5];
-                memcpy(ptr, &val32, sizeof(val32));
-            }
-            else if (publishMe[ topic_to_pub ].topicSubscription[ i ].mp == MP_CAM_SEC_7 )
-            {
-                val32 = cam_secs_chk[j*9+6];
-                memcpy(ptr, &val32, sizeof(val32));
-            }
-            else if (publishMe[ topic_to_pub ].topicSubscription[ i ].mp == MP_CAM_SEC_8 )
-            {
-                val32 = cam_secs_chk[j*9+7];
-                memcpy(ptr, &val32, sizeof(val32));
-            }
-            else if (publishMe[ topic_to_pub ].topicSubscription[ i ].mp == MP_CAM_SEC_9 )
-            {
-                val32 = cam_secs_chk[j*9+8];
-                memcpy(ptr, &val32, sizeof(val32));
-            }
-            else if (publishMe[ topic_to_pub ].topicSubscription[ i ].mp == MP_CAM_NSEC_1)
-            {
-                val32 = cam_nsecs_chk[j*9+0];
-                memcpy(ptr, &val32, sizeof(val32));
-            }
-            else if (publishMe[ topic_to_pub ].topicSubscription[ i ].mp == MP_CAM_NSEC_2 )
-            {
-                val32 = cam_nsecs_chk[j*9+1];
-                memcpy(ptr, &val32, sizeof(val32));
-            }
-            else if (publishMe[ topic_to_pub ].topicSubscription[ i ].mp == MP_CAM_NSEC_3 )
-            {
-                val32 = cam_nsecs_chk[j*9+2];
-                memcpy(ptr, &val32, sizeof(val32));
-            }
-            else if (publishMe[ topic_to_pub ].topicSubscription[ i ].mp == MP_CAM_NSEC_4 )
-            {
-                val32 = cam_nsecs_chk[j*9+3];
-                memcpy(ptr, &val32, sizeof(val32));
-            }
-            else if (publishMe[ topic_to_pub ].topicSubscription[ i ].mp == MP_CAM_NSEC_5 )
-            {
-                val32 = cam_nsecs_chk[j*9+4];
-                memcpy(ptr, &val32, sizeof(val32));
-            }
-            else if (publishMe[ topic_to_pub ].topicSubscription[ i ].mp == MP_CAM_NSEC_6 )
-            {
-                val32 = cam_nsecs_chk[j*9+5];
-                memcpy(ptr, &val32, sizeof(val32));
-            }
-            else if (publishMe[ topic_to_pub ].topicSubscription[ i ].mp == MP_CAM_NSEC_7 )
-            {
-                val32 = cam_nsecs_chk[j*9+6];
-                memcpy(ptr, &val32, sizeof(val32));
-            }
-            else if (publishMe[ topic_to_pub ].topicSubscription[ i ].mp == MP_CAM_NSEC_8 )
-            {
-                val32 = cam_nsecs_chk[j*9+7];
-                memcpy(ptr, &val32, sizeof(val32));
-            }
-            else if (publishMe[ topic_to_pub ].topicSubscription[ i ].mp == MP_CAM_NSEC_9 )
-            {
-                val32 = cam_nsecs_chk[j*9+8];
-                memcpy(ptr, &val32, sizeof(val32));
+                numSpans = history_view( mpInfo->history , mpInfo->column , mpInfo->numSamples , spans );
+                for ( j = 0 ; j < numSpans ; j++ )
+                {
+                    memcpy(ptr, spans[ j ].values, spans[ j ].count * MP_VAL);
+                    ptr += spans[ j ].count * MP_VAL;
+                }
+                cntBytes += mpInfo->numSamples * MP_VAL;
             }
-            ptr += MP_VAL;
-            cntBytes += MP_VAL;
         }
+    } while ( true == history_read_retry( &sensorLock , sequence ) );
+
+    for( i = 0 ; i < publishMe[ topic_to_pub ].numMPs ; i++ )
+    {
+        publishMe[ topic_to_pub ].topicSubscription[ i ].due = false;
     }
-    *ptr = cntBytes;
-    ptr += cntBytes;
 
     // actual length
     actualLength = cntBytes - CMD_ID - LENGTH;
     memcpy( msgLenPtr , &actualLength , sizeof(uint16_t) );
 
-    toSendUDP_size = sizeof(addr_in);
-    sendBytes = sendto(csocket, sendData, cntBytes, 0, (struct sockaddr *)&addr_in, toSendUDP_size);
-
-    if ( cntBytes != sendBytes )
-    {
-        printf("ERROR, publish, sent bytes don't equal message size\n");
-        syslog(LOG_ERR, "%s:%d ERROR! insufficient message data %u != %u", __FUNCTION__, __LINE__, sendBytes, cntBytes);
-    }
+    return cntBytes;
 }
 
 
@@ -1636,6 +1615,36 @@ bool process_HeartBeat( int32_t csocket, int32_t HeartBeat )
 }
 
 
+/**
+ * Looks up where the samples of an MP are kept and stores it in the MP, so
+ * serializePublish() copies them without dispatching on the MP.
+ *
+ * @param[in] mpInfo subscribed MP, mp set
+ * @param[out] mpInfo source, first and stride set when the SIMM publishes the MP
+ *
+ * @return true if the SIMM publishes the MP, false otherwise
+ */
+bool compilePublishPlan( MPinfo *mpInfo )
+{
+    bool success = false;
+    uint32_t i;
+
+    mpInfo->history = NULL;
+    mpInfo->column  = 0;
+
+    for( i = 0 ; (i < sizeof(publishPlan)/sizeof(publishPlan[0])) && (false == success) ; i++ )
+    {
+        if ( publishPlan[ i ].mp == mpInfo->mp )
+        {
+            mpInfo->history = publishPlan[ i ].history;
+            mpInfo->column  = publishPlan[ i ].column;
+            success = true;
+        }
+    }
+
+    return success;
+}
+
 /**
  * This set of data (publishMe) is built based on the
  * current subscription.  After a SUBSCRIBE() and before
@@ -1653,36 +1662,10 @@ bool buildPublishData(void)
     bool success = true;
     uint32_t i;
     uint32_t  k;
-    int32_t periodVar;
-    int32_t numMPsMatching;
-    int32_t numSamplesToChk, remainder;
-
-    const uint32_t SIMMsubscriptionMP[ MAX_SIMM_SUBSCRIPTION ] =
-    {
-        MP_PFP_VALUE,
-        MP_PTLT_TEMPERATURE,
-        MP_PTRT_TEMPERATURE,
-        MP_TCMP,
-        MP_CAM_SEC_1,
-        MP_CAM_NSEC_1,
-        MP_CAM_SEC_2,
-        MP_CAM_NSEC_2,
-        MP_CAM_SEC_3,
-        MP_CAM_NSEC_3,
-        MP_CAM_SEC_4,
-        MP_CAM_NSEC_4,
-        MP_CAM_SEC_5,
-        MP_CAM_NSEC_5,
-        MP_CAM_SEC_6,
-        MP_CAM_NSEC_6,
-        MP_CAM_SEC_7,
-        MP_CAM_NSEC_7,
-        MP_CAM_SEC_8,
-        MP_CAM_NSEC_8,
-        MP_CAM_SEC_9,
-        MP_CAM_NSEC_9,
-        MP_COP_PRESSURE
-    };
+    bool schedulable;
+    int32_t numSamplesToChk;
+    uint32_t mpSize;
+    uint32_t publishSize = PUBLISH_HDR_SIZE;
 
     // for new topic/subscription
     publishMe = realloc(publishMe, sizeof(topicToPublish)*num_topics_total);
@@ -1697,6 +1680,7 @@ bool buildPublishData(void)
         publishMe[ currentTopic ].app_name     = subAppName;
         publishMe[ currentTopic ].numMPs       = MPnum;
         publishMe[ currentTopic ].publishReady = false;
+        publishMe[ currentTopic ].nextReady    = -1;
         
         // for MPs
         publishMe[ currentTopic ].topicSubscription = malloc(sizeof(MPinfo)*publishMe[ currentTopic ].numMPs);
@@ -1738,6 +1722,7 @@ bool buildPublishData(void)
             publishMe[ currentTopic ].topicSubscription[ k ].period         = sub_mpPer[ k ];
             publishMe[ currentTopic ].topicSubscription[ k ].numSamples     = sub_mpNumSamples[ k ];
             publishMe[ currentTopic ].topicSubscription[ k ].valid          = false;
+            publishMe[ currentTopic ].topicSubscription[ k ].due            = false;
 
             // if MP is logical
             if ( (publishMe[ currentTopic ].topicSubscription[ k ].mp == MP_PFP_VALUE ) ||
@@ -1779,147 +1764,106 @@ bool buildPublishData(void)
     {
         for (k = 0; (k < publishMe[ currentTopic ].numMPs) && (true == success); k++)
         {
-            numMPsMatching = 0;
-            for( i = 0 ; i < MAX_SIMM_SUBSCRIPTION ; i++ )
-            {
-                if( SIMMsubscriptionMP[ i ] == publishMe[ currentTopic ].topicSubscription[ k ].mp )
-                {
-                    numMPsMatching++;
-                }
-            } /* for( i = 0 ; i < MAX_SIMM_SUBSCRIPTION ; i++ ) */
-#if 0
-                    syslog(LOG_DEBUG, "%s:%d sub[%d][%d] (%d) match %d found at index %d",
-                           __FUNCTION__, __LINE__, currentTopic, k,
-                           SIMMsubscriptionMP[i], numMPsMatching, i);
-#endif
+            schedulable = compilePublishPlan( &publishMe[ currentTopic ].topicSubscription[ k ] );
+            mpSize = sizeof(uint32_t) * (1 + publishMe[ currentTopic ].topicSubscription[ k ].numSamples);
 
-            // checks numer of samples requested based on period requested and whatever the minimum period is configured.
-            numSamplesToChk = publishMe[currentTopic].topicSubscription[k].numSamples * MINPER;
-            remainder = publishMe[currentTopic].topicSubscription[k].period % MINPER;
+            // checks numer of samples requested based on period requested: one per whole MINPER, at least one.
+            numSamplesToChk = publishMe[currentTopic].topicSubscription[k].period / MINPER;
+            if ( 0 == numSamplesToChk )
+            {
+                numSamplesToChk = 1;
+            }
 #if 0
-            syslog(LOG_DEBUG, "%s:%d sub[%d][%d] samples %d * %d = %d ?= period %d (remainder %d)",
+            syslog(LOG_DEBUG, "%s:%d sub[%d][%d] samples %d ?= %d for period %d",
                    __FUNCTION__, __LINE__, currentTopic, k,
-                   publishMe[currentTopic].topicSubscription[k].numSamples, MINPER, numSamplesToChk,
-                   publishMe[currentTopic].topicSubscription[k].period, remainder);
+                   publishMe[currentTopic].topicSubscription[k].numSamples, numSamplesToChk,
+                   publishMe[currentTopic].topicSubscription[k].period);
 #endif
-            if ( 0 == remainder )
+            if ( WHEEL_TICK_MS > publishMe[currentTopic].topicSubscription[k].period )
             {
-                if ( numSamplesToChk != publishMe[currentTopic].topicSubscription[k].period )
-                {
-                    printf("INVALID SUBSCRIPTION: MP number of samples doesn't correspond to the period requested \n");
-                    syslog(LOG_ERR, "%s:%d INVALID SUBSCRIPTION: sub[%d][%d] MP %d: invalid period %d * %d != %d",
-                           __FUNCTION__, __LINE__, currentTopic, k,
-                           publishMe[currentTopic].topicSubscription[k].mp,
-                           publishMe[currentTopic].topicSubscription[k].numSamples, MINPER,
-                           publishMe[currentTopic].topicSubscription[k].period);
-                    numSamplesToChk = 0;
-                }
+                printf("INVALID SUBSCRIPTION: MP PERIOD shorter than the minimum period allowed \n");
+                syslog(LOG_ERR, "%s:%d INVALID SUBSCRIPTION: sub[%d][%d] MP %d: invalid period %d < %d",
+                       __FUNCTION__, __LINE__, currentTopic, k,
+                       publishMe[currentTopic].topicSubscription[k].mp,
+                       publishMe[currentTopic].topicSubscription[k].period, WHEEL_TICK_MS);
+                numSamplesToChk = 0;
             }
-            else
+            else if ( (uint32_t)numSamplesToChk != publishMe[currentTopic].topicSubscription[k].numSamples )
+            {
+                printf("INVALID SUBSCRIPTION: MP number of samples doesn't correspond to the period requested \n");
+                syslog(LOG_ERR, "%s:%d INVALID SUBSCRIPTION: sub[%d][%d] MP %d: invalid samples %d != %d for period %d",
+                       __FUNCTION__, __LINE__, currentTopic, k,
+                       publishMe[currentTopic].topicSubscription[k].mp,
+                       publishMe[currentTopic].topicSubscription[k].numSamples, numSamplesToChk,
+                       publishMe[currentTopic].topicSubscription[k].period);
+                numSamplesToChk = 0;
+            }
+            else if ( MAX_DATA_PERIOD < publishMe[currentTopic].topicSubscription[k].numSamples )
+            {
+                printf("INVALID SUBSCRIPTION: MP number of samples exceeds the samples kept \n");
+                syslog(LOG_ERR, "%s:%d INVALID SUBSCRIPTION: sub[%d][%d] MP %d: invalid samples %d > %d",
+                       __FUNCTION__, __LINE__, currentTopic, k,
+                       publishMe[currentTopic].topicSubscription[k].mp,
+                       publishMe[currentTopic].topicSubscription[k].numSamples, MAX_DATA_PERIOD);
+                numSamplesToChk = 0;
+            }
+            else if ( (true == schedulable) && (PUBLISHBUFSIZE < publishSize + mpSize) )
             {
-                printf("INVALID SUBSCRIPTION: MP PERIOD not integer multiple of minimum period allowed \n");
-                syslog(LOG_ERR, "%s:%d INVALID SUBSCRIPTION: sub[%d][%d] MP %d: invalid period %d %% %d != 0",
+                printf("INVALID SUBSCRIPTION: MP doesn't fit in the publish of its topic \n");
+                syslog(LOG_ERR, "%s:%d INVALID SUBSCRIPTION: sub[%d][%d] MP %d: publish size %u > %d",
                        __FUNCTION__, __LINE__, currentTopic, k,
                        publishMe[currentTopic].topicSubscription[k].mp,
-                       publishMe[currentTopic].topicSubscription[k].period, MINPER);
+                       publishSize + mpSize, PUBLISHBUFSIZE);
                 numSamplesToChk = 0;
             }
 
-            // determines valid and invalid MPs based on (1) if MP is schedulable and (2) number of samples and period
-            if ( ( 0 == numMPsMatching ) || ( 0 == numSamplesToChk ) )
+            // determines valid and invalid MPs based on (1) if MP is schedulable, (2) number of samples and period
+            // and (3) room left in the publish
+            if ( ( false == schedulable ) || ( 0 == numSamplesToChk ) )
             {
                 publishMe[ currentTopic ].topicSubscription[ k ].valid = false;
             }
             else
             {
                 publishMe[ currentTopic ].topicSubscription[ k ].valid = true;
+                publishSize += mpSize;
             }
         } /* for (k = 0; (k < publishMe[ currentTopic ].numMPs) && (true == success); k++) */
 
-        periodVar = getVarPeriod();
-
+        // every valid MP is published on its own period, MPs of the topic that
+        // are due at the same tick go out in the same publish
+        publishMe[ currentTopic ].period    = 0;
+        publishMe[ currentTopic ].topic_id  = -1;
         for( i = 0 ; i < publishMe[currentTopic].numMPs ; i++ )
         {
-            if ( (0 == periodVar) ) // all periods the same?
+            if ( true == publishMe[ currentTopic ].topicSubscription[ i ].valid )
             {
-                publishMe[ currentTopic ].period = publishMe[ currentTopic ].topicSubscription[ 0 ].period;
                 publishMe[ currentTopic ].topic_id  = 1000 + currentTopic; // + getTopicId( publishMe[ currentTopic ].app_name );
 
-                // determine max publish period
-                if (publishMe[ currentTopic ].topicSubscription[ 0 ].period > prevPeriodChk)
+                // the topic period is the shortest one of its MPs
+                if ( (0 == publishMe[ currentTopic ].period) ||
+                     ((uint32_t)publishMe[ currentTopic ].topicSubscription[ i ].period < publishMe[ currentTopic ].period) )
                 {
-                    maxPublishPeriod = publishMe[ currentTopic ].topicSubscription[ 0 ].period;
+                    publishMe[ currentTopic ].period = publishMe[ currentTopic ].topicSubscription[ i ].period;
                 }
 
-                // set all 1 sec publish periods to true for "ready to publish"
-                if (1000 == publishMe[ currentTopic ].topicSubscription[ 0 ].period )
-                {
-                    publishMe[ currentTopic ].publishReady = true;
-                }
-                else
-                {
-                    publishMe[ currentTopic ].publishReady = false;
-                }
+                publishMe[ currentTopic ].topicSubscription[ i ].schedule.topic  = currentTopic;
+                publishMe[ currentTopic ].topicSubscription[ i ].schedule.mp     = i;
+                publishMe[ currentTopic ].topicSubscription[ i ].schedule.period = publishMe[ currentTopic ].topicSubscription[ i ].period / WHEEL_TICK_MS;
+                wheel_add( &publishSchedule , &publishMe[ currentTopic ].topicSubscription[ i ].schedule );
             }
-            else
-            {
-                printf("INVALID SUBSCRIPTION: periods are not all the same \n");
-                publishMe[ currentTopic ].topicSubscription[ i ].valid = false;
-                syslog(LOG_ERR, "%s:%d INVALID SUBSCRIPTION",__FUNCTION__, __LINE__);
-                publishMe[ currentTopic ].period    = 0;
-                publishMe[ currentTopic ].topic_id  = -1;
-            }
-        } /* for( i = 0 ; i < publishMe[currentTopic].numMPs ; i++ ) */
+        }
 
-        prevPeriodChk  = publishMe[ currentTopic ].topicSubscription[ 0 ].period;
+        if ( 0 == publishMe[ currentTopic ].period )
+        {
+            printf("INVALID SUBSCRIPTION: no valid MP to publish \n");
+            syslog(LOG_ERR, "%s:%d INVALID SUBSCRIPTION",__FUNCTION__, __LINE__);
+        }
     } /* if (true == success) */
 
     return success;
 }
 
-/**
- * Used to determine variance of subscribed periods.  Since they
- * should be the same, variance should equal 0.
- *
- *
- * @param[in] void
- * @param[out] var variance of subscribed periods
- *
- * @return variance of subscribed periods
- */
-int32_t getVarPeriod(void)
-{
-    uint32_t i;
-    int32_t avg;
-    int32_t sum;
-    int32_t var;
-    int32_t diff;
-    int32_t sq_diff;
-
-    avg     = 0;
-    sum     = 0;
-    var     = 0;
-    diff    = 0;
-    sq_diff = 0;
-
-    for( i = 0 ; i < publishMe[currentTopic].numMPs ; i++ )
-    {
-        sum = sum + publishMe[ currentTopic ].topicSubscription[ i ].period;
-    }
-
-    avg = sum / publishMe[currentTopic].numMPs;
-
-    for( i = 0 ; i < publishMe[currentTopic].numMPs ; i++ )
-    {
-        diff    = publishMe[ currentTopic ].topicSubscription[ i ].period - avg;
-        sq_diff = diff * diff;
-        var     = var + sq_diff;
-    }
-
-    var = var / ( publishMe[currentTopic].numMPs - 1 );
-    return var;
-}
-
 /**
  * Determines if numSeconds have elapsed.  If numSeconds have
  * elapsed, success is true.  Else, success if false.
@@ -1959,42 +1903,152 @@ bool numSecondsHaveElapsed( struct timespec startTime , struct timespec stopTime
 }
 
 /**
- * Returns number of topics to publish during next 1 second
- * interval.  Flags the next set of available topics to publish.
+ * Advances the publish schedule by one tick of WHEEL_TICK_MS.  Flags
+ * the MPs that are due at the new tick and puts their topics on the
+ * ready list, see nextReadyTopic().  Costs the same however many
+ * topics are subscribed.
  *
  * @param[in] void
- * @param[out] numToPub Returns number of topics to publish
- * during next 1 second interval.
+ * @param[out] numToPub Returns number of topics that became ready
  *
- * @return Returns number of topics to publish during next 1 second
- * interval.
+ * @return Returns number of topics that became ready
  */
 int32_t publishManager(void)
 {
-    // determines next group of subscriptions to publish based on next possible time to publish (every second)
-    // publishMe holds the subscription data to publish
-
     int32_t numToPub = 0;
-    uint32_t i;
+    wheelEntry *entry;
+    wheelEntry *next;
 
-    // only happens once.
-    if ( 0 == nextPublishPeriod )
+    entry = wheel_tick( &publishSchedule );
+    while ( NULL != entry )
     {
-        nextPublishPeriod = 1000;
+        next = entry->next;
+
+        publishMe[ entry->topic ].topicSubscription[ entry->mp ].due = true;
+        if ( false == publishMe[ entry->topic ].publishReady )
+        {
+            publishMe[ entry->topic ].publishReady = true;
+            publishMe[ entry->topic ].nextReady = -1;
+            if ( -1 == lastReadyTopic )
+            {
+                firstReadyTopic = entry->topic;
+            }
+            else
+            {
+                publishMe[ lastReadyTopic ].nextReady = entry->topic;
+            }
+            lastReadyTopic = entry->topic;
+            numToPub++;
+        }
+
+        // this tick is its expiration, so the next one stays on its grid
+        wheel_add( &publishSchedule , entry );
+        entry = next;
     }
 
-    for( i = 0 ; i < num_topics_total ; i++ )
+    return numToPub;
+}
+
+/**
+ * Takes the next topic off the ready list.  Its due MPs are cleared
+ * by process_publish().
+ *
+ * @param[in] void
+ * @param[out] topic index into publishMe, -1 when no topic is ready
+ *
+ * @return index into publishMe, -1 when no topic is ready
+ */
+int32_t nextReadyTopic(void)
+{
+    int32_t topic = firstReadyTopic;
+
+    if ( -1 != topic )
     {
-        if ( (0 != publishMe[i].period) && (( nextPublishPeriod % publishMe[i].period ) == 0) )
+        firstReadyTopic = publishMe[ topic ].nextReady;
+        if ( -1 == firstReadyTopic )
         {
-            publishMe[i].publishReady = true;
-            numToPub++;
+            lastReadyTopic = -1;
+        }
+        publishMe[ topic ].publishReady = false;
+    }
+
+    return topic;
+}
+
+/**
+ * Tells how many ticks the publish thread can sleep before publishManager()
+ * has anything to do.
+ *
+ * @param[in] limit most ticks the caller wants to sleep
+ * @param[out] ticks ticks to sleep, 0 while topics are on the ready list
+ *
+ * @return ticks to sleep, 0 while topics are on the ready list
+ */
+uint32_t publishIdleTicks(uint32_t limit)
+{
+    uint32_t ticks = 0;
+
+    if ( -1 == firstReadyTopic )
+    {
+        ticks = wheel_next( &publishSchedule , limit );
+    }
+
+    return ticks;
+}
+
+
+/**
+ * Maps the heartbeat counter BARSM gives to the processes it watches for
+ * liveness. Without RC360_HEARTBEAT_FD in the environment the process is not
+ * watched and liveness_beat() does nothing.
+ *
+ * @param[in] void
+ * @param[out] success true/false status
+ *
+ * @return success true/false status of mapping the heartbeat counter
+ */
+bool liveness_init(void)
+{
+    bool success = true;
+    const char *fdVar = getenv(LIVENESS_FD_ENV);
+    void *page;
+
+    if ( NULL != fdVar )
+    {
+        // the descriptor stays open, a restarted BARSM takes the counter back
+        // from it
+        errno = 0;
+        page = mmap(NULL, sizeof(uint64_t), PROT_READ | PROT_WRITE, MAP_SHARED,
+                    atoi(fdVar), 0);
+        if ( MAP_FAILED == page )
+        {
+            syslog(LOG_ERR, "%s:%d unable to map the heartbeat counter (%d:%s)",
+                   __FUNCTION__, __LINE__, errno, strerror(errno));
+            success = false;
         }
         else
         {
-            publishMe[i].publishReady = false;
+            livenessCounter = (volatile uint64_t *)page;
         }
     }
 
-    return numToPub;
+    return success;
+}
+
+
+/**
+ * Tells BARSM that the process is still making progress. Has to be called at
+ * least once per heartbeat= period of the process manifest.
+ *
+ * @param[in] void
+ * @param[out] void
+ *
+ * @return void
+ */
+void liveness_beat(void)
+{
+    if ( NULL != livenessCounter )
+    {
+        (*livenessCounter)++;
+    }
 }
@@ -12,6 +12,8 @@
 #define __SIMMFUNCTIONS_H__
 #include <time.h>
 #include <sys/socket.h>
+#include "publish_wheel.h"
+#include "sensor_history.h"
 
 /****************
 * GLOBALS
@@ -26,7 +28,8 @@
 #endif
 
 #define UNUSED(x) (x)__attribute__((unused))
-// using this for now, while each MP must have the same PERIOD
+// sensor data comes in once per MINPER, an MP carries one sample per whole
+// MINPER of its period.  Periods themselves are any number of WHEEL_TICK_MS
                                                 // MILLSECONDS
 #define MINPER                                  1000
 #define MINPER_PFP_VALUE                        1000
@@ -57,6 +60,8 @@
  
 #define MAX_SIMM_SUBSCRIPTION                   33   
 #define MAX_TIMESTAMPS                          9  
+#define PUBLISH_HDR_SIZE                        14      // CMD_ID, LENGTH, TOPIC_ID, NUM_MPS, SEQ_NUM
+#define PUBLISHBUFSIZE                          8192    // largest PUBLISH, buildPublishData() keeps topics within it
 #define PI                                      3.1415926535897932384626433832795
 //SUBSCRIBE MP INFO
 typedef struct
@@ -68,6 +73,10 @@ typedef struct
     uint32_t numSamples;
     bool logical;
     bool valid;
+    bool due;                   // goes out with the next publish of its topic
+    wheelEntry schedule;        // valid MPs are scheduled on their period
+    const sensorHistory *history;   // the samples are the newest ones of column
+    uint32_t column;
 } MPinfo;
 
 //SUBSCRIBE TOPIC INFO
@@ -78,7 +87,8 @@ typedef struct
     uint32_t period;
     uint32_t numMPs;
     MPinfo *topicSubscription;
-    bool publishReady;
+    bool publishReady;          // some MP is due, the topic is on the ready list
+    int32_t nextReady;          // next topic on the ready list, -1 at the end
 } topicToPublish;
 
 extern topicToPublish *publishMe;
@@ -91,16 +101,6 @@ extern uint32_t voltages_toGet[5];
 extern uint32_t timestamps_toGet[9];
 extern uint32_t ts_HiLoCnt_toGet[3];
 
-extern uint32_t *pfp_values;
-extern uint32_t *ptlt_values;
-extern uint32_t *ptrt_values;
-extern uint32_t *tcmp_values;
-extern uint32_t *cop_values;
-extern uint32_t *cam_secs;
-extern uint32_t *cam_nsecs;
-
-extern uint32_t *cam_secs_chk;
-extern uint32_t *cam_nsecs_chk;
 extern int32_t num_mps; 
 extern int32_t MPnum;
 extern int32_t *sub_mp;
@@ -113,9 +113,6 @@ extern pid_t simmPid;
 extern uint32_t num_topics_total;
 extern uint32_t num_topics_atCurrentRate;
 extern uint32_t currentTopic;
-extern int32_t maxPublishPeriod; 
-extern int32_t prevPeriodChk;
-extern int32_t nextPublishPeriod;
 
 extern float *hannWindowCo;
 
@@ -225,10 +222,19 @@ enum topicIDs
 };
 
 
+// set by BARSM for a process it watches for liveness, see liveness_init()
+#define LIVENESS_FD_ENV     "RC360_HEARTBEAT_FD"
+
+// set by BARSM for a process it created sockets for, see UDPsetup()
+#define LISTEN_FDS_ENV      "RC360_LISTEN_FDS"
+#define LISTEN_FD_START     5
+
+// set by BARSM when AACM listens on an AF_UNIX socket instead of TCP, see AACMsetup()
+#define AACM_SOCKET_ENV     "RC360_AACM_SOCKET"
+
 /****************
 * PRIVATE FUNCTION PROTOTYPES
 ****************/
-int32_t getVarPeriod(void); 
 
 // at boot API processing
 bool process_registerApp( int32_t csocket , struct timespec goTime );
@@ -240,11 +246,17 @@ bool process_sysInit( int32_t csocket );
 
 // run-time API processing
 void process_publish( int32_t csocket , struct sockaddr_in addr_in , int32_t topic_to_pub );
+int32_t serializePublish( int32_t topic_to_pub , uint8_t *sendData );
 bool process_subscribe( int32_t csocket );
 bool process_subscribe_ack( int32_t csocket );
 bool process_HeartBeat( int32_t csocket, int32_t HeartBeat );
 bool numSecondsHaveElapsed( struct timespec startTime , struct timespec stopTime , int32_t numSeconds );
+bool compilePublishPlan( MPinfo *mpInfo );
 bool buildPublishData(void);
 int32_t publishManager(void);
+int32_t nextReadyTopic(void);
+uint32_t publishIdleTicks(uint32_t limit);
+bool liveness_init(void);
+void liveness_beat(void);
 
 #endif